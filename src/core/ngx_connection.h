@@ -51,6 +51,8 @@ struct ngx_listening_s {
     ngx_listening_t    *previous;
     ngx_connection_t   *connection;
 
+    ngx_uint_t          worker;
+
     unsigned            open:1;
     unsigned            remain:1;
     unsigned            ignore:1;
@@ -68,6 +70,11 @@ struct ngx_listening_s {
 #endif
     unsigned            keepalive:2;
 
+#if (NGX_HAVE_REUSEPORT)
+    unsigned            reuseport:1;
+    unsigned            add_reuseport:1;
+#endif
+
 #if (NGX_HAVE_DEFERRED_ACCEPT)
     unsigned            deferred_accept:1;
     unsigned            delete_deferred:1;
@@ -176,6 +183,11 @@ struct ngx_connection_s {
     ngx_buf_t          *busy_sendfile;
 #endif
 
+#if (NGX_HAVE_EPOLL)
+    uint32_t            epoll_events;    /* the requested epoll events */
+    uint32_t            epoll_active;    /* the events set in the kernel */
+#endif
+
 #if (NGX_THREADS)
     ngx_atomic_t        lock;
 #endif
@@ -184,6 +196,7 @@ struct ngx_connection_s {
 
 ngx_listening_t *ngx_create_listening(ngx_conf_t *cf, void *sockaddr,
     socklen_t socklen);
+ngx_int_t ngx_clone_listening(ngx_conf_t *cf, ngx_listening_t *ls);
 ngx_int_t ngx_set_inherited_sockets(ngx_cycle_t *cycle);
 ngx_int_t ngx_open_listening_sockets(ngx_cycle_t *cycle);
 void ngx_configure_listening_sockets(ngx_cycle_t *cycle);
@@ -9,6 +9,9 @@
 #include <ngx_core.h>
 
 
+ngx_uint_t  ngx_cpu_features;
+
+
 #if (( __i386__ || __amd64__ ) && ( __GNUC__ || __INTEL_COMPILER ))
 
 
@@ -55,7 +58,7 @@ ngx_cpuid(uint32_t i, uint32_t *buf)
 
         "cpuid"
 
-    : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (i) );
+    : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (i), "c" (0) );
 
     buf[0] = eax;
     buf[1] = ebx;
@@ -64,6 +67,21 @@ ngx_cpuid(uint32_t i, uint32_t *buf)
 }
 
 
+static ngx_inline uint32_t
+ngx_xgetbv(void)
+{
+    uint32_t  eax, edx;
+
+    __asm__ (
+
+        ".byte 0x0f, 0x01, 0xd0"
+
+    : "=a" (eax), "=d" (edx) : "c" (0) );
+
+    return eax;
+}
+
+
 #endif
 
 
@@ -125,6 +143,35 @@ ngx_cpuinfo(void)
     } else if (ngx_strcmp(vendor, "AuthenticAMD") == 0) {
         ngx_cacheline_size = 64;
     }
+
+    if (cpu[2] & 0x04000000) {
+        ngx_cpu_features |= NGX_CPU_SSE2;
+    }
+
+    if (cpu[3] & 0x00000200) {
+        ngx_cpu_features |= NGX_CPU_SSSE3;
+    }
+
+    if (cpu[3] & 0x00100000) {
+        ngx_cpu_features |= NGX_CPU_SSE42;
+    }
+
+#if ( __amd64__ )
+
+    /* AVX2 requires the OS to save the YMM state, see OSXSAVE and XCR0 */
+
+    if (vbuf[0] >= 7
+        && (cpu[3] & 0x18000000) == 0x18000000
+        && (ngx_xgetbv() & 0x6) == 0x6)
+    {
+        ngx_cpuid(7, cpu);
+
+        if (cpu[1] & 0x00000020) {
+            ngx_cpu_features |= NGX_CPU_AVX2;
+        }
+    }
+
+#endif
 }
 
 #else
@@ -8,6 +8,10 @@
 #include <ngx_config.h>
 #include <ngx_core.h>
 
+#if (NGX_HAVE_SIMD)
+#include <immintrin.h>
+#endif
+
 
 /*
  * The code and lookup tables are based on the algorithm
@@ -20,6 +24,9 @@
  * CRC32 loop, but the cache misses overhead is bigger than overhead of
  * the additional code.  For example, ngx_crc32_short() of 16 bytes of data
  * takes half as much CPU clocks than ngx_crc32_long().
+ *
+ * The long data are processed 8 bytes at a time using the "slicing-by-8"
+ * tables derived from the 256 element table in ngx_crc32_table_init().
  */
 
 
@@ -101,12 +108,28 @@ uint32_t  ngx_crc32_table256[] = {
 
 uint32_t *ngx_crc32_table_short = ngx_crc32_table16;
 
+static uint32_t  ngx_crc32_table8[8][256];
+static uint32_t  ngx_crc32c_table8[8][256];
+
+
+static void ngx_crc32_slice8_init(uint32_t table[][256], uint32_t poly);
+static uint32_t ngx_crc32_slice8(uint32_t table[][256], uint32_t crc,
+    u_char *p, size_t len);
+#if (NGX_HAVE_SIMD)
+static uint32_t ngx_crc32c_sse42(uint32_t crc, u_char *p, size_t len);
+#endif
+
 
 ngx_int_t
 ngx_crc32_table_init(void)
 {
     void  *p;
 
+    /* the reflected CRC-32 and CRC-32C polynomials */
+
+    ngx_crc32_slice8_init(ngx_crc32_table8, 0xedb88320);
+    ngx_crc32_slice8_init(ngx_crc32c_table8, 0x82f63b78);
+
     if (((uintptr_t) ngx_crc32_table_short
           & ~((uintptr_t) ngx_cacheline_size - 1))
         == (uintptr_t) ngx_crc32_table_short)
@@ -127,3 +150,121 @@ ngx_crc32_table_init(void)
 
     return NGX_OK;
 }
+
+
+static void
+ngx_crc32_slice8_init(uint32_t table[][256], uint32_t poly)
+{
+    uint32_t    crc;
+    ngx_uint_t  i, k;
+
+    for (i = 0; i < 256; i++) {
+        crc = i;
+
+        for (k = 0; k < 8; k++) {
+            crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+        }
+
+        table[0][i] = crc;
+    }
+
+    for (i = 0; i < 256; i++) {
+        crc = table[0][i];
+
+        for (k = 1; k < 8; k++) {
+            crc = table[0][crc & 0xff] ^ (crc >> 8);
+            table[k][i] = crc;
+        }
+    }
+}
+
+
+static uint32_t
+ngx_crc32_slice8(uint32_t table[][256], uint32_t crc, u_char *p, size_t len)
+{
+    uint32_t  lo, hi;
+
+    while (len >= 8) {
+        lo = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24);
+        hi = p[4] | p[5] << 8 | p[6] << 16 | (uint32_t) p[7] << 24;
+
+        crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff]
+              ^ table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24]
+              ^ table[3][hi & 0xff] ^ table[2][(hi >> 8) & 0xff]
+              ^ table[1][(hi >> 16) & 0xff] ^ table[0][hi >> 24];
+
+        p += 8;
+        len -= 8;
+    }
+
+    while (len--) {
+        crc = table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+
+void
+ngx_crc32_update_slice8(uint32_t *crc, u_char *p, size_t len)
+{
+    *crc = ngx_crc32_slice8(ngx_crc32_table8, *crc, p, len);
+}
+
+
+void
+ngx_crc32c_update(uint32_t *crc, u_char *p, size_t len)
+{
+#if (NGX_HAVE_SIMD)
+
+    if (ngx_cpu_features & NGX_CPU_SSE42) {
+        *crc = ngx_crc32c_sse42(*crc, p, len);
+        return;
+    }
+
+#endif
+
+    *crc = ngx_crc32_slice8(ngx_crc32c_table8, *crc, p, len);
+}
+
+
+#if (NGX_HAVE_SIMD)
+
+__attribute__ ((target("sse4.2")))
+static uint32_t
+ngx_crc32c_sse42(uint32_t crc, u_char *p, size_t len)
+{
+#if ( __amd64__ )
+    uint64_t  c, v;
+
+    c = crc;
+
+    while (len >= 8) {
+        ngx_memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        len -= 8;
+    }
+
+    crc = (uint32_t) c;
+
+#else
+    uint32_t  v;
+
+    while (len >= 4) {
+        ngx_memcpy(&v, p, 4);
+        crc = _mm_crc32_u32(crc, v);
+        p += 4;
+        len -= 4;
+    }
+
+#endif
+
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+
+    return crc;
+}
+
+#endif
@@ -17,6 +17,15 @@ extern uint32_t  *ngx_crc32_table_short;
 extern uint32_t   ngx_crc32_table256[];
 
 
+/* the shorter data are faster to process a byte at a time */
+
+#define NGX_CRC32_SLICE_MIN  32
+
+
+void ngx_crc32_update_slice8(uint32_t *crc, u_char *p, size_t len);
+void ngx_crc32c_update(uint32_t *crc, u_char *p, size_t len);
+
+
 static ngx_inline uint32_t
 ngx_crc32_short(u_char *p, size_t len)
 {
@@ -42,6 +51,11 @@ ngx_crc32_long(u_char *p, size_t len)
 
     crc = 0xffffffff;
 
+    if (len >= NGX_CRC32_SLICE_MIN) {
+        ngx_crc32_update_slice8(&crc, p, len);
+        return crc ^ 0xffffffff;
+    }
+
     while (len--) {
         crc = ngx_crc32_table256[(crc ^ *p++) & 0xff] ^ (crc >> 8);
     }
@@ -59,6 +73,11 @@ ngx_crc32_update(uint32_t *crc, u_char *p, size_t len)
 {
     uint32_t  c;
 
+    if (len >= NGX_CRC32_SLICE_MIN) {
+        ngx_crc32_update_slice8(crc, p, len);
+        return;
+    }
+
     c = *crc;
 
     while (len--) {
@@ -73,6 +92,33 @@ ngx_crc32_update(uint32_t *crc, u_char *p, size_t len)
     crc ^= 0xffffffff
 
 
+/*
+ * CRC-32C (Castagnoli) is computed by the SSE4.2 crc32 instruction,
+ * its values differ from the ngx_crc32_*() ones, so it should not be used
+ * for the checksums that are already stored somewhere
+ */
+
+static ngx_inline uint32_t
+ngx_crc32c(u_char *p, size_t len)
+{
+    uint32_t  crc;
+
+    crc = 0xffffffff;
+
+    ngx_crc32c_update(&crc, p, len);
+
+    return crc ^ 0xffffffff;
+}
+
+
+#define ngx_crc32c_init(crc)                                                  \
+    crc = 0xffffffff
+
+
+#define ngx_crc32c_final(crc)                                                 \
+    crc ^= 0xffffffff
+
+
 ngx_int_t ngx_crc32_table_init(void);
 
 
@@ -465,9 +465,13 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
             }
 
             if (shm_zone[i].tag == oshm_zone[n].tag
-                && shm_zone[i].shm.size == oshm_zone[n].shm.size)
+                && shm_zone[i].shm.size == oshm_zone[n].shm.size
+                && !shm_zone[i].noreuse
+                && ((shm_zone[i].shm.flags ^ oshm_zone[n].shm.flags)
+                    & (NGX_SHM_HUGEPAGES|NGX_SHM_PREFAULT)) == 0)
             {
                 shm_zone[i].shm.addr = oshm_zone[n].shm.addr;
+                shm_zone[i].shm.flags = oshm_zone[n].shm.flags;
 
                 if (shm_zone[i].init(&shm_zone[i], oshm_zone[n].data)
                     != NGX_OK)
@@ -517,6 +521,15 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
                     continue;
                 }
 
+                /*
+                 * per worker SO_REUSEPORT copies share the same address,
+                 * so each old socket may be taken over only once
+                 */
+
+                if (ls[i].remain) {
+                    continue;
+                }
+
                 if (ngx_cmp_sockaddr(nls[n].sockaddr, ls[i].sockaddr) == NGX_OK)
                 {
                     nls[n].fd = ls[i].fd;
@@ -562,6 +575,12 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
                         nls[n].add_deferred = 1;
                     }
 #endif
+
+#if (NGX_HAVE_REUSEPORT)
+                    if (nls[n].reuseport && !ls[i].reuseport) {
+                        nls[n].add_reuseport = 1;
+                    }
+#endif
                     break;
                 }
             }
@@ -612,7 +631,6 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
     /* 
      * 初始化所有模块.
      */
-    for (i = 0; ngx_modules[i]; i++) {
     for (i = 0; ngx_modules[i]; i++) {
         if (ngx_modules[i]->init_module) {
             if (ngx_modules[i]->init_module(cycle) != NGX_OK) {
@@ -942,6 +960,7 @@ ngx_init_zone_pool(ngx_cycle_t *cycle, ngx_shm_zone_t *zn)
 {
     u_char           *file;
     ngx_slab_pool_t  *sp;
+    ngx_core_conf_t  *ccf;
 
     sp = (ngx_slab_pool_t *) zn->shm.addr;
 
@@ -980,6 +999,16 @@ ngx_init_zone_pool(ngx_cycle_t *cycle, ngx_shm_zone_t *zn)
         return NGX_ERROR;
     }
 
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+
+    if (ccf->slab_cache) {
+        /* room for the workers, the helpers, and the workers being replaced */
+
+        sp->cache_size = ccf->slab_cache;
+        sp->ncaches = ngx_min(2 * (ngx_uint_t) ccf->worker_processes + 4,
+                              NGX_MAX_PROCESSES);
+    }
+
     ngx_slab_init(sp);
 
     return NGX_OK;
@@ -1340,8 +1369,10 @@ ngx_shared_memory_add(ngx_conf_t *cf, ngx_str_t *name, size_t size, void *tag)
     shm_zone->shm.size = size;
     shm_zone->shm.name = *name;
     shm_zone->shm.exists = 0;
+    shm_zone->shm.flags = 0;
     shm_zone->init = NULL;
     shm_zone->tag = tag;
+    shm_zone->noreuse = 0;
 
     return shm_zone;
 }
@@ -9,6 +9,74 @@
 #include <ngx_core.h>
 
 
+#if (NGX_HASH_PERFECT)
+
+/*
+ * a minimal perfect hash in the "compress, hash and displace" manner:
+ * keys are split into about nelts / NGX_HASH_PERFECT_LOAD groups,
+ * the groups are placed from the largest one, and a displacement pair
+ * (d0, d1) is found for each group so that the slots
+ * (f1 + d0 * f2 + d1) % size of all its keys are free;
+ * single key groups are placed directly into the first free slot
+ */
+
+#define NGX_HASH_PERFECT_LOAD     2
+#define NGX_HASH_PERFECT_SEEDS    8
+#define NGX_HASH_PERFECT_D0       16
+#define NGX_HASH_PERFECT_GROUP    64
+
+#define NGX_HASH_PERFECT_MUL      0x9e3779b97f4a7c15
+
+
+static ngx_int_t ngx_hash_perfect_init(ngx_hash_init_t *hinit,
+    ngx_hash_key_t *names, ngx_uint_t nelts);
+
+
+static ngx_inline uint64_t
+ngx_hash_perfect_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53;
+    h ^= h >> 33;
+
+    return h;
+}
+
+
+#define ngx_hash_perfect_range(x, n)                                          \
+    ((((uint64_t) (uint32_t) (x)) * (n)) >> 32)
+
+#define ngx_hash_perfect_group(h, ndisp)                                      \
+    ngx_hash_perfect_range(h, ndisp)
+
+#define ngx_hash_perfect_f1(h, size)                                          \
+    ngx_hash_perfect_range((h) >> 32, size)
+
+#define ngx_hash_perfect_f2(h, size)                                          \
+    ngx_hash_perfect_range(((h) * NGX_HASH_PERFECT_MUL) >> 32, size)
+
+
+static ngx_inline ngx_uint_t
+ngx_hash_perfect_index(ngx_hash_t *hash, ngx_uint_t key)
+{
+    uint64_t          h;
+    ngx_hash_disp_t  *d;
+
+    h = ngx_hash_perfect_mix((uint64_t) key ^ hash->seed);
+
+    d = &hash->disp[ngx_hash_perfect_group(h, hash->ndisp)];
+
+    return (ngx_uint_t) ((ngx_hash_perfect_f1(h, hash->size)
+                          + d->d0 * ngx_hash_perfect_f2(h, hash->size)
+                          + d->d1)
+                         % hash->size);
+}
+
+#endif
+
+
 void *
 ngx_hash_find(ngx_hash_t *hash, ngx_uint_t key, u_char *name, size_t len)
 {
@@ -19,8 +87,21 @@ ngx_hash_find(ngx_hash_t *hash, ngx_uint_t key, u_char *name, size_t len)
     ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0, "hf:\"%*s\"", len, name);
 #endif
 
+#if (NGX_HASH_PERFECT)
+
+    if (hash->disp) {
+        elt = hash->buckets[ngx_hash_perfect_index(hash, key)];
+
+    } else {
+        elt = hash->buckets[key % hash->size];
+    }
+
+#else
+
     elt = hash->buckets[key % hash->size];
 
+#endif
+
     if (elt == NULL) {
         return NULL;
     }
@@ -270,6 +351,22 @@ ngx_hash_init(ngx_hash_init_t *hinit, ngx_hash_key_t *names, ngx_uint_t nelts)
         }
     }
 
+#if (NGX_HASH_PERFECT)
+
+    switch (ngx_hash_perfect_init(hinit, names, nelts)) {
+
+    case NGX_OK:
+        return NGX_OK;
+
+    case NGX_ERROR:
+        return NGX_ERROR;
+
+    default: /* NGX_DECLINED */
+        break;
+    }
+
+#endif
+
     /*
      * 临时计数数组
      * test[i] = buckets[i]所占内存大小
@@ -450,6 +547,10 @@ found:
     hinit->hash->buckets = buckets;
     hinit->hash->size = size;
 
+#if (NGX_HASH_PERFECT)
+    hinit->hash->disp = NULL;
+#endif
+
 #if 0
 
     for (i = 0; i < size; i++) {
@@ -484,6 +585,342 @@ found:
 }
 
 
+#if (NGX_HASH_PERFECT)
+
+static ngx_int_t
+ngx_hash_perfect_init(ngx_hash_init_t *hinit, ngx_hash_key_t *names,
+    ngx_uint_t nelts)
+{
+    u_char           *p, *elts, *taken;
+    size_t            len;
+    uint64_t          h, seed, *hv;
+    ngx_uint_t        i, j, n, k, m, b, s, d0, d1, idx, size, ndisp, e, empty,
+                      maxk, *start, *order, *leader, *slot, *off, *nk,
+                      *groups;
+    ngx_hash_elt_t   *elt, **buckets;
+    ngx_hash_disp_t  *disp;
+
+    n = 0;
+
+    for (i = 0; i < nelts; i++) {
+        if (names[i].key.data) {
+            n++;
+        }
+    }
+
+    if (n == 0) {
+        return NGX_DECLINED;
+    }
+
+    ndisp = n / NGX_HASH_PERFECT_LOAD + 1;
+
+    p = ngx_alloc(nelts * (sizeof(uint64_t) + 3 * sizeof(ngx_uint_t))
+                  + n * (sizeof(ngx_uint_t) + 1)
+                  + ndisp * (sizeof(ngx_hash_disp_t) + 2 * sizeof(ngx_uint_t))
+                  + (n + 2) * sizeof(ngx_uint_t),
+                  hinit->pool->log);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    hv = (uint64_t *) p;
+    order = (ngx_uint_t *) &hv[nelts];
+    leader = &order[nelts];
+    slot = &leader[nelts];
+    off = &slot[nelts];
+    start = &off[n];
+    groups = &start[ndisp];
+    nk = &groups[ndisp];
+    disp = (ngx_hash_disp_t *) &nk[n + 2];
+    taken = (u_char *) &disp[ndisp];
+
+    seed = 0;
+    size = 0;
+
+    for (s = 0; s < NGX_HASH_PERFECT_SEEDS; s++) {
+
+        seed = s * NGX_HASH_PERFECT_MUL;
+
+        /* distribute the keys among the groups */
+
+        ngx_memzero(start, ndisp * sizeof(ngx_uint_t));
+
+        for (i = 0; i < nelts; i++) {
+            if (names[i].key.data == NULL) {
+                continue;
+            }
+
+            hv[i] = ngx_hash_perfect_mix((uint64_t) names[i].key_hash ^ seed);
+            start[ngx_hash_perfect_group(hv[i], ndisp)]++;
+        }
+
+        for (b = 0, j = 0; b < ndisp; b++) {
+            j += start[b];
+            start[b] = j;
+        }
+
+        for (i = nelts; i--; /* void */) {
+            if (names[i].key.data) {
+                order[--start[ngx_hash_perfect_group(hv[i], ndisp)]] = i;
+            }
+        }
+
+        /*
+         * the keys with equal hash values cannot be told apart
+         * and share a slot, the same as in the regular hash
+         */
+
+        ngx_memzero(nk, (n + 2) * sizeof(ngx_uint_t));
+
+        m = 0;
+        maxk = 0;
+
+        for (b = 0; b < ndisp; b++) {
+            e = (b + 1 < ndisp) ? start[b + 1] : n;
+
+            if (e - start[b] > NGX_HASH_PERFECT_GROUP) {
+                goto failed;
+            }
+
+            k = 0;
+
+            for (j = start[b]; j < e; j++) {
+                i = order[j];
+                leader[i] = i;
+
+                for (idx = start[b]; idx < j; idx++) {
+                    if (names[order[idx]].key_hash == names[i].key_hash) {
+                        leader[i] = leader[order[idx]];
+                        break;
+                    }
+                }
+
+                if (leader[i] == i) {
+                    k++;
+                }
+            }
+
+            nk[k + 1]++;
+            m += k;
+
+            if (k > maxk) {
+                maxk = k;
+            }
+        }
+
+        /* sort the groups by the number of distinct keys, largest first */
+
+        for (k = maxk + 1, j = 0; k--; /* void */) {
+            idx = nk[k + 1];
+            nk[k + 1] = j;
+            j += idx;
+        }
+
+        for (b = 0; b < ndisp; b++) {
+            e = (b + 1 < ndisp) ? start[b + 1] : n;
+
+            for (k = 0, j = start[b]; j < e; j++) {
+                if (leader[order[j]] == order[j]) {
+                    k++;
+                }
+            }
+
+            groups[nk[k + 1]++] = b;
+        }
+
+        /* place the groups */
+
+        size = m;
+
+        ngx_memzero(taken, size);
+        empty = 0;
+
+        for (j = 0; j < ndisp; j++) {
+            b = groups[j];
+            e = (b + 1 < ndisp) ? start[b + 1] : n;
+
+            disp[b].d0 = 0;
+            disp[b].d1 = 0;
+
+            k = 0;
+
+            for (idx = start[b]; idx < e; idx++) {
+                if (leader[order[idx]] == order[idx]) {
+                    off[k++] = order[idx];
+                }
+            }
+
+            if (k == 0) {
+                continue;
+            }
+
+            if (k == 1) {
+                while (taken[empty]) {
+                    empty++;
+                }
+
+                h = hv[off[0]];
+
+                disp[b].d1 = (uint32_t)
+                             ((empty + size - ngx_hash_perfect_f1(h, size)) % size);
+
+                slot[off[0]] = empty;
+                taken[empty] = 1;
+
+                continue;
+            }
+
+            for (d0 = 0; d0 < NGX_HASH_PERFECT_D0; d0++) {
+                for (d1 = 0; d1 < size; d1++) {
+
+                    for (i = 0; i < k; i++) {
+                        h = hv[off[i]];
+
+                        idx = (ngx_uint_t) ((ngx_hash_perfect_f1(h, size)
+                                             + d0 * ngx_hash_perfect_f2(h, size)
+                                             + d1)
+                                            % size);
+
+                        if (taken[idx]) {
+                            break;
+                        }
+
+                        taken[idx] = 1;
+                        slot[off[i]] = idx;
+                    }
+
+                    if (i == k) {
+                        disp[b].d0 = (uint32_t) d0;
+                        disp[b].d1 = (uint32_t) d1;
+                        goto placed;
+                    }
+
+                    while (i--) {
+                        taken[slot[off[i]]] = 0;
+                    }
+                }
+            }
+
+            goto failed;
+
+        placed:
+
+            continue;
+        }
+
+        goto found;
+
+    failed:
+
+        continue;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_CORE, hinit->pool->log, 0,
+                   "perfect %s was not found, falling back", hinit->name);
+
+    ngx_free(p);
+
+    return NGX_DECLINED;
+
+found:
+
+    /* lay out the slots, each one is terminated by a NULL value */
+
+    for (i = 0; i < size; i++) {
+        off[i] = sizeof(void *);
+    }
+
+    for (i = 0; i < nelts; i++) {
+        if (names[i].key.data == NULL) {
+            continue;
+        }
+
+        slot[i] = slot[leader[i]];
+        off[slot[i]] += NGX_HASH_ELT_SIZE(&names[i]);
+    }
+
+    len = 0;
+
+    for (i = 0; i < size; i++) {
+        idx = off[i];
+        off[i] = len;
+        len += idx;
+    }
+
+    if (hinit->hash == NULL) {
+        hinit->hash = ngx_pcalloc(hinit->pool, sizeof(ngx_hash_wildcard_t)
+                                             + size * sizeof(ngx_hash_elt_t *));
+        if (hinit->hash == NULL) {
+            ngx_free(p);
+            return NGX_ERROR;
+        }
+
+        buckets = (ngx_hash_elt_t **)
+                      ((u_char *) hinit->hash + sizeof(ngx_hash_wildcard_t));
+
+    } else {
+        buckets = ngx_pcalloc(hinit->pool, size * sizeof(ngx_hash_elt_t *));
+        if (buckets == NULL) {
+            ngx_free(p);
+            return NGX_ERROR;
+        }
+    }
+
+    elts = ngx_palloc(hinit->pool, len + ngx_cacheline_size);
+    if (elts == NULL) {
+        ngx_free(p);
+        return NGX_ERROR;
+    }
+
+    elts = ngx_align_ptr(elts, ngx_cacheline_size);
+
+    for (i = 0; i < size; i++) {
+        buckets[i] = (ngx_hash_elt_t *) (elts + off[i]);
+        off[i] = 0;
+    }
+
+    for (i = 0; i < nelts; i++) {
+        if (names[i].key.data == NULL) {
+            continue;
+        }
+
+        elt = (ngx_hash_elt_t *) ((u_char *) buckets[slot[i]] + off[slot[i]]);
+
+        elt->value = names[i].value;
+        elt->len = (u_short) names[i].key.len;
+
+        ngx_strlow(elt->name, names[i].key.data, names[i].key.len);
+
+        off[slot[i]] += NGX_HASH_ELT_SIZE(&names[i]);
+    }
+
+    for (i = 0; i < size; i++) {
+        elt = (ngx_hash_elt_t *) ((u_char *) buckets[i] + off[i]);
+        elt->value = NULL;
+    }
+
+    hinit->hash->disp = ngx_palloc(hinit->pool,
+                                   ndisp * sizeof(ngx_hash_disp_t));
+    if (hinit->hash->disp == NULL) {
+        ngx_free(p);
+        return NGX_ERROR;
+    }
+
+    ngx_memcpy(hinit->hash->disp, disp, ndisp * sizeof(ngx_hash_disp_t));
+
+    ngx_free(p);
+
+    hinit->hash->buckets = buckets;
+    hinit->hash->size = size;
+    hinit->hash->ndisp = ndisp;
+    hinit->hash->seed = seed;
+
+    return NGX_OK;
+}
+
+#endif
+
+
 ngx_int_t
 ngx_hash_wildcard_init(ngx_hash_init_t *hinit, ngx_hash_key_t *names,
     ngx_uint_t nelts)
@@ -20,9 +20,24 @@ typedef struct {
 } ngx_hash_elt_t;
 
 
+#if (NGX_HASH_PERFECT)
+
+typedef struct {
+    uint32_t          d0;
+    uint32_t          d1;
+} ngx_hash_disp_t;
+
+#endif
+
+
 typedef struct {
     ngx_hash_elt_t  **buckets;
     ngx_uint_t        size;
+#if (NGX_HASH_PERFECT)
+    ngx_hash_disp_t  *disp;
+    ngx_uint_t        ndisp;
+    uint64_t          seed;
+#endif
 } ngx_hash_t;
 
 
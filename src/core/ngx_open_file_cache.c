@@ -8,6 +8,9 @@
 #include <ngx_config.h>
 #include <ngx_core.h>
 #include <ngx_event.h>
+#if (NGX_THREAD_POOL)
+#include <ngx_thread_pool.h>
+#endif
 
 
 /*
@@ -21,6 +24,17 @@
 #define NGX_MIN_READ_AHEAD  (128 * 1024)
 
 
+#if (NGX_THREAD_POOL)
+
+typedef struct {
+    ngx_str_t                 name;
+    ngx_open_file_info_t      of;
+    ngx_int_t                 rc;
+} ngx_thread_open_ctx_t;
+
+#endif
+
+
 static void ngx_open_file_cache_cleanup(void *data);
 #if (NGX_HAVE_OPENAT)
 static ngx_fd_t ngx_openat_file_owner(ngx_fd_t at_fd, const u_char *name,
@@ -33,6 +47,13 @@ static ngx_int_t ngx_file_info_wrapper(ngx_str_t *name,
     ngx_open_file_info_t *of, ngx_file_info_t *fi, ngx_log_t *log);
 static ngx_int_t ngx_open_and_stat_file(ngx_str_t *name,
     ngx_open_file_info_t *of, ngx_log_t *log);
+#if (NGX_THREAD_POOL)
+static ngx_int_t ngx_thread_open_and_stat_file(ngx_str_t *name,
+    ngx_open_file_info_t *of, ngx_pool_t *pool);
+static void ngx_thread_open_handler(void *data, ngx_log_t *log);
+static void ngx_thread_open_discard(ngx_thread_task_t *task, ngx_log_t *log);
+static void ngx_thread_open_cleanup(void *data);
+#endif
 static void ngx_open_file_add_event(ngx_open_file_cache_t *cache,
     ngx_cached_open_file_t *file, ngx_open_file_info_t *of, ngx_log_t *log);
 static void ngx_open_file_cleanup(void *data);
@@ -179,6 +200,17 @@ ngx_open_cached_file(ngx_open_file_cache_t *cache, ngx_str_t *name,
             return NGX_ERROR;
         }
 
+#if (NGX_THREAD_POOL)
+
+        if (of->thread_handler) {
+            rc = ngx_thread_open_and_stat_file(name, of, pool);
+
+            if (rc == NGX_AGAIN) {
+                return rc;
+            }
+
+        } else
+#endif
         rc = ngx_open_and_stat_file(name, of, pool->log);
 
         if (rc == NGX_OK && !of->is_dir) {
@@ -200,12 +232,18 @@ ngx_open_cached_file(ngx_open_file_cache_t *cache, ngx_str_t *name,
 
     now = ngx_time();
 
-    hash = ngx_crc32_long(name->data, name->len);
+    hash = ngx_crc32c(name->data, name->len);
 
     file = ngx_open_file_lookup(cache, name, hash);
 
     if (file) {
 
+#if (NGX_THREAD_POOL)
+        if (of->thread_task) {
+            ngx_thread_open_discard(of->thread_task, pool->log);
+        }
+#endif
+
         file->uses++;
 
         ngx_queue_remove(&file->queue);
@@ -347,6 +385,17 @@ ngx_open_cached_file(ngx_open_file_cache_t *cache, ngx_str_t *name,
 
     /* not found */
 
+#if (NGX_THREAD_POOL)
+
+    if (of->thread_handler) {
+        rc = ngx_thread_open_and_stat_file(name, of, pool);
+
+        if (rc == NGX_AGAIN) {
+            return rc;
+        }
+
+    } else
+#endif
     rc = ngx_open_and_stat_file(name, of, pool->log);
 
     if (rc != NGX_OK && (of->err == 0 || !of->errors)) {
@@ -879,6 +928,123 @@ done:
 }
 
 
+#if (NGX_THREAD_POOL)
+
+static ngx_int_t
+ngx_thread_open_and_stat_file(ngx_str_t *name, ngx_open_file_info_t *of,
+    ngx_pool_t *pool)
+{
+    ngx_pool_cleanup_t     *cln;
+    ngx_thread_task_t      *task;
+    ngx_thread_open_ctx_t  *ctx;
+
+    task = of->thread_task;
+
+    if (task == NULL) {
+        cln = ngx_pool_cleanup_add(pool, 0);
+        if (cln == NULL) {
+            return NGX_ERROR;
+        }
+
+        task = ngx_thread_task_alloc(pool, sizeof(ngx_thread_open_ctx_t));
+        if (task == NULL) {
+            return NGX_ERROR;
+        }
+
+        cln->handler = ngx_thread_open_cleanup;
+        cln->data = task;
+
+        of->thread_task = task;
+    }
+
+    ctx = task->ctx;
+
+    if (task->event.complete) {
+        task->event.complete = 0;
+
+        if (ctx->name.len == name->len
+            && ngx_strncmp(ctx->name.data, name->data, name->len) == 0)
+        {
+            ctx->of.thread_handler = of->thread_handler;
+            ctx->of.thread_ctx = of->thread_ctx;
+            ctx->of.thread_task = of->thread_task;
+
+            *of = ctx->of;
+
+            return ctx->rc;
+        }
+
+        /* the result of the request for another name */
+
+        task->event.complete = 1;
+        ngx_thread_open_discard(task, pool->log);
+    }
+
+    ctx->name.len = name->len;
+    ctx->name.data = ngx_pnalloc(pool, name->len + 1);
+    if (ctx->name.data == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_cpystrn(ctx->name.data, name->data, name->len + 1);
+
+    ctx->of = *of;
+
+    task->handler = ngx_thread_open_handler;
+
+    if (of->thread_handler(task, of->thread_ctx) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    return NGX_AGAIN;
+}
+
+
+static void
+ngx_thread_open_handler(void *data, ngx_log_t *log)
+{
+    ngx_thread_open_ctx_t *ctx = data;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_CORE, log, 0,
+                   "thread open handler: \"%V\"", &ctx->name);
+
+    ctx->rc = ngx_open_and_stat_file(&ctx->name, &ctx->of, log);
+}
+
+
+static void
+ngx_thread_open_discard(ngx_thread_task_t *task, ngx_log_t *log)
+{
+    ngx_thread_open_ctx_t  *ctx;
+
+    if (!task->event.complete) {
+        return;
+    }
+
+    task->event.complete = 0;
+
+    ctx = task->ctx;
+
+    if (ctx->rc == NGX_OK && ctx->of.fd != NGX_INVALID_FILE) {
+        if (ngx_close_file(ctx->of.fd) == NGX_FILE_ERROR) {
+            ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                          ngx_close_file_n " \"%V\" failed", &ctx->name);
+        }
+    }
+}
+
+
+static void
+ngx_thread_open_cleanup(void *data)
+{
+    ngx_thread_task_t  *task = data;
+
+    ngx_thread_open_discard(task, ngx_cycle->log);
+}
+
+#endif
+
+
 /*
  * we ignore any possible event setting error and
  * fallback to usual periodic file retests
@@ -32,6 +32,13 @@ typedef struct {
 
     ngx_uint_t               min_uses;
 
+#if (NGX_THREAD_POOL)
+    ngx_int_t              (*thread_handler)(ngx_thread_task_t *task,
+                                             void *data);
+    void                    *thread_ctx;
+    ngx_thread_task_t       *thread_task;
+#endif
+
 #if (NGX_HAVE_OPENAT)
     size_t                   disable_symlinks_from;
     unsigned                 disable_symlinks:2;
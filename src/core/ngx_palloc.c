@@ -11,6 +11,25 @@
 
 static void *ngx_palloc_block(ngx_pool_t *pool, size_t size);
 static void *ngx_palloc_large(ngx_pool_t *pool, size_t size);
+static void *ngx_get_cached_block(size_t size, ngx_log_t *log);
+static void ngx_free_cached_block(void *p, size_t size);
+
+
+#define NGX_POOL_CACHE_SLOTS  16
+
+typedef struct ngx_cached_block_s  ngx_cached_block_t;
+
+struct ngx_cached_block_s {
+    ngx_cached_block_t  *next;
+};
+
+
+size_t               ngx_pool_cache_max;
+ngx_uint_t           ngx_pool_cache_hits;
+ngx_uint_t           ngx_pool_cache_misses;
+
+static size_t               ngx_pool_cache_size;
+static ngx_cached_block_t  *ngx_pool_cache[NGX_POOL_CACHE_SLOTS];
 
 
 /**
@@ -27,7 +46,7 @@ ngx_create_pool(size_t size, ngx_log_t *log)
     ngx_pool_t  *p;
 
     /* 申请已对齐的内存 */
-    p = ngx_memalign(NGX_POOL_ALIGNMENT, size, log);
+    p = ngx_get_cached_block(size, log);
     if (p == NULL) {
         return NULL;
     }
@@ -102,7 +121,7 @@ ngx_destroy_pool(ngx_pool_t *pool)
 
     /* 释放内存块链表 */
     for (p = pool, n = pool->d.next; /* void */; p = n, n = n->d.next) {
-        ngx_free(p);
+        ngx_free_cached_block(p, p->d.end - (u_char *) p);
 
         if (n == NULL) {
             break;
@@ -245,7 +264,7 @@ ngx_palloc_block(ngx_pool_t *pool, size_t size)
     psize = (size_t) (pool->d.end - (u_char *) pool);
 
     /* 申请一块新的内存块来扩充当前内存池 */
-    m = ngx_memalign(NGX_POOL_ALIGNMENT, psize, pool->log);
+    m = ngx_get_cached_block(psize, pool->log);
     if (m == NULL) {
         return NULL;
     }
@@ -523,30 +542,54 @@ ngx_pool_delete_file(void *data)
 }
 
 
-#if 0
+/*
+ * a worker keeps up to ngx_pool_cache_max bytes of freed pool blocks
+ * of 1 to NGX_POOL_CACHE_SLOTS pages in the per-size free lists,
+ * other blocks are allocated and freed as usual
+ */
 
 static void *
-ngx_get_cached_block(size_t size)
+ngx_get_cached_block(size_t size, ngx_log_t *log)
 {
-    void                     *p;
-    ngx_cached_block_slot_t  *slot;
+    ngx_uint_t           n;
+    ngx_cached_block_t  *b;
+
+    if (ngx_pool_cache_max
+        && (size & (ngx_pagesize - 1)) == 0
+        && (n = size >> ngx_pagesize_shift) <= NGX_POOL_CACHE_SLOTS)
+    {
+        b = ngx_pool_cache[n - 1];
+
+        if (b) {
+            ngx_pool_cache[n - 1] = b->next;
+            ngx_pool_cache_size -= size;
+            ngx_pool_cache_hits++;
+            return b;
+        }
 
-    if (ngx_cycle->cache == NULL) {
-        return NULL;
+        ngx_pool_cache_misses++;
     }
 
-    slot = &ngx_cycle->cache[(size + ngx_pagesize - 1) / ngx_pagesize];
+    return ngx_memalign(NGX_POOL_ALIGNMENT, size, log);
+}
 
-    slot->tries++;
 
-    if (slot->number) {
-        p = slot->block;
-        slot->block = slot->block->next;
-        slot->number--;
-        return p;
+static void
+ngx_free_cached_block(void *p, size_t size)
+{
+    ngx_uint_t           n;
+    ngx_cached_block_t  *b;
+
+    if (ngx_pool_cache_size + size <= ngx_pool_cache_max
+        && (size & (ngx_pagesize - 1)) == 0
+        && (n = size >> ngx_pagesize_shift) <= NGX_POOL_CACHE_SLOTS)
+    {
+        b = p;
+        b->next = ngx_pool_cache[n - 1];
+        ngx_pool_cache[n - 1] = b;
+        ngx_pool_cache_size += size;
+        return;
     }
 
-    return NULL;
+    ngx_free(p);
 }
-
-#endif
@@ -72,6 +72,11 @@ typedef struct {
     ngx_log_t            *log;
 } ngx_pool_cleanup_file_t;
 
+extern size_t      ngx_pool_cache_max;
+extern ngx_uint_t  ngx_pool_cache_hits;
+extern ngx_uint_t  ngx_pool_cache_misses;
+
+
 /* 不用内存池申请内存 */
 void *ngx_alloc(size_t size, ngx_log_t *log);
 void *ngx_calloc(size_t size, ngx_log_t *log);
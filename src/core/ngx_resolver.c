@@ -369,7 +369,7 @@ ngx_resolve_name_done(ngx_resolver_ctx_t *ctx)
 
     if (ctx->state == NGX_AGAIN || ctx->state == NGX_RESOLVE_TIMEDOUT) {
 
-        hash = ngx_crc32_short(ctx->name.data, ctx->name.len);
+        hash = ngx_crc32c(ctx->name.data, ctx->name.len);
 
         rn = ngx_resolver_lookup_name(r, &ctx->name, hash);
 
@@ -423,7 +423,7 @@ ngx_resolve_name_locked(ngx_resolver_t *r, ngx_resolver_ctx_t *ctx)
     ngx_resolver_ctx_t   *next;
     ngx_resolver_node_t  *rn;
 
-    hash = ngx_crc32_short(ctx->name.data, ctx->name.len);
+    hash = ngx_crc32c(ctx->name.data, ctx->name.len);
 
     rn = ngx_resolver_lookup_name(r, &ctx->name, hash);
 
@@ -467,6 +467,7 @@ ngx_resolve_name_locked(ngx_resolver_t *r, ngx_resolver_ctx_t *ctx)
                     ctx->naddrs = naddrs;
                     ctx->addrs = (naddrs == 1) ? &ctx->addr : addrs;
                     ctx->addr = addr;
+                    ctx->valid = rn->valid;
                     next = ctx->next;
 
                     ctx->handler(ctx);
@@ -1191,7 +1192,7 @@ ngx_resolver_process_a(ngx_resolver_t *r, u_char *buf, size_t last,
 
     ngx_log_debug1(NGX_LOG_DEBUG_CORE, r->log, 0, "resolver qs:%V", &name);
 
-    hash = ngx_crc32_short(name.data, name.len);
+    hash = ngx_crc32c(name.data, name.len);
 
     /* lock name mutex */
 
@@ -1409,6 +1410,7 @@ ngx_resolver_process_a(ngx_resolver_t *r, u_char *buf, size_t last,
              ctx->naddrs = naddrs;
              ctx->addrs = (naddrs == 1) ? &ctx->addr : addrs;
              ctx->addr = addr;
+             ctx->valid = rn->valid;
              next = ctx->next;
 
              ctx->handler(ctx);
@@ -123,6 +123,7 @@ struct ngx_resolver_ctx_s {
     ngx_uint_t                naddrs;
     in_addr_t                *addrs;
     in_addr_t                 addr;
+    time_t                    valid;
 
     ngx_resolver_handler_pt   handler;
     void                     *data;
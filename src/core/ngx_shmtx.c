@@ -13,12 +13,35 @@
 
 
 static void ngx_shmtx_wakeup(ngx_shmtx_t *mtx);
+static void ngx_shmtx_lock_contended(ngx_shmtx_t *mtx);
+static ngx_atomic_uint_t ngx_shmtx_usec(void);
+
+
+#if (NGX_HAVE_FUTEX)
+
+/* futex() waits on the low 32 bits of the lock, that is the owner pid */
+
+#if (NGX_HAVE_LITTLE_ENDIAN)
+#define ngx_shmtx_futex(mtx)      ((uint32_t *) (mtx)->lock)
+#else
+#define ngx_shmtx_futex(mtx)                                                  \
+    ((uint32_t *) (mtx)->lock + sizeof(ngx_atomic_t) / sizeof(uint32_t) - 1)
+#endif
+
+#define NGX_SHMTX_MIN_SPIN        16
+
+#endif
 
 
 ngx_int_t
 ngx_shmtx_create(ngx_shmtx_t *mtx, ngx_shmtx_sh_t *addr, u_char *name)
 {
     mtx->lock = &addr->lock;
+    mtx->sh = addr;
+
+#if (NGX_HAVE_FUTEX)
+    mtx->wait = &addr->wait;
+#endif
 
     if (mtx->spin == (ngx_uint_t) -1) {
         return NGX_OK;
@@ -26,7 +49,13 @@ ngx_shmtx_create(ngx_shmtx_t *mtx, ngx_shmtx_sh_t *addr, u_char *name)
 
     mtx->spin = 2048;
 
-#if (NGX_HAVE_POSIX_SEM)
+#if (NGX_HAVE_FUTEX)
+
+    if (addr->spin == 0) {
+        addr->spin = NGX_SHMTX_MIN_SPIN;
+    }
+
+#elif (NGX_HAVE_POSIX_SEM)
 
     mtx->wait = &addr->wait;
 
@@ -46,7 +75,7 @@ ngx_shmtx_create(ngx_shmtx_t *mtx, ngx_shmtx_sh_t *addr, u_char *name)
 void
 ngx_shmtx_destroy(ngx_shmtx_t *mtx)
 {
-#if (NGX_HAVE_POSIX_SEM)
+#if (NGX_HAVE_POSIX_SEM && !NGX_HAVE_FUTEX)
 
     if (mtx->semaphore) {
         if (sem_destroy(&mtx->sem) == -1) {
@@ -62,22 +91,147 @@ ngx_shmtx_destroy(ngx_shmtx_t *mtx)
 ngx_uint_t
 ngx_shmtx_trylock(ngx_shmtx_t *mtx)
 {
-    return (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid));
+    if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
+        mtx->sh->acquired++;
+        return 1;
+    }
+
+    return 0;
 }
 
 
 void
 ngx_shmtx_lock(ngx_shmtx_t *mtx)
 {
-    ngx_uint_t         i, n;
-
     ngx_log_debug0(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0, "shmtx lock");
 
+    if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
+        mtx->sh->acquired++;
+        return;
+    }
+
+    ngx_shmtx_lock_contended(mtx);
+}
+
+
+#if (NGX_HAVE_FUTEX)
+
+/*
+ * The spinning is bounded by the spin count that was enough to get
+ * the lock recently, so the waiters go to sleep early if the lock is held
+ * for a long time.  The spinning also stops if the lock goes to another
+ * owner: the new owner has just started, and the wait will be long.
+ */
+
+static void
+ngx_shmtx_lock_contended(ngx_shmtx_t *mtx)
+{
+    ngx_uint_t         n, spin, spins, sleeps;
+    ngx_atomic_uint_t  owner, start;
+
+    start = ngx_shmtx_usec();
+    spins = 0;
+    sleeps = 0;
+
     for ( ;; ) {
 
+        owner = *mtx->lock;
+
+        if (ngx_ncpu > 1) {
+
+            spin = ngx_min(2 * mtx->sh->spin, mtx->spin);
+
+            for (n = 1; n <= spin; n++) {
+
+                ngx_cpu_pause();
+
+                if (*mtx->lock == 0
+                    && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid))
+                {
+                    spins += n;
+                    goto locked;
+                }
+
+                if (*mtx->lock != owner && *mtx->lock != 0) {
+                    break;
+                }
+            }
+
+            spins += n;
+        }
+
+        (void) ngx_atomic_fetch_add(mtx->wait, 1);
+
+        owner = *mtx->lock;
+
+        if (owner == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
+            (void) ngx_atomic_fetch_add(mtx->wait, -1);
+            goto locked;
+        }
+
+        ngx_log_debug1(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
+                       "shmtx wait %uA", owner);
+
+        if (syscall(SYS_futex, ngx_shmtx_futex(mtx), FUTEX_WAIT,
+                    (uint32_t) owner, NULL, NULL, 0)
+            == -1)
+        {
+            ngx_err_t  err;
+
+            err = ngx_errno;
+
+            if (err != NGX_EAGAIN && err != NGX_EINTR) {
+                ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, err,
+                              "futex(FUTEX_WAIT) failed while waiting on shmtx");
+                ngx_sched_yield();
+            }
+        }
+
+        (void) ngx_atomic_fetch_add(mtx->wait, -1);
+
+        sleeps++;
+
         if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
-            return;
+            goto locked;
         }
+    }
+
+locked:
+
+    /* the statistics are updated under the lock */
+
+    if (sleeps == 0) {
+        mtx->sh->spin += ((ngx_atomic_int_t) spins
+                          - (ngx_atomic_int_t) mtx->sh->spin) / 8;
+
+    } else {
+        mtx->sh->spin -= mtx->sh->spin / 8;
+    }
+
+    if (mtx->sh->spin < NGX_SHMTX_MIN_SPIN) {
+        mtx->sh->spin = NGX_SHMTX_MIN_SPIN;
+    }
+
+    mtx->sh->acquired++;
+    mtx->sh->contended++;
+    mtx->sh->spins += spins;
+    mtx->sh->sleeps += sleeps;
+    mtx->sh->wait_time += ngx_shmtx_usec() - start;
+}
+
+#else
+
+static void
+ngx_shmtx_lock_contended(ngx_shmtx_t *mtx)
+{
+    ngx_uint_t         i, n, spins, sleeps;
+    ngx_atomic_uint_t  start;
+
+    start = ngx_shmtx_usec();
+    spins = 0;
+    sleeps = 0;
+
+    for ( ;; ) {
 
         if (ngx_ncpu > 1) {
 
@@ -87,21 +241,25 @@ ngx_shmtx_lock(ngx_shmtx_t *mtx)
                     ngx_cpu_pause();
                 }
 
+                spins += n;
+
                 if (*mtx->lock == 0
                     && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid))
                 {
-                    return;
+                    goto locked;
                 }
             }
         }
 
+        sleeps++;
+
 #if (NGX_HAVE_POSIX_SEM)
 
         if (mtx->semaphore) {
             (void) ngx_atomic_fetch_add(mtx->wait, 1);
 
             if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
-                return;
+                goto locked;
             }
 
             ngx_log_debug1(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
@@ -122,15 +280,33 @@ ngx_shmtx_lock(ngx_shmtx_t *mtx)
             ngx_log_debug0(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
                            "shmtx awoke");
 
+            if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
+                goto locked;
+            }
+
             continue;
         }
 
 #endif
 
         ngx_sched_yield();
+
+        if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
+            goto locked;
+        }
     }
+
+locked:
+
+    mtx->sh->acquired++;
+    mtx->sh->contended++;
+    mtx->sh->spins += spins;
+    mtx->sh->sleeps += sleeps;
+    mtx->sh->wait_time += ngx_shmtx_usec() - start;
 }
 
+#endif
+
 
 void
 ngx_shmtx_unlock(ngx_shmtx_t *mtx)
@@ -163,7 +339,24 @@ ngx_shmtx_force_unlock(ngx_shmtx_t *mtx, ngx_pid_t pid)
 static void
 ngx_shmtx_wakeup(ngx_shmtx_t *mtx)
 {
-#if (NGX_HAVE_POSIX_SEM)
+#if (NGX_HAVE_FUTEX)
+
+    if (*mtx->wait == 0) {
+        return;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
+                   "shmtx wake %uA", *mtx->wait);
+
+    if (syscall(SYS_futex, ngx_shmtx_futex(mtx), FUTEX_WAKE, 1,
+                NULL, NULL, 0)
+        == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      "futex(FUTEX_WAKE) failed while wake shmtx");
+    }
+
+#elif (NGX_HAVE_POSIX_SEM)
     ngx_atomic_uint_t  wait;
 
     if (!mtx->semaphore) {
@@ -195,6 +388,16 @@ ngx_shmtx_wakeup(ngx_shmtx_t *mtx)
 }
 
 
+static ngx_atomic_uint_t
+ngx_shmtx_usec(void)
+{
+    struct timeval  tv;
+
+    ngx_gettimeofday(&tv);
+
+    return (ngx_atomic_uint_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
 #else
 
 
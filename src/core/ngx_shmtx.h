@@ -15,25 +15,39 @@
 
 typedef struct {
     ngx_atomic_t   lock;
-#if (NGX_HAVE_POSIX_SEM)
+#if (NGX_HAVE_FUTEX || NGX_HAVE_POSIX_SEM)
     ngx_atomic_t   wait;
 #endif
+#if (NGX_HAVE_FUTEX)
+    ngx_atomic_t   spin;
+#endif
+
+    /* the statistics of the atomic mutexes, updated under the lock */
+
+    ngx_atomic_t   acquired;
+    ngx_atomic_t   contended;
+    ngx_atomic_t   spins;
+    ngx_atomic_t   sleeps;
+    ngx_atomic_t   wait_time;   /* usec */
 } ngx_shmtx_sh_t;
 
 
 typedef struct {
 #if (NGX_HAVE_ATOMIC_OPS)
-    ngx_atomic_t  *lock;
-#if (NGX_HAVE_POSIX_SEM)
-    ngx_atomic_t  *wait;
-    ngx_uint_t     semaphore;
-    sem_t          sem;
+    ngx_atomic_t    *lock;
+    ngx_shmtx_sh_t  *sh;
+#if (NGX_HAVE_FUTEX)
+    ngx_atomic_t    *wait;
+#elif (NGX_HAVE_POSIX_SEM)
+    ngx_atomic_t    *wait;
+    ngx_uint_t       semaphore;
+    sem_t            sem;
 #endif
 #else
-    ngx_fd_t       fd;
-    u_char        *name;
+    ngx_fd_t         fd;
+    u_char          *name;
 #endif
-    ngx_uint_t     spin;
+    ngx_uint_t       spin;
 } ngx_shmtx_t;
 
 
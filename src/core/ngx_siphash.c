@@ -0,0 +1,109 @@
+
+/*
+ * Copyright (C) Jean-Philippe Aumasson
+ * Copyright (C) Daniel J. Bernstein
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+#define ngx_sip_rotl(x, b)  (((x) << (b)) | ((x) >> (64 - (b))))
+
+#define ngx_sip_read64(p)                                                     \
+    ((uint64_t) (p)[0] | (uint64_t) (p)[1] << 8                               \
+     | (uint64_t) (p)[2] << 16 | (uint64_t) (p)[3] << 24                      \
+     | (uint64_t) (p)[4] << 32 | (uint64_t) (p)[5] << 40                      \
+     | (uint64_t) (p)[6] << 48 | (uint64_t) (p)[7] << 56)
+
+#define ngx_sip_round(v0, v1, v2, v3)                                         \
+    v0 += v1; v1 = ngx_sip_rotl(v1, 13); v1 ^= v0; v0 = ngx_sip_rotl(v0, 32); \
+    v2 += v3; v3 = ngx_sip_rotl(v3, 16); v3 ^= v2;                            \
+    v0 += v3; v3 = ngx_sip_rotl(v3, 21); v3 ^= v0;                            \
+    v2 += v1; v1 = ngx_sip_rotl(v1, 17); v1 ^= v2; v2 = ngx_sip_rotl(v2, 32)
+
+
+void
+ngx_siphash128(u_char digest[16], u_char *key, u_char *data, size_t len)
+{
+    u_char      *last;
+    uint64_t     k0, k1, v0, v1, v2, v3, m, r;
+    ngx_uint_t   i;
+
+    k0 = ngx_sip_read64(key);
+    k1 = ngx_sip_read64(key + 8);
+
+    v0 = 0x736f6d6570736575ULL ^ k0;
+    v1 = 0x646f72616e646f6dULL ^ k1 ^ 0xee;
+    v2 = 0x6c7967656e657261ULL ^ k0;
+    v3 = 0x7465646279746573ULL ^ k1;
+
+    last = data + (len & ~(size_t) 7);
+
+    while (data < last) {
+        m = ngx_sip_read64(data);
+
+        v3 ^= m;
+        ngx_sip_round(v0, v1, v2, v3);
+        ngx_sip_round(v0, v1, v2, v3);
+        v0 ^= m;
+
+        data += 8;
+    }
+
+    m = (uint64_t) len << 56;
+
+    switch (len & 7) {
+    case 7:
+        m |= (uint64_t) data[6] << 48;
+        /* fall through */
+    case 6:
+        m |= (uint64_t) data[5] << 40;
+        /* fall through */
+    case 5:
+        m |= (uint64_t) data[4] << 32;
+        /* fall through */
+    case 4:
+        m |= (uint64_t) data[3] << 24;
+        /* fall through */
+    case 3:
+        m |= (uint64_t) data[2] << 16;
+        /* fall through */
+    case 2:
+        m |= (uint64_t) data[1] << 8;
+        /* fall through */
+    case 1:
+        m |= (uint64_t) data[0];
+    }
+
+    v3 ^= m;
+    ngx_sip_round(v0, v1, v2, v3);
+    ngx_sip_round(v0, v1, v2, v3);
+    v0 ^= m;
+
+    v2 ^= 0xee;
+
+    for (i = 0; i < 4; i++) {
+        ngx_sip_round(v0, v1, v2, v3);
+    }
+
+    r = v0 ^ v1 ^ v2 ^ v3;
+
+    for (i = 0; i < 8; i++) {
+        digest[i] = (u_char) (r >> (8 * i));
+    }
+
+    v1 ^= 0xdd;
+
+    for (i = 0; i < 4; i++) {
+        ngx_sip_round(v0, v1, v2, v3);
+    }
+
+    r = v0 ^ v1 ^ v2 ^ v3;
+
+    for (i = 0; i < 8; i++) {
+        digest[i + 8] = (u_char) (r >> (8 * i));
+    }
+}
@@ -62,6 +62,12 @@ static void ngx_slab_free_pages(ngx_slab_pool_t *pool, ngx_slab_page_t *page,
     ngx_uint_t pages);
 static void ngx_slab_error(ngx_slab_pool_t *pool, ngx_uint_t level,
     char *text);
+static void *ngx_slab_alloc_uncached(ngx_slab_pool_t *pool, size_t size);
+static void ngx_slab_free_uncached(ngx_slab_pool_t *pool, void *p);
+static uintptr_t *ngx_slab_get_cache(ngx_slab_pool_t *pool);
+static void *ngx_slab_cache_alloc(ngx_slab_pool_t *pool, size_t size);
+static ngx_int_t ngx_slab_cache_free(ngx_slab_pool_t *pool, void *p);
+static void ngx_slab_flush_caches_locked(ngx_slab_pool_t *pool);
 
 
 static ngx_uint_t  ngx_slab_max_size;
@@ -129,8 +135,22 @@ ngx_slab_init(ngx_slab_pool_t *pool)
         pool->pages->slab = pages;
     }
 
+    pool->npages = pages;
+    pool->pfree = pages;
+
     pool->log_ctx = &pool->zero;
     pool->zero = '\0';
+
+    pool->log_nomem = 1;
+
+    if (pool->cache_size && pool->ncaches) {
+        size = pool->ncaches * sizeof(uintptr_t *);
+
+        pool->caches = ngx_slab_alloc_uncached(pool, size);
+        if (pool->caches) {
+            ngx_memzero(pool->caches, size);
+        }
+    }
 }
 
 
@@ -151,6 +171,40 @@ ngx_slab_alloc(ngx_slab_pool_t *pool, size_t size)
 
 void *
 ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
+{
+    void  *p;
+
+    if (pool->caches == NULL) {
+        return ngx_slab_alloc_uncached(pool, size);
+    }
+
+    if (size < ngx_slab_max_size) {
+        p = ngx_slab_cache_alloc(pool, size);
+        if (p) {
+            return p;
+        }
+    }
+
+    pool->log_nomem = 0;
+
+    p = ngx_slab_alloc_uncached(pool, size);
+
+    pool->log_nomem = 1;
+
+    if (p) {
+        return p;
+    }
+
+    /* the chunks cached by all processes are returned to the pool */
+
+    ngx_slab_flush_caches_locked(pool);
+
+    return ngx_slab_alloc_uncached(pool, size);
+}
+
+
+static void *
+ngx_slab_alloc_uncached(ngx_slab_pool_t *pool, size_t size)
 {
     size_t            s;
     uintptr_t         p, n, m, mask, *bitmap;
@@ -408,6 +462,17 @@ ngx_slab_free(ngx_slab_pool_t *pool, void *p)
 
 void
 ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
+{
+    if (pool->caches && ngx_slab_cache_free(pool, p) == NGX_OK) {
+        return;
+    }
+
+    ngx_slab_free_uncached(pool, p);
+}
+
+
+static void
+ngx_slab_free_uncached(ngx_slab_pool_t *pool, void *p)
 {
     size_t            size;
     uintptr_t         slab, m, *bitmap;
@@ -614,6 +679,188 @@ fail:
 }
 
 
+/*
+ * A worker, helper or single process keeps up to pool->cache_size chunks
+ * of each size class in its own cache, selected by ngx_process_slot,
+ * so the chunks freed by a process are reused by it first, and the
+ * allocations and frees do not search and update the page bitmaps.
+ * The caches are used under the pool mutex only, so the process that
+ * fails to allocate returns the chunks cached by all processes to the
+ * pool, and the master does so for the processes it reaps.
+ */
+
+static uintptr_t *
+ngx_slab_get_cache(ngx_slab_pool_t *pool)
+{
+    size_t      size;
+    uintptr_t  *cache;
+
+    if (ngx_process != NGX_PROCESS_WORKER
+        && ngx_process != NGX_PROCESS_HELPER
+        && ngx_process != NGX_PROCESS_SINGLE)
+    {
+        return NULL;
+    }
+
+    if ((ngx_uint_t) ngx_process_slot >= pool->ncaches) {
+        return NULL;
+    }
+
+    cache = pool->caches[ngx_process_slot];
+
+    if (cache) {
+        return cache;
+    }
+
+    size = (ngx_pagesize_shift - pool->min_shift)
+           * (pool->cache_size + 1) * sizeof(uintptr_t);
+
+    cache = ngx_slab_alloc_uncached(pool, size);
+
+    if (cache) {
+        ngx_memzero(cache, size);
+        pool->caches[ngx_process_slot] = cache;
+    }
+
+    return cache;
+}
+
+
+static void *
+ngx_slab_cache_alloc(ngx_slab_pool_t *pool, size_t size)
+{
+    void        *p;
+    size_t       s;
+    uintptr_t   *cache;
+    ngx_uint_t   n, shift;
+
+    cache = ngx_slab_get_cache(pool);
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    if (size > pool->min_size) {
+        shift = 1;
+        for (s = size - 1; s >>= 1; shift++) { /* void */ }
+
+    } else {
+        shift = pool->min_shift;
+    }
+
+    cache += (shift - pool->min_shift) * (pool->cache_size + 1);
+
+    n = cache[0];
+
+    if (n == 0) {
+        return NULL;
+    }
+
+    p = (void *) cache[n];
+    cache[0] = n - 1;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
+                   "slab cache alloc: %p", p);
+
+    return p;
+}
+
+
+static ngx_int_t
+ngx_slab_cache_free(ngx_slab_pool_t *pool, void *p)
+{
+    uintptr_t        *cache;
+    ngx_uint_t        n, shift;
+    ngx_slab_page_t  *page;
+
+    if ((u_char *) p < pool->start || (u_char *) p >= pool->end) {
+        return NGX_DECLINED;
+    }
+
+    page = &pool->pages[((u_char *) p - pool->start) >> ngx_pagesize_shift];
+
+    switch (page->prev & NGX_SLAB_PAGE_MASK) {
+
+    case NGX_SLAB_SMALL:
+    case NGX_SLAB_BIG:
+        shift = page->slab & NGX_SLAB_SHIFT_MASK;
+        break;
+
+    case NGX_SLAB_EXACT:
+        shift = ngx_slab_exact_shift;
+        break;
+
+    default: /* NGX_SLAB_PAGE */
+        return NGX_DECLINED;
+    }
+
+    if ((uintptr_t) p & (((uintptr_t) 1 << shift) - 1)) {
+        return NGX_DECLINED;
+    }
+
+    cache = ngx_slab_get_cache(pool);
+    if (cache == NULL) {
+        return NGX_DECLINED;
+    }
+
+    cache += (shift - pool->min_shift) * (pool->cache_size + 1);
+
+    n = cache[0];
+
+    if (n == pool->cache_size) {
+        return NGX_DECLINED;
+    }
+
+    cache[n + 1] = (uintptr_t) p;
+    cache[0] = n + 1;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
+                   "slab cache free: %p", p);
+
+    return NGX_OK;
+}
+
+
+void
+ngx_slab_flush_cache_locked(ngx_slab_pool_t *pool, ngx_uint_t slot)
+{
+    void        *p;
+    uintptr_t   *cache;
+    ngx_uint_t   i, n;
+
+    if (pool->caches == NULL || slot >= pool->ncaches) {
+        return;
+    }
+
+    cache = pool->caches[slot];
+
+    if (cache == NULL) {
+        return;
+    }
+
+    for (i = pool->min_shift; i < ngx_pagesize_shift; i++) {
+
+        for (n = cache[0]; n; /* void */) {
+            p = (void *) cache[n];
+            cache[0] = --n;
+            ngx_slab_free_uncached(pool, p);
+        }
+
+        cache += pool->cache_size + 1;
+    }
+}
+
+
+static void
+ngx_slab_flush_caches_locked(ngx_slab_pool_t *pool)
+{
+    ngx_uint_t  slot;
+
+    for (slot = 0; slot < pool->ncaches; slot++) {
+        ngx_slab_flush_cache_locked(pool, slot);
+    }
+}
+
+
 static ngx_slab_page_t *
 ngx_slab_alloc_pages(ngx_slab_pool_t *pool, ngx_uint_t pages)
 {
@@ -642,6 +889,8 @@ ngx_slab_alloc_pages(ngx_slab_pool_t *pool, ngx_uint_t pages)
             page->next = NULL;
             page->prev = NGX_SLAB_PAGE;
 
+            pool->pfree -= pages;
+
             if (--pages == 0) {
                 return page;
             }
@@ -657,7 +906,10 @@ ngx_slab_alloc_pages(ngx_slab_pool_t *pool, ngx_uint_t pages)
         }
     }
 
-    ngx_slab_error(pool, NGX_LOG_CRIT, "ngx_slab_alloc() failed: no memory");
+    if (pool->log_nomem) {
+        ngx_slab_error(pool, NGX_LOG_CRIT,
+                       "ngx_slab_alloc() failed: no memory");
+    }
 
     return NULL;
 }
@@ -669,6 +921,8 @@ ngx_slab_free_pages(ngx_slab_pool_t *pool, ngx_slab_page_t *page,
 {
     ngx_slab_page_t  *prev;
 
+    pool->pfree += pages;
+
     page->slab = pages--;
 
     if (pages) {
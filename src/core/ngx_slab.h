@@ -39,8 +39,17 @@ typedef struct {
     u_char           *log_ctx;
     u_char            zero;
 
+    unsigned          log_nomem:1;
+
     void             *data;
     void             *addr;
+
+    ngx_uint_t        npages;
+    ngx_uint_t        pfree;
+
+    ngx_uint_t        cache_size;
+    ngx_uint_t        ncaches;
+    uintptr_t       **caches;
 } ngx_slab_pool_t;
 
 
@@ -49,6 +58,7 @@ void *ngx_slab_alloc(ngx_slab_pool_t *pool, size_t size);
 void *ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size);
 void ngx_slab_free(ngx_slab_pool_t *pool, void *p);
 void ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p);
+void ngx_slab_flush_cache_locked(ngx_slab_pool_t *pool, ngx_uint_t slot);
 
 
 #endif /* _NGX_SLAB_H_INCLUDED_ */
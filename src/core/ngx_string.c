@@ -18,6 +18,18 @@ static ngx_int_t ngx_decode_base64_internal(ngx_str_t *dst, ngx_str_t *src,
 void
 ngx_strlow(u_char *dst, u_char *src, size_t n)
 {
+#if (NGX_HAVE_SIMD)
+    size_t  i;
+
+    if (n >= 16) {
+        i = ngx_strlow_simd(dst, src, n);
+
+        dst += i;
+        src += i;
+        n -= i;
+    }
+#endif
+
     while (n) {
         *dst = ngx_tolower(*src);
         dst++;
@@ -592,6 +604,18 @@ ngx_strncasecmp(u_char *s1, u_char *s2, size_t n)
 {
     ngx_uint_t  c1, c2;
 
+#if (NGX_HAVE_SIMD)
+    size_t      i;
+
+    if (n >= 16) {
+        i = ngx_strncasecmp_simd(s1, s2, n);
+
+        s1 += i;
+        s2 += i;
+        n -= i;
+    }
+#endif
+
     while (n) {
         c1 = (ngx_uint_t) *s1++;
         c2 = (ngx_uint_t) *s2++;
@@ -682,11 +706,30 @@ ngx_strstrn(u_char *s1, char *s2, size_t n)
 u_char *
 ngx_strcasestrn(u_char *s1, char *s2, size_t n)
 {
-    ngx_uint_t  c1, c2;
+#if !(NGX_HAVE_SIMD)
+    ngx_uint_t  c1;
+#endif
+    ngx_uint_t  c2;
 
     c2 = (ngx_uint_t) *s2++;
     c2 = (c2 >= 'A' && c2 <= 'Z') ? (c2 | 0x20) : c2;
 
+#if (NGX_HAVE_SIMD)
+
+    for ( ;; ) {
+        s1 = ngx_strcasechr_simd(s1, c2);
+
+        if (*s1++ == '\0') {
+            return NULL;
+        }
+
+        if (ngx_strncasecmp(s1, (u_char *) s2, n) == 0) {
+            return --s1;
+        }
+    }
+
+#else
+
     do {
         do {
             c1 = (ngx_uint_t) *s1++;
@@ -702,6 +745,8 @@ ngx_strcasestrn(u_char *s1, char *s2, size_t n)
     } while (ngx_strncasecmp(s1, (u_char *) s2, n) != 0);
 
     return --s1;
+
+#endif
 }
 
 
@@ -1349,6 +1394,9 @@ uintptr_t
 ngx_escape_uri(u_char *dst, u_char *src, size_t size, ngx_uint_t type)
 {
     ngx_uint_t      n;
+#if (NGX_HAVE_SIMD)
+    size_t          i;
+#endif
     uint32_t       *escape;
     static u_char   hex[] = "0123456789abcdef";
 
@@ -1489,6 +1537,17 @@ ngx_escape_uri(u_char *dst, u_char *src, size_t size, ngx_uint_t type)
         while (size) {
             if (escape[*src >> 5] & (1 << (*src & 0x1f))) {
                 n++;
+
+#if (NGX_HAVE_SIMD)
+            } else if (size >= 16) {
+                i = ngx_escape_uri_simd(NULL, src, size, escape, type);
+
+                if (i) {
+                    src += i;
+                    size -= i;
+                    continue;
+                }
+#endif
             }
             src++;
             size--;
@@ -1505,6 +1564,20 @@ ngx_escape_uri(u_char *dst, u_char *src, size_t size, ngx_uint_t type)
             src++;
 
         } else {
+
+#if (NGX_HAVE_SIMD)
+            if (size >= 16) {
+                i = ngx_escape_uri_simd(dst, src, size, escape, type);
+
+                if (i) {
+                    dst += i;
+                    src += i;
+                    size -= i;
+                    continue;
+                }
+            }
+#endif
+
             *dst++ = *src++;
         }
         size--;
@@ -1518,6 +1591,9 @@ void
 ngx_unescape_uri(u_char **dst, u_char **src, size_t size, ngx_uint_t type)
 {
     u_char  *d, *s, ch, c, decoded;
+#if (NGX_HAVE_SIMD)
+    size_t   n;
+#endif
     enum {
         sw_usual = 0,
         sw_quoted,
@@ -1549,6 +1625,21 @@ ngx_unescape_uri(u_char **dst, u_char **src, size_t size, ngx_uint_t type)
             }
 
             *d++ = ch;
+
+#if (NGX_HAVE_SIMD)
+            if (size >= 16) {
+                n = ngx_unescape_uri_simd(s, size,
+                                 type & (NGX_UNESCAPE_URI|NGX_UNESCAPE_REDIRECT));
+                if (d != s) {
+                    ngx_memmove(d, s, n);
+                }
+
+                d += n;
+                s += n;
+                size -= n;
+            }
+#endif
+
             break;
 
         case sw_quoted:
@@ -1649,12 +1740,29 @@ ngx_escape_html(u_char *dst, u_char *src, size_t size)
 {
     u_char      ch;
     ngx_uint_t  len;
+#if (NGX_HAVE_SIMD)
+    size_t      n;
+#endif
 
     if (dst == NULL) {
 
         len = 0;
 
         while (size) {
+
+#if (NGX_HAVE_SIMD)
+            if (size >= 16) {
+                n = ngx_escape_html_simd(NULL, src, size);
+
+                src += n;
+                size -= n;
+
+                if (size == 0) {
+                    break;
+                }
+            }
+#endif
+
             switch (*src++) {
 
             case '<':
@@ -1683,6 +1791,21 @@ ngx_escape_html(u_char *dst, u_char *src, size_t size)
     }
 
     while (size) {
+
+#if (NGX_HAVE_SIMD)
+        if (size >= 16) {
+            n = ngx_escape_html_simd(dst, src, size);
+
+            dst += n;
+            src += n;
+            size -= n;
+
+            if (size == 0) {
+                break;
+            }
+        }
+#endif
+
         ch = *src++;
 
         switch (ch) {
@@ -1716,6 +1839,59 @@ ngx_escape_html(u_char *dst, u_char *src, size_t size)
 }
 
 
+uintptr_t
+ngx_escape_json(u_char *dst, u_char *src, size_t size)
+{
+    u_char      ch;
+    ngx_uint_t  len;
+
+    if (dst == NULL) {
+
+        len = 0;
+
+        while (size) {
+            ch = *src++;
+
+            if (ch == '\\' || ch == '"') {
+                len++;
+
+            } else if (ch <= 0x1f) {
+                len += sizeof("\\u001F") - 2;
+            }
+
+            size--;
+        }
+
+        return (uintptr_t) len;
+    }
+
+    while (size) {
+        ch = *src++;
+
+        if (ch > 0x1f) {
+
+            if (ch == '\\' || ch == '"') {
+                *dst++ = '\\';
+            }
+
+            *dst++ = ch;
+
+        } else {
+            *dst++ = '\\'; *dst++ = 'u'; *dst++ = '0'; *dst++ = '0';
+            *dst++ = '0' + (ch >> 4);
+
+            ch &= 0xf;
+
+            *dst++ = (ch < 10) ? ('0' + ch) : ('A' + ch - 10);
+        }
+
+        size--;
+    }
+
+    return (uintptr_t) dst;
+}
+
+
 void
 ngx_str_rbtree_insert_value(ngx_rbtree_node_t *temp,
     ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel)
@@ -205,6 +205,24 @@ uintptr_t ngx_escape_uri(u_char *dst, u_char *src, size_t size,
     ngx_uint_t type);
 void ngx_unescape_uri(u_char **dst, u_char **src, size_t size, ngx_uint_t type);
 uintptr_t ngx_escape_html(u_char *dst, u_char *src, size_t size);
+uintptr_t ngx_escape_json(u_char *dst, u_char *src, size_t size);
+
+
+#if (NGX_HAVE_SIMD)
+
+size_t ngx_strlow_simd(u_char *dst, u_char *src, size_t n);
+size_t ngx_strncasecmp_simd(u_char *s1, u_char *s2, size_t n);
+u_char *ngx_strcasechr_simd(u_char *s, ngx_uint_t c);
+size_t ngx_escape_uri_simd(u_char *dst, u_char *src, size_t size,
+    uint32_t *escape, ngx_uint_t type);
+size_t ngx_escape_html_simd(u_char *dst, u_char *src, size_t size);
+size_t ngx_unescape_uri_simd(u_char *src, size_t size, ngx_uint_t question);
+
+#define NGX_SIMD_LUT_SIZE  33
+
+size_t ngx_strspn_simd(u_char *p, size_t size, uint32_t *map, u_char *lut);
+
+#endif
 
 
 typedef struct {
@@ -0,0 +1,595 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+#include <immintrin.h>
+
+
+/*
+ * the vector versions process the leading part of a string and return
+ * its length, the rest is left to the scalar code in ngx_string.c;
+ * the functions are built for the particular instruction sets and
+ * are selected by the ngx_cpu_features detected in ngx_cpuinfo()
+ */
+
+
+#define NGX_SIMD_SSE2   __attribute__ ((target("sse2")))
+#define NGX_SIMD_SSSE3  __attribute__ ((target("ssse3")))
+#define NGX_SIMD_AVX2   __attribute__ ((target("avx2")))
+
+
+/* x86 pages are at least 4K, a load within a page cannot fault */
+
+#define ngx_simd_page_cross(p, n)                                             \
+    (((uintptr_t) (p) & 4095) > 4096 - (n))
+
+
+static u_char      ngx_simd_escape_lut[8][32];
+static uint32_t   *ngx_simd_escape_map[8];
+
+static u_char      ngx_simd_bits[16] = {
+    1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+};
+
+
+/* 'A' - 'Z' are mapped to the lowest signed values by adding 0x80 - 'A' */
+
+static ngx_inline NGX_SIMD_SSE2 __m128i
+ngx_simd_lower128(__m128i v)
+{
+    __m128i  upper;
+
+    upper = _mm_cmplt_epi8(_mm_add_epi8(v, _mm_set1_epi8(0x80 - 'A')),
+                           _mm_set1_epi8(-128 + 26));
+
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+
+static ngx_inline NGX_SIMD_AVX2 __m256i
+ngx_simd_lower256(__m256i v)
+{
+    __m256i  upper;
+
+    upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26),
+                              _mm256_add_epi8(v, _mm256_set1_epi8(0x80 - 'A')));
+
+    return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+
+/*
+ * the 256-bit escape bitmap is looked up by nibbles: the low nibble
+ * selects a byte in a 16-byte row, the high nibble selects a row
+ * (t0 for 0-7, t1 for 8-f) and a bit in the byte; the bytes of
+ * the characters to be left as is are set in the returned mask
+ */
+
+static ngx_inline NGX_SIMD_SSSE3 __m128i
+ngx_simd_clean128(__m128i v, __m128i t0, __m128i t1, __m128i bits)
+{
+    __m128i  lo, hi, high, row;
+
+    lo = _mm_and_si128(v, _mm_set1_epi8(0x0f));
+    hi = _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+
+    high = _mm_cmpgt_epi8(hi, _mm_set1_epi8(7));
+
+    row = _mm_or_si128(_mm_andnot_si128(high, _mm_shuffle_epi8(t0, lo)),
+                       _mm_and_si128(high, _mm_shuffle_epi8(t1, lo)));
+
+    return _mm_cmpeq_epi8(_mm_and_si128(row, _mm_shuffle_epi8(bits, hi)),
+                          _mm_setzero_si128());
+}
+
+
+static ngx_inline NGX_SIMD_AVX2 __m256i
+ngx_simd_clean256(__m256i v, __m256i t0, __m256i t1, __m256i bits)
+{
+    __m256i  lo, hi, high, row;
+
+    lo = _mm256_and_si256(v, _mm256_set1_epi8(0x0f));
+    hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0f));
+
+    high = _mm256_cmpgt_epi8(hi, _mm256_set1_epi8(7));
+
+    row = _mm256_or_si256(
+              _mm256_andnot_si256(high, _mm256_shuffle_epi8(t0, lo)),
+              _mm256_and_si256(high, _mm256_shuffle_epi8(t1, lo)));
+
+    return _mm256_cmpeq_epi8(_mm256_and_si256(row,
+                                              _mm256_shuffle_epi8(bits, hi)),
+                             _mm256_setzero_si256());
+}
+
+
+static ngx_inline NGX_SIMD_SSE2 __m128i
+ngx_simd_html128(__m128i v)
+{
+    return _mm_or_si128(
+               _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('<')),
+                            _mm_cmpeq_epi8(v, _mm_set1_epi8('>'))),
+               _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('&')),
+                            _mm_cmpeq_epi8(v, _mm_set1_epi8('"'))));
+}
+
+
+static ngx_inline NGX_SIMD_AVX2 __m256i
+ngx_simd_html256(__m256i v)
+{
+    return _mm256_or_si256(
+               _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('<')),
+                               _mm256_cmpeq_epi8(v, _mm256_set1_epi8('>'))),
+               _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('&')),
+                               _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))));
+}
+
+
+static NGX_SIMD_SSE2 size_t
+ngx_strlow_sse2(u_char *dst, u_char *src, size_t n)
+{
+    size_t   i;
+    __m128i  v;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        v = _mm_loadu_si128((__m128i *) &src[i]);
+        _mm_storeu_si128((__m128i *) &dst[i], ngx_simd_lower128(v));
+    }
+
+    return i;
+}
+
+
+static NGX_SIMD_AVX2 size_t
+ngx_strlow_avx2(u_char *dst, u_char *src, size_t n)
+{
+    size_t   i;
+    __m128i  v;
+    __m256i  w;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        w = _mm256_loadu_si256((__m256i *) &src[i]);
+        _mm256_storeu_si256((__m256i *) &dst[i], ngx_simd_lower256(w));
+    }
+
+    if (i + 16 <= n) {
+        v = _mm_loadu_si128((__m128i *) &src[i]);
+        _mm_storeu_si128((__m128i *) &dst[i], ngx_simd_lower128(v));
+        i += 16;
+    }
+
+    return i;
+}
+
+
+size_t
+ngx_strlow_simd(u_char *dst, u_char *src, size_t n)
+{
+    if (ngx_cpu_features & NGX_CPU_AVX2) {
+        return ngx_strlow_avx2(dst, src, n);
+    }
+
+    if (ngx_cpu_features & NGX_CPU_SSE2) {
+        return ngx_strlow_sse2(dst, src, n);
+    }
+
+    return 0;
+}
+
+
+/*
+ * the strings may be shorter than n, so the loads are not allowed
+ * to cross a page boundary; the length of the equal prefix without
+ * the null character is returned
+ */
+
+static NGX_SIMD_SSE2 size_t
+ngx_strncasecmp_sse2(u_char *s1, u_char *s2, size_t n)
+{
+    size_t   i;
+    __m128i  v1, v2, eq;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+
+        if (ngx_simd_page_cross(&s1[i], 16) || ngx_simd_page_cross(&s2[i], 16))
+        {
+            break;
+        }
+
+        v1 = _mm_loadu_si128((__m128i *) &s1[i]);
+        v2 = _mm_loadu_si128((__m128i *) &s2[i]);
+
+        v1 = ngx_simd_lower128(v1);
+        v2 = ngx_simd_lower128(v2);
+
+        eq = _mm_andnot_si128(_mm_cmpeq_epi8(v1, _mm_setzero_si128()),
+                              _mm_cmpeq_epi8(v1, v2));
+
+        if (_mm_movemask_epi8(eq) != 0xffff) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+
+size_t
+ngx_strncasecmp_simd(u_char *s1, u_char *s2, size_t n)
+{
+    if (ngx_cpu_features & NGX_CPU_SSE2) {
+        return ngx_strncasecmp_sse2(s1, s2, n);
+    }
+
+    return 0;
+}
+
+
+/*
+ * aligned loads never cross a page boundary, so the null-terminated
+ * string may be read in whole 16-byte blocks
+ */
+
+static NGX_SIMD_SSE2 u_char *
+ngx_strcasechr_sse2(u_char *s, ngx_uint_t c)
+{
+    u_char      *p;
+    ngx_uint_t   m;
+    __m128i      v, vc;
+
+    p = (u_char *) ((uintptr_t) s & ~(uintptr_t) 15);
+
+    vc = _mm_set1_epi8((char) c);
+
+    v = _mm_load_si128((__m128i *) p);
+
+    m = _mm_movemask_epi8(_mm_or_si128(
+                              _mm_cmpeq_epi8(ngx_simd_lower128(v), vc),
+                              _mm_cmpeq_epi8(v, _mm_setzero_si128())));
+
+    m &= (ngx_uint_t) 0xffff << (s - p);
+
+    while (m == 0) {
+        p += 16;
+
+        v = _mm_load_si128((__m128i *) p);
+
+        m = _mm_movemask_epi8(_mm_or_si128(
+                                  _mm_cmpeq_epi8(ngx_simd_lower128(v), vc),
+                                  _mm_cmpeq_epi8(v, _mm_setzero_si128())));
+    }
+
+    return p + __builtin_ctz(m);
+}
+
+
+u_char *
+ngx_strcasechr_simd(u_char *s, ngx_uint_t c)
+{
+    /*
+     * the first character of the needle is a sign extended char,
+     * so in the scalar code a character above 0x7f never matches
+     */
+
+    if ((ngx_cpu_features & NGX_CPU_SSE2) && c <= 0xff) {
+        return ngx_strcasechr_sse2(s, c);
+    }
+
+    while (*s && ngx_tolower(*s) != c) {
+        s++;
+    }
+
+    return s;
+}
+
+
+/*
+ * the span functions skip the leading characters that are not marked
+ * in the lookup table, and copy them if dst is not NULL;
+ * the output of the 16 or 32 input bytes is at least as long as the input,
+ * so a whole vector may be stored even if it contains a byte to escape
+ */
+
+static NGX_SIMD_SSSE3 size_t
+ngx_simd_span_ssse3(u_char *dst, u_char *src, size_t size, u_char *lut)
+{
+    size_t      i;
+    ngx_uint_t  m;
+    __m128i     v, t0, t1, bits;
+
+    t0 = _mm_loadu_si128((__m128i *) lut);
+    t1 = _mm_loadu_si128((__m128i *) &lut[16]);
+    bits = _mm_loadu_si128((__m128i *) ngx_simd_bits);
+
+    for (i = 0; i + 16 <= size; i += 16) {
+        v = _mm_loadu_si128((__m128i *) &src[i]);
+
+        if (dst) {
+            _mm_storeu_si128((__m128i *) &dst[i], v);
+        }
+
+        m = _mm_movemask_epi8(ngx_simd_clean128(v, t0, t1, bits));
+
+        if (m != 0xffff) {
+            return i + __builtin_ctz(~m);
+        }
+    }
+
+    return i;
+}
+
+
+static NGX_SIMD_AVX2 size_t
+ngx_simd_span_avx2(u_char *dst, u_char *src, size_t size, u_char *lut)
+{
+    size_t    i;
+    uint32_t  m;
+    __m128i   v, t0, t1, bits;
+    __m256i   w, w0, w1, wbits;
+
+    t0 = _mm_loadu_si128((__m128i *) lut);
+    t1 = _mm_loadu_si128((__m128i *) &lut[16]);
+    bits = _mm_loadu_si128((__m128i *) ngx_simd_bits);
+
+    w0 = _mm256_broadcastsi128_si256(t0);
+    w1 = _mm256_broadcastsi128_si256(t1);
+    wbits = _mm256_broadcastsi128_si256(bits);
+
+    for (i = 0; i + 32 <= size; i += 32) {
+        w = _mm256_loadu_si256((__m256i *) &src[i]);
+
+        if (dst) {
+            _mm256_storeu_si256((__m256i *) &dst[i], w);
+        }
+
+        m = (uint32_t) _mm256_movemask_epi8(ngx_simd_clean256(w, w0, w1,
+                                                              wbits));
+
+        if (m != 0xffffffff) {
+            return i + __builtin_ctz(~m);
+        }
+    }
+
+    if (i + 16 <= size) {
+        v = _mm_loadu_si128((__m128i *) &src[i]);
+
+        if (dst) {
+            _mm_storeu_si128((__m128i *) &dst[i], v);
+        }
+
+        m = _mm_movemask_epi8(ngx_simd_clean128(v, t0, t1, bits));
+
+        if (m != 0xffff) {
+            return i + __builtin_ctz(~m);
+        }
+
+        i += 16;
+    }
+
+    return i;
+}
+
+
+static void
+ngx_simd_table(u_char *lut, uint32_t *map, ngx_uint_t accept)
+{
+    ngx_uint_t  c, stop;
+
+    ngx_memzero(lut, 32);
+
+    for (c = 0; c < 256; c++) {
+        stop = (map[c >> 5] & (1U << (c & 0x1f))) ? !accept : accept;
+
+        if (stop) {
+            lut[(c >> 7) * 16 + (c & 0xf)] |= (u_char) (1 << ((c >> 4) & 7));
+        }
+    }
+}
+
+
+size_t
+ngx_escape_uri_simd(u_char *dst, u_char *src, size_t size, uint32_t *escape,
+    ngx_uint_t type)
+{
+    u_char  *lut;
+
+    if (!(ngx_cpu_features & NGX_CPU_SSSE3)) {
+        return 0;
+    }
+
+    lut = ngx_simd_escape_lut[type];
+
+    if (ngx_simd_escape_map[type] != escape) {
+        ngx_simd_table(lut, escape, 0);
+        ngx_simd_escape_map[type] = escape;
+    }
+
+    if (ngx_cpu_features & NGX_CPU_AVX2) {
+        return ngx_simd_span_avx2(dst, src, size, lut);
+    }
+
+    return ngx_simd_span_ssse3(dst, src, size, lut);
+}
+
+
+/*
+ * the length of the leading part of p that consists of the characters
+ * set in the map; the lookup table is built in the caller's lut buffer
+ * on the first use
+ */
+
+size_t
+ngx_strspn_simd(u_char *p, size_t size, uint32_t *map, u_char *lut)
+{
+    if (!(ngx_cpu_features & NGX_CPU_SSSE3)) {
+        return 0;
+    }
+
+    if (lut[32] == 0) {
+        ngx_simd_table(lut, map, 1);
+        lut[32] = 1;
+    }
+
+    if (ngx_cpu_features & NGX_CPU_AVX2) {
+        return ngx_simd_span_avx2(NULL, p, size, lut);
+    }
+
+    return ngx_simd_span_ssse3(NULL, p, size, lut);
+}
+
+
+static NGX_SIMD_SSE2 size_t
+ngx_escape_html_sse2(u_char *dst, u_char *src, size_t size)
+{
+    size_t      i;
+    ngx_uint_t  m;
+    __m128i     v;
+
+    for (i = 0; i + 16 <= size; i += 16) {
+        v = _mm_loadu_si128((__m128i *) &src[i]);
+
+        if (dst) {
+            _mm_storeu_si128((__m128i *) &dst[i], v);
+        }
+
+        m = _mm_movemask_epi8(ngx_simd_html128(v));
+
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+    }
+
+    return i;
+}
+
+
+static NGX_SIMD_AVX2 size_t
+ngx_escape_html_avx2(u_char *dst, u_char *src, size_t size)
+{
+    size_t    i;
+    uint32_t  m;
+    __m128i   v;
+    __m256i   w;
+
+    for (i = 0; i + 32 <= size; i += 32) {
+        w = _mm256_loadu_si256((__m256i *) &src[i]);
+
+        if (dst) {
+            _mm256_storeu_si256((__m256i *) &dst[i], w);
+        }
+
+        m = (uint32_t) _mm256_movemask_epi8(ngx_simd_html256(w));
+
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+    }
+
+    if (i + 16 <= size) {
+        v = _mm_loadu_si128((__m128i *) &src[i]);
+
+        if (dst) {
+            _mm_storeu_si128((__m128i *) &dst[i], v);
+        }
+
+        m = _mm_movemask_epi8(ngx_simd_html128(v));
+
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+
+        i += 16;
+    }
+
+    return i;
+}
+
+
+size_t
+ngx_escape_html_simd(u_char *dst, u_char *src, size_t size)
+{
+    if (ngx_cpu_features & NGX_CPU_AVX2) {
+        return ngx_escape_html_avx2(dst, src, size);
+    }
+
+    if (ngx_cpu_features & NGX_CPU_SSE2) {
+        return ngx_escape_html_sse2(dst, src, size);
+    }
+
+    return 0;
+}
+
+
+/*
+ * the unescaping is usually done in place, so nothing is stored here,
+ * only the length of the leading part without "%" (and "?") is returned
+ */
+
+static NGX_SIMD_SSE2 size_t
+ngx_unescape_uri_sse2(u_char *src, size_t size, ngx_uint_t question)
+{
+    size_t      i;
+    ngx_uint_t  m;
+    __m128i     v, q;
+
+    q = _mm_set1_epi8(question ? '?' : '%');
+
+    for (i = 0; i + 16 <= size; i += 16) {
+        v = _mm_loadu_si128((__m128i *) &src[i]);
+
+        m = _mm_movemask_epi8(_mm_or_si128(
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('%')),
+                                  _mm_cmpeq_epi8(v, q)));
+
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+    }
+
+    return i;
+}
+
+
+static NGX_SIMD_AVX2 size_t
+ngx_unescape_uri_avx2(u_char *src, size_t size, ngx_uint_t question)
+{
+    size_t    i;
+    uint32_t  m;
+    __m256i   w, q;
+
+    q = _mm256_set1_epi8(question ? '?' : '%');
+
+    for (i = 0; i + 32 <= size; i += 32) {
+        w = _mm256_loadu_si256((__m256i *) &src[i]);
+
+        m = (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(
+                              _mm256_cmpeq_epi8(w, _mm256_set1_epi8('%')),
+                              _mm256_cmpeq_epi8(w, q)));
+
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+    }
+
+    return i + ngx_unescape_uri_sse2(&src[i], size - i, question);
+}
+
+
+size_t
+ngx_unescape_uri_simd(u_char *src, size_t size, ngx_uint_t question)
+{
+    if (ngx_cpu_features & NGX_CPU_AVX2) {
+        return ngx_unescape_uri_avx2(src, size, question);
+    }
+
+    if (ngx_cpu_features & NGX_CPU_SSE2) {
+        return ngx_unescape_uri_sse2(src, size, question);
+    }
+
+    return 0;
+}
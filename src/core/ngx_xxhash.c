@@ -0,0 +1,437 @@
+
+/*
+ * Copyright (C) Yann Collet
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+/*
+ * XXH3 128-bit hash with the default secret and zero seed,
+ * the scalar variant of the xxHash reference implementation
+ */
+
+
+#define NGX_XXH_PRIME32_1   0x9e3779b1U
+#define NGX_XXH_PRIME32_2   0x85ebca77U
+#define NGX_XXH_PRIME32_3   0xc2b2ae3dU
+
+#define NGX_XXH_PRIME64_1   0x9e3779b185ebca87ULL
+#define NGX_XXH_PRIME64_2   0xc2b2ae3d27d4eb4fULL
+#define NGX_XXH_PRIME64_3   0x165667b19e3779f9ULL
+#define NGX_XXH_PRIME64_4   0x85ebca77c2b2ae63ULL
+#define NGX_XXH_PRIME64_5   0x27d4eb2f165667c5ULL
+
+#define NGX_XXH_PRIME_MX1   0x165667919e3779f9ULL
+#define NGX_XXH_PRIME_MX2   0x9fb21c651e98df25ULL
+
+#define NGX_XXH_SECRET_SIZE  192
+#define NGX_XXH_STRIPE_LEN   64
+#define NGX_XXH_STRIPES                                                       \
+    ((NGX_XXH_SECRET_SIZE - NGX_XXH_STRIPE_LEN) / 8)
+
+
+#if (NGX_HAVE_LITTLE_ENDIAN && NGX_HAVE_NONALIGNED)
+
+#define ngx_xxh_read32(p)  (*(uint32_t *) (p))
+#define ngx_xxh_read64(p)  (*(uint64_t *) (p))
+
+#else
+
+#define ngx_xxh_read32(p)                                                     \
+    ((uint32_t) (p)[0] | (uint32_t) (p)[1] << 8                               \
+     | (uint32_t) (p)[2] << 16 | (uint32_t) (p)[3] << 24)
+
+#define ngx_xxh_read64(p)                                                     \
+    ((uint64_t) ngx_xxh_read32(p) | (uint64_t) ngx_xxh_read32((p) + 4) << 32)
+
+#endif
+
+
+#define ngx_xxh_rotl32(x, r)  (((x) << (r)) | ((x) >> (32 - (r))))
+#define ngx_xxh_swap32(x)                                                     \
+    (((x) << 24) | (((x) << 8) & 0xff0000) | (((x) >> 8) & 0xff00)           \
+     | ((x) >> 24))
+#define ngx_xxh_swap64(x)                                                     \
+    ((uint64_t) ngx_xxh_swap32((uint32_t) (x)) << 32                          \
+     | ngx_xxh_swap32((uint32_t) ((x) >> 32)))
+
+
+typedef struct {
+    uint64_t  low;
+    uint64_t  high;
+} ngx_xxh_uint128_t;
+
+
+static ngx_inline ngx_xxh_uint128_t ngx_xxh_mult128(uint64_t a, uint64_t b);
+static ngx_inline uint64_t ngx_xxh_mult128_fold64(uint64_t a, uint64_t b);
+static ngx_inline uint64_t ngx_xxh64_avalanche(uint64_t h);
+static ngx_inline uint64_t ngx_xxh3_avalanche(uint64_t h);
+static ngx_inline uint64_t ngx_xxh3_mix16(u_char *p, u_char *secret);
+static ngx_inline void ngx_xxh3_mix32(ngx_xxh_uint128_t *acc, u_char *p1,
+    u_char *p2, u_char *secret);
+static void ngx_xxh3_0to16(ngx_xxh_uint128_t *h, u_char *p, size_t len);
+static void ngx_xxh3_17to240(ngx_xxh_uint128_t *h, u_char *p, size_t len);
+static void ngx_xxh3_long(ngx_xxh_uint128_t *h, u_char *p, size_t len);
+static void ngx_xxh3_accumulate(uint64_t *acc, u_char *p, u_char *secret);
+static uint64_t ngx_xxh3_merge(uint64_t *acc, u_char *secret,
+    uint64_t start);
+
+
+static u_char  ngx_xxh3_secret[NGX_XXH_SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe,
+    0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+    0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78,
+    0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e,
+    0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+    0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e,
+    0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f,
+    0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+    0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3,
+    0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49,
+    0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+    0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28,
+    0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e
+};
+
+
+void
+ngx_xxh128(u_char digest[16], u_char *data, size_t len)
+{
+    ngx_uint_t         i;
+    ngx_xxh_uint128_t  h;
+
+    if (len <= 16) {
+        ngx_xxh3_0to16(&h, data, len);
+
+    } else if (len <= 240) {
+        ngx_xxh3_17to240(&h, data, len);
+
+    } else {
+        ngx_xxh3_long(&h, data, len);
+    }
+
+    for (i = 0; i < 8; i++) {
+        digest[i] = (u_char) (h.high >> (56 - 8 * i));
+        digest[i + 8] = (u_char) (h.low >> (56 - 8 * i));
+    }
+}
+
+
+static ngx_inline ngx_xxh_uint128_t
+ngx_xxh_mult128(uint64_t a, uint64_t b)
+{
+    ngx_xxh_uint128_t  r;
+
+#if (__SIZEOF_INT128__)
+
+    unsigned __int128  m;
+
+    m = (unsigned __int128) a * b;
+
+    r.low = (uint64_t) m;
+    r.high = (uint64_t) (m >> 64);
+
+#else
+
+    uint64_t  lo_lo, hi_lo, lo_hi, hi_hi, cross;
+
+    lo_lo = (a & 0xffffffff) * (b & 0xffffffff);
+    hi_lo = (a >> 32) * (b & 0xffffffff);
+    lo_hi = (a & 0xffffffff) * (b >> 32);
+    hi_hi = (a >> 32) * (b >> 32);
+
+    cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+
+    r.high = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    r.low = (cross << 32) | (lo_lo & 0xffffffff);
+
+#endif
+
+    return r;
+}
+
+
+static ngx_inline uint64_t
+ngx_xxh_mult128_fold64(uint64_t a, uint64_t b)
+{
+    ngx_xxh_uint128_t  r;
+
+    r = ngx_xxh_mult128(a, b);
+
+    return r.low ^ r.high;
+}
+
+
+static ngx_inline uint64_t
+ngx_xxh64_avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= NGX_XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= NGX_XXH_PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+
+static ngx_inline uint64_t
+ngx_xxh3_avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= NGX_XXH_PRIME_MX1;
+    h ^= h >> 32;
+
+    return h;
+}
+
+
+static ngx_inline uint64_t
+ngx_xxh3_mix16(u_char *p, u_char *secret)
+{
+    return ngx_xxh_mult128_fold64(ngx_xxh_read64(p) ^ ngx_xxh_read64(secret),
+                                  ngx_xxh_read64(p + 8)
+                                  ^ ngx_xxh_read64(secret + 8));
+}
+
+
+static ngx_inline void
+ngx_xxh3_mix32(ngx_xxh_uint128_t *acc, u_char *p1, u_char *p2,
+    u_char *secret)
+{
+    acc->low += ngx_xxh3_mix16(p1, secret);
+    acc->low ^= ngx_xxh_read64(p2) + ngx_xxh_read64(p2 + 8);
+    acc->high += ngx_xxh3_mix16(p2, secret + 16);
+    acc->high ^= ngx_xxh_read64(p1) + ngx_xxh_read64(p1 + 8);
+}
+
+
+static void
+ngx_xxh3_0to16(ngx_xxh_uint128_t *h, u_char *p, size_t len)
+{
+    u_char            *s;
+    uint32_t           lo32, hi32;
+    uint64_t           lo, hi;
+    ngx_xxh_uint128_t  m;
+
+    s = ngx_xxh3_secret;
+
+    if (len > 8) {
+        lo = ngx_xxh_read64(p);
+        hi = ngx_xxh_read64(p + len - 8);
+
+        m = ngx_xxh_mult128(lo ^ hi ^ ngx_xxh_read64(s + 32)
+                            ^ ngx_xxh_read64(s + 40),
+                            NGX_XXH_PRIME64_1);
+
+        hi ^= ngx_xxh_read64(s + 48) ^ ngx_xxh_read64(s + 56);
+
+        m.low += (uint64_t) (len - 1) << 54;
+        m.high += hi + (uint64_t) (uint32_t) hi * (NGX_XXH_PRIME32_2 - 1);
+        m.low ^= ngx_xxh_swap64(m.high);
+
+        *h = ngx_xxh_mult128(m.low, NGX_XXH_PRIME64_2);
+        h->high += m.high * NGX_XXH_PRIME64_2;
+
+        h->low = ngx_xxh3_avalanche(h->low);
+        h->high = ngx_xxh3_avalanche(h->high);
+
+        return;
+    }
+
+    if (len >= 4) {
+        lo = ngx_xxh_read32(p) + ((uint64_t) ngx_xxh_read32(p + len - 4) << 32);
+        lo ^= ngx_xxh_read64(s + 16) ^ ngx_xxh_read64(s + 24);
+
+        m = ngx_xxh_mult128(lo, NGX_XXH_PRIME64_1 + (len << 2));
+
+        m.high += m.low << 1;
+        m.low ^= m.high >> 3;
+
+        m.low ^= m.low >> 35;
+        m.low *= NGX_XXH_PRIME_MX2;
+        m.low ^= m.low >> 28;
+
+        h->low = m.low;
+        h->high = ngx_xxh3_avalanche(m.high);
+
+        return;
+    }
+
+    if (len > 0) {
+        lo32 = ((uint32_t) p[0] << 16) | ((uint32_t) p[len >> 1] << 24)
+               | p[len - 1] | ((uint32_t) len << 8);
+        hi32 = ngx_xxh_swap32(lo32);
+        hi32 = ngx_xxh_rotl32(hi32, 13);
+
+        lo = lo32 ^ (uint64_t) (ngx_xxh_read32(s) ^ ngx_xxh_read32(s + 4));
+        hi = hi32 ^ (uint64_t) (ngx_xxh_read32(s + 8) ^ ngx_xxh_read32(s + 12));
+
+        h->low = ngx_xxh64_avalanche(lo);
+        h->high = ngx_xxh64_avalanche(hi);
+
+        return;
+    }
+
+    h->low = ngx_xxh64_avalanche(ngx_xxh_read64(s + 64)
+                                 ^ ngx_xxh_read64(s + 72));
+    h->high = ngx_xxh64_avalanche(ngx_xxh_read64(s + 80)
+                                  ^ ngx_xxh_read64(s + 88));
+}
+
+
+static void
+ngx_xxh3_17to240(ngx_xxh_uint128_t *h, u_char *p, size_t len)
+{
+    u_char            *s;
+    ngx_uint_t         i, n;
+    ngx_xxh_uint128_t  acc;
+
+    s = ngx_xxh3_secret;
+
+    acc.low = len * NGX_XXH_PRIME64_1;
+    acc.high = 0;
+
+    if (len <= 128) {
+
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    ngx_xxh3_mix32(&acc, p + 48, p + len - 64, s + 96);
+                }
+
+                ngx_xxh3_mix32(&acc, p + 32, p + len - 48, s + 64);
+            }
+
+            ngx_xxh3_mix32(&acc, p + 16, p + len - 32, s + 32);
+        }
+
+        ngx_xxh3_mix32(&acc, p, p + len - 16, s);
+
+    } else {
+        n = len / 32;
+
+        for (i = 0; i < 4; i++) {
+            ngx_xxh3_mix32(&acc, p + 32 * i, p + 32 * i + 16, s + 32 * i);
+        }
+
+        acc.low = ngx_xxh3_avalanche(acc.low);
+        acc.high = ngx_xxh3_avalanche(acc.high);
+
+        for (i = 4; i < n; i++) {
+            ngx_xxh3_mix32(&acc, p + 32 * i, p + 32 * i + 16,
+                           s + 3 + 32 * (i - 4));
+        }
+
+        /* the last 32 bytes are mixed with the secret taken from its end */
+
+        ngx_xxh3_mix32(&acc, p + len - 16, p + len - 32, s + 136 - 17 - 16);
+    }
+
+    h->low = ngx_xxh3_avalanche(acc.low + acc.high);
+    h->high = (uint64_t) 0
+              - ngx_xxh3_avalanche(acc.low * NGX_XXH_PRIME64_1
+                                   + acc.high * NGX_XXH_PRIME64_4
+                                   + len * NGX_XXH_PRIME64_2);
+}
+
+
+static void
+ngx_xxh3_long(ngx_xxh_uint128_t *h, u_char *p, size_t len)
+{
+    u_char      *s, *last;
+    uint64_t     acc[8];
+    ngx_uint_t   i, k, n, blocks;
+
+    s = ngx_xxh3_secret;
+
+    acc[0] = NGX_XXH_PRIME32_3;
+    acc[1] = NGX_XXH_PRIME64_1;
+    acc[2] = NGX_XXH_PRIME64_2;
+    acc[3] = NGX_XXH_PRIME64_3;
+    acc[4] = NGX_XXH_PRIME64_4;
+    acc[5] = NGX_XXH_PRIME32_2;
+    acc[6] = NGX_XXH_PRIME64_5;
+    acc[7] = NGX_XXH_PRIME32_1;
+
+    blocks = (len - 1) / (NGX_XXH_STRIPE_LEN * NGX_XXH_STRIPES);
+
+    for (n = 0; n < blocks; n++) {
+
+        for (i = 0; i < NGX_XXH_STRIPES; i++) {
+            ngx_xxh3_accumulate(acc, p, s + 8 * i);
+            p += NGX_XXH_STRIPE_LEN;
+        }
+
+        /* scramble */
+
+        for (k = 0; k < 8; k++) {
+            acc[k] ^= acc[k] >> 47;
+            acc[k] ^= ngx_xxh_read64(s + NGX_XXH_SECRET_SIZE
+                                     - NGX_XXH_STRIPE_LEN + 8 * k);
+            acc[k] *= NGX_XXH_PRIME32_1;
+        }
+    }
+
+    last = p + len - blocks * NGX_XXH_STRIPE_LEN * NGX_XXH_STRIPES;
+    n = (last - 1 - p) / NGX_XXH_STRIPE_LEN;
+
+    for (i = 0; i < n; i++) {
+        ngx_xxh3_accumulate(acc, p, s + 8 * i);
+        p += NGX_XXH_STRIPE_LEN;
+    }
+
+    ngx_xxh3_accumulate(acc, last - NGX_XXH_STRIPE_LEN,
+                        s + NGX_XXH_SECRET_SIZE - NGX_XXH_STRIPE_LEN - 7);
+
+    h->low = ngx_xxh3_merge(acc, s + 11, len * NGX_XXH_PRIME64_1);
+    h->high = ngx_xxh3_merge(acc, s + NGX_XXH_SECRET_SIZE - 64 - 11,
+                             ~(len * NGX_XXH_PRIME64_2));
+}
+
+
+static void
+ngx_xxh3_accumulate(uint64_t *acc, u_char *p, u_char *secret)
+{
+    uint64_t    v, k;
+    ngx_uint_t  i;
+
+    for (i = 0; i < 8; i++) {
+        v = ngx_xxh_read64(p + 8 * i);
+        k = v ^ ngx_xxh_read64(secret + 8 * i);
+
+        acc[i ^ 1] += v;
+        acc[i] += (k & 0xffffffff) * (k >> 32);
+    }
+}
+
+
+static uint64_t
+ngx_xxh3_merge(uint64_t *acc, u_char *secret, uint64_t start)
+{
+    ngx_uint_t  i;
+
+    for (i = 0; i < 4; i++) {
+        start += ngx_xxh_mult128_fold64(acc[2 * i]
+                                        ^ ngx_xxh_read64(secret + 16 * i),
+                                        acc[2 * i + 1]
+                                        ^ ngx_xxh_read64(secret + 16 * i + 8));
+    }
+
+    return ngx_xxh3_avalanche(start);
+}
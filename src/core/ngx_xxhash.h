@@ -0,0 +1,20 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_XXHASH_H_INCLUDED_
+#define _NGX_XXHASH_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+/* XXH3 128-bit hash, the digest is in the canonical big-endian form */
+
+void ngx_xxh128(u_char digest[16], u_char *data, size_t len);
+
+
+#endif /* _NGX_XXHASH_H_INCLUDED_ */
@@ -104,6 +104,10 @@ static ngx_int_t ngx_epoll_del_event(ngx_event_t *ev, ngx_int_t event,
 static ngx_int_t ngx_epoll_add_connection(ngx_connection_t *c);
 static ngx_int_t ngx_epoll_del_connection(ngx_connection_t *c,
     ngx_uint_t flags);
+static ngx_int_t ngx_epoll_set_event(ngx_connection_t *c, uint32_t events);
+static void ngx_epoll_unlink_change(ngx_connection_t *c);
+static ngx_int_t ngx_epoll_process_changes(ngx_cycle_t *cycle,
+    ngx_uint_t nowait);
 static ngx_int_t ngx_epoll_process_events(ngx_cycle_t *cycle, ngx_msec_t timer,
     ngx_uint_t flags);
 
@@ -118,6 +122,17 @@ static int                  ep = -1;
 static struct epoll_event  *event_list;
 static ngx_uint_t           nevents;
 
+/*
+ * the connections whose events were changed in the current iteration,
+ * the list is processed before epoll_wait()
+ */
+
+static ngx_connection_t   **change_list;
+static ngx_uint_t           nchanges, max_changes;
+
+static ngx_uint_t           ngx_epoll_ctl_calls;
+static ngx_uint_t           ngx_epoll_ctl_saved;
+
 #if (NGX_HAVE_FILE_AIO)
 
 int                         ngx_eventfd = -1;
@@ -162,7 +177,7 @@ ngx_event_module_t  ngx_epoll_module_ctx = {
         ngx_epoll_del_event,             /* disable an event */
         ngx_epoll_add_connection,        /* add an connection */
         ngx_epoll_del_connection,        /* delete an connection */
-        NULL,                            /* process the changes */
+        ngx_epoll_process_changes,       /* process the changes */
         ngx_epoll_process_events,        /* process the events */
         ngx_epoll_init,                  /* init the events */
         ngx_epoll_done,                  /* done the events */
@@ -304,7 +319,8 @@ failed:
 static ngx_int_t
 ngx_epoll_init(ngx_cycle_t *cycle, ngx_msec_t timer)
 {
-    ngx_epoll_conf_t  *epcf;
+    ngx_epoll_conf_t   *epcf;
+    ngx_connection_t  **list;
 
     epcf = ngx_event_get_conf(cycle->conf_ctx, ngx_epoll_module);
 
@@ -338,6 +354,23 @@ ngx_epoll_init(ngx_cycle_t *cycle, ngx_msec_t timer)
 
     nevents = epcf->events;
 
+    if (max_changes < cycle->connection_n) {
+        list = ngx_alloc(sizeof(ngx_connection_t *) * cycle->connection_n,
+                         cycle->log);
+        if (list == NULL) {
+            return NGX_ERROR;
+        }
+
+        if (change_list) {
+            ngx_memcpy(list, change_list,
+                       nchanges * sizeof(ngx_connection_t *));
+            ngx_free(change_list);
+        }
+
+        change_list = list;
+        max_changes = cycle->connection_n;
+    }
+
     ngx_io = ngx_os_io;
 
     /*
@@ -393,17 +426,21 @@ ngx_epoll_done(ngx_cycle_t *cycle)
 
     event_list = NULL;
     nevents = 0;
+
+    ngx_free(change_list);
+
+    change_list = NULL;
+    nchanges = 0;
+    max_changes = 0;
 }
 
 
 static ngx_int_t
 ngx_epoll_add_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
 {
-    int                  op;
     uint32_t             events, prev;
     ngx_event_t         *e;
     ngx_connection_t    *c;
-    struct epoll_event   ee;
 
     c = ev->data;
 
@@ -425,23 +462,15 @@ ngx_epoll_add_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
     }
 
     if (e->active) {
-        op = EPOLL_CTL_MOD;
         events |= prev;
-
-    } else {
-        op = EPOLL_CTL_ADD;
     }
 
-    ee.events = events | (uint32_t) flags;
-    ee.data.ptr = (void *) ((uintptr_t) c | ev->instance);
+    events |= (uint32_t) flags;
 
-    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, ev->log, 0,
-                   "epoll add event: fd:%d op:%d ev:%08XD",
-                   c->fd, op, ee.events);
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "epoll add event: fd:%d ev:%08XD", c->fd, events);
 
-    if (epoll_ctl(ep, op, c->fd, &ee) == -1) {
-        ngx_log_error(NGX_LOG_ALERT, ev->log, ngx_errno,
-                      "epoll_ctl(%d, %d) failed", op, c->fd);
+    if (ngx_epoll_set_event(c, events) != NGX_OK) {
         return NGX_ERROR;
     }
 
@@ -457,11 +486,11 @@ ngx_epoll_add_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
 static ngx_int_t
 ngx_epoll_del_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
 {
-    int                  op;
-    uint32_t             prev;
+    uint32_t             prev, events;
     ngx_event_t         *e;
     ngx_connection_t    *c;
-    struct epoll_event   ee;
+
+    c = ev->data;
 
     /*
      * when the file descriptor is closed, the epoll automatically deletes
@@ -470,12 +499,14 @@ ngx_epoll_del_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
      */
 
     if (flags & NGX_CLOSE_EVENT) {
+        ngx_epoll_unlink_change(c);
+
+        c->epoll_active = 0;
+        c->epoll_events = 0;
         ev->active = 0;
         return NGX_OK;
     }
 
-    c = ev->data;
-
     if (event == NGX_READ_EVENT) {
         e = c->write;
         prev = EPOLLOUT;
@@ -486,23 +517,16 @@ ngx_epoll_del_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
     }
 
     if (e->active) {
-        op = EPOLL_CTL_MOD;
-        ee.events = prev | (uint32_t) flags;
-        ee.data.ptr = (void *) ((uintptr_t) c | ev->instance);
+        events = prev | (uint32_t) flags;
 
     } else {
-        op = EPOLL_CTL_DEL;
-        ee.events = 0;
-        ee.data.ptr = NULL;
+        events = 0;
     }
 
-    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, ev->log, 0,
-                   "epoll del event: fd:%d op:%d ev:%08XD",
-                   c->fd, op, ee.events);
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "epoll del event: fd:%d ev:%08XD", c->fd, events);
 
-    if (epoll_ctl(ep, op, c->fd, &ee) == -1) {
-        ngx_log_error(NGX_LOG_ALERT, ev->log, ngx_errno,
-                      "epoll_ctl(%d, %d) failed", op, c->fd);
+    if (ngx_epoll_set_event(c, events) != NGX_OK) {
         return NGX_ERROR;
     }
 
@@ -515,17 +539,10 @@ ngx_epoll_del_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
 static ngx_int_t
 ngx_epoll_add_connection(ngx_connection_t *c)
 {
-    struct epoll_event  ee;
-
-    ee.events = EPOLLIN|EPOLLOUT|EPOLLET;
-    ee.data.ptr = (void *) ((uintptr_t) c | c->read->instance);
-
-    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
-                   "epoll add connection: fd:%d ev:%08XD", c->fd, ee.events);
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "epoll add connection: fd:%d", c->fd);
 
-    if (epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ee) == -1) {
-        ngx_log_error(NGX_LOG_ALERT, c->log, ngx_errno,
-                      "epoll_ctl(EPOLL_CTL_ADD, %d) failed", c->fd);
+    if (ngx_epoll_set_event(c, EPOLLIN|EPOLLOUT|EPOLLET) != NGX_OK) {
         return NGX_ERROR;
     }
 
@@ -539,9 +556,6 @@ ngx_epoll_add_connection(ngx_connection_t *c)
 static ngx_int_t
 ngx_epoll_del_connection(ngx_connection_t *c, ngx_uint_t flags)
 {
-    int                 op;
-    struct epoll_event  ee;
-
     /*
      * when the file descriptor is closed the epoll automatically deletes
      * it from its queue so we do not need to delete explicitly the event
@@ -549,6 +563,10 @@ ngx_epoll_del_connection(ngx_connection_t *c, ngx_uint_t flags)
      */
 
     if (flags & NGX_CLOSE_EVENT) {
+        ngx_epoll_unlink_change(c);
+
+        c->epoll_active = 0;
+        c->epoll_events = 0;
         c->read->active = 0;
         c->write->active = 0;
         return NGX_OK;
@@ -557,23 +575,160 @@ ngx_epoll_del_connection(ngx_connection_t *c, ngx_uint_t flags)
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
                    "epoll del connection: fd:%d", c->fd);
 
-    op = EPOLL_CTL_DEL;
+    if (ngx_epoll_set_event(c, 0) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    c->read->active = 0;
+    c->write->active = 0;
+
+    return NGX_OK;
+}
+
+
+/*
+ * The events of a connection are changed in the kernel once per iteration
+ * in ngx_epoll_process_changes(), so a sequence of the changes made by
+ * handlers collapses into a single epoll_ctl() or into nothing at all.
+ * The deletion is done at once because the descriptor may be closed
+ * or passed to another process right after it.
+ */
+
+static ngx_int_t
+ngx_epoll_set_event(ngx_connection_t *c, uint32_t events)
+{
+    struct epoll_event  ee;
+
+    c->epoll_events = events;
+
+    if (events) {
+
+        if (c->read->index < nchanges && change_list[c->read->index] == c) {
+            ngx_epoll_ctl_saved++;
+            return NGX_OK;
+        }
+
+        if (nchanges == max_changes) {
+            (void) ngx_epoll_process_changes((ngx_cycle_t *) ngx_cycle, 0);
+        }
+
+        c->read->index = nchanges;
+        change_list[nchanges++] = c;
+
+        return NGX_OK;
+    }
+
+    ngx_epoll_unlink_change(c);
+
+    if (c->epoll_active == 0) {
+        ngx_epoll_ctl_saved++;
+        return NGX_OK;
+    }
+
+    c->epoll_active = 0;
+
+    ngx_epoll_ctl_calls++;
+
     ee.events = 0;
     ee.data.ptr = NULL;
 
-    if (epoll_ctl(ep, op, c->fd, &ee) == -1) {
+    if (epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, &ee) == -1) {
         ngx_log_error(NGX_LOG_ALERT, c->log, ngx_errno,
-                      "epoll_ctl(%d, %d) failed", op, c->fd);
+                      "epoll_ctl(%d, %d) failed", EPOLL_CTL_DEL, c->fd);
         return NGX_ERROR;
     }
 
-    c->read->active = 0;
-    c->write->active = 0;
-
     return NGX_OK;
 }
 
 
+static void
+ngx_epoll_unlink_change(ngx_connection_t *c)
+{
+    ngx_connection_t  *last;
+
+    if (c->read->index >= nchanges || change_list[c->read->index] != c) {
+        return;
+    }
+
+    /* the queued change is not needed anymore */
+
+    ngx_epoll_ctl_saved++;
+
+    last = change_list[--nchanges];
+
+    if (c->read->index < nchanges) {
+        change_list[c->read->index] = last;
+        last->read->index = c->read->index;
+    }
+
+    c->read->index = NGX_INVALID_INDEX;
+}
+
+
+static ngx_int_t
+ngx_epoll_process_changes(ngx_cycle_t *cycle, ngx_uint_t nowait)
+{
+    int                 op;
+    ngx_int_t           rc;
+    ngx_uint_t          i;
+    ngx_connection_t   *c;
+    struct epoll_event  ee;
+
+    rc = NGX_OK;
+
+    for (i = 0; i < nchanges; i++) {
+        c = change_list[i];
+
+        c->read->index = NGX_INVALID_INDEX;
+
+        if (c->epoll_events == c->epoll_active) {
+            ngx_epoll_ctl_saved++;
+            continue;
+        }
+
+        op = c->epoll_active ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+        ee.events = c->epoll_events;
+        ee.data.ptr = (void *) ((uintptr_t) c | c->read->instance);
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                       "epoll change: fd:%d op:%d ev:%08XD",
+                       c->fd, op, ee.events);
+
+        ngx_epoll_ctl_calls++;
+
+        if (epoll_ctl(ep, op, c->fd, &ee) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, c->log, ngx_errno,
+                          "epoll_ctl(%d, %d) failed", op, c->fd);
+            rc = NGX_ERROR;
+            continue;
+        }
+
+        c->epoll_active = c->epoll_events;
+    }
+
+    nchanges = 0;
+
+#if (NGX_STAT_STUB)
+
+    if (ngx_epoll_ctl_calls) {
+        (void) ngx_atomic_fetch_add(ngx_stat_epoll_ctl, ngx_epoll_ctl_calls);
+        ngx_epoll_ctl_calls = 0;
+    }
+
+    if (ngx_epoll_ctl_saved) {
+        (void) ngx_atomic_fetch_add(ngx_stat_epoll_ctl_saved,
+                                    ngx_epoll_ctl_saved);
+        ngx_epoll_ctl_saved = 0;
+    }
+
+#endif
+
+    return rc;
+}
+
+
 static ngx_int_t
 ngx_epoll_process_events(ngx_cycle_t *cycle, ngx_msec_t timer, ngx_uint_t flags)
 {
@@ -587,6 +742,8 @@ ngx_epoll_process_events(ngx_cycle_t *cycle, ngx_msec_t timer, ngx_uint_t flags)
 
     /* NGX_TIMER_INFINITE == INFTIM */
 
+    (void) ngx_epoll_process_changes(cycle, 0);
+
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
                    "epoll timer: %M", timer);
 
@@ -0,0 +1,837 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+/*
+ * multishot poll and the poll update have appeared in Linux 5.13 together
+ * with IORING_FEAT_RSRC_TAGS, the timeout argument of io_uring_enter()
+ * has appeared in Linux 5.11
+ */
+
+#define NGX_IOURING_FEATURES                                                  \
+    (IORING_FEAT_NODROP|IORING_FEAT_EXT_ARG|IORING_FEAT_RSRC_TAGS)
+
+
+typedef struct {
+    ngx_uint_t  entries;
+} ngx_iouring_conf_t;
+
+
+static ngx_int_t ngx_iouring_init(ngx_cycle_t *cycle, ngx_msec_t timer);
+static void ngx_iouring_done(ngx_cycle_t *cycle);
+static ngx_int_t ngx_iouring_add_event(ngx_event_t *ev, ngx_int_t event,
+    ngx_uint_t flags);
+static ngx_int_t ngx_iouring_del_event(ngx_event_t *ev, ngx_int_t event,
+    ngx_uint_t flags);
+static ngx_int_t ngx_iouring_add_connection(ngx_connection_t *c);
+static ngx_int_t ngx_iouring_del_connection(ngx_connection_t *c,
+    ngx_uint_t flags);
+static ngx_int_t ngx_iouring_process_events(ngx_cycle_t *cycle,
+    ngx_msec_t timer, ngx_uint_t flags);
+
+static struct io_uring_sqe *ngx_iouring_get_sqe(ngx_log_t *log);
+static ngx_int_t ngx_iouring_submit(ngx_log_t *log);
+static ngx_int_t ngx_iouring_poll_add(ngx_connection_t *c, ngx_uint_t level);
+static ngx_int_t ngx_iouring_poll_update(ngx_connection_t *c);
+static ngx_int_t ngx_iouring_poll_remove(ngx_connection_t *c);
+
+static void *ngx_iouring_create_conf(ngx_cycle_t *cycle);
+static char *ngx_iouring_init_conf(ngx_cycle_t *cycle, void *conf);
+
+
+extern ngx_module_t          ngx_epoll_module;
+
+static int                   ring = -1;
+
+static void                 *sq_ring;
+static size_t                sq_ring_size;
+static void                 *cq_ring;
+static size_t                cq_ring_size;
+static struct io_uring_sqe  *sqes;
+static size_t                sqes_size;
+
+static uint32_t             *sq_head;
+static uint32_t             *sq_tail;
+static uint32_t             *sq_array;
+static uint32_t              sq_mask;
+static uint32_t              sq_entries;
+
+static uint32_t             *cq_head;
+static uint32_t             *cq_tail;
+static struct io_uring_cqe  *cqes;
+static uint32_t              cq_mask;
+
+
+static ngx_str_t      iouring_name = ngx_string("io_uring");
+
+static ngx_command_t  ngx_iouring_commands[] = {
+
+    { ngx_string("io_uring_entries"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_iouring_conf_t, entries),
+      NULL },
+
+      ngx_null_command
+};
+
+
+ngx_event_module_t  ngx_iouring_module_ctx = {
+    &iouring_name,
+    ngx_iouring_create_conf,             /* create configuration */
+    ngx_iouring_init_conf,               /* init configuration */
+
+    {
+        ngx_iouring_add_event,           /* add an event */
+        ngx_iouring_del_event,           /* delete an event */
+        ngx_iouring_add_event,           /* enable an event */
+        ngx_iouring_del_event,           /* disable an event */
+        ngx_iouring_add_connection,      /* add an connection */
+        ngx_iouring_del_connection,      /* delete an connection */
+        NULL,                            /* process the changes */
+        ngx_iouring_process_events,      /* process the events */
+        ngx_iouring_init,                /* init the events */
+        ngx_iouring_done,                /* done the events */
+    }
+
+};
+
+ngx_module_t  ngx_iouring_module = {
+    NGX_MODULE_V1,
+    &ngx_iouring_module_ctx,             /* module context */
+    ngx_iouring_commands,                /* module directives */
+    NGX_EVENT_MODULE,                    /* module type */
+    NULL,                                /* init master */
+    NULL,                                /* init module */
+    NULL,                                /* init process */
+    NULL,                                /* init thread */
+    NULL,                                /* exit thread */
+    NULL,                                /* exit process */
+    NULL,                                /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+/*
+ * We call io_uring_setup() and io_uring_enter() directly as syscalls
+ * instead of liburing usage to avoid the dependency: only a poll request
+ * per connection is used, so the rings are simple enough to drive by hand.
+ *
+ * The module is a readiness notification method: the ring replaces
+ * epoll_wait() and epoll_ctl(), while the data are still transferred
+ * by ngx_os_io.  The recv(), send() and accept() requests complete
+ * asynchronously into buffers owned by the kernel until the completion,
+ * and the ngx_os_io interface and its callers expect the data to be
+ * transferred synchronously.
+ */
+
+static int
+io_uring_setup(u_int entries, struct io_uring_params *p)
+{
+    return syscall(SYS_io_uring_setup, entries, p);
+}
+
+
+static int
+io_uring_enter(int fd, u_int to_submit, u_int min_complete, u_int flags,
+    void *arg, size_t argsz)
+{
+    return syscall(SYS_io_uring_enter, fd, to_submit, min_complete, flags,
+                   arg, argsz);
+}
+
+
+static ngx_int_t
+ngx_iouring_init(ngx_cycle_t *cycle, ngx_msec_t timer)
+{
+    u_char                  *p;
+    ngx_err_t                err;
+    ngx_event_module_t      *module;
+    ngx_iouring_conf_t      *iocf;
+    struct io_uring_params   params;
+
+    iocf = ngx_event_get_conf(cycle->conf_ctx, ngx_iouring_module);
+
+    if (ring == -1) {
+        ngx_memzero(&params, sizeof(struct io_uring_params));
+
+        ring = io_uring_setup(iocf->entries, &params);
+
+        if (ring == -1) {
+            err = ngx_errno;
+            goto fallback;
+        }
+
+        if ((params.features & NGX_IOURING_FEATURES) != NGX_IOURING_FEATURES)
+        {
+            err = 0;
+            goto fallback;
+        }
+
+        sq_ring_size = params.sq_off.array
+                       + params.sq_entries * sizeof(uint32_t);
+        cq_ring_size = params.cq_off.cqes
+                       + params.cq_entries * sizeof(struct io_uring_cqe);
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            sq_ring_size = ngx_max(sq_ring_size, cq_ring_size);
+            cq_ring_size = sq_ring_size;
+        }
+
+        sq_ring = mmap(NULL, sq_ring_size, PROT_READ|PROT_WRITE,
+                       MAP_SHARED|MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+
+        if (sq_ring == MAP_FAILED) {
+            ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                          "mmap(IORING_OFF_SQ_RING) failed");
+            goto failed;
+        }
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            cq_ring = sq_ring;
+
+        } else {
+            cq_ring = mmap(NULL, cq_ring_size, PROT_READ|PROT_WRITE,
+                           MAP_SHARED|MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+
+            if (cq_ring == MAP_FAILED) {
+                ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                              "mmap(IORING_OFF_CQ_RING) failed");
+                goto failed;
+            }
+        }
+
+        sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+        sqes = mmap(NULL, sqes_size, PROT_READ|PROT_WRITE,
+                    MAP_SHARED|MAP_POPULATE, ring, IORING_OFF_SQES);
+
+        if (sqes == MAP_FAILED) {
+            ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                          "mmap(IORING_OFF_SQES) failed");
+            goto failed;
+        }
+
+        p = sq_ring;
+
+        sq_head = (uint32_t *) (p + params.sq_off.head);
+        sq_tail = (uint32_t *) (p + params.sq_off.tail);
+        sq_array = (uint32_t *) (p + params.sq_off.array);
+        sq_mask = *(uint32_t *) (p + params.sq_off.ring_mask);
+        sq_entries = *(uint32_t *) (p + params.sq_off.ring_entries);
+
+        p = cq_ring;
+
+        cq_head = (uint32_t *) (p + params.cq_off.head);
+        cq_tail = (uint32_t *) (p + params.cq_off.tail);
+        cqes = (struct io_uring_cqe *) (p + params.cq_off.cqes);
+        cq_mask = *(uint32_t *) (p + params.cq_off.ring_mask);
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                       "io_uring: fd:%d sq:%uD cq:%uD",
+                       ring, params.sq_entries, params.cq_entries);
+    }
+
+    ngx_io = ngx_os_io;
+
+#if (NGX_HAVE_FILE_AIO)
+
+    /* the AIO context is set up by epoll only, the files are read in place */
+
+    ngx_file_aio = 0;
+
+#endif
+
+    ngx_event_actions = ngx_iouring_module_ctx.actions;
+
+    ngx_event_flags = NGX_USE_CLEAR_EVENT
+                      |NGX_USE_GREEDY_EVENT
+                      |NGX_USE_EPOLL_EVENT;
+
+    return NGX_OK;
+
+fallback:
+
+    ngx_log_error(NGX_LOG_NOTICE, cycle->log, err,
+                  "io_uring is not available, using epoll");
+
+    ngx_iouring_done(cycle);
+
+    module = ngx_epoll_module.ctx;
+
+    return module->actions.init(cycle, timer);
+
+failed:
+
+    ngx_iouring_done(cycle);
+
+    return NGX_ERROR;
+}
+
+
+static void
+ngx_iouring_done(ngx_cycle_t *cycle)
+{
+    if (sqes && sqes != MAP_FAILED) {
+        if (munmap(sqes, sqes_size) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                          "munmap(IORING_OFF_SQES) failed");
+        }
+    }
+
+    if (cq_ring && cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+        if (munmap(cq_ring, cq_ring_size) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                          "munmap(IORING_OFF_CQ_RING) failed");
+        }
+    }
+
+    if (sq_ring && sq_ring != MAP_FAILED) {
+        if (munmap(sq_ring, sq_ring_size) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                          "munmap(IORING_OFF_SQ_RING) failed");
+        }
+    }
+
+    if (ring != -1 && close(ring) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "io_uring close() failed");
+    }
+
+    ring = -1;
+
+    sq_ring = NULL;
+    cq_ring = NULL;
+    sqes = NULL;
+}
+
+
+/*
+ * Every connection has at most one poll request for the POLLIN and POLLOUT
+ * of its active events.  The edge-triggered events are mapped to a multishot
+ * poll request that is armed while any of the connection events is active,
+ * the level-triggered ones (listening sockets) are mapped to an ordinary
+ * poll request that is rearmed after the notification just like
+ * NGX_USE_LEVEL_EVENT requires.
+ *
+ * When an event becomes active or inactive while the other one is active,
+ * the mask of the armed request is updated in place; the kernel polls
+ * the file again, so the request reports an initial level like
+ * EPOLL_CTL_MOD does.
+ *
+ * The user_data of the request is the connection pointer with the instance
+ * bit and two generation bits: the generation allows to ignore
+ * the notifications of the previous requests of the connection.
+ */
+
+static ngx_int_t
+ngx_iouring_add_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
+{
+    ngx_uint_t         level;
+    ngx_connection_t  *c;
+
+    c = ev->data;
+
+    if (ev->active) {
+        return NGX_OK;
+    }
+
+    level = (flags & NGX_CLEAR_EVENT) ? 0 : 1;
+
+    ngx_log_debug4(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "io_uring add event: fd:%d ev:%i fl:%ui armed:%d",
+                   c->fd, event, flags, c->read->uring_armed);
+
+    ev->active = 1;
+
+    if (c->read->uring_armed) {
+
+        if (c->read->uring_level == level) {
+            return ngx_iouring_poll_update(c);
+        }
+
+        if (ngx_iouring_poll_remove(c) == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+    }
+
+    return ngx_iouring_poll_add(c, level);
+}
+
+
+static ngx_int_t
+ngx_iouring_del_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
+{
+    ngx_event_t       *e;
+    ngx_connection_t  *c;
+
+    c = ev->data;
+
+    ev->active = 0;
+
+    e = (event == NGX_READ_EVENT) ? c->write : c->read;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "io_uring del event: fd:%d ev:%i fl:%ui",
+                   c->fd, event, flags);
+
+    /*
+     * unlike epoll, the poll request holds the file reference, so the
+     * request must be removed even if the file descriptor is being closed
+     */
+
+    if (!c->read->uring_armed) {
+        return NGX_OK;
+    }
+
+    if (e->active) {
+        return ngx_iouring_poll_update(c);
+    }
+
+    return ngx_iouring_poll_remove(c);
+}
+
+
+static ngx_int_t
+ngx_iouring_add_connection(ngx_connection_t *c)
+{
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "io_uring add connection: fd:%d", c->fd);
+
+    c->read->active = 1;
+    c->write->active = 1;
+
+    if (c->read->uring_armed) {
+
+        if (!c->read->uring_level) {
+            return ngx_iouring_poll_update(c);
+        }
+
+        if (ngx_iouring_poll_remove(c) == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+    }
+
+    return ngx_iouring_poll_add(c, 0);
+}
+
+
+static ngx_int_t
+ngx_iouring_del_connection(ngx_connection_t *c, ngx_uint_t flags)
+{
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "io_uring del connection: fd:%d fl:%ui", c->fd, flags);
+
+    c->read->active = 0;
+    c->write->active = 0;
+
+    if (c->read->uring_armed) {
+        return ngx_iouring_poll_remove(c);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_iouring_poll_add(ngx_connection_t *c, ngx_uint_t level)
+{
+    ngx_event_t          *rev;
+    struct io_uring_sqe  *sqe;
+
+    sqe = ngx_iouring_get_sqe(c->log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    rev = c->read;
+
+    rev->uring_armed = 1;
+    rev->uring_level = level;
+    rev->uring_gen++;
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = c->fd;
+    sqe->poll32_events = (rev->active ? POLLIN : 0)
+                         | (c->write->active ? POLLOUT : 0);
+    sqe->len = level ? 0 : IORING_POLL_ADD_MULTI;
+    sqe->user_data = (uintptr_t) c | rev->instance | (rev->uring_gen << 1);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_iouring_poll_update(ngx_connection_t *c)
+{
+    ngx_event_t          *rev;
+    struct io_uring_sqe  *sqe;
+
+    sqe = ngx_iouring_get_sqe(c->log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    rev = c->read;
+
+    /*
+     * the update completion has zero user_data and is ignored; if the
+     * request has just completed, the update fails, and the request
+     * is rearmed with the new mask when its completion is processed
+     */
+
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = (uintptr_t) c | rev->instance | (rev->uring_gen << 1);
+    sqe->poll32_events = (rev->active ? POLLIN : 0)
+                         | (c->write->active ? POLLOUT : 0);
+    sqe->len = IORING_POLL_UPDATE_EVENTS
+               | (rev->uring_level ? 0 : IORING_POLL_ADD_MULTI);
+    sqe->user_data = 0;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_iouring_poll_remove(ngx_connection_t *c)
+{
+    ngx_event_t          *rev;
+    struct io_uring_sqe  *sqe;
+
+    sqe = ngx_iouring_get_sqe(c->log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    rev = c->read;
+
+    rev->uring_armed = 0;
+
+    /* the remove request completion has zero user_data and is ignored */
+
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = (uintptr_t) c | rev->instance | (rev->uring_gen << 1);
+    sqe->user_data = 0;
+
+    return NGX_OK;
+}
+
+
+static struct io_uring_sqe *
+ngx_iouring_get_sqe(ngx_log_t *log)
+{
+    uint32_t              tail, index;
+    struct io_uring_sqe  *sqe;
+
+    tail = *sq_tail;
+
+    if (tail - *sq_head >= sq_entries) {
+
+        if (ngx_iouring_submit(log) != NGX_OK) {
+            return NULL;
+        }
+
+        if (tail - *sq_head >= sq_entries) {
+            ngx_log_error(NGX_LOG_ALERT, log, 0,
+                          "io_uring submission queue is full");
+            return NULL;
+        }
+    }
+
+    index = tail & sq_mask;
+
+    sqe = &sqes[index];
+    ngx_memzero(sqe, sizeof(struct io_uring_sqe));
+
+    sq_array[index] = index;
+
+    /*
+     * the kernel reads the queue in io_uring_enter() only,
+     * so the tail may be moved before the entry is filled
+     */
+
+    *sq_tail = tail + 1;
+
+    return sqe;
+}
+
+
+static ngx_int_t
+ngx_iouring_submit(ngx_log_t *log)
+{
+    uint32_t   n;
+    ngx_err_t  err;
+
+    n = *sq_tail - *sq_head;
+
+    if (n == 0) {
+        return NGX_OK;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0, "io_uring submit: %uD", n);
+
+    if (io_uring_enter(ring, n, 0, 0, NULL, 0) == -1) {
+        err = ngx_errno;
+
+        if (err == NGX_EINTR || err == NGX_EAGAIN || err == EBUSY) {
+            return NGX_OK;
+        }
+
+        ngx_log_error(NGX_LOG_ALERT, log, err, "io_uring_enter() failed");
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_iouring_process_events(ngx_cycle_t *cycle, ngx_msec_t timer,
+    ngx_uint_t flags)
+{
+    int                             rc;
+    u_int                           n, enter;
+    uint32_t                        head, tail, revents;
+    uint64_t                        data;
+    ngx_int_t                       instance, gen;
+    ngx_uint_t                      level;
+    ngx_err_t                       err;
+    ngx_event_t                    *rev, *wev, **queue;
+    ngx_connection_t               *c;
+    struct io_uring_cqe            *cqe;
+    struct __kernel_timespec        ts;
+    struct io_uring_getevents_arg   arg;
+
+    n = *sq_tail - *sq_head;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "io_uring timer: %M, submit: %ud", timer, n);
+
+    /* the changes are submitted and the events are waited by one syscall */
+
+    enter = IORING_ENTER_GETEVENTS|IORING_ENTER_EXT_ARG;
+
+    ngx_memzero(&arg, sizeof(struct io_uring_getevents_arg));
+
+    if (timer != NGX_TIMER_INFINITE) {
+        ts.tv_sec = timer / 1000;
+        ts.tv_nsec = (timer % 1000) * 1000000;
+        arg.ts = (uintptr_t) &ts;
+    }
+
+    rc = io_uring_enter(ring, n, 1, enter, &arg, sizeof(arg));
+
+    err = (rc == -1) ? ngx_errno : 0;
+
+    if (flags & NGX_UPDATE_TIME || ngx_event_timer_alarm) {
+        ngx_time_update();
+    }
+
+    if (err) {
+        if (err == NGX_EINTR) {
+
+            if (ngx_event_timer_alarm) {
+                ngx_event_timer_alarm = 0;
+                return NGX_OK;
+            }
+
+            level = NGX_LOG_INFO;
+
+        } else if (err == ETIME || err == NGX_EAGAIN || err == EBUSY) {
+            level = 0;
+
+        } else {
+            level = NGX_LOG_ALERT;
+        }
+
+        if (level) {
+            ngx_log_error(level, cycle->log, err, "io_uring_enter() failed");
+            return NGX_ERROR;
+        }
+    }
+
+    head = *cq_head;
+    tail = *cq_tail;
+
+    ngx_memory_barrier();
+
+    if (head == tail) {
+        return NGX_OK;
+    }
+
+    ngx_mutex_lock(ngx_posted_events_mutex);
+
+    for ( /* void */ ; head != tail; head++) {
+        cqe = &cqes[head & cq_mask];
+
+        data = cqe->user_data;
+
+        if (data == 0) {
+            continue;
+        }
+
+        instance = (ngx_int_t) (data & 1);
+        gen = (ngx_int_t) ((data >> 1) & 3);
+        c = (ngx_connection_t *) (uintptr_t) (data & ~(uint64_t) 7);
+
+        rev = c->read;
+
+        if (c->fd == -1
+            || rev->instance != instance
+            || rev->uring_gen != gen
+            || !rev->uring_armed)
+        {
+            /*
+             * the stale event from a file descriptor
+             * that was just closed in this iteration
+             * or from the removed poll request
+             */
+
+            ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                           "io_uring: stale event %p", c);
+            continue;
+        }
+
+        ngx_log_debug4(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                       "io_uring: fd:%d res:%d fl:%uD d:%p",
+                       c->fd, cqe->res, cqe->flags, (void *) data);
+
+        if (cqe->res < 0) {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, -cqe->res,
+                          "io_uring poll on fd:%d failed", c->fd);
+
+            rev->uring_armed = 0;
+            revents = POLLERR;
+
+        } else {
+            revents = (uint32_t) cqe->res;
+
+            if (!(cqe->flags & IORING_CQE_F_MORE)) {
+
+                /*
+                 * the ordinary poll request or the multishot one
+                 * which was terminated by the kernel, e.g., on CQ overflow
+                 */
+
+                rev->uring_armed = 0;
+
+                if (rev->active || c->write->active) {
+                    if (ngx_iouring_poll_add(c, rev->uring_level)
+                        == NGX_ERROR)
+                    {
+                        revents = POLLERR;
+                    }
+                }
+            }
+        }
+
+        if ((revents & (POLLERR|POLLHUP))
+             && (revents & (POLLIN|POLLOUT)) == 0)
+        {
+            /*
+             * if the error events were returned without POLLIN or POLLOUT,
+             * then add these flags to handle the events at least in one
+             * active handler
+             */
+
+            revents |= POLLIN|POLLOUT;
+        }
+
+        if ((revents & POLLIN) && rev->active) {
+
+            if ((flags & NGX_POST_THREAD_EVENTS) && !rev->accept) {
+                rev->posted_ready = 1;
+
+            } else {
+                rev->ready = 1;
+            }
+
+            if (flags & NGX_POST_EVENTS) {
+                queue = (ngx_event_t **) (rev->accept ?
+                               &ngx_posted_accept_events : &ngx_posted_events);
+
+                ngx_locked_post_event(rev, queue);
+
+            } else {
+                rev->handler(rev);
+            }
+        }
+
+        wev = c->write;
+
+        if ((revents & POLLOUT) && wev->active) {
+
+            if (c->fd == -1 || wev->instance != instance) {
+
+                /*
+                 * the stale event from a file descriptor
+                 * that was just closed in this iteration
+                 */
+
+                ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                               "io_uring: stale event %p", c);
+                continue;
+            }
+
+            if (flags & NGX_POST_THREAD_EVENTS) {
+                wev->posted_ready = 1;
+
+            } else {
+                wev->ready = 1;
+            }
+
+            if (flags & NGX_POST_EVENTS) {
+                ngx_locked_post_event(wev, &ngx_posted_events);
+
+            } else {
+                wev->handler(wev);
+            }
+        }
+    }
+
+    ngx_memory_barrier();
+
+    *cq_head = tail;
+
+    ngx_mutex_unlock(ngx_posted_events_mutex);
+
+    return NGX_OK;
+}
+
+
+static void *
+ngx_iouring_create_conf(ngx_cycle_t *cycle)
+{
+    ngx_iouring_conf_t  *iocf;
+
+    iocf = ngx_palloc(cycle->pool, sizeof(ngx_iouring_conf_t));
+    if (iocf == NULL) {
+        return NULL;
+    }
+
+    iocf->entries = NGX_CONF_UNSET;
+
+    return iocf;
+}
+
+
+static char *
+ngx_iouring_init_conf(ngx_cycle_t *cycle, void *conf)
+{
+    ngx_iouring_conf_t *iocf = conf;
+
+    ngx_conf_init_uint_value(iocf->entries, 512);
+
+    return NGX_CONF_OK;
+}
@@ -24,6 +24,7 @@ extern ngx_module_t ngx_select_module;
 static char *ngx_event_init_conf(ngx_cycle_t *cycle, void *conf);
 static ngx_int_t ngx_event_module_init(ngx_cycle_t *cycle);
 static ngx_int_t ngx_event_process_init(ngx_cycle_t *cycle);
+static void ngx_event_process_exit(ngx_cycle_t *cycle);
 static char *ngx_events_block(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 
 static char *ngx_event_connections(ngx_conf_t *cf, ngx_command_t *cmd,
@@ -35,6 +36,11 @@ static char *ngx_event_debug_connection(ngx_conf_t *cf, ngx_command_t *cmd,
 static void *ngx_event_core_create_conf(ngx_cycle_t *cycle);
 static char *ngx_event_core_init_conf(ngx_cycle_t *cycle, void *conf);
 
+#if (NGX_STAT_STUB)
+static void ngx_event_memory_stat_init(ngx_cycle_t *cycle);
+static void ngx_event_memory_stat_update(void);
+#endif
+
 
 static ngx_uint_t     ngx_timer_resolution;
 sig_atomic_t          ngx_event_timer_alarm;
@@ -73,6 +79,35 @@ ngx_atomic_t   ngx_stat_reading0;
 ngx_atomic_t  *ngx_stat_reading = &ngx_stat_reading0;
 ngx_atomic_t   ngx_stat_writing0;
 ngx_atomic_t  *ngx_stat_writing = &ngx_stat_writing0;
+ngx_atomic_t   ngx_stat_epoll_ctl0;
+ngx_atomic_t  *ngx_stat_epoll_ctl = &ngx_stat_epoll_ctl0;
+ngx_atomic_t   ngx_stat_epoll_ctl_saved0;
+ngx_atomic_t  *ngx_stat_epoll_ctl_saved = &ngx_stat_epoll_ctl_saved0;
+ngx_atomic_t   ngx_stat_minflt0;
+ngx_atomic_t  *ngx_stat_minflt = &ngx_stat_minflt0;
+ngx_atomic_t   ngx_stat_majflt0;
+ngx_atomic_t  *ngx_stat_majflt = &ngx_stat_majflt0;
+ngx_atomic_t   ngx_stat_dtlb_misses0;
+ngx_atomic_t  *ngx_stat_dtlb_misses = &ngx_stat_dtlb_misses0;
+ngx_atomic_t   ngx_stat_pool_cache_hits0;
+ngx_atomic_t  *ngx_stat_pool_cache_hits = &ngx_stat_pool_cache_hits0;
+ngx_atomic_t   ngx_stat_pool_cache_misses0;
+ngx_atomic_t  *ngx_stat_pool_cache_misses = &ngx_stat_pool_cache_misses0;
+
+u_char             *ngx_stat_workers;
+ngx_stat_worker_t   ngx_stat_worker0;
+ngx_stat_worker_t  *ngx_stat_worker = &ngx_stat_worker0;
+
+static ngx_msec_t  ngx_event_stat_time;
+static long        ngx_event_stat_minflt;
+static long        ngx_event_stat_majflt;
+static ngx_uint_t  ngx_event_stat_pool_hits;
+static ngx_uint_t  ngx_event_stat_pool_misses;
+
+#if (NGX_HAVE_PERF_EVENT)
+static int         ngx_event_dtlb_fd = -1;
+static uint64_t    ngx_event_stat_dtlb;
+#endif
 
 #endif
 
@@ -117,6 +152,13 @@ ngx_module_t  ngx_events_module = {
 static ngx_str_t  event_core_name = ngx_string("event_core");
 
 
+static ngx_conf_bitmask_t  ngx_event_connections_memory_mask[] = {
+    { ngx_string("hugepages"), NGX_ALLOC_HUGEPAGES },
+    { ngx_string("numa_local"), NGX_ALLOC_NUMA_LOCAL },
+    { ngx_null_string, 0 }
+};
+
+
 static ngx_command_t  ngx_event_core_commands[] = {
 
     { ngx_string("worker_connections"),
@@ -133,6 +175,13 @@ static ngx_command_t  ngx_event_core_commands[] = {
       0,
       NULL },
 
+    { ngx_string("worker_connections_memory"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE12,
+      ngx_conf_set_bitmask_slot,
+      0,
+      offsetof(ngx_event_conf_t, connections_memory),
+      &ngx_event_connections_memory_mask },
+
     { ngx_string("use"),
       NGX_EVENT_CONF|NGX_CONF_TAKE1,
       ngx_event_use,
@@ -161,6 +210,13 @@ static ngx_command_t  ngx_event_core_commands[] = {
       offsetof(ngx_event_conf_t, accept_mutex_delay),
       NULL },
 
+    { ngx_string("timer_wheel"),
+      NGX_EVENT_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      0,
+      offsetof(ngx_event_conf_t, timer_wheel),
+      NULL },
+
     { ngx_string("debug_connection"),
       NGX_EVENT_CONF|NGX_CONF_TAKE1,
       ngx_event_debug_connection,
@@ -191,7 +247,7 @@ ngx_module_t  ngx_event_core_module = {
     ngx_event_process_init,                /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
-    NULL,                                  /* exit process */
+    ngx_event_process_exit,                /* exit process */
     NULL,                                  /* exit master */
     NGX_MODULE_V1_PADDING
 };
@@ -267,6 +323,16 @@ ngx_process_events_and_timers(ngx_cycle_t *cycle)
         ngx_event_expire_timers();
     }
 
+#if (NGX_STAT_STUB)
+    ngx_stat_worker->loops++;
+    ngx_stat_worker->connections = cycle->connection_n
+                                   - cycle->free_connection_n;
+
+    if (ngx_current_msec - ngx_event_stat_time >= 1000) {
+        ngx_event_memory_stat_update();
+    }
+#endif
+
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
                    "posted events %p", ngx_posted_events);
 
@@ -516,11 +582,20 @@ ngx_event_module_init(ngx_cycle_t *cycle)
            + cl          /* ngx_stat_requests */
            + cl          /* ngx_stat_active */
            + cl          /* ngx_stat_reading */
-           + cl;         /* ngx_stat_writing */
+           + cl          /* ngx_stat_writing */
+           + cl          /* ngx_stat_epoll_ctl */
+           + cl          /* ngx_stat_epoll_ctl_saved */
+           + cl          /* ngx_stat_minflt */
+           + cl          /* ngx_stat_majflt */
+           + cl          /* ngx_stat_dtlb_misses */
+           + cl          /* ngx_stat_pool_cache_hits */
+           + cl          /* ngx_stat_pool_cache_misses */
+           + NGX_MAX_PROCESSES * NGX_STAT_WORKER_SIZE;   /* ngx_stat_workers */
 
 #endif
 
     shm.size = size;
+    shm.flags = 0;
     shm.name.len = sizeof("nginx_shared_zone");
     shm.name.data = (u_char *) "nginx_shared_zone";
     shm.log = cycle->log;
@@ -563,6 +638,14 @@ ngx_event_module_init(ngx_cycle_t *cycle)
     ngx_stat_active = (ngx_atomic_t *) (shared + 6 * cl);
     ngx_stat_reading = (ngx_atomic_t *) (shared + 7 * cl);
     ngx_stat_writing = (ngx_atomic_t *) (shared + 8 * cl);
+    ngx_stat_epoll_ctl = (ngx_atomic_t *) (shared + 9 * cl);
+    ngx_stat_epoll_ctl_saved = (ngx_atomic_t *) (shared + 10 * cl);
+    ngx_stat_minflt = (ngx_atomic_t *) (shared + 11 * cl);
+    ngx_stat_majflt = (ngx_atomic_t *) (shared + 12 * cl);
+    ngx_stat_dtlb_misses = (ngx_atomic_t *) (shared + 13 * cl);
+    ngx_stat_pool_cache_hits = (ngx_atomic_t *) (shared + 14 * cl);
+    ngx_stat_pool_cache_misses = (ngx_atomic_t *) (shared + 15 * cl);
+    ngx_stat_workers = shared + 16 * cl;
 
 #endif
 
@@ -618,6 +701,28 @@ ngx_event_process_init(ngx_cycle_t *cycle)
         ngx_use_accept_mutex = 0;
     }
 
+#if (NGX_HAVE_REUSEPORT)
+
+    /*
+     * the accept mutex is not needed if every listening socket
+     * has its own SO_REUSEPORT copy in each worker process
+     */
+
+    if (ngx_use_accept_mutex) {
+        ls = cycle->listening.elts;
+        for (i = 0; i < cycle->listening.nelts; i++) {
+            if (!ls[i].reuseport) {
+                break;
+            }
+        }
+
+        if (i == cycle->listening.nelts) {
+            ngx_use_accept_mutex = 0;
+        }
+    }
+
+#endif
+
 #if (NGX_THREADS)
     ngx_posted_events_mutex = ngx_mutex_init(cycle->log, 0);
     if (ngx_posted_events_mutex == NULL) {
@@ -625,6 +730,8 @@ ngx_event_process_init(ngx_cycle_t *cycle)
     }
 #endif
 
+    ngx_event_timer_wheel = ecf->timer_wheel;
+
     if (ngx_event_timer_init(cycle->log) == NGX_ERROR) {
         return NGX_ERROR;
     }
@@ -696,18 +803,43 @@ ngx_event_process_init(ngx_cycle_t *cycle)
         }
     }
 
+#endif
+
+#if (NGX_HAVE_NUMA)
+
+    /* the connection pools and buffers are allocated by the worker later */
+
+    if (ecf->connections_memory & NGX_ALLOC_NUMA_LOCAL) {
+        (void) ngx_numa_set_local_policy(cycle->log);
+    }
+
+#endif
+
+#if (NGX_STAT_STUB)
+
+    ngx_event_memory_stat_init(cycle);
+
+    if (ngx_stat_workers && ngx_process == NGX_PROCESS_WORKER) {
+        ngx_stat_worker = ngx_stat_worker_slot(ngx_process_slot);
+
+        ngx_memzero(ngx_stat_worker, sizeof(ngx_stat_worker_t));
+        ngx_stat_worker->pid = ngx_pid;
+    }
+
 #endif
 
     cycle->connections =
-        ngx_alloc(sizeof(ngx_connection_t) * cycle->connection_n, cycle->log);
+        ngx_alloc_pages(sizeof(ngx_connection_t) * cycle->connection_n,
+                        ecf->connections_memory, cycle->log);
     if (cycle->connections == NULL) {
         return NGX_ERROR;
     }
 
     c = cycle->connections;
 
-    cycle->read_events = ngx_alloc(sizeof(ngx_event_t) * cycle->connection_n,
-                                   cycle->log);
+    cycle->read_events =
+        ngx_alloc_pages(sizeof(ngx_event_t) * cycle->connection_n,
+                        ecf->connections_memory, cycle->log);
     if (cycle->read_events == NULL) {
         return NGX_ERROR;
     }
@@ -722,8 +854,9 @@ ngx_event_process_init(ngx_cycle_t *cycle)
 #endif
     }
 
-    cycle->write_events = ngx_alloc(sizeof(ngx_event_t) * cycle->connection_n,
-                                    cycle->log);
+    cycle->write_events =
+        ngx_alloc_pages(sizeof(ngx_event_t) * cycle->connection_n,
+                        ecf->connections_memory, cycle->log);
     if (cycle->write_events == NULL) {
         return NGX_ERROR;
     }
@@ -763,6 +896,15 @@ ngx_event_process_init(ngx_cycle_t *cycle)
     ls = cycle->listening.elts;
     for (i = 0; i < cycle->listening.nelts; i++) {
 
+#if (NGX_HAVE_REUSEPORT)
+        if (ls[i].reuseport
+            && ls[i].worker != ngx_worker
+            && ngx_process != NGX_PROCESS_SINGLE)
+        {
+            continue;
+        }
+#endif
+
         c = ngx_get_connection(ls[i].fd, cycle->log);
 
         if (c == NULL) {
@@ -843,6 +985,16 @@ ngx_event_process_init(ngx_cycle_t *cycle)
 
         rev->handler = ngx_event_accept;
 
+#if (NGX_HAVE_REUSEPORT)
+        if (ls[i].reuseport) {
+            if (ngx_add_event(rev, NGX_READ_EVENT, 0) == NGX_ERROR) {
+                return NGX_ERROR;
+            }
+
+            continue;
+        }
+#endif
+
         if (ngx_use_accept_mutex) {
             continue;
         }
@@ -866,6 +1018,107 @@ ngx_event_process_init(ngx_cycle_t *cycle)
 }
 
 
+#if (NGX_STAT_STUB)
+
+/*
+ * the page faults and TLB misses of the workers are summed
+ * in the shared counters to compare the connections memory settings
+ */
+
+static void
+ngx_event_memory_stat_init(ngx_cycle_t *cycle)
+{
+    struct rusage  ru;
+#if (NGX_HAVE_PERF_EVENT)
+    struct perf_event_attr  attr;
+#endif
+
+    ngx_event_stat_time = ngx_current_msec;
+
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        ngx_event_stat_minflt = ru.ru_minflt;
+        ngx_event_stat_majflt = ru.ru_majflt;
+    }
+
+    ngx_event_stat_pool_hits = ngx_pool_cache_hits;
+    ngx_event_stat_pool_misses = ngx_pool_cache_misses;
+
+#if (NGX_HAVE_PERF_EVENT)
+
+    if (ngx_event_dtlb_fd != -1) {
+        return;
+    }
+
+    ngx_memzero(&attr, sizeof(struct perf_event_attr));
+
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.size = sizeof(struct perf_event_attr);
+    attr.config = PERF_COUNT_HW_CACHE_DTLB
+                  | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                  | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    ngx_event_dtlb_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+    if (ngx_event_dtlb_fd == -1) {
+        ngx_log_error(NGX_LOG_INFO, cycle->log, ngx_errno,
+                      "perf_event_open(dTLB misses) failed, "
+                      "TLB misses are not counted");
+        return;
+    }
+
+    ngx_event_stat_dtlb = 0;
+
+#endif
+}
+
+
+static void
+ngx_event_memory_stat_update(void)
+{
+    struct rusage  ru;
+#if (NGX_HAVE_PERF_EVENT)
+    uint64_t       n;
+#endif
+
+    ngx_event_stat_time = ngx_current_msec;
+
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        (void) ngx_atomic_fetch_add(ngx_stat_minflt,
+                                    ru.ru_minflt - ngx_event_stat_minflt);
+        (void) ngx_atomic_fetch_add(ngx_stat_majflt,
+                                    ru.ru_majflt - ngx_event_stat_majflt);
+
+        ngx_event_stat_minflt = ru.ru_minflt;
+        ngx_event_stat_majflt = ru.ru_majflt;
+    }
+
+    (void) ngx_atomic_fetch_add(ngx_stat_pool_cache_hits,
+                                ngx_pool_cache_hits - ngx_event_stat_pool_hits);
+    (void) ngx_atomic_fetch_add(ngx_stat_pool_cache_misses,
+                                ngx_pool_cache_misses
+                                - ngx_event_stat_pool_misses);
+
+    ngx_event_stat_pool_hits = ngx_pool_cache_hits;
+    ngx_event_stat_pool_misses = ngx_pool_cache_misses;
+
+#if (NGX_HAVE_PERF_EVENT)
+
+    if (ngx_event_dtlb_fd != -1
+        && read(ngx_event_dtlb_fd, &n, sizeof(uint64_t)) == sizeof(uint64_t))
+    {
+        (void) ngx_atomic_fetch_add(ngx_stat_dtlb_misses,
+                                    n - ngx_event_stat_dtlb);
+        ngx_event_stat_dtlb = n;
+    }
+
+#endif
+}
+
+#endif
+
+
 ngx_int_t
 ngx_send_lowat(ngx_connection_t *c, size_t lowat)
 {
@@ -901,6 +1154,15 @@ ngx_send_lowat(ngx_connection_t *c, size_t lowat)
 }
 
 
+static void
+ngx_event_process_exit(ngx_cycle_t *cycle)
+{
+#if (NGX_STAT_STUB)
+    ngx_stat_worker->pid = 0;
+#endif
+}
+
+
 static char *
 ngx_events_block(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -1191,6 +1453,8 @@ ngx_event_core_create_conf(ngx_cycle_t *cycle)
     ecf->connections = NGX_CONF_UNSET_UINT;
     ecf->use = NGX_CONF_UNSET_UINT;
     ecf->multi_accept = NGX_CONF_UNSET;
+    ecf->timer_wheel = NGX_CONF_UNSET;
+    ecf->connections_memory = 0;
     ecf->accept_mutex = NGX_CONF_UNSET;
     ecf->accept_mutex_delay = NGX_CONF_UNSET_MSEC;
     ecf->name = (void *) NGX_CONF_UNSET;
@@ -1227,6 +1491,22 @@ ngx_event_core_init_conf(ngx_cycle_t *cycle, void *conf)
 
     module = NULL;
 
+#if !(NGX_HAVE_MAP_HUGETLB)
+    if (ecf->connections_memory & NGX_ALLOC_HUGEPAGES) {
+        ngx_log_error(NGX_LOG_WARN, cycle->log, 0,
+                      "\"worker_connections_memory hugepages\" "
+                      "is not supported on this platform, ignored");
+    }
+#endif
+
+#if !(NGX_HAVE_NUMA)
+    if (ecf->connections_memory & NGX_ALLOC_NUMA_LOCAL) {
+        ngx_log_error(NGX_LOG_WARN, cycle->log, 0,
+                      "\"worker_connections_memory numa_local\" "
+                      "is not supported on this platform, ignored");
+    }
+#endif
+
 #if (NGX_HAVE_EPOLL) && !(NGX_TEST_BUILD_EPOLL)
 
     fd = epoll_create(100);
@@ -1308,6 +1588,7 @@ ngx_event_core_init_conf(ngx_cycle_t *cycle, void *conf)
     ngx_conf_init_value(ecf->multi_accept, 0);
     ngx_conf_init_value(ecf->accept_mutex, 1);
     ngx_conf_init_msec_value(ecf->accept_mutex_delay, 500);
+    ngx_conf_init_value(ecf->timer_wheel, 0);
 
 
 #if (NGX_HAVE_RTSIG)
@@ -94,6 +94,13 @@ struct ngx_event_s {
     int              kq_errno;
 #endif
 
+#if (NGX_HAVE_IOURING)
+    /* the io_uring poll request state, kept in the read event */
+    unsigned         uring_armed:1;
+    unsigned         uring_level:1;
+    unsigned         uring_gen:2;
+#endif
+
     /*
      * kqueue only:
      *   accept:     number of sockets that wait to be accepted
@@ -279,7 +286,7 @@ extern ngx_event_actions_t   ngx_event_actions;
 #define NGX_USE_GREEDY_EVENT     0x00000020
 
 /*
- * The event filter is epoll.
+ * The event filter is epoll or io_uring poll.
  */
 #define NGX_USE_EPOLL_EVENT      0x00000040
 
@@ -474,6 +481,10 @@ typedef struct {
 
     ngx_msec_t    accept_mutex_delay;
 
+    ngx_flag_t    timer_wheel;
+
+    ngx_uint_t    connections_memory;
+
     u_char       *name;
 
 #if (NGX_DEBUG)
@@ -511,6 +522,35 @@ extern ngx_atomic_t  *ngx_stat_requests;
 extern ngx_atomic_t  *ngx_stat_active;
 extern ngx_atomic_t  *ngx_stat_reading;
 extern ngx_atomic_t  *ngx_stat_writing;
+extern ngx_atomic_t  *ngx_stat_epoll_ctl;
+extern ngx_atomic_t  *ngx_stat_epoll_ctl_saved;
+extern ngx_atomic_t  *ngx_stat_minflt;
+extern ngx_atomic_t  *ngx_stat_majflt;
+extern ngx_atomic_t  *ngx_stat_dtlb_misses;
+extern ngx_atomic_t  *ngx_stat_pool_cache_hits;
+extern ngx_atomic_t  *ngx_stat_pool_cache_misses;
+
+
+/*
+ * the counters of a worker process are only updated by the worker itself,
+ * each slot takes its own cache line
+ */
+
+#define NGX_STAT_WORKER_SIZE  128
+
+typedef struct {
+    ngx_pid_t           pid;
+    ngx_atomic_uint_t   accepted;
+    ngx_atomic_uint_t   requests;
+    ngx_atomic_uint_t   connections;
+    ngx_atomic_uint_t   loops;
+} ngx_stat_worker_t;
+
+#define ngx_stat_worker_slot(n)                                               \
+    ((ngx_stat_worker_t *) (ngx_stat_workers + (n) * NGX_STAT_WORKER_SIZE))
+
+extern u_char             *ngx_stat_workers;
+extern ngx_stat_worker_t  *ngx_stat_worker;
 
 #endif
 
@@ -256,3 +256,31 @@ ngx_event_get_peer(ngx_peer_connection_t *pc, void *data)
 {
     return NGX_OK;
 }
+
+
+void
+ngx_peer_stat_ewma(ngx_atomic_t *ewma, ngx_atomic_uint_t sample)
+{
+    ngx_atomic_uint_t  old, avg;
+
+    /*
+     * the weight of a new sample is 1/8, the first one is taken as is;
+     * zero is reserved for "no samples yet"
+     */
+
+    do {
+        old = *ewma;
+
+        if (old == 0) {
+            avg = sample ? sample : 1;
+
+        } else {
+            avg = old - old / 8 + sample / 8;
+
+            if (avg == 0) {
+                avg = 1;
+            }
+        }
+
+    } while (!ngx_atomic_cmp_set(ewma, old, avg));
+}
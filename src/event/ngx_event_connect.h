@@ -21,6 +21,27 @@
 
 typedef struct ngx_peer_connection_s  ngx_peer_connection_t;
 
+
+/* the counters may live in shared memory and are updated atomically */
+
+typedef struct {
+    ngx_atomic_t                     requests;
+    ngx_atomic_t                     active;
+    ngx_atomic_t                     responses[5];
+    ngx_atomic_t                     fails;
+    ngx_atomic_t                     unavail;
+    ngx_atomic_t                     unavail_until;
+    ngx_atomic_t                     sent;
+    ngx_atomic_t                     received;
+
+    /* exponentially weighted moving averages, in microseconds */
+
+    ngx_atomic_t                     connect_time;
+    ngx_atomic_t                     header_time;
+    ngx_atomic_t                     response_time;
+} ngx_peer_stat_t;
+
+
 typedef ngx_int_t (*ngx_event_get_peer_pt)(ngx_peer_connection_t *pc,
     void *data);
 typedef void (*ngx_event_free_peer_pt)(ngx_peer_connection_t *pc, void *data,
@@ -62,6 +83,8 @@ struct ngx_peer_connection_s {
 
     ngx_log_t                       *log;
 
+    ngx_peer_stat_t                 *stat;
+
     unsigned                         cached:1;
 
                                      /* ngx_connection_log_error_e */
@@ -71,6 +94,7 @@ struct ngx_peer_connection_s {
 
 ngx_int_t ngx_event_connect_peer(ngx_peer_connection_t *pc);
 ngx_int_t ngx_event_get_peer(ngx_peer_connection_t *pc, void *data);
+void ngx_peer_stat_ewma(ngx_atomic_t *ewma, ngx_atomic_uint_t sample);
 
 
 #endif /* _NGX_EVENT_CONNECT_H_INCLUDED_ */
@@ -1723,7 +1723,7 @@ ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn, ngx_ssl_session_t *sess)
 
     ngx_memcpy(id, sess->session_id, sess->session_id_length);
 
-    hash = ngx_crc32_short(sess->session_id, sess->session_id_length);
+    hash = ngx_crc32c(sess->session_id, sess->session_id_length);
 
     ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
                    "ssl new session: %08XD:%d:%d",
@@ -1785,7 +1785,7 @@ ngx_ssl_get_cached_session(ngx_ssl_conn_t *ssl_conn, u_char *id, int len,
     ngx_connection_t         *c;
 #endif
 
-    hash = ngx_crc32_short(id, (size_t) len);
+    hash = ngx_crc32c(id, (size_t) len);
     *copy = 0;
 
 #if (NGX_DEBUG)
@@ -1899,7 +1899,7 @@ ngx_ssl_remove_session(SSL_CTX *ssl, ngx_ssl_session_t *sess)
     id = sess->session_id;
     len = (size_t) sess->session_id_length;
 
-    hash = ngx_crc32_short(id, len);
+    hash = ngx_crc32c(id, len);
 
     ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ngx_cycle->log, 0,
                    "ssl remove session: %08XD:%uz", hash, len);
@@ -10,6 +10,55 @@
 #include <ngx_event.h>
 
 
+/*
+ * The timer wheel is a hierarchy of NGX_TIMER_WHEEL_LEVELS wheels:
+ * the root wheel has 256 one millisecond slots, each next wheel has
+ * 64 slots, every slot spans the whole previous wheel.  A timer is placed
+ * into the lowest wheel that covers its expiration time, and when the root
+ * wheel wraps around, a slot of the next wheel is cascaded down.
+ *
+ * The timer node fields are reused: node->left and node->right link
+ * the node into a circular slot list, node->parent points to the slot.
+ */
+
+#define NGX_TIMER_WHEEL_LEVELS     5
+#define NGX_TIMER_WHEEL_ROOT_BITS  8
+#define NGX_TIMER_WHEEL_BITS       6
+#define NGX_TIMER_WHEEL_ROOT_SIZE  (1 << NGX_TIMER_WHEEL_ROOT_BITS)
+#define NGX_TIMER_WHEEL_SIZE       (1 << NGX_TIMER_WHEEL_BITS)
+#define NGX_TIMER_WHEEL_ROOT_MASK  (NGX_TIMER_WHEEL_ROOT_SIZE - 1)
+#define NGX_TIMER_WHEEL_MASK       (NGX_TIMER_WHEEL_SIZE - 1)
+
+#define NGX_TIMER_WHEEL_SLOTS                                                 \
+    (NGX_TIMER_WHEEL_ROOT_SIZE                                                \
+     + (NGX_TIMER_WHEEL_LEVELS - 1) * NGX_TIMER_WHEEL_SIZE)
+
+#define ngx_event_timer_wheel_shift(level)                                    \
+    (NGX_TIMER_WHEEL_ROOT_BITS + ((level) - 1) * NGX_TIMER_WHEEL_BITS)
+
+#define ngx_event_timer_wheel_slot(level, n)                                  \
+    (&ngx_timer_wheel.slots[NGX_TIMER_WHEEL_ROOT_SIZE                         \
+                            + ((level) - 1) * NGX_TIMER_WHEEL_SIZE + (n)])
+
+
+typedef struct {
+    /* the next millisecond to expire */
+    ngx_msec_t          base;
+
+    ngx_uint_t          count;
+    ngx_uint_t          level_count[NGX_TIMER_WHEEL_LEVELS];
+
+    ngx_rbtree_node_t   slots[NGX_TIMER_WHEEL_SLOTS];
+} ngx_event_timer_wheel_t;
+
+
+static ngx_msec_t ngx_event_find_timer_wheel(void);
+static void ngx_event_expire_timers_wheel(void);
+static void ngx_event_timer_wheel_link(ngx_rbtree_node_t *node);
+static void ngx_event_timer_wheel_advance(ngx_msec_t base);
+static ngx_uint_t ngx_event_timer_wheel_level(ngx_rbtree_node_t *slot);
+
+
 #if (NGX_THREADS)
 ngx_mutex_t  *ngx_event_timer_mutex;
 #endif
@@ -18,6 +67,9 @@ ngx_mutex_t  *ngx_event_timer_mutex;
 ngx_thread_volatile ngx_rbtree_t  ngx_event_timer_rbtree;
 static ngx_rbtree_node_t          ngx_event_timer_sentinel;
 
+ngx_uint_t                        ngx_event_timer_wheel;
+static ngx_event_timer_wheel_t    ngx_timer_wheel;
+
 /*
  * the event timer rbtree may contain the duplicate keys, however,
  * it should not be a problem, because we use the rbtree to find
@@ -27,9 +79,20 @@ static ngx_rbtree_node_t          ngx_event_timer_sentinel;
 ngx_int_t
 ngx_event_timer_init(ngx_log_t *log)
 {
+    ngx_uint_t  i;
+
     ngx_rbtree_init(&ngx_event_timer_rbtree, &ngx_event_timer_sentinel,
                     ngx_rbtree_insert_timer_value);
 
+    ngx_memzero(&ngx_timer_wheel, sizeof(ngx_event_timer_wheel_t));
+
+    for (i = 0; i < NGX_TIMER_WHEEL_SLOTS; i++) {
+        ngx_timer_wheel.slots[i].left = &ngx_timer_wheel.slots[i];
+        ngx_timer_wheel.slots[i].right = &ngx_timer_wheel.slots[i];
+    }
+
+    ngx_timer_wheel.base = ngx_current_msec;
+
 #if (NGX_THREADS)
 
     if (ngx_event_timer_mutex) {
@@ -48,12 +111,27 @@ ngx_event_timer_init(ngx_log_t *log)
 }
 
 
+ngx_uint_t
+ngx_event_timers_empty(void)
+{
+    if (ngx_event_timer_wheel) {
+        return ngx_timer_wheel.count == 0;
+    }
+
+    return ngx_event_timer_rbtree.root == ngx_event_timer_rbtree.sentinel;
+}
+
+
 ngx_msec_t
 ngx_event_find_timer(void)
 {
     ngx_msec_int_t      timer;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_wheel) {
+        return ngx_event_find_timer_wheel();
+    }
+
     if (ngx_event_timer_rbtree.root == &ngx_event_timer_sentinel) {
         return NGX_TIMER_INFINITE;
     }
@@ -79,6 +157,11 @@ ngx_event_expire_timers(void)
     ngx_event_t        *ev;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_wheel) {
+        ngx_event_expire_timers_wheel();
+        return;
+    }
+
     sentinel = ngx_event_timer_rbtree.sentinel;
 
     for ( ;; ) {
@@ -156,3 +239,307 @@ ngx_event_expire_timers(void)
 
     ngx_mutex_unlock(ngx_event_timer_mutex);
 }
+
+
+void
+ngx_event_timer_wheel_insert(ngx_rbtree_node_t *node)
+{
+    if (ngx_timer_wheel.count == 0) {
+        ngx_timer_wheel.base = ngx_current_msec;
+    }
+
+    ngx_event_timer_wheel_link(node);
+}
+
+
+void
+ngx_event_timer_wheel_delete(ngx_rbtree_node_t *node)
+{
+    node->left->right = node->right;
+    node->right->left = node->left;
+
+    ngx_timer_wheel.level_count[ngx_event_timer_wheel_level(node->parent)]--;
+    ngx_timer_wheel.count--;
+}
+
+
+static void
+ngx_event_timer_wheel_link(ngx_rbtree_node_t *node)
+{
+    ngx_uint_t          level, shift;
+    ngx_msec_t          expires;
+    ngx_msec_int_t      delta;
+    ngx_rbtree_node_t  *slot;
+
+    expires = node->key;
+    delta = (ngx_msec_int_t) (expires - ngx_timer_wheel.base);
+
+    if (delta < 0) {
+
+        /* the timer has already expired, it will be run on the next pass */
+
+        level = 0;
+        slot = &ngx_timer_wheel.slots[ngx_timer_wheel.base
+                                      & NGX_TIMER_WHEEL_ROOT_MASK];
+
+    } else if (delta < NGX_TIMER_WHEEL_ROOT_SIZE) {
+        level = 0;
+        slot = &ngx_timer_wheel.slots[expires & NGX_TIMER_WHEEL_ROOT_MASK];
+
+    } else {
+
+        for (level = 1; /* void */ ; level++) {
+            shift = ngx_event_timer_wheel_shift(level);
+
+            if (((delta >> NGX_TIMER_WHEEL_BITS) >> shift) == 0) {
+                break;
+            }
+
+            if (level == NGX_TIMER_WHEEL_LEVELS - 1) {
+
+                /*
+                 * the timer is too far away, it is placed into the most
+                 * distant slot and will be placed again after cascading
+                 */
+
+                expires = ngx_timer_wheel.base
+                          - ((ngx_msec_t) 1 << shift);
+                break;
+            }
+        }
+
+        slot = ngx_event_timer_wheel_slot(level,
+                                     (expires >> shift) & NGX_TIMER_WHEEL_MASK);
+    }
+
+    node->parent = slot;
+    node->left = slot->left;
+    node->right = slot;
+    slot->left->right = node;
+    slot->left = node;
+
+    ngx_timer_wheel.level_count[level]++;
+    ngx_timer_wheel.count++;
+}
+
+
+static ngx_msec_t
+ngx_event_find_timer_wheel(void)
+{
+    ngx_uint_t          i, n, level, shift;
+    ngx_msec_t          base, expires, min;
+    ngx_msec_int_t      timer;
+    ngx_rbtree_node_t  *slot;
+
+    if (ngx_timer_wheel.count == 0) {
+        return NGX_TIMER_INFINITE;
+    }
+
+    ngx_mutex_lock(ngx_event_timer_mutex);
+
+    base = ngx_timer_wheel.base;
+
+    /*
+     * the root wheel contains exact expiration times, the other wheels
+     * give the time of the nearest cascading, which is not later than
+     * any timer in the cascaded slot
+     */
+
+    min = base + NGX_TIMER_INFINITE / 2;
+
+    if (ngx_timer_wheel.level_count[0]) {
+
+        for (i = 0; i < NGX_TIMER_WHEEL_ROOT_SIZE; i++) {
+            slot = &ngx_timer_wheel.slots[(base + i)
+                                          & NGX_TIMER_WHEEL_ROOT_MASK];
+
+            if (slot->right != slot) {
+                break;
+            }
+        }
+
+        min = base + i;
+    }
+
+    for (level = 1; level < NGX_TIMER_WHEEL_LEVELS; level++) {
+
+        if (ngx_timer_wheel.level_count[level] == 0) {
+            continue;
+        }
+
+        shift = ngx_event_timer_wheel_shift(level);
+        n = (base >> shift) & NGX_TIMER_WHEEL_MASK;
+
+        for (i = 1; i < NGX_TIMER_WHEEL_SIZE; i++) {
+            slot = ngx_event_timer_wheel_slot(level,
+                                              (n + i) & NGX_TIMER_WHEEL_MASK);
+
+            if (slot->right != slot) {
+                break;
+            }
+        }
+
+        expires = ((base >> shift) + i) << shift;
+
+        if ((ngx_msec_int_t) (expires - min) < 0) {
+            min = expires;
+        }
+    }
+
+    ngx_mutex_unlock(ngx_event_timer_mutex);
+
+    timer = (ngx_msec_int_t) (min - ngx_current_msec);
+
+    return (ngx_msec_t) (timer > 0 ? timer : 0);
+}
+
+
+static void
+ngx_event_expire_timers_wheel(void)
+{
+    ngx_msec_t          next;
+    ngx_event_t        *ev;
+    ngx_rbtree_node_t  *slot, *node;
+
+    ngx_mutex_lock(ngx_event_timer_mutex);
+
+    while ((ngx_msec_int_t) (ngx_current_msec - ngx_timer_wheel.base) >= 0) {
+
+        if (ngx_timer_wheel.count == 0) {
+            ngx_timer_wheel.base = ngx_current_msec + 1;
+            break;
+        }
+
+        if (ngx_timer_wheel.level_count[0] == 0) {
+
+            /* skip the empty root wheel up to the next cascading */
+
+            next = (ngx_timer_wheel.base | NGX_TIMER_WHEEL_ROOT_MASK) + 1;
+
+            if ((ngx_msec_int_t) (ngx_current_msec - next) < 0) {
+                ngx_event_timer_wheel_advance(ngx_current_msec + 1);
+                break;
+            }
+
+            ngx_event_timer_wheel_advance(next);
+            continue;
+        }
+
+        slot = &ngx_timer_wheel.slots[ngx_timer_wheel.base
+                                      & NGX_TIMER_WHEEL_ROOT_MASK];
+
+        while (slot->right != slot) {
+            node = slot->right;
+
+            ev = (ngx_event_t *) ((char *) node - offsetof(ngx_event_t, timer));
+
+#if (NGX_THREADS)
+
+            if (ngx_threaded && ngx_trylock(ev->lock) == 0) {
+
+                /* the slot will be walked again on the next call */
+
+                ngx_log_debug1(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                               "event %p is busy in expire timers", ev);
+
+                ngx_mutex_unlock(ngx_event_timer_mutex);
+                return;
+            }
+#endif
+
+            ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                           "event timer del: %d: %M",
+                           ngx_event_ident(ev->data), ev->timer.key);
+
+            ngx_event_timer_wheel_delete(node);
+
+            ngx_mutex_unlock(ngx_event_timer_mutex);
+
+#if (NGX_DEBUG)
+            ev->timer.left = NULL;
+            ev->timer.right = NULL;
+            ev->timer.parent = NULL;
+#endif
+
+            ev->timer_set = 0;
+
+#if (NGX_THREADS)
+            if (ngx_threaded) {
+                ev->posted_timedout = 1;
+
+                ngx_post_event(ev, &ngx_posted_events);
+
+                ngx_unlock(ev->lock);
+
+                ngx_mutex_lock(ngx_event_timer_mutex);
+
+                continue;
+            }
+#endif
+
+            ev->timedout = 1;
+
+            ev->handler(ev);
+
+            ngx_mutex_lock(ngx_event_timer_mutex);
+        }
+
+        ngx_event_timer_wheel_advance(ngx_timer_wheel.base + 1);
+    }
+
+    ngx_mutex_unlock(ngx_event_timer_mutex);
+}
+
+
+static void
+ngx_event_timer_wheel_advance(ngx_msec_t base)
+{
+    ngx_uint_t          n, level;
+    ngx_rbtree_node_t  *slot, *node;
+
+    ngx_timer_wheel.base = base;
+
+    if (base & NGX_TIMER_WHEEL_ROOT_MASK) {
+        return;
+    }
+
+    /*
+     * the root wheel has wrapped around: the slots of the next wheels
+     * that start at the new base are cascaded down before the base
+     * may be used by ngx_event_find_timer_wheel()
+     */
+
+    for (level = 1; level < NGX_TIMER_WHEEL_LEVELS; level++) {
+
+        n = (ngx_timer_wheel.base >> ngx_event_timer_wheel_shift(level))
+            & NGX_TIMER_WHEEL_MASK;
+
+        slot = ngx_event_timer_wheel_slot(level, n);
+
+        while (slot->right != slot) {
+            node = slot->right;
+
+            ngx_event_timer_wheel_delete(node);
+            ngx_event_timer_wheel_link(node);
+        }
+
+        if (n != 0) {
+            break;
+        }
+    }
+}
+
+
+static ngx_uint_t
+ngx_event_timer_wheel_level(ngx_rbtree_node_t *slot)
+{
+    ngx_uint_t  n;
+
+    n = slot - ngx_timer_wheel.slots;
+
+    if (n < NGX_TIMER_WHEEL_ROOT_SIZE) {
+        return 0;
+    }
+
+    return 1 + (n - NGX_TIMER_WHEEL_ROOT_SIZE) / NGX_TIMER_WHEEL_SIZE;
+}
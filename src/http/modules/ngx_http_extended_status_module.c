@@ -0,0 +1,1295 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+#include <nginx.h>
+
+
+typedef struct {
+    ngx_queue_t                          queue;
+
+    ngx_atomic_t                         requests;
+    ngx_atomic_t                         responses[5];
+    ngx_atomic_t                         discarded;
+    ngx_atomic_t                         received;
+    ngx_atomic_t                         sent;
+    ngx_atomic_t                         request_time;
+
+    unsigned                             location:1;
+    size_t                               server_len;
+    size_t                               location_len;
+    u_char                               data[1];
+} ngx_http_extended_status_node_t;
+
+
+typedef struct {
+    ngx_queue_t                          queue;
+    ngx_peer_stat_t                      stat;
+
+    unsigned                             backup:1;
+    size_t                               upstream_len;
+    size_t                               peer_len;
+    u_char                               data[1];
+} ngx_http_extended_status_peer_node_t;
+
+
+typedef struct {
+    ngx_queue_t                          queue;
+    ngx_queue_t                          peers;
+} ngx_http_extended_status_shctx_t;
+
+
+typedef struct {
+    ngx_str_t                            server;
+    ngx_str_t                            location;
+    ngx_uint_t                           type;
+} ngx_http_extended_status_label_t;
+
+
+typedef struct {
+    ngx_http_upstream_srv_conf_t        *uscf;
+    ngx_str_t                           *upstream;
+    ngx_http_upstream_rr_peer_t         *peer;
+    ngx_peer_stat_t                     *stat;
+    ngx_uint_t                           backup;
+    ngx_uint_t                           number;
+} ngx_http_extended_status_peer_t;
+
+
+typedef struct {
+    ngx_array_t                          labels;
+    ngx_http_extended_status_node_t    **nodes;
+
+    ngx_array_t                          peers;
+
+    ngx_shm_zone_t                      *shm_zone;
+    ngx_slab_pool_t                     *shpool;
+    ngx_http_extended_status_shctx_t    *sh;
+} ngx_http_extended_status_main_conf_t;
+
+
+typedef struct {
+    ngx_str_t                            name;
+    ngx_uint_t                           index;
+} ngx_http_extended_status_srv_conf_t;
+
+
+typedef struct {
+    ngx_uint_t                           slot;
+    ngx_stat_worker_t                    stat;
+} ngx_http_extended_status_worker_t;
+
+
+typedef struct {
+    ngx_flag_t                           enable;
+    ngx_uint_t                           index;
+} ngx_http_extended_status_loc_conf_t;
+
+
+#define NGX_HTTP_EXTENDED_STATUS_SERVER    0
+#define NGX_HTTP_EXTENDED_STATUS_LOCATION  1
+
+#define NGX_HTTP_EXTENDED_STATUS_NONE      ((ngx_uint_t) -1)
+
+
+static ngx_int_t ngx_http_extended_status_log_handler(ngx_http_request_t *r);
+static void ngx_http_extended_status_account(
+    ngx_http_extended_status_node_t *node, ngx_uint_t status,
+    ngx_atomic_uint_t received, ngx_atomic_uint_t sent, ngx_msec_int_t ms);
+static ngx_int_t ngx_http_extended_status_handler(ngx_http_request_t *r);
+static u_char *ngx_http_extended_status_workers(u_char *p,
+    ngx_http_extended_status_worker_t *workers, ngx_uint_t n);
+static u_char *ngx_http_extended_status_node(u_char *p,
+    ngx_http_extended_status_node_t *node);
+static u_char *ngx_http_extended_status_upstreams(u_char *p,
+    ngx_http_extended_status_peer_t *peer, ngx_uint_t n);
+
+static void *ngx_http_extended_status_create_main_conf(ngx_conf_t *cf);
+static void *ngx_http_extended_status_create_srv_conf(ngx_conf_t *cf);
+static char *ngx_http_extended_status_merge_srv_conf(ngx_conf_t *cf,
+    void *parent, void *child);
+static void *ngx_http_extended_status_create_loc_conf(ngx_conf_t *cf);
+static char *ngx_http_extended_status_merge_loc_conf(ngx_conf_t *cf,
+    void *parent, void *child);
+static ngx_int_t ngx_http_extended_status_label(ngx_conf_t *cf,
+    ngx_str_t *server, ngx_str_t *location, ngx_uint_t type);
+static ngx_int_t ngx_http_extended_status_add_peers(ngx_conf_t *cf,
+    ngx_http_extended_status_main_conf_t *emcf);
+static ngx_int_t ngx_http_extended_status_init_zone(ngx_shm_zone_t *shm_zone,
+    void *data);
+static ngx_int_t ngx_http_extended_status_init_peers(ngx_shm_zone_t *shm_zone,
+    ngx_http_extended_status_main_conf_t *emcf);
+static char *ngx_http_extended_status_zone(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static char *ngx_http_extended_status(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static ngx_int_t ngx_http_extended_status_init(ngx_conf_t *cf);
+
+
+static ngx_command_t  ngx_http_extended_status_commands[] = {
+
+    { ngx_string("extended_status_zone"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+      ngx_http_extended_status_zone,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("extended_status_accounting"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_extended_status_loc_conf_t, enable),
+      NULL },
+
+    { ngx_string("extended_status"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS,
+      ngx_http_extended_status,
+      0,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_extended_status_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    ngx_http_extended_status_init,         /* postconfiguration */
+
+    ngx_http_extended_status_create_main_conf,
+                                           /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    ngx_http_extended_status_create_srv_conf,
+                                           /* create server configuration */
+    ngx_http_extended_status_merge_srv_conf,
+                                           /* merge server configuration */
+
+    ngx_http_extended_status_create_loc_conf,
+                                           /* create location configuration */
+    ngx_http_extended_status_merge_loc_conf
+                                           /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_extended_status_module = {
+    NGX_MODULE_V1,
+    &ngx_http_extended_status_module_ctx,  /* module context */
+    ngx_http_extended_status_commands,     /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static ngx_int_t
+ngx_http_extended_status_log_handler(ngx_http_request_t *r)
+{
+    ngx_uint_t                             status;
+    ngx_time_t                            *tp;
+    ngx_msec_int_t                         ms;
+    ngx_atomic_uint_t                      received, sent;
+    ngx_http_extended_status_srv_conf_t   *escf;
+    ngx_http_extended_status_loc_conf_t   *elcf;
+    ngx_http_extended_status_main_conf_t  *emcf;
+
+    elcf = ngx_http_get_module_loc_conf(r, ngx_http_extended_status_module);
+
+    if (!elcf->enable) {
+        return NGX_OK;
+    }
+
+    emcf = ngx_http_get_module_main_conf(r, ngx_http_extended_status_module);
+    escf = ngx_http_get_module_srv_conf(r, ngx_http_extended_status_module);
+
+    if (r->err_status) {
+        status = r->err_status;
+
+    } else {
+        status = r->headers_out.status;
+    }
+
+    tp = ngx_timeofday();
+
+    ms = (ngx_msec_int_t)
+             ((tp->sec - r->start_sec) * 1000 + (tp->msec - r->start_msec));
+    ms = ngx_max(ms, 0);
+
+    received = r->request_length;
+    sent = r->connection->sent;
+
+    ngx_http_extended_status_account(emcf->nodes[escf->index], status,
+                                     received, sent, ms);
+
+    if (elcf->index != NGX_HTTP_EXTENDED_STATUS_NONE) {
+        ngx_http_extended_status_account(emcf->nodes[elcf->index], status,
+                                         received, sent, ms);
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_extended_status_account(ngx_http_extended_status_node_t *node,
+    ngx_uint_t status, ngx_atomic_uint_t received, ngx_atomic_uint_t sent,
+    ngx_msec_int_t ms)
+{
+    (void) ngx_atomic_fetch_add(&node->requests, 1);
+
+    if (status >= 100 && status < 600) {
+        (void) ngx_atomic_fetch_add(&node->responses[status / 100 - 1], 1);
+
+    } else {
+        (void) ngx_atomic_fetch_add(&node->discarded, 1);
+    }
+
+    (void) ngx_atomic_fetch_add(&node->received, received);
+    (void) ngx_atomic_fetch_add(&node->sent, sent);
+    (void) ngx_atomic_fetch_add(&node->request_time, ms);
+}
+
+
+static ngx_int_t
+ngx_http_extended_status_handler(ngx_http_request_t *r)
+{
+    size_t                                 size;
+    ngx_int_t                              rc;
+    ngx_buf_t                             *b;
+    ngx_uint_t                             i, k, n, nlocations;
+    ngx_queue_t                           *q;
+    ngx_chain_t                            out;
+    ngx_array_t                            nodes;
+    ngx_stat_worker_t                     *w;
+    ngx_http_extended_status_node_t      **node, **np;
+    ngx_http_extended_status_peer_t       *peer;
+    ngx_http_upstream_rr_peers_t          *peers;
+    ngx_http_extended_status_worker_t     *workers;
+    ngx_http_extended_status_main_conf_t  *emcf;
+
+    if (r->method != NGX_HTTP_GET && r->method != NGX_HTTP_HEAD) {
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    ngx_str_set(&r->headers_out.content_type, "application/json");
+
+    if (r->method == NGX_HTTP_HEAD) {
+        r->headers_out.status = NGX_HTTP_OK;
+
+        return ngx_http_send_header(r);
+    }
+
+    emcf = ngx_http_get_module_main_conf(r, ngx_http_extended_status_module);
+
+    /* the per worker counters are summed up here, not on the hot path */
+
+    workers = ngx_palloc(r->pool, NGX_MAX_PROCESSES
+                                  * sizeof(ngx_http_extended_status_worker_t));
+    if (workers == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    n = 0;
+
+    if (ngx_stat_workers) {
+        for (i = 0; i < NGX_MAX_PROCESSES; i++) {
+            w = ngx_stat_worker_slot(i);
+
+            if (w->pid == 0) {
+                continue;
+            }
+
+            workers[n].slot = i;
+            workers[n].stat = *w;
+            n++;
+        }
+    }
+
+    if (ngx_array_init(&nodes, r->pool, 16, sizeof(void *)) != NGX_OK) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    /* the nodes are never freed, so only the list walk is locked */
+
+    if (emcf->shm_zone) {
+        ngx_shmtx_lock(&emcf->shpool->mutex);
+
+        for (q = ngx_queue_head(&emcf->sh->queue);
+             q != ngx_queue_sentinel(&emcf->sh->queue);
+             q = ngx_queue_next(q))
+        {
+            np = ngx_array_push(&nodes);
+            if (np == NULL) {
+                ngx_shmtx_unlock(&emcf->shpool->mutex);
+                return NGX_HTTP_INTERNAL_SERVER_ERROR;
+            }
+
+            *np = ngx_queue_data(q, ngx_http_extended_status_node_t, queue);
+        }
+
+        ngx_shmtx_unlock(&emcf->shpool->mutex);
+    }
+
+    size = sizeof("{\"version\":\"" NGINX_VERSION "\",") - 1
+           + sizeof("\"connections\":{\"accepted\":,\"handled\":,"
+                    "\"active\":,\"reading\":,\"writing\":,\"waiting\":},")
+           - 1 + 6 * NGX_ATOMIC_T_LEN
+           + sizeof("\"requests\":{\"total\":},") - 1 + NGX_ATOMIC_T_LEN
+           + sizeof("\"workers\":{\"accepted\":,\"requests\":,"
+                    "\"connections\":,\"loops\":,\"processes\":[]},") - 1
+           + 4 * NGX_ATOMIC_T_LEN
+           + n * (sizeof(",{\"slot\":,\"pid\":,\"accepted\":,\"requests\":,"
+                         "\"connections\":,\"loops\":}") - 1
+                  + NGX_INT_T_LEN + NGX_INT64_LEN + 4 * NGX_ATOMIC_T_LEN)
+           + sizeof("\"server_zones\":{},\"upstreams\":{}}" CRLF) - 1;
+
+    node = nodes.elts;
+
+    for (i = 0; i < nodes.nelts; i++) {
+        size += sizeof(",\"\":{\"requests\":,\"responses\":{\"1xx\":,"
+                       "\"2xx\":,\"3xx\":,\"4xx\":,\"5xx\":},\"discarded\":,"
+                       "\"received\":,\"sent\":,\"request_time\":,"
+                       "\"locations\":{}}") - 1
+                + 10 * NGX_ATOMIC_T_LEN
+                + node[i]->location_len
+                + ngx_escape_json(NULL, node[i]->data + node[i]->server_len,
+                                  node[i]->location_len)
+                + node[i]->server_len
+                + ngx_escape_json(NULL, node[i]->data, node[i]->server_len);
+    }
+
+    peer = emcf->peers.elts;
+
+    for (i = 0; i < emcf->peers.nelts; i++) {
+
+        /*
+         * the health checks update the peers copied to an upstream zone,
+         * and the peers of resolved servers are replaced by the workers
+         */
+
+        peers = peer[i].uscf->peer.data;
+
+        if (peer[i].backup) {
+            peers = peers->next;
+        }
+
+        peer[i].peer = NULL;
+
+        for (k = 0; peers && k < peers->number; k++) {
+            if (peers->peer[k].stat == peer[i].stat) {
+                peer[i].peer = &peers->peer[k];
+                break;
+            }
+        }
+
+        if (peer[i].peer == NULL) {
+
+            /* the address is no longer resolved */
+
+            continue;
+        }
+
+        size += sizeof(",\"\":{\"peers\":[]}") - 1
+                + peer[i].upstream->len
+                + ngx_escape_json(NULL, peer[i].upstream->data,
+                                  peer[i].upstream->len)
+                + sizeof(",{\"server\":\"\",\"backup\":false,\"weight\":,"
+                         "\"state\":\"unhealthy\",\"requests\":,\"active\":,"
+                         "\"responses\":{\"1xx\":,\"2xx\":,\"3xx\":,\"4xx\":,"
+                         "\"5xx\":},\"fails\":,\"unavail\":,\"sent\":,"
+                         "\"received\":,\"connect_time\":,\"header_time\":,"
+                         "\"response_time\":}") - 1
+                + NGX_INT_T_LEN + 14 * NGX_ATOMIC_T_LEN
+                + peer[i].peer->name.len
+                + ngx_escape_json(NULL, peer[i].peer->name.data,
+                                  peer[i].peer->name.len);
+    }
+
+    b = ngx_create_temp_buf(r->pool, size);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    b->last = ngx_sprintf(b->last, "{\"version\":\"" NGINX_VERSION "\","
+                          "\"connections\":{\"accepted\":%uA,"
+                          "\"handled\":%uA,\"active\":%uA,\"reading\":%uA,"
+                          "\"writing\":%uA,\"waiting\":%uA},"
+                          "\"requests\":{\"total\":%uA},",
+                          *ngx_stat_accepted, *ngx_stat_handled,
+                          *ngx_stat_active, *ngx_stat_reading,
+                          *ngx_stat_writing,
+                          *ngx_stat_active
+                          - (*ngx_stat_reading + *ngx_stat_writing),
+                          *ngx_stat_requests);
+
+    b->last = ngx_http_extended_status_workers(b->last, workers, n);
+
+    b->last = ngx_cpymem(b->last, "\"server_zones\":{",
+                         sizeof("\"server_zones\":{") - 1);
+
+    n = 0;
+
+    for (i = 0; i < nodes.nelts; i++) {
+
+        if (node[i]->location) {
+            continue;
+        }
+
+        if (n++) {
+            *b->last++ = ',';
+        }
+
+        b->last = ngx_http_extended_status_node(b->last, node[i]);
+
+        nlocations = 0;
+
+        for (k = 0; k < nodes.nelts; k++) {
+
+            if (!node[k]->location
+                || node[k]->server_len != node[i]->server_len
+                || ngx_strncmp(node[k]->data, node[i]->data,
+                               node[i]->server_len)
+                   != 0)
+            {
+                continue;
+            }
+
+            if (nlocations++) {
+                *b->last++ = ',';
+            }
+
+            b->last = ngx_http_extended_status_node(b->last, node[k]);
+            *b->last++ = '}';
+        }
+
+        *b->last++ = '}';
+        *b->last++ = '}';
+    }
+
+    *b->last++ = '}';
+    *b->last++ = ',';
+
+    b->last = ngx_http_extended_status_upstreams(b->last, emcf->peers.elts,
+                                                 emcf->peers.nelts);
+
+    b->last = ngx_cpymem(b->last, "}" CRLF, sizeof("}" CRLF) - 1);
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    b->last_buf = (r == r->main) ? 1 : 0;
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
+static u_char *
+ngx_http_extended_status_workers(u_char *p,
+    ngx_http_extended_status_worker_t *workers, ngx_uint_t n)
+{
+    ngx_uint_t          i;
+    ngx_stat_worker_t  *w;
+    ngx_atomic_uint_t   accepted, requests, connections, loops;
+
+    accepted = 0;
+    requests = 0;
+    connections = 0;
+    loops = 0;
+
+    for (i = 0; i < n; i++) {
+        accepted += workers[i].stat.accepted;
+        requests += workers[i].stat.requests;
+        connections += workers[i].stat.connections;
+        loops += workers[i].stat.loops;
+    }
+
+    p = ngx_sprintf(p, "\"workers\":{\"accepted\":%uA,\"requests\":%uA,"
+                    "\"connections\":%uA,\"loops\":%uA,\"processes\":[",
+                    accepted, requests, connections, loops);
+
+    for (i = 0; i < n; i++) {
+        w = &workers[i].stat;
+
+        p = ngx_sprintf(p, "%s{\"slot\":%ui,\"pid\":%P,\"accepted\":%uA,"
+                        "\"requests\":%uA,\"connections\":%uA,"
+                        "\"loops\":%uA}",
+                        i ? "," : "", workers[i].slot, w->pid,
+                        w->accepted, w->requests, w->connections, w->loops);
+    }
+
+    return ngx_cpymem(p, "]},", sizeof("]},") - 1);
+}
+
+
+/* the closing brace is left for the "locations" object of a server */
+
+static u_char *
+ngx_http_extended_status_node(u_char *p, ngx_http_extended_status_node_t *node)
+{
+    u_char  *name;
+    size_t   len;
+
+    if (node->location) {
+        name = node->data + node->server_len;
+        len = node->location_len;
+
+    } else {
+        name = node->data;
+        len = node->server_len;
+    }
+
+    *p++ = '"';
+    p = (u_char *) ngx_escape_json(p, name, len);
+
+    p = ngx_sprintf(p, "\":{\"requests\":%uA,\"responses\":{\"1xx\":%uA,"
+                    "\"2xx\":%uA,\"3xx\":%uA,\"4xx\":%uA,\"5xx\":%uA},"
+                    "\"discarded\":%uA,\"received\":%uA,\"sent\":%uA,"
+                    "\"request_time\":%uA",
+                    node->requests, node->responses[0], node->responses[1],
+                    node->responses[2], node->responses[3],
+                    node->responses[4],
+                    node->discarded, node->received, node->sent,
+                    node->request_time);
+
+    if (!node->location) {
+        p = ngx_cpymem(p, ",\"locations\":{", sizeof(",\"locations\":{") - 1);
+    }
+
+    return p;
+}
+
+
+/* the peers are kept grouped by their upstreams */
+
+static u_char *
+ngx_http_extended_status_upstreams(u_char *p,
+    ngx_http_extended_status_peer_t *peer, ngx_uint_t n)
+{
+    char             *state;
+    ngx_str_t        *upstream;
+    ngx_uint_t        i;
+    ngx_peer_stat_t  *stat;
+
+    p = ngx_cpymem(p, "\"upstreams\":{", sizeof("\"upstreams\":{") - 1);
+
+    upstream = NULL;
+
+    for (i = 0; i < n; i++) {
+
+        if (peer[i].peer == NULL) {
+            continue;
+        }
+
+        if (peer[i].upstream != upstream) {
+
+            if (upstream) {
+                *p++ = ']';
+                *p++ = '}';
+                *p++ = ',';
+            }
+
+            upstream = peer[i].upstream;
+
+            *p++ = '"';
+            p = (u_char *) ngx_escape_json(p, peer[i].upstream->data,
+                                           peer[i].upstream->len);
+            p = ngx_cpymem(p, "\":{\"peers\":[", sizeof("\":{\"peers\":[") - 1);
+
+        } else {
+            *p++ = ',';
+        }
+
+        stat = peer[i].peer->stat;
+
+        if (peer[i].peer->down) {
+            state = "down";
+
+        } else if (peer[i].peer->unhealthy) {
+            state = "unhealthy";
+
+        } else if (stat->unavail_until >= (ngx_atomic_uint_t) ngx_time()) {
+            state = "unavail";
+
+        } else {
+            state = "up";
+        }
+
+        p = ngx_cpymem(p, "{\"server\":\"", sizeof("{\"server\":\"") - 1);
+        p = (u_char *) ngx_escape_json(p, peer[i].peer->name.data,
+                                       peer[i].peer->name.len);
+
+        p = ngx_sprintf(p, "\",\"backup\":%s,\"weight\":%i,\"state\":\"%s\","
+                        "\"requests\":%uA,\"active\":%uA,"
+                        "\"responses\":{\"1xx\":%uA,\"2xx\":%uA,\"3xx\":%uA,"
+                        "\"4xx\":%uA,\"5xx\":%uA},\"fails\":%uA,"
+                        "\"unavail\":%uA,\"sent\":%uA,\"received\":%uA,"
+                        "\"connect_time\":%uA,\"header_time\":%uA,"
+                        "\"response_time\":%uA}",
+                        peer[i].backup ? "true" : "false",
+                        peer[i].peer->weight, state,
+                        stat->requests, stat->active,
+                        stat->responses[0], stat->responses[1],
+                        stat->responses[2], stat->responses[3],
+                        stat->responses[4], stat->fails, stat->unavail,
+                        stat->sent, stat->received, stat->connect_time,
+                        stat->header_time, stat->response_time);
+    }
+
+    if (upstream) {
+        *p++ = ']';
+        *p++ = '}';
+    }
+
+    *p++ = '}';
+
+    return p;
+}
+
+
+static void *
+ngx_http_extended_status_create_main_conf(ngx_conf_t *cf)
+{
+    ngx_http_extended_status_main_conf_t  *emcf;
+
+    emcf = ngx_pcalloc(cf->pool, sizeof(ngx_http_extended_status_main_conf_t));
+    if (emcf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     emcf->nodes = NULL;
+     *     emcf->shm_zone = NULL;
+     *     emcf->shpool = NULL;
+     *     emcf->sh = NULL;
+     */
+
+    if (ngx_array_init(&emcf->labels, cf->pool, 8,
+                       sizeof(ngx_http_extended_status_label_t))
+        != NGX_OK)
+    {
+        return NULL;
+    }
+
+    if (ngx_array_init(&emcf->peers, cf->pool, 4,
+                       sizeof(ngx_http_extended_status_peer_t))
+        != NGX_OK)
+    {
+        return NULL;
+    }
+
+    return emcf;
+}
+
+
+static void *
+ngx_http_extended_status_create_srv_conf(ngx_conf_t *cf)
+{
+    ngx_http_extended_status_srv_conf_t  *conf;
+
+    conf = ngx_pcalloc(cf->pool, sizeof(ngx_http_extended_status_srv_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    conf->index = NGX_HTTP_EXTENDED_STATUS_NONE;
+
+    return conf;
+}
+
+
+static char *
+ngx_http_extended_status_merge_srv_conf(ngx_conf_t *cf, void *parent,
+    void *child)
+{
+    ngx_http_extended_status_srv_conf_t *conf = child;
+
+    u_char                      *p;
+    ngx_int_t                    index;
+    ngx_uint_t                   s, n, same;
+    ngx_http_core_srv_conf_t    *cscf, **cscfp;
+    ngx_http_core_main_conf_t   *cmcf;
+
+    cscf = ngx_http_conf_get_module_srv_conf(cf, ngx_http_core_module);
+    cmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_core_module);
+
+    /*
+     * the counters are kept per server block: the blocks sharing
+     * the first server name, or having none, are told apart
+     * by their numbers in the configuration
+     */
+
+    cscfp = cmcf->servers.elts;
+
+    n = 0;
+    same = 0;
+
+    for (s = 0; s < cmcf->servers.nelts; s++) {
+
+        if (cscfp[s] == cscf) {
+            n = s + 1;
+            continue;
+        }
+
+        if (cscfp[s]->server_name.len == cscf->server_name.len
+            && ngx_strncmp(cscfp[s]->server_name.data, cscf->server_name.data,
+                           cscf->server_name.len)
+               == 0)
+        {
+            same = 1;
+        }
+    }
+
+    conf->name = cscf->server_name;
+
+    if (same) {
+        p = ngx_pnalloc(cf->pool, cscf->server_name.len + 1 + NGX_INT_T_LEN);
+        if (p == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        conf->name.len = ngx_sprintf(p, "%V#%ui", &cscf->server_name, n) - p;
+        conf->name.data = p;
+    }
+
+    index = ngx_http_extended_status_label(cf, &conf->name, NULL,
+                                           NGX_HTTP_EXTENDED_STATUS_SERVER);
+    if (index == NGX_ERROR) {
+        return NGX_CONF_ERROR;
+    }
+
+    conf->index = index;
+
+    return NGX_CONF_OK;
+}
+
+
+static void *
+ngx_http_extended_status_create_loc_conf(ngx_conf_t *cf)
+{
+    ngx_http_extended_status_loc_conf_t  *conf;
+
+    conf = ngx_pcalloc(cf->pool, sizeof(ngx_http_extended_status_loc_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    conf->enable = NGX_CONF_UNSET;
+    conf->index = NGX_HTTP_EXTENDED_STATUS_NONE;
+
+    return conf;
+}
+
+
+static char *
+ngx_http_extended_status_merge_loc_conf(ngx_conf_t *cf, void *parent,
+    void *child)
+{
+    ngx_http_extended_status_loc_conf_t *prev = parent;
+    ngx_http_extended_status_loc_conf_t *conf = child;
+
+    ngx_int_t                             index;
+    ngx_http_core_loc_conf_t             *clcf;
+    ngx_http_extended_status_srv_conf_t  *escf;
+
+    ngx_conf_merge_value(conf->enable, prev->enable, 1);
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+
+    /* requests not matching any location are only accounted per server */
+
+    if (!conf->enable || clcf->name.len == 0) {
+        return NGX_CONF_OK;
+    }
+
+    /* the server block has been merged before its locations */
+
+    escf = ngx_http_conf_get_module_srv_conf(cf,
+                                             ngx_http_extended_status_module);
+
+    index = ngx_http_extended_status_label(cf, &escf->name, &clcf->name,
+                                           NGX_HTTP_EXTENDED_STATUS_LOCATION);
+    if (index == NGX_ERROR) {
+        return NGX_CONF_ERROR;
+    }
+
+    conf->index = index;
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_int_t
+ngx_http_extended_status_label(ngx_conf_t *cf, ngx_str_t *server,
+    ngx_str_t *location, ngx_uint_t type)
+{
+    ngx_uint_t                             i;
+    ngx_http_extended_status_label_t      *label;
+    ngx_http_extended_status_main_conf_t  *emcf;
+
+    emcf = ngx_http_conf_get_module_main_conf(cf,
+                                              ngx_http_extended_status_module);
+
+    label = emcf->labels.elts;
+
+    for (i = 0; i < emcf->labels.nelts; i++) {
+
+        if (label[i].type != type
+            || label[i].server.len != server->len
+            || ngx_strncmp(label[i].server.data, server->data, server->len)
+               != 0)
+        {
+            continue;
+        }
+
+        if (type == NGX_HTTP_EXTENDED_STATUS_SERVER
+            || (label[i].location.len == location->len
+                && ngx_strncmp(label[i].location.data, location->data,
+                               location->len)
+                   == 0))
+        {
+            return i;
+        }
+    }
+
+    label = ngx_array_push(&emcf->labels);
+    if (label == NULL) {
+        return NGX_ERROR;
+    }
+
+    label->server = *server;
+
+    if (location) {
+        label->location = *location;
+
+    } else {
+        ngx_str_null(&label->location);
+    }
+
+    label->type = type;
+
+    return i;
+}
+
+
+/*
+ * the peers are known only after the upstream module has initialized
+ * its balancers, so they are collected here and not when merging;
+ * they are resolved when the zone is initialized
+ */
+
+static ngx_int_t
+ngx_http_extended_status_add_peers(ngx_conf_t *cf,
+    ngx_http_extended_status_main_conf_t *emcf)
+{
+    ngx_uint_t                        i, n, backup;
+    ngx_http_upstream_rr_peers_t     *peers;
+    ngx_http_extended_status_peer_t  *peer;
+    ngx_http_upstream_srv_conf_t    **uscfp;
+    ngx_http_upstream_main_conf_t    *umcf;
+
+    umcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_upstream_module);
+
+    uscfp = umcf->upstreams.elts;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        /* the implicit upstreams of proxy_pass and others are skipped */
+
+        if (!(uscfp[i]->flags & NGX_HTTP_UPSTREAM_CREATE)) {
+            continue;
+        }
+
+        backup = 0;
+
+        for (peers = uscfp[i]->peer.data; peers; peers = peers->next) {
+
+            for (n = 0; n < peers->number; n++) {
+                peer = ngx_array_push(&emcf->peers);
+                if (peer == NULL) {
+                    return NGX_ERROR;
+                }
+
+                peer->uscf = uscfp[i];
+                peer->upstream = &uscfp[i]->host;
+                peer->peer = NULL;
+                peer->backup = backup;
+                peer->number = n;
+            }
+
+            backup = 1;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_extended_status_init_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_http_extended_status_main_conf_t  *oemcf = data;
+
+    size_t                                 len;
+    ngx_uint_t                             i;
+    ngx_queue_t                           *q;
+    ngx_http_extended_status_node_t       *node;
+    ngx_http_extended_status_label_t      *label;
+    ngx_http_extended_status_main_conf_t  *emcf;
+
+    emcf = shm_zone->data;
+
+    if (oemcf) {
+        emcf->sh = oemcf->sh;
+        emcf->shpool = oemcf->shpool;
+
+    } else {
+        emcf->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+        if (shm_zone->shm.exists) {
+            emcf->sh = emcf->shpool->data;
+
+        } else {
+            emcf->sh = ngx_slab_alloc(emcf->shpool,
+                                      sizeof(ngx_http_extended_status_shctx_t));
+            if (emcf->sh == NULL) {
+                return NGX_ERROR;
+            }
+
+            emcf->shpool->data = emcf->sh;
+
+            ngx_queue_init(&emcf->sh->queue);
+            ngx_queue_init(&emcf->sh->peers);
+
+            len = sizeof(" in extended_status zone \"\"")
+                  + shm_zone->shm.name.len;
+
+            emcf->shpool->log_ctx = ngx_slab_alloc(emcf->shpool, len);
+            if (emcf->shpool->log_ctx == NULL) {
+                return NGX_ERROR;
+            }
+
+            ngx_sprintf(emcf->shpool->log_ctx,
+                        " in extended_status zone \"%V\"%Z",
+                        &shm_zone->shm.name);
+        }
+    }
+
+    /*
+     * the servers and locations are resolved to their nodes once here,
+     * so the log handler does not look them up and takes no lock;
+     * the counters of the ones no longer configured stay in the zone
+     */
+
+    label = emcf->labels.elts;
+
+    ngx_shmtx_lock(&emcf->shpool->mutex);
+
+    for (i = 0; i < emcf->labels.nelts; i++) {
+
+        for (q = ngx_queue_head(&emcf->sh->queue);
+             q != ngx_queue_sentinel(&emcf->sh->queue);
+             q = ngx_queue_next(q))
+        {
+            node = ngx_queue_data(q, ngx_http_extended_status_node_t, queue);
+
+            if (node->location == label[i].type
+                && node->server_len == label[i].server.len
+                && node->location_len == label[i].location.len
+                && ngx_strncmp(node->data, label[i].server.data,
+                               node->server_len)
+                   == 0
+                && ngx_strncmp(node->data + node->server_len,
+                               label[i].location.data, node->location_len)
+                   == 0)
+            {
+                emcf->nodes[i] = node;
+                break;
+            }
+        }
+
+        if (emcf->nodes[i]) {
+            continue;
+        }
+
+        node = ngx_slab_alloc_locked(emcf->shpool,
+                                     sizeof(ngx_http_extended_status_node_t)
+                                     + label[i].server.len
+                                     + label[i].location.len);
+        if (node == NULL) {
+            ngx_shmtx_unlock(&emcf->shpool->mutex);
+
+            ngx_log_error(NGX_LOG_EMERG, shm_zone->shm.log, 0,
+                          "could not allocate counters of \"%V%V\" "
+                          "in extended_status zone \"%V\"",
+                          &label[i].server, &label[i].location,
+                          &shm_zone->shm.name);
+            return NGX_ERROR;
+        }
+
+        ngx_memzero(node, sizeof(ngx_http_extended_status_node_t));
+
+        node->location = label[i].type;
+        node->server_len = label[i].server.len;
+        node->location_len = label[i].location.len;
+
+        ngx_memcpy(ngx_cpymem(node->data, label[i].server.data,
+                              label[i].server.len),
+                   label[i].location.data, label[i].location.len);
+
+        ngx_queue_insert_tail(&emcf->sh->queue, &node->queue);
+
+        emcf->nodes[i] = node;
+    }
+
+    if (ngx_http_extended_status_init_peers(shm_zone, emcf) != NGX_OK) {
+        ngx_shmtx_unlock(&emcf->shpool->mutex);
+        return NGX_ERROR;
+    }
+
+    ngx_shmtx_unlock(&emcf->shpool->mutex);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_extended_status_init_peers(ngx_shm_zone_t *shm_zone,
+    ngx_http_extended_status_main_conf_t *emcf)
+{
+    size_t                                 size;
+    ngx_uint_t                             i, k;
+    ngx_queue_t                           *q;
+    ngx_http_upstream_rr_peers_t          *peers;
+    ngx_http_extended_status_peer_t       *peer;
+    ngx_http_extended_status_peer_node_t  *node;
+
+    /*
+     * the counters are linked to the peers of the configuration, so
+     * the balancers and the upstream module update them without a lock;
+     * the peers may have been moved to an upstream zone already
+     */
+
+    peer = emcf->peers.elts;
+
+    for (i = 0; i < emcf->peers.nelts; i++) {
+
+        peers = peer[i].uscf->peer.data;
+
+        if (peer[i].backup) {
+            peers = peers->next;
+        }
+
+        peer[i].peer = &peers->peer[peer[i].number];
+
+        for (q = ngx_queue_head(&emcf->sh->peers);
+             q != ngx_queue_sentinel(&emcf->sh->peers);
+             q = ngx_queue_next(q))
+        {
+            node = ngx_queue_data(q, ngx_http_extended_status_peer_node_t,
+                                  queue);
+
+            if (node->backup == peer[i].backup
+                && node->upstream_len == peer[i].upstream->len
+                && node->peer_len == peer[i].peer->name.len
+                && ngx_strncmp(node->data, peer[i].upstream->data,
+                               node->upstream_len)
+                   == 0
+                && ngx_strncmp(node->data + node->upstream_len,
+                               peer[i].peer->name.data, node->peer_len)
+                   == 0)
+            {
+                /* the same server may be listed in an upstream twice */
+
+                for (k = 0; k < i; k++) {
+                    if (peer[k].peer->stat == &node->stat) {
+                        break;
+                    }
+                }
+
+                if (k == i) {
+                    peer[i].peer->stat = &node->stat;
+                    break;
+                }
+            }
+        }
+
+        if (peer[i].peer->stat) {
+            peer[i].stat = peer[i].peer->stat;
+            continue;
+        }
+
+        size = sizeof(ngx_http_extended_status_peer_node_t)
+               + peer[i].upstream->len + peer[i].peer->name.len;
+
+        node = ngx_slab_alloc_locked(emcf->shpool, size);
+        if (node == NULL) {
+            ngx_log_error(NGX_LOG_EMERG, shm_zone->shm.log, 0,
+                          "could not allocate counters of peer \"%V\" "
+                          "of upstream \"%V\" in extended_status zone \"%V\"",
+                          &peer[i].peer->name, peer[i].upstream,
+                          &shm_zone->shm.name);
+            return NGX_ERROR;
+        }
+
+        ngx_memzero(node, sizeof(ngx_http_extended_status_peer_node_t));
+
+        node->backup = peer[i].backup;
+        node->upstream_len = peer[i].upstream->len;
+        node->peer_len = peer[i].peer->name.len;
+
+        ngx_memcpy(ngx_cpymem(node->data, peer[i].upstream->data,
+                              peer[i].upstream->len),
+                   peer[i].peer->name.data, peer[i].peer->name.len);
+
+        ngx_queue_insert_tail(&emcf->sh->peers, &node->queue);
+
+        peer[i].peer->stat = &node->stat;
+        peer[i].stat = &node->stat;
+    }
+
+    return NGX_OK;
+}
+
+
+static char *
+ngx_http_extended_status_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_extended_status_main_conf_t *emcf = conf;
+
+    u_char     *p;
+    ssize_t     size;
+    ngx_str_t  *value, name, s;
+
+    if (emcf->shm_zone) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    name.data = value[1].data;
+
+    p = (u_char *) ngx_strchr(name.data, ':');
+
+    if (p == NULL) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    name.len = p - name.data;
+
+    s.data = p + 1;
+    s.len = value[1].data + value[1].len - s.data;
+
+    size = ngx_parse_size(&s);
+
+    if (size == NGX_ERROR) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (size < (ssize_t) (8 * ngx_pagesize)) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "zone \"%V\" is too small", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    emcf->shm_zone = ngx_shared_memory_add(cf, &name, size,
+                                           &ngx_http_extended_status_module);
+    if (emcf->shm_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    if (emcf->shm_zone->data) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "duplicate zone \"%V\"", &name);
+        return NGX_CONF_ERROR;
+    }
+
+    emcf->shm_zone->init = ngx_http_extended_status_init_zone;
+    emcf->shm_zone->data = emcf;
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_http_extended_status(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+    clcf->handler = ngx_http_extended_status_handler;
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_int_t
+ngx_http_extended_status_init(ngx_conf_t *cf)
+{
+    ngx_http_handler_pt                   *h;
+    ngx_http_core_main_conf_t             *cmcf;
+    ngx_http_extended_status_main_conf_t  *emcf;
+
+    emcf = ngx_http_conf_get_module_main_conf(cf,
+                                              ngx_http_extended_status_module);
+
+    if (emcf->shm_zone == NULL) {
+        return NGX_OK;
+    }
+
+    if (ngx_http_extended_status_add_peers(cf, emcf) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    /* the nodes are resolved in ngx_http_extended_status_init_zone() */
+
+    emcf->nodes = ngx_pcalloc(cf->pool,
+                              emcf->labels.nelts * sizeof(void *));
+    if (emcf->nodes == NULL) {
+        return NGX_ERROR;
+    }
+
+    cmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_core_module);
+
+    h = ngx_array_push(&cmcf->phases[NGX_HTTP_LOG_PHASE].handlers);
+    if (h == NULL) {
+        return NGX_ERROR;
+    }
+
+    *h = ngx_http_extended_status_log_handler;
+
+    return NGX_OK;
+}
+
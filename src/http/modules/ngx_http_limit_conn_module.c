@@ -77,7 +77,7 @@ static ngx_conf_enum_t  ngx_http_limit_conn_log_levels[] = {
 static ngx_command_t  ngx_http_limit_conn_commands[] = {
 
     { ngx_string("limit_conn_zone"),
-      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE2,
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE23|NGX_CONF_TAKE4,
       ngx_http_limit_conn_zone,
       0,
       0,
@@ -187,7 +187,7 @@ ngx_http_limit_conn_handler(ngx_http_request_t *r)
 
         r->main->limit_conn_set = 1;
 
-        hash = ngx_crc32_short(vv->data, len);
+        hash = ngx_crc32c(vv->data, len);
 
         shpool = (ngx_slab_pool_t *) limits[i].shm_zone->shm.addr;
 
@@ -494,7 +494,7 @@ ngx_http_limit_conn_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     u_char                     *p;
     ssize_t                     size;
     ngx_str_t                  *value, name, s;
-    ngx_uint_t                  i;
+    ngx_uint_t                  i, flags;
     ngx_shm_zone_t             *shm_zone;
     ngx_http_limit_conn_ctx_t  *ctx;
 
@@ -502,6 +502,7 @@ ngx_http_limit_conn_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     ctx = NULL;
     size = 0;
+    flags = 0;
     name.len = 0;
 
     for (i = 1; i < cf->args->nelts; i++) {
@@ -540,6 +541,16 @@ ngx_http_limit_conn_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strcmp(value[i].data, "hugepages") == 0) {
+            flags |= NGX_SHM_HUGEPAGES;
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "prefault") == 0) {
+            flags |= NGX_SHM_PREFAULT;
+            continue;
+        }
+
         if (value[i].data[0] == '$') {
 
             value[i].len--;
@@ -596,6 +607,7 @@ ngx_http_limit_conn_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     shm_zone->init = ngx_http_limit_conn_init_zone;
     shm_zone->data = ctx;
+    shm_zone->shm.flags = flags;
 
     return NGX_CONF_OK;
 }
@@ -87,7 +87,7 @@ static ngx_conf_enum_t  ngx_http_limit_req_log_levels[] = {
 static ngx_command_t  ngx_http_limit_req_commands[] = {
 
     { ngx_string("limit_req_zone"),
-      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE3,
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE3|NGX_CONF_TAKE4|NGX_CONF_TAKE5,
       ngx_http_limit_req_zone,
       0,
       0,
@@ -196,7 +196,7 @@ ngx_http_limit_req_handler(ngx_http_request_t *r)
             continue;
         }
 
-        hash = ngx_crc32_short(vv->data, len);
+        hash = ngx_crc32c(vv->data, len);
 
         ngx_shmtx_lock(&ctx->shpool->mutex);
 
@@ -715,7 +715,7 @@ ngx_http_limit_req_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     ssize_t                    size;
     ngx_str_t                 *value, name, s;
     ngx_int_t                  rate, scale;
-    ngx_uint_t                 i;
+    ngx_uint_t                 i, flags;
     ngx_shm_zone_t            *shm_zone;
     ngx_http_limit_req_ctx_t  *ctx;
 
@@ -723,6 +723,7 @@ ngx_http_limit_req_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     ctx = NULL;
     size = 0;
+    flags = 0;
     rate = 1;
     scale = 1;
     name.len = 0;
@@ -787,6 +788,16 @@ ngx_http_limit_req_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strcmp(value[i].data, "hugepages") == 0) {
+            flags |= NGX_SHM_HUGEPAGES;
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "prefault") == 0) {
+            flags |= NGX_SHM_PREFAULT;
+            continue;
+        }
+
         if (value[i].data[0] == '$') {
 
             value[i].len--;
@@ -845,6 +856,7 @@ ngx_http_limit_req_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     shm_zone->init = ngx_http_limit_req_init_zone;
     shm_zone->data = ctx;
+    shm_zone->shm.flags = flags;
 
     return NGX_CONF_OK;
 }
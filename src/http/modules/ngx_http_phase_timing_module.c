@@ -0,0 +1,1023 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+/*
+ * log-linear histograms of microseconds: exact values below 16,
+ * then 8 buckets per power of two up to 2^31 usec
+ */
+
+#define NGX_HTTP_PHASE_TIMING_BUCKETS  232
+
+
+typedef struct {
+    ngx_atomic_t                     count;
+    ngx_atomic_t                     time;
+    ngx_atomic_t                     hist[NGX_HTTP_PHASE_TIMING_BUCKETS];
+} ngx_http_phase_timing_hist_t;
+
+
+typedef struct {
+    ngx_queue_t                      queue;
+    ngx_atomic_t                     requests;
+    ngx_http_phase_timing_hist_t     phases[NGX_HTTP_PHASE_TIMING_N];
+    size_t                           len;
+    u_char                           name[1];
+} ngx_http_phase_timing_node_t;
+
+
+typedef struct {
+    ngx_queue_t                      queue;
+} ngx_http_phase_timing_shctx_t;
+
+
+typedef struct {
+    ngx_array_t                      labels;      /* ngx_str_t */
+    ngx_http_phase_timing_node_t   **nodes;
+
+    ngx_flag_t                       enable;
+    ngx_flag_t                       status;
+
+    ngx_shm_zone_t                  *shm_zone;
+    ngx_slab_pool_t                 *shpool;
+    ngx_http_phase_timing_shctx_t   *sh;
+} ngx_http_phase_timing_main_conf_t;
+
+
+typedef struct {
+    ngx_flag_t                       enable;
+    ngx_str_t                        label;
+    ngx_uint_t                       index;
+} ngx_http_phase_timing_loc_conf_t;
+
+
+static ngx_int_t ngx_http_phase_timing_handler(ngx_http_request_t *r);
+static ngx_int_t ngx_http_phase_timing_log_handler(ngx_http_request_t *r);
+static ngx_int_t ngx_http_phase_timing_status_handler(ngx_http_request_t *r);
+static ngx_chain_t *ngx_http_phase_timing_status_node(ngx_http_request_t *r,
+    ngx_http_phase_timing_node_t *node, ngx_http_phase_timing_node_t *snap,
+    ngx_uint_t first);
+static ngx_uint_t ngx_http_phase_timing_bucket(uint64_t usec);
+static uint64_t ngx_http_phase_timing_value(ngx_uint_t bucket);
+static uint64_t ngx_http_phase_timing_percentile(
+    ngx_http_phase_timing_hist_t *h, ngx_atomic_uint_t total,
+    ngx_uint_t permille);
+static uint64_t ngx_http_phase_timing_get(ngx_http_phase_timing_t *pt,
+    ngx_uint_t phase);
+static ngx_int_t ngx_http_phase_timing_variable(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data);
+
+static ngx_int_t ngx_http_phase_timing_add_variables(ngx_conf_t *cf);
+static void *ngx_http_phase_timing_create_main_conf(ngx_conf_t *cf);
+static void *ngx_http_phase_timing_create_loc_conf(ngx_conf_t *cf);
+static char *ngx_http_phase_timing_merge_loc_conf(ngx_conf_t *cf,
+    void *parent, void *child);
+static ngx_int_t ngx_http_phase_timing_init_zone(ngx_shm_zone_t *shm_zone,
+    void *data);
+static char *ngx_http_phase_timing(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static char *ngx_http_phase_timing_zone(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static char *ngx_http_phase_timing_status(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static ngx_int_t ngx_http_phase_timing_init(ngx_conf_t *cf);
+
+
+static ngx_command_t  ngx_http_phase_timing_commands[] = {
+
+    { ngx_string("phase_timing"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_http_phase_timing,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("phase_timing_zone"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+      ngx_http_phase_timing_zone,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("phase_timing_status"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS,
+      ngx_http_phase_timing_status,
+      0,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_phase_timing_module_ctx = {
+    ngx_http_phase_timing_add_variables,   /* preconfiguration */
+    ngx_http_phase_timing_init,            /* postconfiguration */
+
+    ngx_http_phase_timing_create_main_conf, /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    NULL,                                  /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    ngx_http_phase_timing_create_loc_conf, /* create location configuration */
+    ngx_http_phase_timing_merge_loc_conf   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_phase_timing_module = {
+    NGX_MODULE_V1,
+    &ngx_http_phase_timing_module_ctx,     /* module context */
+    ngx_http_phase_timing_commands,        /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static ngx_str_t  ngx_http_phase_timing_names[] = {
+    ngx_string("post_read"),
+    ngx_string("server_rewrite"),
+    ngx_string("find_config"),
+    ngx_string("rewrite"),
+    ngx_string("post_rewrite"),
+    ngx_string("preaccess"),
+    ngx_string("access"),
+    ngx_string("post_access"),
+    ngx_string("try_files"),
+    ngx_string("content"),
+    ngx_string("log"),
+    ngx_string("filter")
+};
+
+
+static ngx_str_t  ngx_http_phase_timing_prefix =
+    ngx_string("phase_time_");
+
+
+static ngx_int_t
+ngx_http_phase_timing_handler(ngx_http_request_t *r)
+{
+    ngx_http_phase_timing_t  *pt;
+
+    if (r->phase_timing || r != r->main) {
+        return NGX_DECLINED;
+    }
+
+    pt = ngx_pcalloc(r->pool, sizeof(ngx_http_phase_timing_t));
+    if (pt == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    pt->start = ngx_monotonic_usec();
+    pt->phase = NGX_HTTP_POST_READ_PHASE;
+    pt->visited = 1 << NGX_HTTP_POST_READ_PHASE;
+
+    r->phase_timing = pt;
+
+    return NGX_DECLINED;
+}
+
+
+static ngx_int_t
+ngx_http_phase_timing_log_handler(ngx_http_request_t *r)
+{
+    uint64_t                            time;
+    ngx_uint_t                          i, bucket;
+    ngx_http_phase_timing_t            *pt;
+    ngx_http_phase_timing_hist_t       *h;
+    ngx_http_phase_timing_node_t       *node;
+    ngx_http_phase_timing_loc_conf_t   *plcf;
+    ngx_http_phase_timing_main_conf_t  *pmcf;
+
+    pt = r->phase_timing;
+
+    if (pt == NULL) {
+        return NGX_OK;
+    }
+
+    plcf = ngx_http_get_module_loc_conf(r, ngx_http_phase_timing_module);
+
+    if (!plcf->enable) {
+        return NGX_OK;
+    }
+
+    pmcf = ngx_http_get_module_main_conf(r, ngx_http_phase_timing_module);
+
+    if (pmcf->nodes == NULL || plcf->index == NGX_CONF_UNSET_UINT) {
+        return NGX_OK;
+    }
+
+    node = pmcf->nodes[plcf->index];
+
+    (void) ngx_atomic_fetch_add(&node->requests, 1);
+
+    for (i = 0; i < NGX_HTTP_PHASE_TIMING_N; i++) {
+
+        if (!(pt->visited & (1 << i))) {
+            continue;
+        }
+
+        time = ngx_http_phase_timing_get(pt, i);
+        bucket = ngx_http_phase_timing_bucket(time);
+
+        h = &node->phases[i];
+
+        (void) ngx_atomic_fetch_add(&h->count, 1);
+        (void) ngx_atomic_fetch_add(&h->time, (ngx_atomic_int_t) time);
+        (void) ngx_atomic_fetch_add(&h->hist[bucket], 1);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_phase_timing_status_handler(ngx_http_request_t *r)
+{
+    ngx_int_t                           rc;
+    ngx_buf_t                          *b;
+    ngx_uint_t                          i;
+    ngx_array_t                         nodes;
+    ngx_queue_t                        *q;
+    ngx_chain_t                        *out, **ll;
+    ngx_http_phase_timing_node_t      **node, *snap;
+    ngx_http_phase_timing_main_conf_t  *pmcf;
+
+    if (r->method != NGX_HTTP_GET && r->method != NGX_HTTP_HEAD) {
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    ngx_str_set(&r->headers_out.content_type, "application/json");
+
+    if (r->method == NGX_HTTP_HEAD) {
+        r->headers_out.status = NGX_HTTP_OK;
+
+        return ngx_http_send_header(r);
+    }
+
+    pmcf = ngx_http_get_module_main_conf(r, ngx_http_phase_timing_module);
+
+    if (ngx_array_init(&nodes, r->pool, 8, sizeof(void *)) != NGX_OK) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    /* the nodes are never freed, so only the list walk is locked */
+
+    ngx_shmtx_lock(&pmcf->shpool->mutex);
+
+    for (q = ngx_queue_head(&pmcf->sh->queue);
+         q != ngx_queue_sentinel(&pmcf->sh->queue);
+         q = ngx_queue_next(q))
+    {
+        node = ngx_array_push(&nodes);
+        if (node == NULL) {
+            ngx_shmtx_unlock(&pmcf->shpool->mutex);
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        *node = ngx_queue_data(q, ngx_http_phase_timing_node_t, queue);
+    }
+
+    ngx_shmtx_unlock(&pmcf->shpool->mutex);
+
+    snap = ngx_palloc(r->pool, sizeof(ngx_http_phase_timing_node_t));
+    if (snap == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    b = ngx_create_temp_buf(r->pool, 1);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    out = ngx_alloc_chain_link(r->pool);
+    if (out == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    *b->last++ = '{';
+
+    out->buf = b;
+    ll = &out->next;
+
+    r->headers_out.content_length_n = 1;
+
+    node = nodes.elts;
+
+    for (i = 0; i < nodes.nelts; i++) {
+        *ll = ngx_http_phase_timing_status_node(r, node[i], snap, i == 0);
+        if (*ll == NULL) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        r->headers_out.content_length_n += (*ll)->buf->last - (*ll)->buf->pos;
+        ll = &(*ll)->next;
+    }
+
+    b = ngx_create_temp_buf(r->pool, sizeof("}" CRLF) - 1);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    b->last = ngx_cpymem(b->last, "}" CRLF, sizeof("}" CRLF) - 1);
+    b->last_buf = (r == r->main) ? 1 : 0;
+
+    *ll = ngx_alloc_chain_link(r->pool);
+    if (*ll == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    (*ll)->buf = b;
+    (*ll)->next = NULL;
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n += b->last - b->pos;
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    return ngx_http_output_filter(r, out);
+}
+
+
+static ngx_chain_t *
+ngx_http_phase_timing_status_node(ngx_http_request_t *r,
+    ngx_http_phase_timing_node_t *node, ngx_http_phase_timing_node_t *snap,
+    ngx_uint_t first)
+{
+    char                          *sep;
+    size_t                         len;
+    ngx_buf_t                     *b;
+    ngx_uint_t                     i, k, n;
+    ngx_chain_t                   *cl;
+    ngx_atomic_uint_t              total;
+    ngx_http_phase_timing_hist_t  *h;
+
+    /* the counters keep changing, so a copy is formatted */
+
+    ngx_memcpy(snap, node, sizeof(ngx_http_phase_timing_node_t));
+
+    len = sizeof(",\"\":{\"requests\":,\"phases\":{}}") - 1
+          + node->len + ngx_escape_json(NULL, node->name, node->len)
+          + NGX_ATOMIC_T_LEN;
+
+    for (i = 0; i < NGX_HTTP_PHASE_TIMING_N; i++) {
+        h = &snap->phases[i];
+
+        if (h->count == 0) {
+            continue;
+        }
+
+        len += sizeof(",\"\":{\"count\":,\"time\":,\"p50\":,\"p90\":,"
+                      "\"p99\":,\"p999\":,\"max\":,\"histogram\":[]}") - 1
+               + ngx_http_phase_timing_names[i].len + 2 * NGX_ATOMIC_T_LEN
+               + 5 * NGX_INT64_LEN;
+
+        for (k = 0; k < NGX_HTTP_PHASE_TIMING_BUCKETS; k++) {
+            if (h->hist[k]) {
+                len += sizeof(",[,]") - 1 + NGX_INT64_LEN + NGX_ATOMIC_T_LEN;
+            }
+        }
+    }
+
+    b = ngx_create_temp_buf(r->pool, len);
+    if (b == NULL) {
+        return NULL;
+    }
+
+    if (!first) {
+        *b->last++ = ',';
+    }
+
+    *b->last++ = '"';
+    b->last = (u_char *) ngx_escape_json(b->last, node->name, node->len);
+
+    b->last = ngx_sprintf(b->last, "\":{\"requests\":%uA,\"phases\":{",
+                          snap->requests);
+
+    n = 0;
+
+    for (i = 0; i < NGX_HTTP_PHASE_TIMING_N; i++) {
+        h = &snap->phases[i];
+
+        if (h->count == 0) {
+            continue;
+        }
+
+        total = 0;
+
+        for (k = 0; k < NGX_HTTP_PHASE_TIMING_BUCKETS; k++) {
+            total += h->hist[k];
+        }
+
+        b->last = ngx_sprintf(b->last,
+                              "%s\"%V\":{\"count\":%uA,\"time\":%uA,"
+                              "\"p50\":%uL,\"p90\":%uL,\"p99\":%uL,"
+                              "\"p999\":%uL,\"max\":%uL,\"histogram\":[",
+                              n++ ? "," : "",
+                              &ngx_http_phase_timing_names[i],
+                              h->count, h->time,
+                              ngx_http_phase_timing_percentile(h, total, 500),
+                              ngx_http_phase_timing_percentile(h, total, 900),
+                              ngx_http_phase_timing_percentile(h, total, 990),
+                              ngx_http_phase_timing_percentile(h, total, 999),
+                              ngx_http_phase_timing_percentile(h, total,
+                                                               1000));
+
+        sep = "";
+
+        for (k = 0; k < NGX_HTTP_PHASE_TIMING_BUCKETS; k++) {
+            if (h->hist[k] == 0) {
+                continue;
+            }
+
+            b->last = ngx_sprintf(b->last, "%s[%uL,%uA]", sep,
+                                  ngx_http_phase_timing_value(k), h->hist[k]);
+            sep = ",";
+        }
+
+        *b->last++ = ']';
+        *b->last++ = '}';
+    }
+
+    *b->last++ = '}';
+    *b->last++ = '}';
+
+    cl = ngx_alloc_chain_link(r->pool);
+    if (cl == NULL) {
+        return NULL;
+    }
+
+    cl->buf = b;
+    cl->next = NULL;
+
+    return cl;
+}
+
+
+static ngx_uint_t
+ngx_http_phase_timing_bucket(uint64_t usec)
+{
+    ngx_uint_t  shift;
+
+    if (usec >= 0x80000000) {
+        return NGX_HTTP_PHASE_TIMING_BUCKETS - 1;
+    }
+
+    for (shift = 0; (usec >> shift) >= 16; shift++) { /* void */ }
+
+    return shift * 8 + (ngx_uint_t) (usec >> shift);
+}
+
+
+/* the upper bound of a bucket */
+
+static uint64_t
+ngx_http_phase_timing_value(ngx_uint_t bucket)
+{
+    ngx_uint_t  shift;
+
+    if (bucket < 16) {
+        return bucket;
+    }
+
+    shift = bucket / 8 - 1;
+
+    return ((uint64_t) (bucket - shift * 8 + 1) << shift) - 1;
+}
+
+
+static uint64_t
+ngx_http_phase_timing_percentile(ngx_http_phase_timing_hist_t *h,
+    ngx_atomic_uint_t total, ngx_uint_t permille)
+{
+    ngx_uint_t         i;
+    ngx_atomic_uint_t  n, rank;
+
+    rank = (total * permille + 999) / 1000;
+
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    n = 0;
+
+    for (i = 0; i < NGX_HTTP_PHASE_TIMING_BUCKETS; i++) {
+        n += h->hist[i];
+
+        if (n >= rank) {
+            break;
+        }
+    }
+
+    if (i == NGX_HTTP_PHASE_TIMING_BUCKETS) {
+        i--;
+    }
+
+    return ngx_http_phase_timing_value(i);
+}
+
+
+static uint64_t
+ngx_http_phase_timing_get(ngx_http_phase_timing_t *pt, ngx_uint_t phase)
+{
+    uint64_t  time, now;
+
+    time = pt->time[phase];
+
+    /* the phase still running is accounted up to now */
+
+    if (phase == pt->phase && !pt->filter) {
+        now = ngx_monotonic_usec();
+
+        if (now > pt->start) {
+            time += now - pt->start;
+        }
+    }
+
+    return time;
+}
+
+
+static ngx_int_t
+ngx_http_phase_timing_variable(ngx_http_request_t *r,
+    ngx_http_variable_value_t *v, uintptr_t data)
+{
+    u_char                   *p;
+    uint64_t                  time;
+    ngx_http_phase_timing_t  *pt;
+
+    pt = r->main->phase_timing;
+
+    if (pt == NULL || !(pt->visited & (1 << data))) {
+        v->not_found = 1;
+        return NGX_OK;
+    }
+
+    p = ngx_pnalloc(r->pool, NGX_INT64_LEN + 8);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    time = ngx_http_phase_timing_get(pt, data);
+
+    v->len = ngx_sprintf(p, "%uL.%06uL", time / 1000000, time % 1000000) - p;
+    v->valid = 1;
+    v->no_cacheable = 0;
+    v->not_found = 0;
+    v->data = p;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_phase_timing_add_variables(ngx_conf_t *cf)
+{
+    u_char               *p;
+    ngx_str_t             name;
+    ngx_uint_t            i;
+    ngx_http_variable_t  *var;
+
+    for (i = 0; i < NGX_HTTP_PHASE_TIMING_N; i++) {
+
+        if (i == NGX_HTTP_LOG_PHASE) {
+            continue;
+        }
+
+        name.len = ngx_http_phase_timing_prefix.len
+                   + ngx_http_phase_timing_names[i].len;
+
+        name.data = ngx_pnalloc(cf->pool, name.len);
+        if (name.data == NULL) {
+            return NGX_ERROR;
+        }
+
+        p = ngx_cpymem(name.data, ngx_http_phase_timing_prefix.data,
+                       ngx_http_phase_timing_prefix.len);
+        ngx_memcpy(p, ngx_http_phase_timing_names[i].data,
+                   ngx_http_phase_timing_names[i].len);
+
+        var = ngx_http_add_variable(cf, &name, NGX_HTTP_VAR_NOCACHEABLE);
+        if (var == NULL) {
+            return NGX_ERROR;
+        }
+
+        var->get_handler = ngx_http_phase_timing_variable;
+        var->data = i;
+    }
+
+    return NGX_OK;
+}
+
+
+static void *
+ngx_http_phase_timing_create_main_conf(ngx_conf_t *cf)
+{
+    ngx_http_phase_timing_main_conf_t  *pmcf;
+
+    pmcf = ngx_pcalloc(cf->pool, sizeof(ngx_http_phase_timing_main_conf_t));
+    if (pmcf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     pmcf->nodes = NULL;
+     *     pmcf->enable = 0;
+     *     pmcf->status = 0;
+     *     pmcf->shm_zone = NULL;
+     *     pmcf->shpool = NULL;
+     *     pmcf->sh = NULL;
+     */
+
+    if (ngx_array_init(&pmcf->labels, cf->pool, 4, sizeof(ngx_str_t))
+        != NGX_OK)
+    {
+        return NULL;
+    }
+
+    return pmcf;
+}
+
+
+static void *
+ngx_http_phase_timing_create_loc_conf(ngx_conf_t *cf)
+{
+    ngx_http_phase_timing_loc_conf_t  *conf;
+
+    conf = ngx_pcalloc(cf->pool, sizeof(ngx_http_phase_timing_loc_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     conf->label = { 0, NULL };
+     */
+
+    conf->enable = NGX_CONF_UNSET;
+    conf->index = NGX_CONF_UNSET_UINT;
+
+    return conf;
+}
+
+
+static char *
+ngx_http_phase_timing_merge_loc_conf(ngx_conf_t *cf, void *parent,
+    void *child)
+{
+    ngx_http_phase_timing_loc_conf_t *prev = parent;
+    ngx_http_phase_timing_loc_conf_t *conf = child;
+
+    ngx_str_t                          *label, name;
+    ngx_uint_t                          i;
+    ngx_http_core_loc_conf_t           *clcf;
+    ngx_http_phase_timing_main_conf_t  *pmcf;
+
+    if (conf->enable == NGX_CONF_UNSET) {
+        conf->enable = prev->enable;
+        conf->label = prev->label;
+    }
+
+    if (conf->enable == NGX_CONF_UNSET) {
+        conf->enable = 0;
+    }
+
+    if (!conf->enable) {
+        return NGX_CONF_OK;
+    }
+
+    /* "phase_timing on" labels the statistics with the location name */
+
+    if (conf->label.len) {
+        name = conf->label;
+
+    } else {
+        clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+        name = clcf->name;
+    }
+
+    pmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_phase_timing_module);
+
+    pmcf->enable = 1;
+
+    /*
+     * the http and server levels have no name, and the requests
+     * finalized before a location is found are not accounted
+     */
+
+    if (name.len == 0) {
+        return NGX_CONF_OK;
+    }
+
+    label = pmcf->labels.elts;
+
+    for (i = 0; i < pmcf->labels.nelts; i++) {
+        if (label[i].len == name.len
+            && ngx_strncmp(label[i].data, name.data, name.len) == 0)
+        {
+            conf->index = i;
+            return NGX_CONF_OK;
+        }
+    }
+
+    label = ngx_array_push(&pmcf->labels);
+    if (label == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    *label = name;
+    conf->index = i;
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_int_t
+ngx_http_phase_timing_init_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_http_phase_timing_main_conf_t  *opmcf = data;
+
+    size_t                              len;
+    ngx_str_t                          *label;
+    ngx_uint_t                          i;
+    ngx_queue_t                        *q;
+    ngx_http_phase_timing_node_t       *node;
+    ngx_http_phase_timing_main_conf_t  *pmcf;
+
+    pmcf = shm_zone->data;
+
+    if (opmcf) {
+        pmcf->sh = opmcf->sh;
+        pmcf->shpool = opmcf->shpool;
+
+    } else {
+        pmcf->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+        if (shm_zone->shm.exists) {
+            pmcf->sh = pmcf->shpool->data;
+
+        } else {
+            pmcf->sh = ngx_slab_alloc(pmcf->shpool,
+                                      sizeof(ngx_http_phase_timing_shctx_t));
+            if (pmcf->sh == NULL) {
+                return NGX_ERROR;
+            }
+
+            pmcf->shpool->data = pmcf->sh;
+
+            ngx_queue_init(&pmcf->sh->queue);
+
+            len = sizeof(" in phase_timing zone \"\"") + shm_zone->shm.name.len;
+
+            pmcf->shpool->log_ctx = ngx_slab_alloc(pmcf->shpool, len);
+            if (pmcf->shpool->log_ctx == NULL) {
+                return NGX_ERROR;
+            }
+
+            ngx_sprintf(pmcf->shpool->log_ctx, " in phase_timing zone \"%V\"%Z",
+                        &shm_zone->shm.name);
+        }
+    }
+
+    /*
+     * the labels are resolved once here, so the log handler only
+     * updates the counters atomically and never takes the lock;
+     * the nodes of the labels no longer configured stay in the zone
+     */
+
+    label = pmcf->labels.elts;
+
+    ngx_shmtx_lock(&pmcf->shpool->mutex);
+
+    for (i = 0; i < pmcf->labels.nelts; i++) {
+
+        for (q = ngx_queue_head(&pmcf->sh->queue);
+             q != ngx_queue_sentinel(&pmcf->sh->queue);
+             q = ngx_queue_next(q))
+        {
+            node = ngx_queue_data(q, ngx_http_phase_timing_node_t, queue);
+
+            if (node->len == label[i].len
+                && ngx_strncmp(node->name, label[i].data, node->len) == 0)
+            {
+                pmcf->nodes[i] = node;
+                break;
+            }
+        }
+
+        if (pmcf->nodes[i]) {
+            continue;
+        }
+
+        node = ngx_slab_alloc_locked(pmcf->shpool,
+                                     sizeof(ngx_http_phase_timing_node_t)
+                                     + label[i].len);
+        if (node == NULL) {
+            ngx_shmtx_unlock(&pmcf->shpool->mutex);
+
+            ngx_log_error(NGX_LOG_EMERG, shm_zone->shm.log, 0,
+                          "could not allocate phase timing \"%V\" "
+                          "in zone \"%V\"", &label[i], &shm_zone->shm.name);
+            return NGX_ERROR;
+        }
+
+        ngx_memzero(node, sizeof(ngx_http_phase_timing_node_t));
+
+        node->len = label[i].len;
+        ngx_memcpy(node->name, label[i].data, label[i].len);
+
+        ngx_queue_insert_tail(&pmcf->sh->queue, &node->queue);
+
+        pmcf->nodes[i] = node;
+    }
+
+    ngx_shmtx_unlock(&pmcf->shpool->mutex);
+
+    return NGX_OK;
+}
+
+
+static char *
+ngx_http_phase_timing(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_phase_timing_loc_conf_t *plcf = conf;
+
+    ngx_str_t  *value;
+
+    if (plcf->enable != NGX_CONF_UNSET) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+        plcf->enable = 0;
+        return NGX_CONF_OK;
+    }
+
+    plcf->enable = 1;
+
+    if (ngx_strcmp(value[1].data, "on") != 0) {
+        plcf->label = value[1];
+    }
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_http_phase_timing_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_phase_timing_main_conf_t *pmcf = conf;
+
+    u_char     *p;
+    ssize_t     size;
+    ngx_str_t  *value, name, s;
+
+    if (pmcf->shm_zone) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    name.data = value[1].data;
+
+    p = (u_char *) ngx_strchr(name.data, ':');
+
+    if (p == NULL) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    name.len = p - name.data;
+
+    s.data = p + 1;
+    s.len = value[1].data + value[1].len - s.data;
+
+    size = ngx_parse_size(&s);
+
+    if (size == NGX_ERROR) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (size < (ssize_t) (8 * ngx_pagesize)) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "zone \"%V\" is too small", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    pmcf->shm_zone = ngx_shared_memory_add(cf, &name, size,
+                                           &ngx_http_phase_timing_module);
+    if (pmcf->shm_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    if (pmcf->shm_zone->data) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "duplicate zone \"%V\"", &name);
+        return NGX_CONF_ERROR;
+    }
+
+    pmcf->shm_zone->init = ngx_http_phase_timing_init_zone;
+    pmcf->shm_zone->data = pmcf;
+
+    return NGX_CONF_OK;
+}
+
+
+static char *
+ngx_http_phase_timing_status(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_core_loc_conf_t           *clcf;
+    ngx_http_phase_timing_main_conf_t  *pmcf;
+
+    pmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_phase_timing_module);
+    pmcf->status = 1;
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+    clcf->handler = ngx_http_phase_timing_status_handler;
+
+    return NGX_CONF_OK;
+}
+
+
+static ngx_int_t
+ngx_http_phase_timing_init(ngx_conf_t *cf)
+{
+    ngx_http_handler_pt                *h;
+    ngx_http_core_main_conf_t          *cmcf;
+    ngx_http_phase_timing_main_conf_t  *pmcf;
+
+    pmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_phase_timing_module);
+
+    if (pmcf->status && pmcf->shm_zone == NULL) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"phase_timing_status\" requires "
+                           "\"phase_timing_zone\"");
+        return NGX_ERROR;
+    }
+
+    if (!pmcf->enable) {
+        return NGX_OK;
+    }
+
+    cmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_core_module);
+
+    h = ngx_array_push(&cmcf->phases[NGX_HTTP_POST_READ_PHASE].handlers);
+    if (h == NULL) {
+        return NGX_ERROR;
+    }
+
+    *h = ngx_http_phase_timing_handler;
+
+    if (pmcf->shm_zone == NULL || pmcf->labels.nelts == 0) {
+        return NGX_OK;
+    }
+
+    /* the nodes are resolved in ngx_http_phase_timing_init_zone() */
+
+    pmcf->nodes = ngx_pcalloc(cf->pool,
+                              pmcf->labels.nelts * sizeof(void *));
+    if (pmcf->nodes == NULL) {
+        return NGX_ERROR;
+    }
+
+    h = ngx_array_push(&cmcf->phases[NGX_HTTP_LOG_PHASE].handlers);
+    if (h == NULL) {
+        return NGX_ERROR;
+    }
+
+    *h = ngx_http_phase_timing_log_handler;
+
+    return NGX_OK;
+}
@@ -133,7 +133,7 @@ static ngx_command_t  ngx_http_ssl_commands[] = {
       NULL },
 
     { ngx_string("ssl_session_cache"),
-      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE12,
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1234,
       ngx_http_ssl_session_cache,
       NGX_HTTP_SRV_CONF_OFFSET,
       0,
@@ -548,12 +548,24 @@ ngx_http_ssl_session_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     size_t       len;
     ngx_str_t   *value, name, size;
     ngx_int_t    n;
-    ngx_uint_t   i, j;
+    ngx_uint_t   i, j, flags;
 
     value = cf->args->elts;
 
+    flags = 0;
+
     for (i = 1; i < cf->args->nelts; i++) {
 
+        if (ngx_strcmp(value[i].data, "hugepages") == 0) {
+            flags |= NGX_SHM_HUGEPAGES;
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "prefault") == 0) {
+            flags |= NGX_SHM_PREFAULT;
+            continue;
+        }
+
         if (ngx_strcmp(value[i].data, "off") == 0) {
             sscf->builtin_session_cache = NGX_SSL_NO_SCACHE;
             continue;
@@ -638,6 +650,17 @@ ngx_http_ssl_session_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         goto invalid;
     }
 
+    if (flags) {
+        if (sscf->shm_zone == NULL) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "\"hugepages\" and \"prefault\" require "
+                               "shared session cache");
+            return NGX_CONF_ERROR;
+        }
+
+        sscf->shm_zone->shm.flags |= flags;
+    }
+
     if (sscf->shm_zone && sscf->builtin_session_cache == NGX_CONF_UNSET) {
         sscf->builtin_session_cache = NGX_SSL_NO_BUILTIN_SCACHE;
     }
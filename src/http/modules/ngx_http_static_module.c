@@ -11,6 +11,11 @@
 
 
 static ngx_int_t ngx_http_static_handler(ngx_http_request_t *r);
+#if (NGX_THREAD_POOL)
+static ngx_int_t ngx_http_static_thread_handler(ngx_thread_task_t *task,
+    void *data);
+static void ngx_http_static_thread_event_handler(ngx_event_t *ev);
+#endif
 static ngx_int_t ngx_http_static_init(ngx_conf_t *cf);
 
 
@@ -99,9 +104,28 @@ ngx_http_static_handler(ngx_http_request_t *r)
         return NGX_HTTP_INTERNAL_SERVER_ERROR;
     }
 
-    if (ngx_open_cached_file(clcf->open_file_cache, &path, &of, r->pool)
-        != NGX_OK)
-    {
+#if (NGX_THREAD_POOL)
+    if (clcf->aio == NGX_HTTP_AIO_THREADS) {
+        of.thread_handler = ngx_http_static_thread_handler;
+        of.thread_ctx = r;
+        of.thread_task = ngx_http_get_module_ctx(r, ngx_http_static_module);
+    }
+#endif
+
+    rc = ngx_open_cached_file(clcf->open_file_cache, &path, &of, r->pool);
+
+#if (NGX_THREAD_POOL)
+    if (of.thread_task) {
+        ngx_http_set_ctx(r, of.thread_task, ngx_http_static_module);
+    }
+
+    if (rc == NGX_AGAIN) {
+        r->main->count++;
+        return NGX_DONE;
+    }
+#endif
+
+    if (rc != NGX_OK) {
         switch (of.err) {
 
         case 0:
@@ -267,6 +291,51 @@ ngx_http_static_handler(ngx_http_request_t *r)
 }
 
 
+#if (NGX_THREAD_POOL)
+
+static ngx_int_t
+ngx_http_static_thread_handler(ngx_thread_task_t *task, void *data)
+{
+    ngx_http_request_t        *r = data;
+
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+
+    task->event.data = r;
+    task->event.handler = ngx_http_static_thread_event_handler;
+
+    if (ngx_thread_task_post(clcf->thread_pool, task) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    r->main->blocked++;
+    r->aio = 1;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_static_thread_event_handler(ngx_event_t *ev)
+{
+    ngx_connection_t    *c;
+    ngx_http_request_t  *r;
+
+    r = ev->data;
+    c = r->connection;
+
+    r->main->blocked--;
+    r->aio = 0;
+
+    r->write_event_handler(r);
+
+    ngx_http_run_posted_requests(c);
+}
+
+#endif
+
+
 static ngx_int_t
 ngx_http_static_init(ngx_conf_t *cf)
 {
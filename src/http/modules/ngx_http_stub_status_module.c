@@ -10,15 +10,25 @@
 #include <ngx_http.h>
 
 
+typedef struct {
+    ngx_flag_t  extended;
+} ngx_http_status_loc_conf_t;
+
+
+static size_t ngx_http_status_extended_size(void);
+static u_char *ngx_http_status_extended(u_char *p);
+static u_char *ngx_http_status_mutex(u_char *p, ngx_str_t *name,
+    ngx_shmtx_sh_t *sh);
+static void *ngx_http_status_create_loc_conf(ngx_conf_t *cf);
 static char *ngx_http_set_status(ngx_conf_t *cf, ngx_command_t *cmd,
                                  void *conf);
 
 static ngx_command_t  ngx_http_status_commands[] = {
 
     { ngx_string("stub_status"),
-      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_http_set_status,
-      0,
+      NGX_HTTP_LOC_CONF_OFFSET,
       0,
       NULL },
 
@@ -37,7 +47,7 @@ static ngx_http_module_t  ngx_http_stub_status_module_ctx = {
     NULL,                                  /* create server configuration */
     NULL,                                  /* merge server configuration */
 
-    NULL,                                  /* create location configuration */
+    ngx_http_status_create_loc_conf,       /* create location configuration */
     NULL                                   /* merge location configuration */
 };
 
@@ -60,11 +70,12 @@ ngx_module_t  ngx_http_stub_status_module = {
 
 static ngx_int_t ngx_http_status_handler(ngx_http_request_t *r)
 {
-    size_t             size;
-    ngx_int_t          rc;
-    ngx_buf_t         *b;
-    ngx_chain_t        out;
-    ngx_atomic_int_t   ap, hn, ac, rq, rd, wr;
+    size_t                       size;
+    ngx_int_t                    rc;
+    ngx_buf_t                   *b;
+    ngx_chain_t                  out;
+    ngx_atomic_int_t             ap, hn, ac, rq, rd, wr;
+    ngx_http_status_loc_conf_t  *slcf;
 
     if (r->method != NGX_HTTP_GET && r->method != NGX_HTTP_HEAD) {
         return NGX_HTTP_NOT_ALLOWED;
@@ -88,11 +99,17 @@ static ngx_int_t ngx_http_status_handler(ngx_http_request_t *r)
         }
     }
 
+    slcf = ngx_http_get_module_loc_conf(r, ngx_http_stub_status_module);
+
     size = sizeof("Active connections:  \n") + NGX_ATOMIC_T_LEN
            + sizeof("server accepts handled requests\n") - 1
            + 6 + 3 * NGX_ATOMIC_T_LEN
            + sizeof("Reading:  Writing:  Waiting:  \n") + 3 * NGX_ATOMIC_T_LEN;
 
+    if (slcf->extended) {
+        size += ngx_http_status_extended_size();
+    }
+
     b = ngx_create_temp_buf(r->pool, size);
     if (b == NULL) {
         return NGX_HTTP_INTERNAL_SERVER_ERROR;
@@ -118,6 +135,10 @@ static ngx_int_t ngx_http_status_handler(ngx_http_request_t *r)
     b->last = ngx_sprintf(b->last, "Reading: %uA Writing: %uA Waiting: %uA \n",
                           rd, wr, ac - (rd + wr));
 
+    if (slcf->extended) {
+        b->last = ngx_http_status_extended(b->last);
+    }
+
     r->headers_out.status = NGX_HTTP_OK;
     r->headers_out.content_length_n = b->last - b->pos;
 
@@ -133,10 +154,192 @@ static ngx_int_t ngx_http_status_handler(ngx_http_request_t *r)
 }
 
 
+static size_t
+ngx_http_status_extended_size(void)
+{
+    size_t            size;
+    ngx_uint_t        i;
+    ngx_shm_zone_t   *shm_zone;
+    ngx_list_part_t  *part;
+
+    size = sizeof("minflt majflt dtlb_misses\n") - 1
+           + 5 + 3 * NGX_ATOMIC_T_LEN;
+
+    size += sizeof("pool_cache hits misses\n") - 1
+            + 4 + 2 * NGX_ATOMIC_T_LEN;
+
+    size += sizeof("zone size pages free hugetlb\n") - 1;
+
+    part = (ngx_list_part_t *) &ngx_cycle->shared_memory.part;
+    shm_zone = part->elts;
+
+    for (i = 0; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+            part = part->next;
+            shm_zone = part->elts;
+            i = 0;
+        }
+
+        size += shm_zone[i].shm.name.len + 7 + NGX_SIZE_T_LEN
+                + 3 * NGX_INT_T_LEN
+                + shm_zone[i].shm.name.len + 7 + 5 * NGX_ATOMIC_T_LEN;
+    }
+
+    size += sizeof("mutex acquired contended spins sleeps wait_usec\n") - 1
+            + sizeof("accept_mutex") - 1 + 7 + 5 * NGX_ATOMIC_T_LEN;
+
+#if (NGX_HAVE_EPOLL)
+    size += sizeof("epoll_ctl calls saved\n") - 1
+            + 4 + 2 * NGX_ATOMIC_T_LEN;
+#endif
+
+    return size;
+}
+
+
+static u_char *
+ngx_http_status_extended(u_char *p)
+{
+    ngx_str_t          name;
+    ngx_uint_t         i, hugetlb;
+    ngx_shm_zone_t    *shm_zone;
+    ngx_slab_pool_t   *sp;
+    ngx_list_part_t   *part;
+    ngx_atomic_int_t   mi, ma, tm, ph, pm;
+#if (NGX_HAVE_EPOLL)
+    ngx_atomic_int_t   ec, es;
+#endif
+
+    mi = *ngx_stat_minflt;
+    ma = *ngx_stat_majflt;
+    tm = *ngx_stat_dtlb_misses;
+
+    p = ngx_cpymem(p, "minflt majflt dtlb_misses\n",
+                   sizeof("minflt majflt dtlb_misses\n") - 1);
+
+    p = ngx_sprintf(p, " %uA %uA %uA \n", mi, ma, tm);
+
+    ph = *ngx_stat_pool_cache_hits;
+    pm = *ngx_stat_pool_cache_misses;
+
+    p = ngx_cpymem(p, "pool_cache hits misses\n",
+                   sizeof("pool_cache hits misses\n") - 1);
+
+    p = ngx_sprintf(p, " %uA %uA \n", ph, pm);
+
+    p = ngx_cpymem(p, "zone size pages free hugetlb\n",
+                   sizeof("zone size pages free hugetlb\n") - 1);
+
+    part = (ngx_list_part_t *) &ngx_cycle->shared_memory.part;
+    shm_zone = part->elts;
+
+    for (i = 0; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+            part = part->next;
+            shm_zone = part->elts;
+            i = 0;
+        }
+
+        sp = (ngx_slab_pool_t *) shm_zone[i].shm.addr;
+        hugetlb = (shm_zone[i].shm.flags & NGX_SHM_HUGETLB) ? 1 : 0;
+
+        p = ngx_sprintf(p, " %V %uz %ui %ui %ui \n",
+                        &shm_zone[i].shm.name, shm_zone[i].shm.size,
+                        sp->npages, sp->pfree, hugetlb);
+    }
+
+    p = ngx_cpymem(p, "mutex acquired contended spins sleeps wait_usec\n",
+                   sizeof("mutex acquired contended spins sleeps wait_usec\n")
+                   - 1);
+
+    if (ngx_accept_mutex_ptr) {
+        ngx_str_set(&name, "accept_mutex");
+
+        p = ngx_http_status_mutex(p, &name,
+                                  (ngx_shmtx_sh_t *) ngx_accept_mutex_ptr);
+    }
+
+    part = (ngx_list_part_t *) &ngx_cycle->shared_memory.part;
+    shm_zone = part->elts;
+
+    for (i = 0; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+            part = part->next;
+            shm_zone = part->elts;
+            i = 0;
+        }
+
+        sp = (ngx_slab_pool_t *) shm_zone[i].shm.addr;
+
+        p = ngx_http_status_mutex(p, &shm_zone[i].shm.name, &sp->lock);
+    }
+
+#if (NGX_HAVE_EPOLL)
+
+    ec = *ngx_stat_epoll_ctl;
+    es = *ngx_stat_epoll_ctl_saved;
+
+    p = ngx_cpymem(p, "epoll_ctl calls saved\n",
+                   sizeof("epoll_ctl calls saved\n") - 1);
+
+    p = ngx_sprintf(p, " %uA %uA \n", ec, es);
+
+#endif
+
+    return p;
+}
+
+
+static u_char *
+ngx_http_status_mutex(u_char *p, ngx_str_t *name, ngx_shmtx_sh_t *sh)
+{
+    return ngx_sprintf(p, " %V %uA %uA %uA %uA %uA \n",
+                       name, sh->acquired, sh->contended, sh->spins,
+                       sh->sleeps, sh->wait_time);
+}
+
+
+static void *
+ngx_http_status_create_loc_conf(ngx_conf_t *cf)
+{
+    ngx_http_status_loc_conf_t  *conf;
+
+    conf = ngx_pcalloc(cf->pool, sizeof(ngx_http_status_loc_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    return conf;
+}
+
+
 static char *ngx_http_set_status(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
+    ngx_http_status_loc_conf_t *slcf = conf;
+
+    ngx_str_t                 *value;
     ngx_http_core_loc_conf_t  *clcf;
 
+    value = cf->args->elts;
+
+    /* any other value enables the status as before */
+
+    if (ngx_strcmp(value[1].data, "extended") == 0) {
+        slcf->extended = 1;
+    }
+
     clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
     clcf->handler = ngx_http_status_handler;
 
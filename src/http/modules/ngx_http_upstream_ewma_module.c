@@ -0,0 +1,471 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+/* added to the latency, in microseconds, so that fast peers are balanced */
+#define NGX_HTTP_UPSTREAM_EWMA_COST  100
+
+
+typedef struct {
+    ngx_msec_t                         decay;
+} ngx_http_upstream_ewma_srv_conf_t;
+
+
+typedef struct {
+    /* the round robin data must be first */
+    ngx_http_upstream_rr_peer_data_t   rrp;
+
+    ngx_msec_t                         decay;
+    uint64_t                           start;
+
+    ngx_event_get_peer_pt              get_rr_peer;
+    ngx_event_free_peer_pt             free_rr_peer;
+} ngx_http_upstream_ewma_peer_data_t;
+
+
+static ngx_int_t ngx_http_upstream_init_ewma_peer(ngx_http_request_t *r,
+    ngx_http_upstream_srv_conf_t *us);
+static ngx_int_t ngx_http_upstream_get_ewma_peer(ngx_peer_connection_t *pc,
+    void *data);
+static void ngx_http_upstream_free_ewma_peer(ngx_peer_connection_t *pc,
+    void *data, ngx_uint_t state);
+static ngx_uint_t ngx_http_upstream_ewma_cost(
+    ngx_http_upstream_ewma_peer_data_t *ewp, ngx_http_upstream_rr_peer_t *peer);
+
+static void *ngx_http_upstream_ewma_create_conf(ngx_conf_t *cf);
+static char *ngx_http_upstream_ewma(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+
+
+static ngx_command_t  ngx_http_upstream_ewma_commands[] = {
+
+    { ngx_string("ewma"),
+      NGX_HTTP_UPS_CONF|NGX_CONF_NOARGS|NGX_CONF_TAKE1,
+      ngx_http_upstream_ewma,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_upstream_ewma_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    ngx_http_upstream_ewma_create_conf,    /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_upstream_ewma_module = {
+    NGX_MODULE_V1,
+    &ngx_http_upstream_ewma_module_ctx,    /* module context */
+    ngx_http_upstream_ewma_commands,       /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static ngx_int_t
+ngx_http_upstream_init_ewma(ngx_conf_t *cf, ngx_http_upstream_srv_conf_t *us)
+{
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, cf->log, 0,
+                   "init ewma");
+
+    if (ngx_http_upstream_init_round_robin(cf, us) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    us->peer.init = ngx_http_upstream_init_ewma_peer;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_init_ewma_peer(ngx_http_request_t *r,
+    ngx_http_upstream_srv_conf_t *us)
+{
+    ngx_http_upstream_ewma_srv_conf_t   *ecf;
+    ngx_http_upstream_ewma_peer_data_t  *ewp;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "init ewma peer");
+
+    ewp = ngx_palloc(r->pool, sizeof(ngx_http_upstream_ewma_peer_data_t));
+    if (ewp == NULL) {
+        return NGX_ERROR;
+    }
+
+    r->upstream->peer.data = &ewp->rrp;
+
+    if (ngx_http_upstream_init_round_robin_peer(r, us) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    r->upstream->peer.get = ngx_http_upstream_get_ewma_peer;
+    r->upstream->peer.free = ngx_http_upstream_free_ewma_peer;
+
+    ecf = ngx_http_conf_upstream_srv_conf(us, ngx_http_upstream_ewma_module);
+
+    ewp->decay = ecf->decay;
+    ewp->start = 0;
+
+    ewp->get_rr_peer = ngx_http_upstream_get_round_robin_peer;
+    ewp->free_rr_peer = ngx_http_upstream_free_round_robin_peer;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_get_ewma_peer(ngx_peer_connection_t *pc, void *data)
+{
+    ngx_http_upstream_ewma_peer_data_t  *ewp = data;
+
+    time_t                         now;
+    uintptr_t                      m;
+    ngx_int_t                      rc, total, r;
+    ngx_uint_t                     i, n, p, k, c[2];
+    ngx_http_upstream_rr_peer_t   *peer, *best;
+    ngx_http_upstream_rr_peers_t  *peers;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                   "get ewma peer, try: %ui", pc->tries);
+
+    ewp->start = ngx_monotonic_usec();
+
+    if (ewp->rrp.peers->single) {
+        return ewp->get_rr_peer(pc, &ewp->rrp);
+    }
+
+    pc->cached = 0;
+    pc->connection = NULL;
+
+    now = ngx_time();
+
+    peers = ewp->rrp.peers;
+
+    ngx_http_upstream_rr_peers_wlock(peers);
+
+    /*
+     * two candidates are chosen at random in proportion to their weights,
+     * and the one with the lower cost is used; the first candidate is
+     * excluded from the weights when the second one is chosen
+     */
+
+    c[0] = peers->number;
+    c[1] = peers->number;
+
+    for (k = 0; k < 2; k++) {
+
+        total = 0;
+
+        for (i = 0; i < peers->number; i++) {
+
+            n = i / (8 * sizeof(uintptr_t));
+            m = (uintptr_t) 1 << i % (8 * sizeof(uintptr_t));
+
+            if ((ewp->rrp.tried[n] & m) || i == c[0]) {
+                continue;
+            }
+
+            peer = &peers->peer[i];
+
+            if (peer->down || peer->unhealthy) {
+                continue;
+            }
+
+            if (peer->max_fails
+                && peer->fails >= peer->max_fails
+                && now - peer->checked <= peer->fail_timeout)
+            {
+                continue;
+            }
+
+            total += peer->weight;
+        }
+
+        if (total == 0) {
+            break;
+        }
+
+        r = ngx_random() % total;
+
+        for (i = 0; i < peers->number; i++) {
+
+            n = i / (8 * sizeof(uintptr_t));
+            m = (uintptr_t) 1 << i % (8 * sizeof(uintptr_t));
+
+            if ((ewp->rrp.tried[n] & m) || i == c[0]) {
+                continue;
+            }
+
+            peer = &peers->peer[i];
+
+            if (peer->down || peer->unhealthy) {
+                continue;
+            }
+
+            if (peer->max_fails
+                && peer->fails >= peer->max_fails
+                && now - peer->checked <= peer->fail_timeout)
+            {
+                continue;
+            }
+
+            r -= peer->weight;
+
+            if (r < 0) {
+                c[k] = i;
+                break;
+            }
+        }
+    }
+
+    if (c[0] == peers->number) {
+        ngx_log_debug0(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                       "get ewma peer, no peer found");
+
+        goto failed;
+    }
+
+    p = c[0];
+
+    if (c[1] != peers->number
+        && ngx_http_upstream_ewma_cost(ewp, &peers->peer[c[1]])
+           < ngx_http_upstream_ewma_cost(ewp, &peers->peer[c[0]]))
+    {
+        p = c[1];
+    }
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                   "get ewma peer, candidates: %ui %ui, selected: %ui",
+                   c[0], c[1], p);
+
+    best = &peers->peer[p];
+
+    best->checked = now;
+
+    pc->sockaddr = best->sockaddr;
+    pc->socklen = best->socklen;
+    pc->name = &best->name;
+    pc->stat = best->stat;
+
+    ewp->rrp.current = p;
+
+    n = p / (8 * sizeof(uintptr_t));
+    m = (uintptr_t) 1 << p % (8 * sizeof(uintptr_t));
+
+    ewp->rrp.tried[n] |= m;
+
+    best->conns++;
+
+    ngx_http_upstream_rr_peers_unlock(peers);
+
+    if (pc->tries == 1 && peers->next) {
+        pc->tries += peers->next->number;
+    }
+
+    return NGX_OK;
+
+failed:
+
+    if (peers->next) {
+        ngx_log_debug0(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                       "get ewma peer, backup servers");
+
+        ngx_http_upstream_rr_peers_unlock(peers);
+
+        ewp->rrp.peers = peers->next;
+        pc->tries = ewp->rrp.peers->number;
+
+        n = ewp->rrp.peers->number / (8 * sizeof(uintptr_t)) + 1;
+        for (i = 0; i < n; i++) {
+             ewp->rrp.tried[i] = 0;
+        }
+
+        rc = ngx_http_upstream_get_ewma_peer(pc, ewp);
+
+        if (rc != NGX_BUSY) {
+            return rc;
+        }
+
+        ngx_http_upstream_rr_peers_wlock(peers);
+    }
+
+    /* all peers failed, mark them as live for quick recovery */
+
+    for (i = 0; i < peers->number; i++) {
+        peers->peer[i].fails = 0;
+    }
+
+    ngx_http_upstream_rr_peers_unlock(peers);
+
+    pc->name = peers->name;
+
+    return NGX_BUSY;
+}
+
+
+static ngx_uint_t
+ngx_http_upstream_ewma_cost(ngx_http_upstream_ewma_peer_data_t *ewp,
+    ngx_http_upstream_rr_peer_t *peer)
+{
+    ngx_msec_t  idle;
+    ngx_uint_t  latency;
+
+    /*
+     * the average time to the response header kept by the extended status
+     * is used if available; the latency decays while a peer is not used,
+     * so a peer that was slow once is retried eventually instead of being
+     * avoided forever
+     */
+
+    latency = peer->stat ? peer->stat->header_time : peer->latency;
+
+    idle = ngx_current_msec - peer->latency_stamp;
+
+    if (idle >= ewp->decay) {
+        latency = 0;
+
+    } else {
+        latency -= (uint64_t) latency * idle / ewp->decay;
+    }
+
+    return (peer->conns + 1) * (latency + NGX_HTTP_UPSTREAM_EWMA_COST);
+}
+
+
+static void
+ngx_http_upstream_free_ewma_peer(ngx_peer_connection_t *pc, void *data,
+    ngx_uint_t state)
+{
+    ngx_http_upstream_ewma_peer_data_t  *ewp = data;
+
+    uint64_t                       sample;
+    ngx_http_upstream_rr_peer_t   *peer;
+    ngx_http_upstream_rr_peers_t  *peers;
+
+    peers = ewp->rrp.peers;
+    peer = &peers->peer[ewp->rrp.current];
+
+    ewp->free_rr_peer(pc, &ewp->rrp, state);
+
+    if (peers->single) {
+        return;
+    }
+
+    /*
+     * without the extended status the time of a try is sampled here,
+     * a failed try is charged with the time it took to fail
+     */
+
+    sample = ngx_monotonic_usec() - ewp->start;
+
+    ngx_http_upstream_rr_peers_rlock(peers);
+    ngx_http_upstream_rr_peer_lock(peers, peer);
+
+    if (peer->stat == NULL) {
+        ngx_peer_stat_ewma(&peer->latency, sample);
+    }
+
+    peer->latency_stamp = ngx_current_msec;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, pc->log, 0,
+                   "free ewma peer %V, sample: %uL, latency: %uA",
+                   &peer->name, sample,
+                   peer->stat ? peer->stat->header_time : peer->latency);
+
+    ngx_http_upstream_rr_peer_unlock(peers, peer);
+    ngx_http_upstream_rr_peers_unlock(peers);
+}
+
+
+static void *
+ngx_http_upstream_ewma_create_conf(ngx_conf_t *cf)
+{
+    ngx_http_upstream_ewma_srv_conf_t  *conf;
+
+    conf = ngx_palloc(cf->pool, sizeof(ngx_http_upstream_ewma_srv_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    conf->decay = NGX_CONF_UNSET_MSEC;
+
+    return conf;
+}
+
+
+static char *
+ngx_http_upstream_ewma(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_upstream_ewma_srv_conf_t  *ecf = conf;
+
+    ngx_str_t                     *value, s;
+    ngx_http_upstream_srv_conf_t  *uscf;
+
+    if (ecf->decay != NGX_CONF_UNSET_MSEC) {
+        return "is duplicate";
+    }
+
+    ecf->decay = 1000;
+
+    value = cf->args->elts;
+
+    if (cf->args->nelts == 2) {
+
+        if (ngx_strncmp(value[1].data, "decay=", 6) != 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[1]);
+            return NGX_CONF_ERROR;
+        }
+
+        s.len = value[1].len - 6;
+        s.data = &value[1].data[6];
+
+        ecf->decay = ngx_parse_time(&s, 0);
+
+        if (ecf->decay == (ngx_msec_t) NGX_ERROR || ecf->decay == 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[1]);
+            return NGX_CONF_ERROR;
+        }
+    }
+
+    uscf = ngx_http_conf_get_module_srv_conf(cf, ngx_http_upstream_module);
+
+    uscf->peer.init_upstream = ngx_http_upstream_init_ewma;
+
+    uscf->flags = NGX_HTTP_UPSTREAM_CREATE
+                  |NGX_HTTP_UPSTREAM_WEIGHT
+                  |NGX_HTTP_UPSTREAM_MAX_FAILS
+                  |NGX_HTTP_UPSTREAM_FAIL_TIMEOUT
+                  |NGX_HTTP_UPSTREAM_DOWN
+                  |NGX_HTTP_UPSTREAM_BACKUP;
+
+    return NGX_CONF_OK;
+}
@@ -0,0 +1,776 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+typedef struct {
+    ngx_msec_t                         interval;
+    ngx_msec_t                         timeout;
+    ngx_uint_t                         fails;
+    ngx_uint_t                         passes;
+    ngx_uint_t                         status_min;
+    ngx_uint_t                         status_max;
+    ngx_str_t                          match;
+    ngx_str_t                          request;
+} ngx_http_upstream_hc_srv_conf_t;
+
+
+typedef struct {
+    ngx_http_upstream_hc_srv_conf_t   *conf;
+    ngx_http_upstream_rr_peers_t      *peers;
+    ngx_http_upstream_rr_peer_t       *peer;
+    ngx_str_t                         *upstream;
+
+    ngx_peer_connection_t              pc;
+    ngx_buf_t                         *buffer;
+    size_t                             sent;
+} ngx_http_upstream_hc_peer_t;
+
+
+typedef struct {
+    ngx_event_t                        event;
+    ngx_http_upstream_hc_srv_conf_t   *conf;
+    ngx_http_upstream_hc_peer_t       *peer;
+    ngx_uint_t                         number;
+} ngx_http_upstream_hc_t;
+
+
+static void ngx_http_upstream_hc_handler(ngx_event_t *ev);
+static void ngx_http_upstream_hc_start(ngx_http_upstream_hc_peer_t *hp);
+static void ngx_http_upstream_hc_send_handler(ngx_event_t *wev);
+static void ngx_http_upstream_hc_recv_handler(ngx_event_t *rev);
+static void ngx_http_upstream_hc_dummy_handler(ngx_event_t *ev);
+static ngx_int_t ngx_http_upstream_hc_test(ngx_http_upstream_hc_peer_t *hp);
+static void ngx_http_upstream_hc_done(ngx_http_upstream_hc_peer_t *hp,
+    ngx_uint_t passed);
+
+static void *ngx_http_upstream_hc_create_conf(ngx_conf_t *cf);
+static char *ngx_http_upstream_hc(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static ngx_int_t ngx_http_upstream_hc_init(ngx_conf_t *cf);
+static ngx_int_t ngx_http_upstream_hc_init_process(ngx_cycle_t *cycle);
+
+
+static ngx_command_t  ngx_http_upstream_hc_commands[] = {
+
+    { ngx_string("health_check"),
+      NGX_HTTP_UPS_CONF|NGX_CONF_ANY,
+      ngx_http_upstream_hc,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_upstream_health_check_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    ngx_http_upstream_hc_init,             /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    ngx_http_upstream_hc_create_conf,      /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_upstream_health_check_module = {
+    NGX_MODULE_V1,
+    &ngx_http_upstream_health_check_module_ctx, /* module context */
+    ngx_http_upstream_hc_commands,         /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    ngx_http_upstream_hc_init_process,     /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static void
+ngx_http_upstream_hc_handler(ngx_event_t *ev)
+{
+    ngx_uint_t                    i, claimed;
+    ngx_http_upstream_hc_t       *hc;
+    ngx_http_upstream_rr_peer_t  *peer;
+    ngx_http_upstream_hc_peer_t  *hp;
+
+    hc = ev->data;
+
+    /*
+     * the timer ticks at most once a second, as a pending timer
+     * does not let a worker exit gracefully, and the probes are
+     * due according to the time of the next probe of a peer
+     */
+
+    if (ngx_exiting || ngx_quit || ngx_terminate) {
+        return;
+    }
+
+    ngx_add_timer(ev, ngx_min(hc->conf->interval, 1000));
+
+    for (i = 0; i < hc->number; i++) {
+        hp = &hc->peer[i];
+        peer = hp->peer;
+
+        if (hp->pc.connection || peer->down) {
+            continue;
+        }
+
+        /*
+         * the workers race for the probes, and the one that has moved
+         * the time of the next probe of a peer sends this one
+         */
+
+        ngx_http_upstream_rr_peers_rlock(hp->peers);
+        ngx_http_upstream_rr_peer_lock(hp->peers, peer);
+
+        if ((ngx_msec_int_t) (peer->check_next - ngx_current_msec) > 0) {
+            claimed = 0;
+
+        } else {
+            peer->check_next = ngx_current_msec
+                               + ngx_max(hc->conf->interval,
+                                         hc->conf->timeout);
+            claimed = 1;
+        }
+
+        ngx_http_upstream_rr_peer_unlock(hp->peers, peer);
+        ngx_http_upstream_rr_peers_unlock(hp->peers);
+
+        if (claimed) {
+            ngx_http_upstream_hc_start(hp);
+        }
+    }
+}
+
+
+static void
+ngx_http_upstream_hc_start(ngx_http_upstream_hc_peer_t *hp)
+{
+    ngx_int_t          rc;
+    ngx_connection_t  *c;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, hp->pc.log, 0,
+                   "health check of %V", hp->pc.name);
+
+    hp->pc.connection = NULL;
+    hp->pc.cached = 0;
+
+    rc = ngx_event_connect_peer(&hp->pc);
+
+    if (rc == NGX_ERROR || rc == NGX_BUSY || rc == NGX_DECLINED) {
+        hp->pc.connection = NULL;
+        ngx_http_upstream_hc_done(hp, 0);
+        return;
+    }
+
+    /* rc == NGX_OK || rc == NGX_AGAIN */
+
+    c = hp->pc.connection;
+
+    c->data = hp;
+    c->log = hp->pc.log;
+    c->read->log = c->log;
+    c->write->log = c->log;
+
+    c->write->handler = ngx_http_upstream_hc_send_handler;
+    c->read->handler = ngx_http_upstream_hc_recv_handler;
+
+    hp->sent = 0;
+    hp->buffer->pos = hp->buffer->start;
+    hp->buffer->last = hp->buffer->start;
+
+    ngx_add_timer(c->write, hp->conf->timeout);
+
+    if (rc == NGX_OK) {
+        ngx_http_upstream_hc_send_handler(c->write);
+    }
+}
+
+
+static void
+ngx_http_upstream_hc_send_handler(ngx_event_t *wev)
+{
+    ssize_t                       n;
+    ngx_str_t                    *request;
+    ngx_connection_t             *c;
+    ngx_http_upstream_hc_peer_t  *hp;
+
+    c = wev->data;
+    hp = c->data;
+
+    if (wev->timedout) {
+        ngx_log_error(NGX_LOG_ERR, c->log, NGX_ETIMEDOUT,
+                      "health check of %V timed out", hp->pc.name);
+        ngx_http_upstream_hc_done(hp, 0);
+        return;
+    }
+
+    request = &hp->conf->request;
+
+    while (hp->sent < request->len) {
+
+        n = c->send(c, request->data + hp->sent, request->len - hp->sent);
+
+        if (n == NGX_ERROR) {
+            ngx_http_upstream_hc_done(hp, 0);
+            return;
+        }
+
+        if (n == NGX_AGAIN) {
+            if (ngx_handle_write_event(wev, 0) != NGX_OK) {
+                ngx_http_upstream_hc_done(hp, 0);
+            }
+
+            return;
+        }
+
+        hp->sent += n;
+    }
+
+    if (wev->timer_set) {
+        ngx_del_timer(wev);
+    }
+
+    wev->handler = ngx_http_upstream_hc_dummy_handler;
+
+    ngx_add_timer(c->read, hp->conf->timeout);
+
+    if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
+        ngx_http_upstream_hc_done(hp, 0);
+        return;
+    }
+
+    if (c->read->ready) {
+        ngx_http_upstream_hc_recv_handler(c->read);
+    }
+}
+
+
+static void
+ngx_http_upstream_hc_recv_handler(ngx_event_t *rev)
+{
+    size_t                        size;
+    ssize_t                       n;
+    ngx_buf_t                    *b;
+    ngx_connection_t             *c;
+    ngx_http_upstream_hc_peer_t  *hp;
+
+    c = rev->data;
+    hp = c->data;
+
+    if (rev->timedout) {
+        ngx_log_error(NGX_LOG_ERR, c->log, NGX_ETIMEDOUT,
+                      "health check of %V timed out", hp->pc.name);
+        ngx_http_upstream_hc_done(hp, 0);
+        return;
+    }
+
+    if (hp->sent < hp->conf->request.len) {
+
+        /* the response can not come before the request is sent */
+
+        if (ngx_handle_read_event(rev, 0) != NGX_OK) {
+            ngx_http_upstream_hc_done(hp, 0);
+        }
+
+        return;
+    }
+
+    b = hp->buffer;
+
+    /* only the beginning of a response is tested */
+
+    for ( ;; ) {
+        size = b->end - b->last;
+
+        if (size == 0) {
+            break;
+        }
+
+        n = c->recv(c, b->last, size);
+
+        if (n == NGX_AGAIN) {
+            if (ngx_handle_read_event(rev, 0) != NGX_OK) {
+                ngx_http_upstream_hc_done(hp, 0);
+            }
+
+            return;
+        }
+
+        if (n == NGX_ERROR) {
+            ngx_http_upstream_hc_done(hp, 0);
+            return;
+        }
+
+        if (n == 0) {
+            break;
+        }
+
+        b->last += n;
+    }
+
+    ngx_http_upstream_hc_done(hp, ngx_http_upstream_hc_test(hp) == NGX_OK);
+}
+
+
+static void
+ngx_http_upstream_hc_dummy_handler(ngx_event_t *ev)
+{
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, ev->log, 0,
+                   "health check dummy handler");
+}
+
+
+static ngx_int_t
+ngx_http_upstream_hc_test(ngx_http_upstream_hc_peer_t *hp)
+{
+    u_char                           *p, *last;
+    ngx_int_t                         status;
+    ngx_http_upstream_hc_srv_conf_t  *conf;
+
+    conf = hp->conf;
+
+    p = hp->buffer->pos;
+    last = hp->buffer->last;
+
+    /* "HTTP/1.x 200" */
+
+    if (last - p < 12
+        || ngx_strncmp(p, "HTTP/1.", sizeof("HTTP/1.") - 1) != 0
+        || p[8] != ' ')
+    {
+        ngx_log_error(NGX_LOG_ERR, hp->pc.log, 0,
+                      "health check of %V: invalid response", hp->pc.name);
+        return NGX_ERROR;
+    }
+
+    status = ngx_atoi(p + 9, 3);
+
+    if (status == NGX_ERROR
+        || (ngx_uint_t) status < conf->status_min
+        || (ngx_uint_t) status > conf->status_max)
+    {
+        ngx_log_error(NGX_LOG_ERR, hp->pc.log, 0,
+                      "health check of %V: unexpected status \"%*s\"",
+                      hp->pc.name, (size_t) 3, p + 9);
+        return NGX_ERROR;
+    }
+
+    if (conf->match.len == 0) {
+        return NGX_OK;
+    }
+
+    for (p += 12; p + 3 < last; p++) {
+        if (p[0] == CR && p[1] == LF && p[2] == CR && p[3] == LF) {
+            break;
+        }
+    }
+
+    for (p += 4; p + conf->match.len <= last; p++) {
+        if (ngx_strncmp(p, conf->match.data, conf->match.len) == 0) {
+            return NGX_OK;
+        }
+    }
+
+    ngx_log_error(NGX_LOG_ERR, hp->pc.log, 0,
+                  "health check of %V: body does not match \"%V\"",
+                  hp->pc.name, &conf->match);
+
+    return NGX_ERROR;
+}
+
+
+static void
+ngx_http_upstream_hc_done(ngx_http_upstream_hc_peer_t *hp, ngx_uint_t passed)
+{
+    ngx_http_upstream_rr_peer_t      *peer;
+    ngx_http_upstream_rr_peers_t     *peers;
+    ngx_http_upstream_hc_srv_conf_t  *conf;
+
+    if (hp->pc.connection) {
+        ngx_close_connection(hp->pc.connection);
+        hp->pc.connection = NULL;
+    }
+
+    conf = hp->conf;
+    peers = hp->peers;
+    peer = hp->peer;
+
+    ngx_http_upstream_rr_peers_rlock(peers);
+    ngx_http_upstream_rr_peer_lock(peers, peer);
+
+    if (passed) {
+        peer->check_fails = 0;
+
+        if (peer->unhealthy && ++peer->check_passes >= conf->passes) {
+            peer->unhealthy = 0;
+            peer->check_passes = 0;
+
+            /* the passive failures are forgotten as well */
+
+            peer->fails = 0;
+
+            ngx_log_error(NGX_LOG_NOTICE, hp->pc.log, 0,
+                          "peer %V in upstream \"%V\" is healthy",
+                          hp->pc.name, hp->upstream);
+        }
+
+    } else {
+        peer->check_passes = 0;
+
+        if (!peer->unhealthy && ++peer->check_fails >= conf->fails) {
+            peer->unhealthy = 1;
+            peer->check_fails = 0;
+
+            if (peer->stat) {
+                (void) ngx_atomic_fetch_add(&peer->stat->unavail, 1);
+            }
+
+            ngx_log_error(NGX_LOG_WARN, hp->pc.log, 0,
+                          "peer %V in upstream \"%V\" is unhealthy",
+                          hp->pc.name, hp->upstream);
+        }
+    }
+
+    ngx_http_upstream_rr_peer_unlock(peers, peer);
+    ngx_http_upstream_rr_peers_unlock(peers);
+}
+
+
+static void *
+ngx_http_upstream_hc_create_conf(ngx_conf_t *cf)
+{
+    ngx_http_upstream_hc_srv_conf_t  *conf;
+
+    conf = ngx_pcalloc(cf->pool, sizeof(ngx_http_upstream_hc_srv_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by ngx_pcalloc():
+     *
+     *     conf->match = { 0, NULL };
+     *     conf->request = { 0, NULL };
+     */
+
+    conf->interval = NGX_CONF_UNSET_MSEC;
+
+    return conf;
+}
+
+
+static char *
+ngx_http_upstream_hc(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_upstream_hc_srv_conf_t  *hcf = conf;
+
+    u_char                        *p, *dash;
+    ngx_int_t                      n, max;
+    ngx_str_t                     *value, s, uri;
+    ngx_uint_t                     i;
+    ngx_http_upstream_srv_conf_t  *uscf;
+
+    if (hcf->interval != NGX_CONF_UNSET_MSEC) {
+        return "is duplicate";
+    }
+
+    uscf = ngx_http_conf_get_module_srv_conf(cf, ngx_http_upstream_module);
+
+    hcf->interval = 5000;
+    hcf->timeout = 1000;
+    hcf->fails = 1;
+    hcf->passes = 1;
+    hcf->status_min = 200;
+    hcf->status_max = 399;
+
+    ngx_str_set(&uri, "/");
+
+    value = cf->args->elts;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "interval=", 9) == 0) {
+
+            s.len = value[i].len - 9;
+            s.data = &value[i].data[9];
+
+            hcf->interval = ngx_parse_time(&s, 0);
+
+            if (hcf->interval == (ngx_msec_t) NGX_ERROR
+                || hcf->interval == 0)
+            {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "timeout=", 8) == 0) {
+
+            s.len = value[i].len - 8;
+            s.data = &value[i].data[8];
+
+            hcf->timeout = ngx_parse_time(&s, 0);
+
+            if (hcf->timeout == (ngx_msec_t) NGX_ERROR
+                || hcf->timeout == 0)
+            {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "fails=", 6) == 0) {
+
+            n = ngx_atoi(&value[i].data[6], value[i].len - 6);
+
+            if (n == NGX_ERROR || n == 0) {
+                goto invalid;
+            }
+
+            hcf->fails = n;
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "passes=", 7) == 0) {
+
+            n = ngx_atoi(&value[i].data[7], value[i].len - 7);
+
+            if (n == NGX_ERROR || n == 0) {
+                goto invalid;
+            }
+
+            hcf->passes = n;
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "uri=", 4) == 0) {
+
+            uri.len = value[i].len - 4;
+            uri.data = &value[i].data[4];
+
+            if (uri.len == 0 || uri.data[0] != '/') {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "status=", 7) == 0) {
+
+            /* "status=200" or "status=200-299" */
+
+            p = &value[i].data[7];
+            dash = ngx_strlchr(p, value[i].data + value[i].len, '-');
+
+            if (dash) {
+                n = ngx_atoi(p, dash - p);
+                max = ngx_atoi(dash + 1,
+                               value[i].data + value[i].len - dash - 1);
+
+            } else {
+                n = ngx_atoi(p, value[i].data + value[i].len - p);
+                max = n;
+            }
+
+            if (n == NGX_ERROR || max == NGX_ERROR
+                || n < 100 || max > 599 || n > max)
+            {
+                goto invalid;
+            }
+
+            hcf->status_min = n;
+            hcf->status_max = max;
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "match=", 6) == 0) {
+
+            hcf->match.len = value[i].len - 6;
+            hcf->match.data = &value[i].data[6];
+
+            if (hcf->match.len == 0) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        goto invalid;
+    }
+
+    hcf->request.len = sizeof("GET  HTTP/1.0" CRLF "Host: " CRLF
+                              "Connection: close" CRLF CRLF) - 1
+                       + uri.len + uscf->host.len;
+
+    hcf->request.data = ngx_pnalloc(cf->pool, hcf->request.len);
+    if (hcf->request.data == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ngx_sprintf(hcf->request.data, "GET %V HTTP/1.0" CRLF "Host: %V" CRLF
+                "Connection: close" CRLF CRLF, &uri, &uscf->host);
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_hc_init(ngx_conf_t *cf)
+{
+    ngx_uint_t                        i;
+    ngx_http_upstream_srv_conf_t    **uscfp;
+    ngx_http_upstream_main_conf_t    *umcf;
+    ngx_http_upstream_hc_srv_conf_t  *hcf;
+
+    umcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_upstream_module);
+
+    uscfp = umcf->upstreams.elts;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        if (uscfp[i]->srv_conf == NULL) {
+            continue;
+        }
+
+        hcf = ngx_http_conf_upstream_srv_conf(uscfp[i],
+                                       ngx_http_upstream_health_check_module);
+
+        if (hcf->interval == NGX_CONF_UNSET_MSEC) {
+            continue;
+        }
+
+        /* the probes of the workers are coordinated in the zone */
+
+        if (uscfp[i]->shm_zone == NULL) {
+            ngx_log_error(NGX_LOG_EMERG, cf->log, 0,
+                          "health_check requires \"zone\" in upstream \"%V\" "
+                          "in %s:%ui",
+                          &uscfp[i]->host, uscfp[i]->file_name,
+                          uscfp[i]->line);
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_hc_init_process(ngx_cycle_t *cycle)
+{
+    ngx_uint_t                        i, n;
+    ngx_http_upstream_t              *u;
+    ngx_http_upstream_hc_t           *hc;
+    ngx_http_upstream_hc_peer_t      *hp;
+    ngx_http_upstream_rr_peers_t     *peers;
+    ngx_http_upstream_srv_conf_t    **uscfp;
+    ngx_http_upstream_main_conf_t    *umcf;
+    ngx_http_upstream_hc_srv_conf_t  *hcf;
+
+    if (ngx_process != NGX_PROCESS_WORKER
+        && ngx_process != NGX_PROCESS_SINGLE)
+    {
+        return NGX_OK;
+    }
+
+    umcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_upstream_module);
+
+    if (umcf == NULL) {
+        return NGX_OK;
+    }
+
+    uscfp = umcf->upstreams.elts;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        if (uscfp[i]->srv_conf == NULL) {
+            continue;
+        }
+
+        hcf = ngx_http_conf_upstream_srv_conf(uscfp[i],
+                                       ngx_http_upstream_health_check_module);
+
+        if (hcf->interval == NGX_CONF_UNSET_MSEC) {
+            continue;
+        }
+
+        peers = uscfp[i]->peer.data;
+
+        n = peers->number + (peers->next ? peers->next->number : 0);
+
+        hc = ngx_pcalloc(cycle->pool, sizeof(ngx_http_upstream_hc_t));
+        if (hc == NULL) {
+            return NGX_ERROR;
+        }
+
+        hc->peer = ngx_pcalloc(cycle->pool,
+                               n * sizeof(ngx_http_upstream_hc_peer_t));
+        if (hc->peer == NULL) {
+            return NGX_ERROR;
+        }
+
+        hc->conf = hcf;
+
+        for ( /* void */ ; peers; peers = peers->next) {
+
+            for (n = 0; n < peers->number; n++) {
+                hp = &hc->peer[hc->number++];
+
+                hp->conf = hcf;
+                hp->peers = peers;
+                hp->peer = &peers->peer[n];
+                hp->upstream = &uscfp[i]->host;
+
+                hp->pc.sockaddr = hp->peer->sockaddr;
+                hp->pc.socklen = hp->peer->socklen;
+                hp->pc.name = &hp->peer->name;
+                hp->pc.get = ngx_event_get_peer;
+                hp->pc.log = cycle->log;
+                hp->pc.log_error = NGX_ERROR_ERR;
+
+                hp->buffer = ngx_create_temp_buf(cycle->pool, ngx_pagesize);
+                if (hp->buffer == NULL) {
+                    return NGX_ERROR;
+                }
+            }
+        }
+
+        hc->event.handler = ngx_http_upstream_hc_handler;
+        hc->event.data = hc;
+        hc->event.log = cycle->log;
+
+        ngx_add_timer(&hc->event,
+                      ngx_random() % ngx_min(hcf->interval, 1000) + 1);
+    }
+
+    return NGX_OK;
+}
@@ -165,6 +165,8 @@ ngx_http_upstream_get_ip_hash_peer(ngx_peer_connection_t *pc, void *data)
         return iphp->get_rr_peer(pc, &iphp->rrp);
     }
 
+    ngx_http_upstream_rr_peers_wlock(iphp->rrp.peers);
+
     now = ngx_time();
 
     pc->cached = 0;
@@ -204,9 +206,7 @@ ngx_http_upstream_get_ip_hash_peer(ngx_peer_connection_t *pc, void *data)
 
             peer = &iphp->rrp.peers->peer[p];
 
-            /* ngx_lock_mutex(iphp->rrp.peers->mutex); */
-
-            if (!peer->down) {
+            if (!peer->down && !peer->unhealthy) {
 
                 if (peer->max_fails == 0 || peer->fails < peer->max_fails) {
                     break;
@@ -220,12 +220,11 @@ ngx_http_upstream_get_ip_hash_peer(ngx_peer_connection_t *pc, void *data)
 
             iphp->rrp.tried[n] |= m;
 
-            /* ngx_unlock_mutex(iphp->rrp.peers->mutex); */
-
             pc->tries--;
         }
 
         if (++iphp->tries >= 20) {
+            ngx_http_upstream_rr_peers_unlock(iphp->rrp.peers);
             return iphp->get_rr_peer(pc, &iphp->rrp);
         }
     }
@@ -235,8 +234,11 @@ ngx_http_upstream_get_ip_hash_peer(ngx_peer_connection_t *pc, void *data)
     pc->sockaddr = peer->sockaddr;
     pc->socklen = peer->socklen;
     pc->name = &peer->name;
+    pc->stat = peer->stat;
+
+    peer->conns++;
 
-    /* ngx_unlock_mutex(iphp->rrp.peers->mutex); */
+    ngx_http_upstream_rr_peers_unlock(iphp->rrp.peers);
 
     iphp->rrp.tried[n] |= m;
     iphp->hash = hash;
@@ -491,6 +491,7 @@ ngx_http_init_phase_handlers(ngx_conf_t *cf, ngx_http_core_main_conf_t *cmcf)
             find_config_index = n;
 
             ph->checker = ngx_http_core_find_config_phase;
+            ph->phase = i;
             n++;
             ph++;
 
@@ -507,6 +508,7 @@ ngx_http_init_phase_handlers(ngx_conf_t *cf, ngx_http_core_main_conf_t *cmcf)
         case NGX_HTTP_POST_REWRITE_PHASE:
             if (use_rewrite) {
                 ph->checker = ngx_http_core_post_rewrite_phase;
+                ph->phase = i;
                 ph->next = find_config_index;
                 n++;
                 ph++;
@@ -522,6 +524,7 @@ ngx_http_init_phase_handlers(ngx_conf_t *cf, ngx_http_core_main_conf_t *cmcf)
         case NGX_HTTP_POST_ACCESS_PHASE:
             if (use_access) {
                 ph->checker = ngx_http_core_post_access_phase;
+                ph->phase = i;
                 ph->next = n;
                 ph++;
             }
@@ -531,6 +534,7 @@ ngx_http_init_phase_handlers(ngx_conf_t *cf, ngx_http_core_main_conf_t *cmcf)
         case NGX_HTTP_TRY_FILES_PHASE:
             if (cmcf->try_files) {
                 ph->checker = ngx_http_core_try_files_phase;
+                ph->phase = i;
                 n++;
                 ph++;
             }
@@ -549,6 +553,7 @@ ngx_http_init_phase_handlers(ngx_conf_t *cf, ngx_http_core_main_conf_t *cmcf)
 
         for (j = cmcf->phases[i].handlers.nelts - 1; j >=0; j--) {
             ph->checker = checker;
+            ph->phase = i;
             ph->handler = h[j];
             ph->next = n;
             ph++;
@@ -1717,6 +1722,10 @@ ngx_http_init_listening(ngx_conf_t *cf, ngx_http_conf_port_t *port)
             break;
         }
 
+        if (ngx_clone_listening(cf, ls) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
         addr++;
         last--;
     }
@@ -1791,6 +1800,10 @@ ngx_http_add_listening(ngx_conf_t *cf, ngx_http_conf_addr_t *addr)
     ls->setfib = addr->opt.setfib;
 #endif
 
+#if (NGX_HAVE_REUSEPORT)
+    ls->reuseport = addr->opt.reuseport;
+#endif
+
     return ls;
 }
 
@@ -24,6 +24,13 @@
 
 #define NGX_HTTP_CACHE_KEY_LEN       16
 
+#define NGX_HTTP_CACHE_KEY_MD5       0
+#define NGX_HTTP_CACHE_KEY_XXH128    1
+#define NGX_HTTP_CACHE_KEY_SIPHASH   2
+
+/* the files of version 1 and later store CRC-32C of the key */
+#define NGX_HTTP_CACHE_VERSION       1
+
 
 typedef struct {
     ngx_uint_t                       status;
@@ -103,6 +110,13 @@ typedef struct {
     u_short                          valid_msec;
     u_short                          header_start;
     u_short                          body_start;
+
+    /*
+     * the version takes the former trailing padding, so the header size
+     * is not changed and the older files, where the byte is not set,
+     * are still recognized by their CRC-32 checksum
+     */
+    u_char                           version;
 } ngx_http_file_cache_header_t;
 
 
@@ -133,13 +147,15 @@ struct ngx_http_file_cache_s {
     ngx_msec_t                       loader_sleep;
     ngx_msec_t                       loader_threshold;
 
+    ngx_uint_t                       key_hash;
+
     ngx_shm_zone_t                  *shm_zone;
 };
 
 
 ngx_int_t ngx_http_file_cache_new(ngx_http_request_t *r);
 ngx_int_t ngx_http_file_cache_create(ngx_http_request_t *r);
-void ngx_http_file_cache_create_key(ngx_http_request_t *r);
+ngx_int_t ngx_http_file_cache_create_key(ngx_http_request_t *r);
 ngx_int_t ngx_http_file_cache_open(ngx_http_request_t *r);
 void ngx_http_file_cache_set_header(ngx_http_request_t *r, u_char *buf);
 void ngx_http_file_cache_update(ngx_http_request_t *r, ngx_temp_file_t *tf);
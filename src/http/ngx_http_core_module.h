@@ -13,6 +13,10 @@
 #include <ngx_core.h>
 #include <ngx_http.h>
 
+#if (NGX_THREAD_POOL)
+#include <ngx_thread_pool.h>
+#endif
+
 
 #define NGX_HTTP_GZIP_PROXIED_OFF       0x0002
 #define NGX_HTTP_GZIP_PROXIED_EXPIRED   0x0004
@@ -28,6 +32,7 @@
 #define NGX_HTTP_AIO_OFF                0
 #define NGX_HTTP_AIO_ON                 1
 #define NGX_HTTP_AIO_SENDFILE           2
+#define NGX_HTTP_AIO_THREADS            3
 
 
 #define NGX_HTTP_SATISFY_ALL            0
@@ -79,6 +84,9 @@ typedef struct {
     unsigned                   ipv6only:2;
 #endif
     unsigned                   so_keepalive:2;
+#if (NGX_HAVE_REUSEPORT)
+    unsigned                   reuseport:1;
+#endif
 
     int                        backlog;
     int                        rcvbuf;
@@ -132,6 +140,22 @@ struct ngx_http_phase_handler_s {
     ngx_http_phase_handler_pt  checker;
     ngx_http_handler_pt        handler;
     ngx_uint_t                 next;
+    ngx_uint_t                 phase;
+};
+
+
+/* the output filters are timed in a slot of their own after the log phase */
+
+#define NGX_HTTP_PHASE_TIMING_FILTER  (NGX_HTTP_LOG_PHASE + 1)
+#define NGX_HTTP_PHASE_TIMING_N       (NGX_HTTP_LOG_PHASE + 2)
+
+
+struct ngx_http_phase_timing_s {
+    uint64_t                   start;
+    uint64_t                   time[NGX_HTTP_PHASE_TIMING_N];
+    ngx_uint_t                 phase;
+    ngx_uint_t                 visited;
+    unsigned                   filter:1;
 };
 
 
@@ -377,7 +401,7 @@ struct ngx_http_core_loc_conf_s {
                                            /* client_body_in_singe_buffer */
     ngx_flag_t    internal;                /* internal */
     ngx_flag_t    sendfile;                /* sendfile */
-#if (NGX_HAVE_FILE_AIO)
+#if (NGX_HAVE_FILE_AIO || NGX_THREAD_POOL)
     ngx_flag_t    aio;                     /* aio */
 #endif
     ngx_flag_t    tcp_nopush;              /* tcp_nopush */
@@ -414,6 +438,10 @@ struct ngx_http_core_loc_conf_s {
 
     ngx_path_t   *client_body_temp_path;   /* client_body_temp_path */
 
+#if (NGX_THREAD_POOL)
+    ngx_thread_pool_t      *thread_pool;
+#endif
+
     ngx_open_file_cache_t  *open_file_cache;
     time_t        open_file_cache_valid;
     ngx_uint_t    open_file_cache_min_uses;
@@ -18,9 +18,15 @@ static ngx_int_t ngx_http_file_cache_read(ngx_http_request_t *r,
     ngx_http_cache_t *c);
 static ssize_t ngx_http_file_cache_aio_read(ngx_http_request_t *r,
     ngx_http_cache_t *c);
+static uint32_t ngx_http_file_cache_crc32(ngx_http_cache_t *c);
 #if (NGX_HAVE_FILE_AIO)
 static void ngx_http_cache_aio_event_handler(ngx_event_t *ev);
 #endif
+#if (NGX_THREAD_POOL)
+static ngx_int_t ngx_http_cache_thread_handler(ngx_thread_task_t *task,
+    ngx_file_t *file);
+static void ngx_http_cache_thread_event_handler(ngx_event_t *ev);
+#endif
 static ngx_int_t ngx_http_file_cache_exists(ngx_http_file_cache_t *cache,
     ngx_http_cache_t *c);
 static ngx_int_t ngx_http_file_cache_name(ngx_http_request_t *r,
@@ -59,6 +65,10 @@ ngx_str_t  ngx_http_cache_status[] = {
 
 static u_char  ngx_http_file_cache_key[] = { LF, 'K', 'E', 'Y', ':', ' ' };
 
+/* the digest names the cache files, so the key must not change */
+
+static u_char  ngx_http_file_cache_siphash_key[] = "nginx file cache";
+
 
 static ngx_int_t
 ngx_http_file_cache_init(ngx_shm_zone_t *shm_zone, void *data)
@@ -200,21 +210,27 @@ ngx_http_file_cache_create(ngx_http_request_t *r)
 }
 
 
-void
+ngx_int_t
 ngx_http_file_cache_create_key(ngx_http_request_t *r)
 {
+    u_char            *p, *data;
     size_t             len;
     ngx_str_t         *key;
-    ngx_uint_t         i;
+    ngx_uint_t         i, hash;
     ngx_md5_t          md5;
     ngx_http_cache_t  *c;
 
     c = r->cache;
 
+    hash = c->file_cache->key_hash;
+
     len = 0;
 
-    ngx_crc32_init(c->crc32);
-    ngx_md5_init(&md5);
+    ngx_crc32c_init(c->crc32);
+
+    if (hash == NGX_HTTP_CACHE_KEY_MD5) {
+        ngx_md5_init(&md5);
+    }
 
     key = c->keys.elts;
     for (i = 0; i < c->keys.nelts; i++) {
@@ -223,15 +239,49 @@ ngx_http_file_cache_create_key(ngx_http_request_t *r)
 
         len += key[i].len;
 
-        ngx_crc32_update(&c->crc32, key[i].data, key[i].len);
-        ngx_md5_update(&md5, key[i].data, key[i].len);
+        ngx_crc32c_update(&c->crc32, key[i].data, key[i].len);
+
+        if (hash == NGX_HTTP_CACHE_KEY_MD5) {
+            ngx_md5_update(&md5, key[i].data, key[i].len);
+        }
     }
 
     c->header_start = sizeof(ngx_http_file_cache_header_t)
                       + sizeof(ngx_http_file_cache_key) + len + 1;
 
-    ngx_crc32_final(c->crc32);
-    ngx_md5_final(c->key, &md5);
+    ngx_crc32c_final(c->crc32);
+
+    if (hash == NGX_HTTP_CACHE_KEY_MD5) {
+        ngx_md5_final(c->key, &md5);
+        return NGX_OK;
+    }
+
+    /* xxh128 and siphash are not incremental, they need the whole key */
+
+    if (c->keys.nelts == 1) {
+        data = key[0].data;
+
+    } else {
+        data = ngx_pnalloc(r->pool, len);
+        if (data == NULL) {
+            return NGX_ERROR;
+        }
+
+        p = data;
+
+        for (i = 0; i < c->keys.nelts; i++) {
+            p = ngx_cpymem(p, key[i].data, key[i].len);
+        }
+    }
+
+    if (hash == NGX_HTTP_CACHE_KEY_XXH128) {
+        ngx_xxh128(c->key, data, len);
+
+    } else {
+        ngx_siphash128(c->key, ngx_http_file_cache_siphash_key, data, len);
+    }
+
+    return NGX_OK;
 }
 
 
@@ -498,7 +548,9 @@ ngx_http_file_cache_read(ngx_http_request_t *r, ngx_http_cache_t *c)
 
     h = (ngx_http_file_cache_header_t *) c->buf->pos;
 
-    if (h->crc32 != c->crc32) {
+    if ((h->version != NGX_HTTP_CACHE_VERSION || h->crc32 != c->crc32)
+        && h->crc32 != ngx_http_file_cache_crc32(c))
+    {
         ngx_log_error(NGX_LOG_CRIT, r->connection->log, 0,
                       "cache file \"%s\" has md5 collision", c->file.name.data);
         return NGX_DECLINED;
@@ -569,20 +621,55 @@ ngx_http_file_cache_read(ngx_http_request_t *r, ngx_http_cache_t *c)
 }
 
 
+static uint32_t
+ngx_http_file_cache_crc32(ngx_http_cache_t *c)
+{
+    uint32_t    crc32;
+    ngx_str_t  *key;
+    ngx_uint_t  i;
+
+    ngx_crc32_init(crc32);
+
+    key = c->keys.elts;
+    for (i = 0; i < c->keys.nelts; i++) {
+        ngx_crc32_update(&crc32, key[i].data, key[i].len);
+    }
+
+    ngx_crc32_final(crc32);
+
+    return crc32;
+}
+
+
 static ssize_t
 ngx_http_file_cache_aio_read(ngx_http_request_t *r, ngx_http_cache_t *c)
 {
-#if (NGX_HAVE_FILE_AIO)
+#if (NGX_HAVE_FILE_AIO || NGX_THREAD_POOL)
     ssize_t                    n;
     ngx_http_core_loc_conf_t  *clcf;
 
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+#endif
+
+#if (NGX_THREAD_POOL)
+
+    if (clcf->aio == NGX_HTTP_AIO_THREADS) {
+        c->file.thread_handler = ngx_http_cache_thread_handler;
+        c->file.thread_ctx = r;
+
+        return ngx_thread_read(&c->file, c->buf->pos, c->body_start, 0,
+                               r->pool);
+    }
+
+#endif
+
+#if (NGX_HAVE_FILE_AIO)
+
     if (!ngx_file_aio) {
         goto noaio;
     }
 
-    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
-
-    if (!clcf->aio) {
+    if (clcf->aio != NGX_HTTP_AIO_ON && clcf->aio != NGX_HTTP_AIO_SENDFILE) {
         goto noaio;
     }
 
@@ -628,6 +715,48 @@ ngx_http_cache_aio_event_handler(ngx_event_t *ev)
 #endif
 
 
+#if (NGX_THREAD_POOL)
+
+static ngx_int_t
+ngx_http_cache_thread_handler(ngx_thread_task_t *task, ngx_file_t *file)
+{
+    ngx_http_request_t        *r;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    r = file->thread_ctx;
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+
+    task->event.data = r;
+    task->event.handler = ngx_http_cache_thread_event_handler;
+
+    if (ngx_thread_task_post(clcf->thread_pool, task) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    r->main->blocked++;
+    r->aio = 1;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_cache_thread_event_handler(ngx_event_t *ev)
+{
+    ngx_http_request_t  *r;
+
+    r = ev->data;
+
+    r->main->blocked--;
+    r->aio = 0;
+
+    r->connection->write->handler(r->connection->write);
+}
+
+#endif
+
+
 static ngx_int_t
 ngx_http_file_cache_exists(ngx_http_file_cache_t *cache, ngx_http_cache_t *c)
 {
@@ -882,6 +1011,7 @@ ngx_http_file_cache_set_header(ngx_http_request_t *r, u_char *buf)
     h->valid_msec = (u_short) c->valid_msec;
     h->header_start = (u_short) c->header_start;
     h->body_start = (u_short) c->body_start;
+    h->version = NGX_HTTP_CACHE_VERSION;
 
     p = buf + sizeof(ngx_http_file_cache_header_t);
 
@@ -1594,7 +1724,7 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     ngx_str_t               s, name, *value;
     ngx_int_t               loader_files;
     ngx_msec_t              loader_sleep, loader_threshold;
-    ngx_uint_t              i, n;
+    ngx_uint_t              i, n, flags, key_hash;
     ngx_http_file_cache_t  *cache;
 
     cache = ngx_pcalloc(cf->pool, sizeof(ngx_http_file_cache_t));
@@ -1614,6 +1744,8 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     name.len = 0;
     size = 0;
+    flags = 0;
+    key_hash = NGX_HTTP_CACHE_KEY_MD5;
     max_size = NGX_MAX_OFF_T_VALUE;
 
     value = cf->args->elts;
@@ -1766,6 +1898,41 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strncmp(value[i].data, "key_hash=", 9) == 0) {
+
+            s.len = value[i].len - 9;
+            s.data = value[i].data + 9;
+
+            if (ngx_strcmp(s.data, "md5") == 0) {
+                key_hash = NGX_HTTP_CACHE_KEY_MD5;
+                continue;
+            }
+
+            if (ngx_strcmp(s.data, "xxh128") == 0) {
+                key_hash = NGX_HTTP_CACHE_KEY_XXH128;
+                continue;
+            }
+
+            if (ngx_strcmp(s.data, "siphash") == 0) {
+                key_hash = NGX_HTTP_CACHE_KEY_SIPHASH;
+                continue;
+            }
+
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid key_hash value \"%V\"", &value[i]);
+            return NGX_CONF_ERROR;
+        }
+
+        if (ngx_strcmp(value[i].data, "hugepages") == 0) {
+            flags |= NGX_SHM_HUGEPAGES;
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "prefault") == 0) {
+            flags |= NGX_SHM_PREFAULT;
+            continue;
+        }
+
         ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
                            "invalid parameter \"%V\"", &value[i]);
         return NGX_CONF_ERROR;
@@ -1786,6 +1953,7 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     cache->loader_files = loader_files;
     cache->loader_sleep = loader_sleep;
     cache->loader_threshold = loader_threshold;
+    cache->key_hash = key_hash;
 
     if (ngx_add_path(cf, &cache->path) != NGX_OK) {
         return NGX_CONF_ERROR;
@@ -1805,6 +1973,7 @@ ngx_http_file_cache_set_slot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     cache->shm_zone->init = ngx_http_file_cache_init;
     cache->shm_zone->data = cache;
+    cache->shm_zone->shm.flags = flags;
 
     cache->inactive = inactive;
     cache->max_size = max_size;
@@ -33,6 +33,46 @@ static uint32_t  usual[] = {
 };
 
 
+#if (NGX_HAVE_SIMD)
+
+                /* not " ", CR, LF, "\0" */
+
+static uint32_t  value[] = {
+    0xffffdbfe, /* 1111 1111 1111 1111  1101 1011 1111 1110 */
+
+                /* ?>=< ;:98 7654 3210  /.-, +*)( '&%$ #"!  */
+    0xfffffffe, /* 1111 1111 1111 1111  1111 1111 1111 1110 */
+
+    0xffffffff, /* 1111 1111 1111 1111  1111 1111 1111 1111 */
+    0xffffffff, /* 1111 1111 1111 1111  1111 1111 1111 1111 */
+    0xffffffff, /* 1111 1111 1111 1111  1111 1111 1111 1111 */
+    0xffffffff, /* 1111 1111 1111 1111  1111 1111 1111 1111 */
+    0xffffffff, /* 1111 1111 1111 1111  1111 1111 1111 1111 */
+    0xffffffff  /* 1111 1111 1111 1111  1111 1111 1111 1111 */
+};
+
+
+static u_char  usual_lut[NGX_SIMD_LUT_SIZE];
+static u_char  value_lut[NGX_SIMD_LUT_SIZE];
+
+
+/*
+ * skips the run of characters after p that leave the state unchanged,
+ * so the state machine sees only the delimiters
+ */
+
+#define ngx_http_parse_skip(p, last, map)                                     \
+    if (last - p > 16) {                                                      \
+        p += ngx_strspn_simd(p + 1, last - p - 1, map, map##_lut);            \
+    }
+
+#else
+
+#define ngx_http_parse_skip(p, last, map)
+
+#endif
+
+
 #if (NGX_HAVE_LITTLE_ENDIAN && NGX_HAVE_NONALIGNED)
 
 #define ngx_str3_cmp(m, c0, c1, c2, c3)                                       \
@@ -538,6 +578,7 @@ ngx_http_parse_request_line(ngx_http_request_t *r, ngx_buf_t *b)
         case sw_check_uri:
 
             if (usual[ch >> 5] & (1 << (ch & 0x1f))) {
+                ngx_http_parse_skip(p, b->last, usual);
                 break;
             }
 
@@ -623,6 +664,7 @@ ngx_http_parse_request_line(ngx_http_request_t *r, ngx_buf_t *b)
         case sw_uri:
 
             if (usual[ch >> 5] & (1 << (ch & 0x1f))) {
+                ngx_http_parse_skip(p, b->last, usual);
                 break;
             }
 
@@ -900,6 +942,21 @@ ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b,
                 hash = ngx_hash(hash, c);
                 r->lowcase_header[i++] = c;
                 i &= (NGX_HTTP_LC_HEADER_LEN - 1);
+
+                while (p + 1 < b->last) {
+                    c = lowcase[p[1]];
+
+                    if (c == 0) {
+                        break;
+                    }
+
+                    p++;
+
+                    hash = ngx_hash(hash, c);
+                    r->lowcase_header[i++] = c;
+                    i &= (NGX_HTTP_LC_HEADER_LEN - 1);
+                }
+
                 break;
             }
 
@@ -974,6 +1031,7 @@ ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b,
             default:
                 r->header_start = p;
                 state = sw_value;
+                ngx_http_parse_skip(p, b->last, value);
                 break;
             }
             break;
@@ -994,6 +1052,9 @@ ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b,
                 goto done;
             case '\0':
                 return NGX_HTTP_PARSE_INVALID_HEADER;
+            default:
+                ngx_http_parse_skip(p, b->last, value);
+                break;
             }
             break;
 
@@ -1011,6 +1072,7 @@ ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b,
                 return NGX_HTTP_PARSE_INVALID_HEADER;
             default:
                 state = sw_value;
+                ngx_http_parse_skip(p, b->last, value);
                 break;
             }
             break;
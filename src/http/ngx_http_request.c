@@ -514,6 +514,7 @@ ngx_http_init_request(ngx_event_t *rev)
     (void) ngx_atomic_fetch_add(ngx_stat_reading, 1);
     r->stat_reading = 1;
     (void) ngx_atomic_fetch_add(ngx_stat_requests, 1);
+    ngx_stat_worker->requests++;
 #endif
 
     rev->handler(rev);
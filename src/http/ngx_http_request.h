@@ -409,6 +409,8 @@ struct ngx_http_request_s {
     ngx_http_handler_pt               content_handler;
     ngx_uint_t                        access_code;
 
+    ngx_http_phase_timing_t          *phase_timing;
+
     ngx_http_variable_value_t        *variables;
 
 #if (NGX_PCRE)
@@ -70,6 +70,8 @@ static void ngx_http_upstream_next(ngx_http_request_t *r,
 static void ngx_http_upstream_cleanup(void *data);
 static void ngx_http_upstream_finalize_request(ngx_http_request_t *r,
     ngx_http_upstream_t *u, ngx_int_t rc);
+static void ngx_http_upstream_peer_stat_done(ngx_http_upstream_t *u,
+    ngx_uint_t state);
 
 static ngx_int_t ngx_http_upstream_process_header_line(ngx_http_request_t *r,
     ngx_table_elt_t *h, ngx_uint_t offset);
@@ -136,6 +138,7 @@ static char *ngx_http_upstream_server(ngx_conf_t *cf, ngx_command_t *cmd,
 
 static void *ngx_http_upstream_create_main_conf(ngx_conf_t *cf);
 static char *ngx_http_upstream_init_main_conf(ngx_conf_t *cf, void *conf);
+static ngx_int_t ngx_http_upstream_init_process(ngx_cycle_t *cycle);
 
 #if (NGX_HTTP_SSL)
 static void ngx_http_upstream_ssl_init_connection(ngx_http_request_t *,
@@ -312,7 +315,7 @@ ngx_module_t  ngx_http_upstream_module = {
     NGX_HTTP_MODULE,                       /* module type */
     NULL,                                  /* init master */
     NULL,                                  /* init module */
-    NULL,                                  /* init process */
+    ngx_http_upstream_init_process,        /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
     NULL,                                  /* exit process */
@@ -670,13 +673,17 @@ ngx_http_upstream_cache(ngx_http_request_t *r, ngx_http_upstream_t *u)
             return NGX_ERROR;
         }
 
+        r->cache->file_cache = u->conf->cache->data;
+
         if (u->create_key(r) != NGX_OK) {
             return NGX_ERROR;
         }
 
         /* TODO: add keys */
 
-        ngx_http_file_cache_create_key(r);
+        if (ngx_http_file_cache_create_key(r) != NGX_OK) {
+            return NGX_ERROR;
+        }
 
         if (r->cache->header_start + 256 >= u->conf->buffer_size) {
             ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
@@ -708,7 +715,6 @@ ngx_http_upstream_cache(ngx_http_request_t *r, ngx_http_upstream_t *u)
 
         c->min_uses = u->conf->cache_min_uses;
         c->body_start = u->conf->buffer_size;
-        c->file_cache = u->conf->cache->data;
 
         c->lock = u->conf->cache_lock;
         c->lock_timeout = u->conf->cache_lock_timeout;
@@ -1118,12 +1124,15 @@ ngx_http_upstream_connect(ngx_http_request_t *r, ngx_http_upstream_t *u)
     u->state->response_sec = tp->sec;
     u->state->response_msec = tp->msec;
 
+    u->peer.stat = NULL;
+
     rc = ngx_event_connect_peer(&u->peer);
 
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                    "http upstream connect: %i", rc);
 
     if (rc == NGX_ERROR) {
+        u->peer.stat = NULL;
         ngx_http_upstream_finalize_request(r, u,
                                            NGX_HTTP_INTERNAL_SERVER_ERROR);
         return;
@@ -1137,6 +1146,15 @@ ngx_http_upstream_connect(ngx_http_request_t *r, ngx_http_upstream_t *u)
         return;
     }
 
+    if (u->peer.stat) {
+        (void) ngx_atomic_fetch_add(&u->peer.stat->requests, 1);
+        (void) ngx_atomic_fetch_add(&u->peer.stat->active, 1);
+
+        u->peer_start = ngx_monotonic_usec();
+        u->peer_sent = u->peer.connection ? u->peer.connection->sent : 0;
+        u->peer_connected = u->peer.cached;
+    }
+
     if (rc == NGX_DECLINED) {
         ngx_http_upstream_next(r, u, NGX_HTTP_UPSTREAM_FT_ERROR);
         return;
@@ -1389,6 +1407,12 @@ ngx_http_upstream_send_request(ngx_http_request_t *r, ngx_http_upstream_t *u)
         return;
     }
 
+    if (u->peer.stat && !u->peer_connected) {
+        u->peer_connected = 1;
+        ngx_peer_stat_ewma(&u->peer.stat->connect_time,
+                           ngx_monotonic_usec() - u->peer_start);
+    }
+
     c->log->action = "sending request to upstream";
 
     rc = ngx_output_chain(&u->output, u->request_sent ? NULL : u->request_bufs);
@@ -1621,6 +1645,11 @@ ngx_http_upstream_process_header(ngx_http_request_t *r, ngx_http_upstream_t *u)
 
     /* rc == NGX_OK */
 
+    if (u->peer.stat) {
+        ngx_peer_stat_ewma(&u->peer.stat->header_time,
+                           ngx_monotonic_usec() - u->peer_start);
+    }
+
     if (u->headers_in.status_n > NGX_HTTP_SPECIAL_RESPONSE) {
 
         if (r->subrequest_in_memory) {
@@ -2838,8 +2867,10 @@ ngx_http_upstream_next(ngx_http_request_t *r, ngx_http_upstream_t *u,
         state = NGX_PEER_FAILED;
     }
 
-    if (ft_type != NGX_HTTP_UPSTREAM_FT_NOLIVE) {
+    if (u->peer.sockaddr) {
+        ngx_http_upstream_peer_stat_done(u, state);
         u->peer.free(&u->peer, u->peer.data, state);
+        u->peer.sockaddr = NULL;
     }
 
     if (ft_type == NGX_HTTP_UPSTREAM_FT_TIMEOUT) {
@@ -2999,8 +3030,11 @@ ngx_http_upstream_finalize_request(ngx_http_request_t *r,
 
     u->finalize_request(r, rc);
 
-    if (u->peer.free) {
+    ngx_http_upstream_peer_stat_done(u, 0);
+
+    if (u->peer.free && u->peer.sockaddr) {
         u->peer.free(&u->peer, u->peer.data, 0);
+        u->peer.sockaddr = NULL;
     }
 
     if (u->peer.connection) {
@@ -3103,6 +3137,54 @@ ngx_http_upstream_finalize_request(ngx_http_request_t *r,
 }
 
 
+static void
+ngx_http_upstream_peer_stat_done(ngx_http_upstream_t *u, ngx_uint_t state)
+{
+    off_t             received;
+    ngx_uint_t        status;
+    ngx_peer_stat_t  *stat;
+
+    stat = u->peer.stat;
+
+    if (stat == NULL) {
+        return;
+    }
+
+    /* a try is accounted once, either by the next upstream or on finalizing */
+
+    u->peer.stat = NULL;
+
+    (void) ngx_atomic_fetch_add(&stat->active, -1);
+
+    if (state & NGX_PEER_FAILED) {
+        (void) ngx_atomic_fetch_add(&stat->fails, 1);
+    }
+
+    status = u->headers_in.status_n;
+
+    if (status >= 100 && status < 600) {
+        (void) ngx_atomic_fetch_add(&stat->responses[status / 100 - 1], 1);
+
+        ngx_peer_stat_ewma(&stat->response_time,
+                           ngx_monotonic_usec() - u->peer_start);
+    }
+
+    if (u->peer.connection) {
+        (void) ngx_atomic_fetch_add(&stat->sent,
+                                    u->peer.connection->sent - u->peer_sent);
+    }
+
+    if (u->buffering && u->pipe) {
+        received = u->pipe->read_length;
+
+    } else {
+        received = u->state ? u->state->response_length : 0;
+    }
+
+    (void) ngx_atomic_fetch_add(&stat->received, received);
+}
+
+
 static ngx_int_t
 ngx_http_upstream_process_header_line(ngx_http_request_t *r, ngx_table_elt_t *h,
     ngx_uint_t offset)
@@ -4321,6 +4403,26 @@ ngx_http_upstream_server(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strcmp(value[i].data, "resolve") == 0) {
+
+            /* the addresses of a name are refreshed by the workers */
+
+            if (u.family != AF_INET
+                || ngx_inet_addr(u.host.data, u.host.len) != INADDR_NONE)
+            {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "\"resolve\" requires a domain name "
+                                   "in \"%V\"", &u.url);
+                return NGX_CONF_ERROR;
+            }
+
+            us->host = u.host;
+            us->port = u.port;
+            us->resolve = 1;
+
+            continue;
+        }
+
         goto invalid;
     }
 
@@ -4728,3 +4830,36 @@ ngx_http_upstream_init_main_conf(ngx_conf_t *cf, void *conf)
 
     return NGX_CONF_OK;
 }
+
+
+static ngx_int_t
+ngx_http_upstream_init_process(ngx_cycle_t *cycle)
+{
+    ngx_uint_t                      i;
+    ngx_http_upstream_srv_conf_t  **uscfp;
+    ngx_http_upstream_main_conf_t  *umcf;
+
+    if (ngx_process != NGX_PROCESS_WORKER
+        && ngx_process != NGX_PROCESS_SINGLE)
+    {
+        return NGX_OK;
+    }
+
+    umcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_upstream_module);
+
+    if (umcf == NULL) {
+        return NGX_OK;
+    }
+
+    /* the workers resolve the names of the servers on their own */
+
+    uscfp = umcf->upstreams.elts;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+        if (ngx_http_upstream_resolve_round_robin(cycle, uscfp[i]) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
@@ -91,8 +91,12 @@ typedef struct {
     ngx_uint_t                       max_fails;
     time_t                           fail_timeout;
 
+    ngx_str_t                        host;
+    in_port_t                        port;
+
     unsigned                         down:1;
     unsigned                         backup:1;
+    unsigned                         resolve:1;
 } ngx_http_upstream_server_t;
 
 
@@ -116,6 +120,13 @@ struct ngx_http_upstream_srv_conf_s {
     ngx_uint_t                       line;
     in_port_t                        port;
     in_port_t                        default_port;
+
+    ngx_resolver_t                  *resolver;
+    ngx_msec_t                       resolver_timeout;
+
+#if (NGX_HTTP_UPSTREAM_ZONE)
+    ngx_shm_zone_t                  *shm_zone;
+#endif
 };
 
 
@@ -306,6 +317,9 @@ struct ngx_http_upstream_s {
 
     ngx_http_upstream_state_t       *state;
 
+    uint64_t                         peer_start;
+    off_t                            peer_sent;
+
     ngx_str_t                        method;
     ngx_str_t                        schema;
     ngx_str_t                        uri;
@@ -325,6 +339,7 @@ struct ngx_http_upstream_s {
 
     unsigned                         request_sent:1;
     unsigned                         header_sent:1;
+    unsigned                         peer_connected:1;
 };
 
 
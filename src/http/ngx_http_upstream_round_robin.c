@@ -10,8 +10,31 @@
 #include <ngx_http.h>
 
 
+#define NGX_HTTP_UPSTREAM_RESOLVE_RETRY  10
+
+
+typedef struct {
+    ngx_event_t                     event;
+    ngx_http_upstream_srv_conf_t   *upstream;
+    ngx_http_upstream_server_t     *server;
+    ngx_pool_t                     *pool;     /* of the resolved addresses */
+    time_t                          valid;
+    ngx_uint_t                      resolving;  /* unsigned  resolving:1; */
+} ngx_http_upstream_rr_host_t;
+
+
+static ngx_int_t ngx_http_upstream_create_rr_peers(ngx_pool_t *pool,
+    ngx_http_upstream_srv_conf_t *us, ngx_uint_t backup,
+    ngx_http_upstream_rr_peers_t **peersp);
 static ngx_int_t ngx_http_upstream_cmp_servers(const void *one,
     const void *two);
+static void ngx_http_upstream_rr_peers_release(void *data);
+static void ngx_http_upstream_rr_resolve_timer(ngx_event_t *ev);
+static void ngx_http_upstream_rr_resolve_handler(ngx_resolver_ctx_t *ctx);
+static ngx_int_t ngx_http_upstream_rr_update_peers(
+    ngx_http_upstream_srv_conf_t *us, ngx_log_t *log);
+static ngx_int_t ngx_http_upstream_rr_copy_peers(ngx_pool_t *pool,
+    ngx_http_upstream_rr_peers_t *peers, ngx_http_upstream_rr_peers_t *old);
 static ngx_http_upstream_rr_peer_t *ngx_http_upstream_get_peer(
     ngx_http_upstream_rr_peer_data_t *rrp);
 
@@ -30,130 +53,88 @@ ngx_http_upstream_init_round_robin(ngx_conf_t *cf,
     ngx_http_upstream_srv_conf_t *us)
 {
     ngx_url_t                      u;
-    ngx_uint_t                     i, j, n, w;
+    ngx_uint_t                     i, n;
+    ngx_http_core_loc_conf_t      *clcf;
     ngx_http_upstream_server_t    *server;
     ngx_http_upstream_rr_peers_t  *peers, *backup;
 
     us->peer.init = ngx_http_upstream_init_round_robin_peer;
 
     if (us->servers) {
-        server = us->servers->elts;
-
-        n = 0;
-        w = 0;
-
-        for (i = 0; i < us->servers->nelts; i++) {
-            if (server[i].backup) {
-                continue;
-            }
 
-            n += server[i].naddrs;
-            w += server[i].naddrs * server[i].weight;
+        if (ngx_http_upstream_create_rr_peers(cf->pool, us, 0, &peers)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
         }
 
-        if (n == 0) {
+        if (peers == NULL) {
             ngx_log_error(NGX_LOG_EMERG, cf->log, 0,
                           "no servers in upstream \"%V\" in %s:%ui",
                           &us->host, us->file_name, us->line);
             return NGX_ERROR;
         }
 
-        peers = ngx_pcalloc(cf->pool, sizeof(ngx_http_upstream_rr_peers_t)
-                              + sizeof(ngx_http_upstream_rr_peer_t) * (n - 1));
-        if (peers == NULL) {
-            return NGX_ERROR;
-        }
-
-        peers->single = (n == 1);
-        peers->number = n;
-        peers->weighted = (w != n);
-        peers->total_weight = w;
-        peers->name = &us->host;
-
-        n = 0;
+        us->peer.data = peers;
 
-        for (i = 0; i < us->servers->nelts; i++) {
-            for (j = 0; j < server[i].naddrs; j++) {
-                if (server[i].backup) {
-                    continue;
-                }
+        /* backup servers */
 
-                peers->peer[n].sockaddr = server[i].addrs[j].sockaddr;
-                peers->peer[n].socklen = server[i].addrs[j].socklen;
-                peers->peer[n].name = server[i].addrs[j].name;
-                peers->peer[n].max_fails = server[i].max_fails;
-                peers->peer[n].fail_timeout = server[i].fail_timeout;
-                peers->peer[n].down = server[i].down;
-                peers->peer[n].weight = server[i].weight;
-                peers->peer[n].effective_weight = server[i].weight;
-                peers->peer[n].current_weight = 0;
-                n++;
-            }
+        if (ngx_http_upstream_create_rr_peers(cf->pool, us, 1, &backup)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
         }
 
-        us->peer.data = peers;
-
-        ngx_sort(&peers->peer[0], (size_t) n,
-                 sizeof(ngx_http_upstream_rr_peer_t),
-                 ngx_http_upstream_cmp_servers);
-
-        /* backup servers */
+        if (backup) {
+            peers->single = 0;
+            peers->next = backup;
+        }
 
-        n = 0;
-        w = 0;
+        server = us->servers->elts;
 
         for (i = 0; i < us->servers->nelts; i++) {
-            if (!server[i].backup) {
-                continue;
+            if (server[i].resolve) {
+                break;
             }
-
-            n += server[i].naddrs;
-            w += server[i].naddrs * server[i].weight;
         }
 
-        if (n == 0) {
+        if (i == us->servers->nelts) {
             return NGX_OK;
         }
 
-        backup = ngx_pcalloc(cf->pool, sizeof(ngx_http_upstream_rr_peers_t)
-                              + sizeof(ngx_http_upstream_rr_peer_t) * (n - 1));
-        if (backup == NULL) {
+#if (NGX_HTTP_UPSTREAM_ZONE)
+
+        if (us->shm_zone) {
+            ngx_log_error(NGX_LOG_EMERG, cf->log, 0,
+                          "\"resolve\" cannot be used with \"zone\" "
+                          "in upstream \"%V\" in %s:%ui",
+                          &us->host, us->file_name, us->line);
             return NGX_ERROR;
         }
 
-        peers->single = 0;
-        backup->single = 0;
-        backup->number = n;
-        backup->weighted = (w != n);
-        backup->total_weight = w;
-        backup->name = &us->host;
+#endif
 
-        n = 0;
+        /* a dummy resolver without addresses is created in http {} */
 
-        for (i = 0; i < us->servers->nelts; i++) {
-            for (j = 0; j < server[i].naddrs; j++) {
-                if (!server[i].backup) {
-                    continue;
-                }
+        clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
 
-                backup->peer[n].sockaddr = server[i].addrs[j].sockaddr;
-                backup->peer[n].socklen = server[i].addrs[j].socklen;
-                backup->peer[n].name = server[i].addrs[j].name;
-                backup->peer[n].weight = server[i].weight;
-                backup->peer[n].effective_weight = server[i].weight;
-                backup->peer[n].current_weight = 0;
-                backup->peer[n].max_fails = server[i].max_fails;
-                backup->peer[n].fail_timeout = server[i].fail_timeout;
-                backup->peer[n].down = server[i].down;
-                n++;
-            }
+        if (clcf->resolver == NULL
+            || clcf->resolver->udp_connections.nelts == 0)
+        {
+            ngx_log_error(NGX_LOG_EMERG, cf->log, 0,
+                          "no resolver defined to resolve \"%V\" "
+                          "in upstream \"%V\" in %s:%ui",
+                          &server[i].host, &us->host, us->file_name,
+                          us->line);
+            return NGX_ERROR;
         }
 
-        peers->next = backup;
+        us->resolver = clcf->resolver;
+        us->resolver_timeout = clcf->resolver_timeout;
 
-        ngx_sort(&backup->peer[0], (size_t) n,
-                 sizeof(ngx_http_upstream_rr_peer_t),
-                 ngx_http_upstream_cmp_servers);
+        if (us->resolver_timeout == NGX_CONF_UNSET_MSEC) {
+            us->resolver_timeout = 30000;
+        }
 
         return NGX_OK;
     }
@@ -216,6 +197,78 @@ ngx_http_upstream_init_round_robin(ngx_conf_t *cf,
 }
 
 
+static ngx_int_t
+ngx_http_upstream_create_rr_peers(ngx_pool_t *pool,
+    ngx_http_upstream_srv_conf_t *us, ngx_uint_t backup,
+    ngx_http_upstream_rr_peers_t **peersp)
+{
+    ngx_uint_t                     i, j, n, w;
+    ngx_http_upstream_server_t    *server;
+    ngx_http_upstream_rr_peers_t  *peers;
+
+    *peersp = NULL;
+
+    server = us->servers->elts;
+
+    n = 0;
+    w = 0;
+
+    for (i = 0; i < us->servers->nelts; i++) {
+        if (server[i].backup != backup) {
+            continue;
+        }
+
+        n += server[i].naddrs;
+        w += server[i].naddrs * server[i].weight;
+    }
+
+    if (n == 0) {
+        return NGX_OK;
+    }
+
+    peers = ngx_pcalloc(pool, sizeof(ngx_http_upstream_rr_peers_t)
+                              + sizeof(ngx_http_upstream_rr_peer_t) * (n - 1));
+    if (peers == NULL) {
+        return NGX_ERROR;
+    }
+
+    peers->single = (n == 1);
+    peers->number = n;
+    peers->weighted = (w != n);
+    peers->total_weight = w;
+    peers->name = &us->host;
+
+    n = 0;
+
+    for (i = 0; i < us->servers->nelts; i++) {
+        if (server[i].backup != backup) {
+            continue;
+        }
+
+        for (j = 0; j < server[i].naddrs; j++) {
+            peers->peer[n].sockaddr = server[i].addrs[j].sockaddr;
+            peers->peer[n].socklen = server[i].addrs[j].socklen;
+            peers->peer[n].name = server[i].addrs[j].name;
+            peers->peer[n].max_fails = server[i].max_fails;
+            peers->peer[n].fail_timeout = server[i].fail_timeout;
+            peers->peer[n].down = server[i].down;
+            peers->peer[n].weight = server[i].weight;
+            peers->peer[n].effective_weight = server[i].weight;
+            peers->peer[n].current_weight = 0;
+            n++;
+        }
+    }
+
+    ngx_sort(&peers->peer[0], (size_t) n,
+             sizeof(ngx_http_upstream_rr_peer_t),
+             ngx_http_upstream_cmp_servers);
+
+    *peersp = peers;
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_upstream_cmp_servers(const void *one, const void *two)
 {
@@ -233,6 +286,7 @@ ngx_http_upstream_init_round_robin_peer(ngx_http_request_t *r,
     ngx_http_upstream_srv_conf_t *us)
 {
     ngx_uint_t                         n;
+    ngx_pool_cleanup_t                *cln;
     ngx_http_upstream_rr_peer_data_t  *rrp;
 
     rrp = r->upstream->peer.data;
@@ -249,6 +303,21 @@ ngx_http_upstream_init_round_robin_peer(ngx_http_request_t *r,
     rrp->peers = us->peer.data;
     rrp->current = 0;
 
+    if (rrp->peers->pool) {
+
+        /* the set may be replaced while the request uses it */
+
+        cln = ngx_pool_cleanup_add(r->pool, 0);
+        if (cln == NULL) {
+            return NGX_ERROR;
+        }
+
+        cln->handler = ngx_http_upstream_rr_peers_release;
+        cln->data = rrp->peers;
+
+        rrp->peers->refs++;
+    }
+
     n = rrp->peers->number;
 
     if (rrp->peers->next && rrp->peers->next->number > n) {
@@ -282,6 +351,351 @@ ngx_http_upstream_init_round_robin_peer(ngx_http_request_t *r,
 }
 
 
+static void
+ngx_http_upstream_rr_peers_release(void *data)
+{
+    ngx_http_upstream_rr_peers_t  *peers = data;
+
+    if (--peers->refs == 0 && peers->stale) {
+        ngx_destroy_pool(peers->pool);
+    }
+}
+
+
+ngx_int_t
+ngx_http_upstream_resolve_round_robin(ngx_cycle_t *cycle,
+    ngx_http_upstream_srv_conf_t *us)
+{
+    ngx_uint_t                    i;
+    ngx_http_upstream_rr_host_t  *host;
+    ngx_http_upstream_server_t   *server;
+
+    if (us->resolver == NULL) {
+        return NGX_OK;
+    }
+
+    server = us->servers->elts;
+
+    for (i = 0; i < us->servers->nelts; i++) {
+
+        if (!server[i].resolve) {
+            continue;
+        }
+
+        host = ngx_pcalloc(cycle->pool, sizeof(ngx_http_upstream_rr_host_t));
+        if (host == NULL) {
+            return NGX_ERROR;
+        }
+
+        host->upstream = us;
+        host->server = &server[i];
+
+        host->event.handler = ngx_http_upstream_rr_resolve_timer;
+        host->event.data = host;
+        host->event.log = cycle->log;
+
+        /* the first answer brings the time to live of the addresses */
+
+        ngx_add_timer(&host->event, 1);
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_upstream_rr_resolve_timer(ngx_event_t *ev)
+{
+    ngx_resolver_ctx_t            *ctx, temp;
+    ngx_http_upstream_rr_host_t   *host;
+    ngx_http_upstream_srv_conf_t  *us;
+
+    host = ev->data;
+    us = host->upstream;
+
+    /*
+     * the timer is short, as a pending timer does not let
+     * a worker exit gracefully
+     */
+
+    if (ngx_exiting) {
+        return;
+    }
+
+    ngx_add_timer(ev, 1000);
+
+    if (host->resolving || ngx_time() < host->valid) {
+        return;
+    }
+
+    host->valid = ngx_time() + NGX_HTTP_UPSTREAM_RESOLVE_RETRY;
+
+    temp.name = host->server->host;
+
+    ctx = ngx_resolve_start(us->resolver, &temp);
+    if (ctx == NULL || ctx == NGX_NO_RESOLVER) {
+        return;
+    }
+
+    ctx->name = host->server->host;
+    ctx->type = NGX_RESOLVE_A;
+    ctx->handler = ngx_http_upstream_rr_resolve_handler;
+    ctx->data = host;
+    ctx->timeout = us->resolver_timeout;
+
+    host->resolving = 1;
+
+    if (ngx_resolve_name(ctx) != NGX_OK) {
+        host->resolving = 0;
+    }
+}
+
+
+static void
+ngx_http_upstream_rr_resolve_handler(ngx_resolver_ctx_t *ctx)
+{
+    u_char                        *p;
+    size_t                         len;
+    ngx_uint_t                     i, j;
+    ngx_addr_t                    *addrs;
+    ngx_pool_t                    *pool;
+    struct sockaddr_in            *sin;
+    ngx_http_upstream_rr_host_t   *host;
+    ngx_http_upstream_server_t    *server, old;
+
+    host = ctx->data;
+    server = host->server;
+
+    host->resolving = 0;
+
+    if (ctx->state || ctx->naddrs == 0) {
+        ngx_log_error(NGX_LOG_ERR, host->event.log, 0,
+                      "%V could not be resolved (%i: %s) in upstream \"%V\"",
+                      &ctx->name, ctx->state,
+                      ngx_resolver_strerror(ctx->state),
+                      &host->upstream->host);
+        goto done;
+    }
+
+    host->valid = ngx_max(ctx->valid, ngx_time() + 1);
+
+    if (ctx->naddrs == server->naddrs) {
+
+        for (i = 0; i < ctx->naddrs; i++) {
+            for (j = 0; j < server->naddrs; j++) {
+                sin = (struct sockaddr_in *) server->addrs[j].sockaddr;
+
+                if (sin->sin_addr.s_addr == ctx->addrs[i]) {
+                    break;
+                }
+            }
+
+            if (j == server->naddrs) {
+                break;
+            }
+        }
+
+        if (i == ctx->naddrs) {
+            goto done;
+        }
+    }
+
+    pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, host->event.log);
+    if (pool == NULL) {
+        goto done;
+    }
+
+    addrs = ngx_pcalloc(pool, ctx->naddrs * sizeof(ngx_addr_t));
+    if (addrs == NULL) {
+        goto failed;
+    }
+
+    for (i = 0; i < ctx->naddrs; i++) {
+
+        len = NGX_INET_ADDRSTRLEN + sizeof(":65536") - 1;
+
+        p = ngx_pnalloc(pool, len);
+        if (p == NULL) {
+            goto failed;
+        }
+
+        len = ngx_inet_ntop(AF_INET, &ctx->addrs[i], p, NGX_INET_ADDRSTRLEN);
+        len = ngx_sprintf(&p[len], ":%d", server->port) - p;
+
+        sin = ngx_pcalloc(pool, sizeof(struct sockaddr_in));
+        if (sin == NULL) {
+            goto failed;
+        }
+
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(server->port);
+        sin->sin_addr.s_addr = ctx->addrs[i];
+
+        addrs[i].sockaddr = (struct sockaddr *) sin;
+        addrs[i].socklen = sizeof(struct sockaddr_in);
+        addrs[i].name.len = len;
+        addrs[i].name.data = p;
+    }
+
+    ngx_log_error(NGX_LOG_NOTICE, host->event.log, 0,
+                  "%V was resolved to %ui address(es) in upstream \"%V\"",
+                  &ctx->name, ctx->naddrs, &host->upstream->host);
+
+    old = *server;
+
+    server->addrs = addrs;
+    server->naddrs = ctx->naddrs;
+
+    if (ngx_http_upstream_rr_update_peers(host->upstream, host->event.log)
+        != NGX_OK)
+    {
+        *server = old;
+        goto failed;
+    }
+
+    /* the peers keep copies of the addresses */
+
+    if (host->pool) {
+        ngx_destroy_pool(host->pool);
+    }
+
+    host->pool = pool;
+
+    goto done;
+
+failed:
+
+    ngx_destroy_pool(pool);
+
+done:
+
+    ngx_resolve_name_done(ctx);
+}
+
+
+static ngx_int_t
+ngx_http_upstream_rr_update_peers(ngx_http_upstream_srv_conf_t *us,
+    ngx_log_t *log)
+{
+    ngx_pool_t                    *pool;
+    ngx_http_upstream_rr_peers_t  *peers, *backup, *old;
+
+    pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, log);
+    if (pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (ngx_http_upstream_create_rr_peers(pool, us, 0, &peers) != NGX_OK
+        || ngx_http_upstream_create_rr_peers(pool, us, 1, &backup) != NGX_OK)
+    {
+        goto failed;
+    }
+
+    old = us->peer.data;
+
+    if (ngx_http_upstream_rr_copy_peers(pool, peers, old) != NGX_OK) {
+        goto failed;
+    }
+
+    if (backup) {
+        if (ngx_http_upstream_rr_copy_peers(pool, backup, old->next)
+            != NGX_OK)
+        {
+            goto failed;
+        }
+
+        peers->single = 0;
+        peers->next = backup;
+    }
+
+    /* the new requests use the new set, the old one is freed when unused */
+
+    peers->pool = pool;
+    us->peer.data = peers;
+
+    if (old->pool) {
+        old->stale = 1;
+
+        if (old->refs == 0) {
+            ngx_destroy_pool(old->pool);
+        }
+    }
+
+    return NGX_OK;
+
+failed:
+
+    ngx_destroy_pool(pool);
+
+    return NGX_ERROR;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_rr_copy_peers(ngx_pool_t *pool,
+    ngx_http_upstream_rr_peers_t *peers, ngx_http_upstream_rr_peers_t *old)
+{
+    u_char                       *name;
+    ngx_uint_t                    i, j;
+    struct sockaddr              *sockaddr;
+    ngx_http_upstream_rr_peer_t  *peer, *prev;
+
+    for (i = 0; i < peers->number; i++) {
+        peer = &peers->peer[i];
+
+        sockaddr = ngx_palloc(pool, peer->socklen);
+        if (sockaddr == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_memcpy(sockaddr, peer->sockaddr, peer->socklen);
+        peer->sockaddr = sockaddr;
+
+        name = ngx_pnalloc(pool, peer->name.len);
+        if (name == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_memcpy(name, peer->name.data, peer->name.len);
+        peer->name.data = name;
+
+        if (old == NULL) {
+            continue;
+        }
+
+        /*
+         * the state of an address that is still resolved is kept,
+         * except for the connections counted in the old set
+         */
+
+        for (j = 0; j < old->number; j++) {
+            prev = &old->peer[j];
+
+            if (prev->name.len != peer->name.len
+                || ngx_strncmp(prev->name.data, peer->name.data,
+                               peer->name.len)
+                   != 0)
+            {
+                continue;
+            }
+
+            peer->current_weight = prev->current_weight;
+            peer->effective_weight = prev->effective_weight;
+            peer->fails = prev->fails;
+            peer->accessed = prev->accessed;
+            peer->checked = prev->checked;
+            peer->latency = prev->latency;
+            peer->latency_stamp = prev->latency_stamp;
+            peer->stat = prev->stat;
+
+            break;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
 ngx_int_t
 ngx_http_upstream_create_round_robin_peer(ngx_http_request_t *r,
     ngx_http_upstream_resolved_t *ur)
@@ -402,8 +816,6 @@ ngx_http_upstream_get_round_robin_peer(ngx_peer_connection_t *pc, void *data)
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, pc->log, 0,
                    "get rr peer, try: %ui", pc->tries);
 
-    /* ngx_lock_mutex(rrp->peers->mutex); */
-
     if (rrp->peers->last_cached) {
 
         /* cached connection */
@@ -411,8 +823,6 @@ ngx_http_upstream_get_round_robin_peer(ngx_peer_connection_t *pc, void *data)
         c = rrp->peers->cached[rrp->peers->last_cached];
         rrp->peers->last_cached--;
 
-        /* ngx_unlock_mutex(ppr->peers->mutex); */
-
 #if (NGX_THREADS)
         c->read->lock = c->read->own_lock;
         c->write->lock = c->write->own_lock;
@@ -427,13 +837,19 @@ ngx_http_upstream_get_round_robin_peer(ngx_peer_connection_t *pc, void *data)
     pc->cached = 0;
     pc->connection = NULL;
 
-    if (rrp->peers->single) {
-        peer = &rrp->peers->peer[0];
+    peers = rrp->peers;
+
+    ngx_http_upstream_rr_peers_wlock(peers);
+
+    if (peers->single) {
+        peer = &peers->peer[0];
 
-        if (peer->down) {
+        if (peer->down || peer->unhealthy) {
             goto failed;
         }
 
+        rrp->current = 0;
+
     } else {
 
         /* there are several peers */
@@ -452,22 +868,23 @@ ngx_http_upstream_get_round_robin_peer(ngx_peer_connection_t *pc, void *data)
     pc->sockaddr = peer->sockaddr;
     pc->socklen = peer->socklen;
     pc->name = &peer->name;
+    pc->stat = peer->stat;
 
-    /* ngx_unlock_mutex(rrp->peers->mutex); */
+    peer->conns++;
 
-    if (pc->tries == 1 && rrp->peers->next) {
-        pc->tries += rrp->peers->next->number;
+    ngx_http_upstream_rr_peers_unlock(peers);
+
+    if (pc->tries == 1 && peers->next) {
+        pc->tries += peers->next->number;
     }
 
     return NGX_OK;
 
 failed:
 
-    peers = rrp->peers;
-
     if (peers->next) {
 
-        /* ngx_unlock_mutex(peers->mutex); */
+        ngx_http_upstream_rr_peers_unlock(peers);
 
         ngx_log_debug0(NGX_LOG_DEBUG_HTTP, pc->log, 0, "backup servers");
 
@@ -485,7 +902,7 @@ failed:
             return rc;
         }
 
-        /* ngx_lock_mutex(peers->mutex); */
+        ngx_http_upstream_rr_peers_wlock(peers);
     }
 
     /* all peers failed, mark them as live for quick recovery */
@@ -494,7 +911,7 @@ failed:
         peers->peer[i].fails = 0;
     }
 
-    /* ngx_unlock_mutex(peers->mutex); */
+    ngx_http_upstream_rr_peers_unlock(peers);
 
     pc->name = peers->name;
 
@@ -527,7 +944,7 @@ ngx_http_upstream_get_peer(ngx_http_upstream_rr_peer_data_t *rrp)
 
         peer = &rrp->peers->peer[i];
 
-        if (peer->down) {
+        if (peer->down || peer->unhealthy) {
             continue;
         }
 
@@ -576,36 +993,50 @@ ngx_http_upstream_free_round_robin_peer(ngx_peer_connection_t *pc, void *data,
 {
     ngx_http_upstream_rr_peer_data_t  *rrp = data;
 
-    time_t                       now;
-    ngx_http_upstream_rr_peer_t  *peer;
+    time_t                         now;
+    ngx_http_upstream_rr_peer_t   *peer;
+    ngx_http_upstream_rr_peers_t  *peers;
 
     ngx_log_debug2(NGX_LOG_DEBUG_HTTP, pc->log, 0,
                    "free rr peer %ui %ui", pc->tries, state);
 
-    if (state == 0 && pc->tries == 0) {
-        return;
-    }
-
     /* TODO: NGX_PEER_KEEPALIVE */
 
-    if (rrp->peers->single) {
+    peers = rrp->peers;
+    peer = &peers->peer[rrp->current];
+
+    ngx_http_upstream_rr_peers_rlock(peers);
+    ngx_http_upstream_rr_peer_lock(peers, peer);
+
+    if (peers->single) {
+
+        peer->conns--;
+
+        ngx_http_upstream_rr_peer_unlock(peers, peer);
+        ngx_http_upstream_rr_peers_unlock(peers);
+
         pc->tries = 0;
         return;
     }
 
-    peer = &rrp->peers->peer[rrp->current];
-
     if (state & NGX_PEER_FAILED) {
         now = ngx_time();
 
-        /* ngx_lock_mutex(rrp->peers->mutex); */
-
         peer->fails++;
         peer->accessed = now;
         peer->checked = now;
 
         if (peer->max_fails) {
             peer->effective_weight -= peer->weight / peer->max_fails;
+
+            if (peer->stat && peer->fails >= peer->max_fails) {
+
+                if (peer->stat->unavail_until < (ngx_atomic_uint_t) now) {
+                    (void) ngx_atomic_fetch_add(&peer->stat->unavail, 1);
+                }
+
+                peer->stat->unavail_until = now + peer->fail_timeout;
+            }
         }
 
         ngx_log_debug2(NGX_LOG_DEBUG_HTTP, pc->log, 0,
@@ -616,22 +1047,27 @@ ngx_http_upstream_free_round_robin_peer(ngx_peer_connection_t *pc, void *data,
             peer->effective_weight = 0;
         }
 
-        /* ngx_unlock_mutex(rrp->peers->mutex); */
-
     } else {
 
         /* mark peer live if check passed */
 
         if (peer->accessed < peer->checked) {
             peer->fails = 0;
+
+            if (peer->stat && peer->stat->unavail_until) {
+                peer->stat->unavail_until = 0;
+            }
         }
     }
 
+    peer->conns--;
+
+    ngx_http_upstream_rr_peer_unlock(peers, peer);
+    ngx_http_upstream_rr_peers_unlock(peers);
+
     if (pc->tries) {
         pc->tries--;
     }
-
-    /* ngx_unlock_mutex(rrp->peers->mutex); */
 }
 
 
@@ -647,6 +1083,16 @@ ngx_http_upstream_set_round_robin_peer_session(ngx_peer_connection_t *pc,
     ngx_ssl_session_t            *ssl_session;
     ngx_http_upstream_rr_peer_t  *peer;
 
+#if (NGX_HTTP_UPSTREAM_ZONE)
+
+    /* the sessions are local to a process and are not kept in a zone */
+
+    if (rrp->peers->shpool) {
+        return NGX_OK;
+    }
+
+#endif
+
     peer = &rrp->peers->peer[rrp->current];
 
     /* TODO: threads only mutex */
@@ -675,6 +1121,14 @@ ngx_http_upstream_save_round_robin_peer_session(ngx_peer_connection_t *pc,
     ngx_ssl_session_t            *old_ssl_session, *ssl_session;
     ngx_http_upstream_rr_peer_t  *peer;
 
+#if (NGX_HTTP_UPSTREAM_ZONE)
+
+    if (rrp->peers->shpool) {
+        return;
+    }
+
+#endif
+
     ssl_session = ngx_ssl_get_session(pc->connection);
 
     if (ssl_session == NULL) {
@@ -23,6 +23,11 @@ typedef struct {
     ngx_int_t                       effective_weight;
     ngx_int_t                       weight;
 
+    ngx_uint_t                      conns;
+
+    ngx_atomic_t                    latency;       /* EWMA, usec */
+    ngx_msec_t                      latency_stamp;
+
     ngx_uint_t                      fails;
     time_t                          accessed;
     time_t                          checked;
@@ -32,9 +37,22 @@ typedef struct {
 
     ngx_uint_t                      down;          /* unsigned  down:1; */
 
+    /* set by the health checks */
+
+    ngx_uint_t                      unhealthy;
+    ngx_uint_t                      check_fails;
+    ngx_uint_t                      check_passes;
+    ngx_msec_t                      check_next;
+
+    ngx_peer_stat_t                *stat;
+
 #if (NGX_HTTP_SSL)
     ngx_ssl_session_t              *ssl_session;   /* local to a process */
 #endif
+
+#if (NGX_HTTP_UPSTREAM_ZONE)
+    ngx_atomic_t                    lock;
+#endif
 } ngx_http_upstream_rr_peer_t;
 
 
@@ -44,13 +62,23 @@ struct ngx_http_upstream_rr_peers_s {
     ngx_uint_t                      number;
     ngx_uint_t                      last_cached;
 
- /* ngx_mutex_t                    *mutex; */
+#if (NGX_HTTP_UPSTREAM_ZONE)
+    ngx_slab_pool_t                *shpool;
+    ngx_atomic_t                    rwlock;
+#endif
+
     ngx_connection_t              **cached;
 
     ngx_uint_t                      total_weight;
 
+    /* a set of peers rebuilt after resolving */
+
+    ngx_pool_t                     *pool;
+    ngx_uint_t                      refs;
+
     unsigned                        single:1;
     unsigned                        weighted:1;
+    unsigned                        stale:1;
 
     ngx_str_t                      *name;
 
@@ -60,6 +88,50 @@ struct ngx_http_upstream_rr_peers_s {
 };
 
 
+#if (NGX_HTTP_UPSTREAM_ZONE)
+
+#define ngx_http_upstream_rr_peers_rlock(peers)                               \
+                                                                              \
+    if (peers->shpool) {                                                      \
+        ngx_rwlock_rlock(&peers->rwlock);                                     \
+    }
+
+#define ngx_http_upstream_rr_peers_wlock(peers)                               \
+                                                                              \
+    if (peers->shpool) {                                                      \
+        ngx_rwlock_wlock(&peers->rwlock);                                     \
+    }
+
+#define ngx_http_upstream_rr_peers_unlock(peers)                              \
+                                                                              \
+    if (peers->shpool) {                                                      \
+        ngx_rwlock_unlock(&peers->rwlock);                                    \
+    }
+
+
+#define ngx_http_upstream_rr_peer_lock(peers, peer)                           \
+                                                                              \
+    if (peers->shpool) {                                                      \
+        ngx_rwlock_wlock(&peer->lock);                                        \
+    }
+
+#define ngx_http_upstream_rr_peer_unlock(peers, peer)                         \
+                                                                              \
+    if (peers->shpool) {                                                      \
+        ngx_rwlock_unlock(&peer->lock);                                       \
+    }
+
+#else
+
+#define ngx_http_upstream_rr_peers_rlock(peers)
+#define ngx_http_upstream_rr_peers_wlock(peers)
+#define ngx_http_upstream_rr_peers_unlock(peers)
+#define ngx_http_upstream_rr_peer_lock(peers, peer)
+#define ngx_http_upstream_rr_peer_unlock(peers, peer)
+
+#endif
+
+
 typedef struct {
     ngx_http_upstream_rr_peers_t   *peers;
     ngx_uint_t                      current;
@@ -72,6 +144,8 @@ ngx_int_t ngx_http_upstream_init_round_robin(ngx_conf_t *cf,
     ngx_http_upstream_srv_conf_t *us);
 ngx_int_t ngx_http_upstream_init_round_robin_peer(ngx_http_request_t *r,
     ngx_http_upstream_srv_conf_t *us);
+ngx_int_t ngx_http_upstream_resolve_round_robin(ngx_cycle_t *cycle,
+    ngx_http_upstream_srv_conf_t *us);
 ngx_int_t ngx_http_upstream_create_round_robin_peer(ngx_http_request_t *r,
     ngx_http_upstream_resolved_t *ur);
 ngx_int_t ngx_http_upstream_get_round_robin_peer(ngx_peer_connection_t *pc,
@@ -10,6 +10,17 @@
 #include <ngx_http.h>
 
 
+#if (NGX_THREAD_POOL)
+
+#define NGX_HTTP_WRITE_PRELOAD  (1024 * 1024)
+
+static ngx_int_t ngx_http_write_thread_preload(ngx_http_request_t *r,
+    off_t *limit);
+static ngx_int_t ngx_http_write_thread_handler(ngx_thread_task_t *task,
+    ngx_file_t *file);
+static void ngx_http_write_thread_event_handler(ngx_event_t *ev);
+#endif
+
 static ngx_int_t ngx_http_write_filter_init(ngx_conf_t *cf);
 
 
@@ -47,7 +58,7 @@ ngx_module_t  ngx_http_write_filter_module = {
 ngx_int_t
 ngx_http_write_filter(ngx_http_request_t *r, ngx_chain_t *in)
 {
-    off_t                      size, sent, nsent, limit;
+    off_t                      size, sent, nsent, limit, chunk;
     ngx_uint_t                 last, flush;
     ngx_msec_t                 delay;
     ngx_chain_t               *cl, *ln, **ll, *chain;
@@ -230,12 +241,35 @@ ngx_http_write_filter(ngx_http_request_t *r, ngx_chain_t *in)
         limit = clcf->sendfile_max_chunk;
     }
 
+    chunk = limit;
+
+#if (NGX_THREAD_POOL)
+
+    if (clcf->aio == NGX_HTTP_AIO_THREADS && c->sendfile) {
+
+        switch (ngx_http_write_thread_preload(r, &chunk)) {
+
+        case NGX_OK:
+            break;
+
+        case NGX_AGAIN:
+            c->buffered |= NGX_HTTP_WRITE_BUFFERED;
+            return NGX_AGAIN;
+
+        default: /* NGX_ERROR */
+            c->error = 1;
+            return NGX_ERROR;
+        }
+    }
+
+#endif
+
     sent = c->sent;
 
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
-                   "http write filter limit %O", limit);
+                   "http write filter limit %O", chunk);
 
-    chain = c->send_chain(c, r->out, limit);
+    chain = c->send_chain(c, r->out, chunk);
 
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, c->log, 0,
                    "http write filter %p", chain);
@@ -279,6 +313,16 @@ ngx_http_write_filter(ngx_http_request_t *r, ngx_chain_t *in)
         ngx_add_timer(c->write, 1);
     }
 
+#if (NGX_THREAD_POOL)
+
+    /* the send has stopped at the end of the preloaded range */
+
+    if (chunk != limit && chain && c->write->ready && !c->write->delayed) {
+        ngx_post_event(c->write, &ngx_posted_events);
+    }
+
+#endif
+
     for (cl = r->out; cl && cl != chain; /* void */) {
         ln = cl;
         cl = cl->next;
@@ -302,6 +346,125 @@ ngx_http_write_filter(ngx_http_request_t *r, ngx_chain_t *in)
 }
 
 
+#if (NGX_THREAD_POOL)
+
+/*
+ * sendfile() blocks the worker while the file pages are read from disk,
+ * so the first file range of the chain is read into the page cache
+ * by a thread and the send is limited to the bytes read; the limit
+ * of the send is not the rate limit, so reaching it does not delay
+ * the next send
+ */
+
+static ngx_int_t
+ngx_http_write_thread_preload(ngx_http_request_t *r, off_t *limit)
+{
+    off_t         size, preload;
+    ssize_t       n;
+    ngx_buf_t    *b;
+    ngx_chain_t  *cl;
+
+    if (r->aio) {
+        return NGX_AGAIN;
+    }
+
+    size = 0;
+    b = NULL;
+
+    for (cl = r->out; cl; cl = cl->next) {
+        b = cl->buf;
+
+        if (b->in_file && !ngx_buf_in_memory(b)) {
+            break;
+        }
+
+        size += ngx_buf_size(b);
+    }
+
+    if (cl == NULL) {
+        return NGX_OK;
+    }
+
+    preload = b->file_last - b->file_pos;
+
+    if (preload > NGX_HTTP_WRITE_PRELOAD) {
+        preload = NGX_HTTP_WRITE_PRELOAD;
+    }
+
+    if (*limit) {
+        if (*limit <= size) {
+            return NGX_OK;
+        }
+
+        if (preload > *limit - size) {
+            preload = *limit - size;
+        }
+    }
+
+    if (preload <= 0) {
+        return NGX_OK;
+    }
+
+    b->file->thread_handler = ngx_http_write_thread_handler;
+    b->file->thread_ctx = r;
+
+    n = ngx_thread_read(b->file, NULL, (size_t) preload, b->file_pos,
+                        r->pool);
+
+    if (n == NGX_AGAIN || n == NGX_ERROR) {
+        return n;
+    }
+
+    /* sendfile() reports a truncated file if nothing was read */
+
+    if (n > 0) {
+        *limit = size + n;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_write_thread_handler(ngx_thread_task_t *task, ngx_file_t *file)
+{
+    ngx_http_request_t        *r;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    r = file->thread_ctx;
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+
+    task->event.data = r;
+    task->event.handler = ngx_http_write_thread_event_handler;
+
+    if (ngx_thread_task_post(clcf->thread_pool, task) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    r->main->blocked++;
+    r->aio = 1;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_write_thread_event_handler(ngx_event_t *ev)
+{
+    ngx_http_request_t  *r;
+
+    r = ev->data;
+
+    r->main->blocked--;
+    r->aio = 0;
+
+    r->connection->write->handler(r->connection->write);
+}
+
+#endif
+
+
 static ngx_int_t
 ngx_http_write_filter_init(ngx_conf_t *cf)
 {
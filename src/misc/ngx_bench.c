@@ -0,0 +1,304 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <nginx.h>
+#include <ngx_bench.h>
+
+
+/*
+ * The benchmark driver is linked with the nginx objects and prints one
+ * JSON object per line: the first line describes the build and the CPU,
+ * the next ones are the results of the benchmarks.
+ */
+
+
+#define NGX_BENCH_TIME   500     /* msec */
+#define NGX_BENCH_MAX_N  1000000000
+
+
+static ngx_int_t ngx_bench_init(char *const *argv);
+static ngx_int_t ngx_bench_measure(ngx_bench_t *b, ngx_msec_t time);
+static ngx_uint_t ngx_bench_match(ngx_bench_t *b, int argc, char *const *argv,
+    int first);
+static void ngx_bench_write(u_char *buf, u_char *last);
+static uint64_t ngx_bench_usec(void);
+
+
+static ngx_bench_t  *ngx_benches[] = {
+    ngx_bench_core,
+    ngx_bench_event,
+#if (NGX_BENCH_HTTP)
+    ngx_bench_http,
+#endif
+    NULL
+};
+
+
+ngx_pool_t              *ngx_bench_pool;
+ngx_log_t               *ngx_bench_log;
+
+static ngx_log_t         ngx_bench_error_log;
+static ngx_open_file_t   ngx_bench_error_file;
+static ngx_cycle_t       ngx_bench_cycle;
+static uint32_t          ngx_bench_seed = 2463534242U;
+
+
+int ngx_cdecl
+main(int argc, char *const *argv)
+{
+    int           i;
+    u_char        buf[NGX_MAX_ERROR_STR], *p;
+    ngx_int_t     n;
+    ngx_msec_t    time;
+    ngx_uint_t    list, failed;
+    ngx_bench_t  *b, **bs;
+
+    time = NGX_BENCH_TIME;
+    list = 0;
+
+    for (i = 1; i < argc; i++) {
+
+        if (argv[i][0] != '-') {
+            break;
+        }
+
+        if (ngx_strcmp(argv[i], "-l") == 0) {
+            list = 1;
+            continue;
+        }
+
+        if (ngx_strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            i++;
+
+            n = ngx_atoi((u_char *) argv[i], ngx_strlen(argv[i]));
+            if (n <= 0) {
+                goto usage;
+            }
+
+            time = (ngx_msec_t) n;
+            continue;
+        }
+
+        goto usage;
+    }
+
+    if (ngx_bench_init(argv) != NGX_OK) {
+        return 1;
+    }
+
+    if (list) {
+        for (bs = ngx_benches; *bs; bs++) {
+            for (b = *bs; b->name; b++) {
+                p = ngx_sprintf(buf, "%s" NGX_LINEFEED, b->name);
+                ngx_bench_write(buf, p);
+            }
+        }
+
+        return 0;
+    }
+
+    p = ngx_sprintf(buf, "{\"nginx\":\"" NGINX_VERSION "\","
+                         "\"ncpu\":%i,\"cpu_features\":%ui,\"time_ms\":%M}"
+                         NGX_LINEFEED,
+                    ngx_ncpu, ngx_cpu_features, time);
+    ngx_bench_write(buf, p);
+
+    failed = 0;
+
+    for (bs = ngx_benches; *bs; bs++) {
+        for (b = *bs; b->name; b++) {
+
+            if (!ngx_bench_match(b, argc, argv, i)) {
+                continue;
+            }
+
+            if (ngx_bench_measure(b, time) != NGX_OK) {
+                ngx_log_error(NGX_LOG_ERR, ngx_bench_log, 0,
+                              "benchmark \"%s\" failed", b->name);
+                failed = 1;
+            }
+        }
+    }
+
+    return failed;
+
+usage:
+
+    p = ngx_sprintf(buf, "usage: %s [-l] [-t msec] [name-prefix ...]"
+                         NGX_LINEFEED, argv[0]);
+    (void) ngx_write_fd(ngx_stderr, buf, p - buf);
+
+    return 1;
+}
+
+
+static ngx_int_t
+ngx_bench_init(char *const *argv)
+{
+    ngx_bench_error_file.fd = ngx_stderr;
+
+    ngx_bench_error_log.file = &ngx_bench_error_file;
+    ngx_bench_error_log.log_level = NGX_LOG_NOTICE;
+
+    ngx_bench_log = &ngx_bench_error_log;
+
+    ngx_bench_cycle.log = ngx_bench_log;
+    ngx_cycle = &ngx_bench_cycle;
+
+    if (ngx_strerror_init() != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_time_init();
+
+    ngx_pid = ngx_getpid();
+    ngx_os_argv = (char **) argv;
+
+    if (ngx_os_init(ngx_bench_log) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    if (ngx_crc32_table_init() != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_bench_pool = ngx_create_pool(NGX_CYCLE_POOL_SIZE, ngx_bench_log);
+    if (ngx_bench_pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_bench_cycle.pool = ngx_bench_pool;
+
+    return NGX_OK;
+}
+
+
+/*
+ * the number of operations is increased until a run takes the given time,
+ * then ns/op and ops/sec are reported for the last run
+ */
+
+static ngx_int_t
+ngx_bench_measure(ngx_bench_t *b, ngx_msec_t time)
+{
+    u_char      buf[NGX_MAX_ERROR_STR], *p;
+    double      ns, mb;
+    uint64_t    start, elapsed, target;
+    ngx_int_t   rc;
+    ngx_uint_t  n, next;
+
+    if (b->init && b->init(b) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    target = (uint64_t) time * 1000;
+    n = 1;
+
+    for ( ;; ) {
+        start = ngx_bench_usec();
+
+        rc = b->run(b, n);
+
+        elapsed = ngx_bench_usec() - start;
+
+        if (rc != NGX_OK) {
+            break;
+        }
+
+        if (elapsed >= target || n >= NGX_BENCH_MAX_N) {
+            break;
+        }
+
+        /* aim 20% above the target to finish in one more run */
+
+        if (elapsed == 0) {
+            next = n * 100;
+
+        } else {
+            next = (ngx_uint_t) ((double) n * target * 1.2 / elapsed);
+            next = ngx_max(next, n * 2);
+            next = ngx_min(next, n * 100);
+        }
+
+        n = ngx_min(next, NGX_BENCH_MAX_N);
+    }
+
+    if (b->done) {
+        b->done(b);
+    }
+
+    if (rc != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ns = (double) elapsed * 1000 / n;
+
+    p = ngx_sprintf(buf, "{\"bench\":\"%s\",\"iterations\":%ui,"
+                         "\"ns_per_op\":%.2f,\"ops_per_sec\":%uL",
+                    b->name, n, ns, (uint64_t) (1e9 / ns));
+
+    if (b->bytes) {
+        mb = (double) b->bytes * n / elapsed;
+        p = ngx_sprintf(p, ",\"bytes_per_op\":%uz,\"mb_per_sec\":%.2f",
+                        b->bytes, mb);
+    }
+
+    p = ngx_sprintf(p, "}" NGX_LINEFEED);
+
+    ngx_bench_write(buf, p);
+
+    return NGX_OK;
+}
+
+
+static ngx_uint_t
+ngx_bench_match(ngx_bench_t *b, int argc, char *const *argv, int first)
+{
+    int  i;
+
+    if (first == argc) {
+        return 1;
+    }
+
+    for (i = first; i < argc; i++) {
+        if (ngx_strncmp(b->name, argv[i], ngx_strlen(argv[i])) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+uint32_t
+ngx_bench_random(void)
+{
+    ngx_bench_seed ^= ngx_bench_seed << 13;
+    ngx_bench_seed ^= ngx_bench_seed >> 17;
+    ngx_bench_seed ^= ngx_bench_seed << 5;
+
+    return ngx_bench_seed;
+}
+
+
+static void
+ngx_bench_write(u_char *buf, u_char *last)
+{
+    (void) ngx_write_fd(ngx_stdout, buf, last - buf);
+}
+
+
+static uint64_t
+ngx_bench_usec(void)
+{
+    struct timeval  tv;
+
+    ngx_gettimeofday(&tv);
+
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
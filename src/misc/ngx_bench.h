@@ -0,0 +1,57 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_BENCH_H_INCLUDED_
+#define _NGX_BENCH_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+typedef struct ngx_bench_s  ngx_bench_t;
+
+typedef ngx_int_t (*ngx_bench_init_pt)(ngx_bench_t *b);
+typedef ngx_int_t (*ngx_bench_run_pt)(ngx_bench_t *b, ngx_uint_t n);
+typedef void (*ngx_bench_done_pt)(ngx_bench_t *b);
+
+
+/*
+ * "init" is called once before the timed runs and "done" after them,
+ * "run" performs n operations and is timed as a whole; "bytes" is the size
+ * of data processed by one operation, it adds the throughput to the output
+ */
+
+struct ngx_bench_s {
+    char               *name;
+    ngx_bench_init_pt   init;
+    ngx_bench_run_pt    run;
+    ngx_bench_done_pt   done;
+    size_t              bytes;
+    ngx_uint_t          arg;
+    void               *data;
+};
+
+
+#define ngx_bench_null    { NULL, NULL, NULL, NULL, 0, 0, NULL }
+
+
+extern ngx_bench_t  ngx_bench_core[];
+extern ngx_bench_t  ngx_bench_event[];
+#if (NGX_BENCH_HTTP)
+extern ngx_bench_t  ngx_bench_http[];
+#endif
+
+extern ngx_pool_t  *ngx_bench_pool;
+extern ngx_log_t   *ngx_bench_log;
+
+
+/* a cheap xorshift generator, the sequence is the same in every run */
+
+uint32_t ngx_bench_random(void);
+
+
+#endif /* _NGX_BENCH_H_INCLUDED_ */
@@ -0,0 +1,782 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_md5.h>
+#include <ngx_bench.h>
+
+
+#define NGX_BENCH_RBTREE_NODES  100000
+#define NGX_BENCH_HASH_NAMES    1000
+#define NGX_BENCH_SLAB_LIVE     64
+#define NGX_BENCH_SLAB_SIZE     (16 * 1024 * 1024)
+
+
+typedef struct {
+    ngx_uint_t            procs;
+    ngx_uint_t            cache;
+} ngx_bench_slab_t;
+
+
+typedef struct {
+    ngx_hash_combined_t   hash;
+    ngx_str_t            *names;
+    ngx_uint_t           *keys;
+} ngx_bench_hash_t;
+
+
+static ngx_int_t ngx_bench_data_init(ngx_bench_t *b);
+static ngx_int_t ngx_bench_pool_init(ngx_bench_t *b);
+static ngx_int_t ngx_bench_create_pool(ngx_bench_t *b, ngx_uint_t n);
+static void ngx_bench_pool_done(ngx_bench_t *b);
+static ngx_int_t ngx_bench_palloc(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_rbtree_init(ngx_bench_t *b);
+static ngx_int_t ngx_bench_rbtree(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_slab_init(ngx_bench_t *b);
+static ngx_int_t ngx_bench_slab(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_slab_worker(ngx_slab_pool_t *sp, ngx_uint_t n);
+static void ngx_bench_slab_done(ngx_bench_t *b);
+static ngx_int_t ngx_bench_hash_init(ngx_bench_t *b);
+static int ngx_libc_cdecl ngx_bench_hash_cmp(const void *one, const void *two);
+static ngx_int_t ngx_bench_hash_find(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_hash_wc_head(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_hash_wc_tail(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_hash_combined(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_escape_uri(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_crc32_short(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_crc32_long(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_crc32c(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_md5(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_xxh128(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_siphash(ngx_bench_t *b, ngx_uint_t n);
+
+
+static ngx_bench_slab_t  ngx_bench_slab_1p = { 1, 0 };
+static ngx_bench_slab_t  ngx_bench_slab_1p_cached = { 1, 64 };
+static ngx_bench_slab_t  ngx_bench_slab_4p = { 4, 0 };
+static ngx_bench_slab_t  ngx_bench_slab_4p_cached = { 4, 64 };
+
+static ngx_shm_t         ngx_bench_slab_shm;
+
+static ngx_bench_hash_t  ngx_bench_hash;
+
+static ngx_rbtree_t       ngx_bench_rbtree_tree;
+static ngx_rbtree_node_t  ngx_bench_rbtree_sentinel;
+static ngx_rbtree_node_t *ngx_bench_rbtree_nodes;
+
+static u_char            ngx_bench_data[4096];
+static uint32_t          ngx_bench_sink;
+
+
+ngx_bench_t  ngx_bench_core[] = {
+
+    { "pool_create_destroy", ngx_bench_pool_init, ngx_bench_create_pool,
+      ngx_bench_pool_done, 0, 0, NULL },
+
+    { "pool_create_destroy_cached", ngx_bench_pool_init, ngx_bench_create_pool,
+      ngx_bench_pool_done, 0, 1024 * 1024, NULL },
+
+    { "palloc_small", NULL, ngx_bench_palloc, NULL, 0, 0, NULL },
+
+    { "rbtree_insert_delete", ngx_bench_rbtree_init, ngx_bench_rbtree,
+      NULL, 0, 0, NULL },
+
+    { "slab_alloc_free", ngx_bench_slab_init, ngx_bench_slab,
+      ngx_bench_slab_done, 0, 0, &ngx_bench_slab_1p },
+
+    { "slab_alloc_free_cached", ngx_bench_slab_init, ngx_bench_slab,
+      ngx_bench_slab_done, 0, 0, &ngx_bench_slab_1p_cached },
+
+    { "slab_alloc_free_4p", ngx_bench_slab_init, ngx_bench_slab,
+      ngx_bench_slab_done, 0, 0, &ngx_bench_slab_4p },
+
+    { "slab_alloc_free_4p_cached", ngx_bench_slab_init, ngx_bench_slab,
+      ngx_bench_slab_done, 0, 0, &ngx_bench_slab_4p_cached },
+
+    { "hash_find", ngx_bench_hash_init, ngx_bench_hash_find, NULL,
+      0, 0, NULL },
+
+    { "hash_find_wc_head", ngx_bench_hash_init, ngx_bench_hash_wc_head, NULL,
+      0, 0, NULL },
+
+    { "hash_find_wc_tail", ngx_bench_hash_init, ngx_bench_hash_wc_tail, NULL,
+      0, 0, NULL },
+
+    { "hash_find_combined", ngx_bench_hash_init, ngx_bench_hash_combined,
+      NULL, 0, 0, NULL },
+
+    { "escape_uri", NULL, ngx_bench_escape_uri, NULL, 0, 0, NULL },
+
+    { "crc32_short_16", ngx_bench_data_init, ngx_bench_crc32_short, NULL,
+      16, 0, NULL },
+
+    { "crc32_long_256", ngx_bench_data_init, ngx_bench_crc32_long, NULL,
+      256, 0, NULL },
+
+    { "crc32_long_4096", ngx_bench_data_init, ngx_bench_crc32_long, NULL,
+      4096, 0, NULL },
+
+    { "crc32c_16", ngx_bench_data_init, ngx_bench_crc32c, NULL,
+      16, 0, NULL },
+
+    { "crc32c_256", ngx_bench_data_init, ngx_bench_crc32c, NULL,
+      256, 0, NULL },
+
+    { "crc32c_4096", ngx_bench_data_init, ngx_bench_crc32c, NULL,
+      4096, 0, NULL },
+
+    { "md5_64", ngx_bench_data_init, ngx_bench_md5, NULL, 64, 0, NULL },
+
+    { "md5_1024", ngx_bench_data_init, ngx_bench_md5, NULL, 1024, 0, NULL },
+
+    /* the cache key digests, see proxy_cache_path key_hash= */
+
+    { "cache_key_md5_300", ngx_bench_data_init, ngx_bench_md5, NULL,
+      300, 0, NULL },
+
+    { "cache_key_xxh128_300", ngx_bench_data_init, ngx_bench_xxh128, NULL,
+      300, 0, NULL },
+
+    { "cache_key_siphash_300", ngx_bench_data_init, ngx_bench_siphash, NULL,
+      300, 0, NULL },
+
+    ngx_bench_null
+};
+
+
+static ngx_int_t
+ngx_bench_data_init(ngx_bench_t *b)
+{
+    ngx_uint_t  i;
+
+    for (i = 0; i < sizeof(ngx_bench_data); i++) {
+        ngx_bench_data[i] = (u_char) ngx_bench_random();
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_pool_init(ngx_bench_t *b)
+{
+    ngx_pool_cache_max = b->arg;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_create_pool(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_uint_t   i, k;
+    ngx_pool_t  *pool;
+
+    /* a request pool with a few small allocations and one more block */
+
+    for (i = 0; i < n; i++) {
+        pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, ngx_bench_log);
+        if (pool == NULL) {
+            return NGX_ERROR;
+        }
+
+        for (k = 0; k < 8; k++) {
+            if (ngx_palloc(pool, 200 + k * 200) == NULL) {
+                ngx_destroy_pool(pool);
+                return NGX_ERROR;
+            }
+        }
+
+        ngx_destroy_pool(pool);
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_bench_pool_done(ngx_bench_t *b)
+{
+    ngx_pool_cache_max = 0;
+}
+
+
+static ngx_int_t
+ngx_bench_palloc(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_uint_t   i;
+    ngx_pool_t  *pool;
+
+    pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, ngx_bench_log);
+    if (pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < n; i++) {
+
+        if ((i & 127) == 127) {
+            ngx_reset_pool(pool);
+        }
+
+        if (ngx_palloc(pool, 24 + (i & 7) * 8) == NULL) {
+            ngx_destroy_pool(pool);
+            return NGX_ERROR;
+        }
+    }
+
+    ngx_destroy_pool(pool);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_rbtree_init(ngx_bench_t *b)
+{
+    ngx_uint_t  i;
+
+    if (ngx_bench_rbtree_nodes) {
+        return NGX_OK;
+    }
+
+    ngx_bench_rbtree_nodes = ngx_palloc(ngx_bench_pool,
+                                        NGX_BENCH_RBTREE_NODES
+                                        * sizeof(ngx_rbtree_node_t));
+    if (ngx_bench_rbtree_nodes == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_rbtree_init(&ngx_bench_rbtree_tree, &ngx_bench_rbtree_sentinel,
+                    ngx_rbtree_insert_value);
+
+    for (i = 0; i < NGX_BENCH_RBTREE_NODES; i++) {
+        ngx_bench_rbtree_nodes[i].key = ngx_bench_random();
+        ngx_rbtree_insert(&ngx_bench_rbtree_tree, &ngx_bench_rbtree_nodes[i]);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_rbtree(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_uint_t          i;
+    ngx_rbtree_node_t  *node;
+
+    for (i = 0; i < n; i++) {
+        node = &ngx_bench_rbtree_nodes[ngx_bench_random()
+                                       % NGX_BENCH_RBTREE_NODES];
+
+        ngx_rbtree_delete(&ngx_bench_rbtree_tree, node);
+
+        node->key = ngx_bench_random();
+        ngx_rbtree_insert(&ngx_bench_rbtree_tree, node);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_slab_init(ngx_bench_t *b)
+{
+    ngx_bench_slab_t  *bs = b->data;
+
+    ngx_slab_pool_t  *sp;
+
+    ngx_bench_slab_shm.size = NGX_BENCH_SLAB_SIZE;
+    ngx_bench_slab_shm.name.len = sizeof("bench") - 1;
+    ngx_bench_slab_shm.name.data = (u_char *) "bench";
+    ngx_bench_slab_shm.log = ngx_bench_log;
+
+    if (ngx_shm_alloc(&ngx_bench_slab_shm) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    sp = (ngx_slab_pool_t *) ngx_bench_slab_shm.addr;
+
+    sp->end = ngx_bench_slab_shm.addr + ngx_bench_slab_shm.size;
+    sp->min_shift = 3;
+    sp->addr = ngx_bench_slab_shm.addr;
+
+    if (ngx_shmtx_create(&sp->mutex, &sp->lock, NULL) != NGX_OK) {
+        ngx_shm_free(&ngx_bench_slab_shm);
+        return NGX_ERROR;
+    }
+
+    sp->cache_size = bs->cache;
+    sp->ncaches = bs->cache ? bs->procs : 0;
+
+    ngx_slab_init(sp);
+
+    return NGX_OK;
+}
+
+
+/*
+ * the processes share one zone as the workers do, each of them
+ * takes its own cache by the process slot
+ */
+
+static ngx_int_t
+ngx_bench_slab(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_bench_slab_t  *bs = b->data;
+
+    int               status;
+    ngx_int_t         rc;
+    ngx_pid_t         pid;
+    ngx_uint_t        i, k;
+    ngx_slab_pool_t  *sp;
+
+    sp = (ngx_slab_pool_t *) ngx_bench_slab_shm.addr;
+
+    if (bs->procs == 1) {
+        ngx_process_slot = 0;
+        return ngx_bench_slab_worker(sp, n);
+    }
+
+    for (i = 0; i < bs->procs; i++) {
+
+        pid = fork();
+
+        switch (pid) {
+
+        case -1:
+            ngx_log_error(NGX_LOG_ALERT, ngx_bench_log, ngx_errno,
+                          "fork() failed");
+            return NGX_ERROR;
+
+        case 0:
+            ngx_pid = ngx_getpid();
+            ngx_process_slot = i;
+
+            rc = ngx_bench_slab_worker(sp, n / bs->procs + 1);
+
+            exit(rc == NGX_OK ? 0 : 1);
+
+        default:
+            break;
+        }
+    }
+
+    rc = NGX_OK;
+
+    for (k = 0; k < bs->procs; k++) {
+        if (waitpid(-1, &status, 0) == -1
+            || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            rc = NGX_ERROR;
+        }
+    }
+
+    return rc;
+}
+
+
+static ngx_int_t
+ngx_bench_slab_worker(ngx_slab_pool_t *sp, ngx_uint_t n)
+{
+    void        *live[NGX_BENCH_SLAB_LIVE];
+    ngx_uint_t   i, k;
+
+    ngx_memzero(live, sizeof(live));
+
+    /* each operation frees the oldest chunk and allocates a new one */
+
+    for (i = 0; i < n; i++) {
+        k = i % NGX_BENCH_SLAB_LIVE;
+
+        if (live[k]) {
+            ngx_slab_free(sp, live[k]);
+        }
+
+        live[k] = ngx_slab_alloc(sp, 16 << (i & 3));
+        if (live[k] == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    for (k = 0; k < NGX_BENCH_SLAB_LIVE; k++) {
+        if (live[k]) {
+            ngx_slab_free(sp, live[k]);
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_bench_slab_done(ngx_bench_t *b)
+{
+    ngx_bench_slab_t  *bs = b->data;
+
+    ngx_slab_pool_t  *sp;
+
+    sp = (ngx_slab_pool_t *) ngx_bench_slab_shm.addr;
+
+    ngx_shmtx_destroy(&sp->mutex);
+    ngx_shm_free(&ngx_bench_slab_shm);
+}
+
+
+static ngx_int_t
+ngx_bench_hash_init(ngx_bench_t *b)
+{
+    u_char                  *p;
+    ngx_str_t                name;
+    ngx_uint_t               i;
+    ngx_pool_t              *temp_pool;
+    ngx_hash_init_t          hinit;
+    ngx_bench_hash_t        *bh;
+    ngx_hash_keys_arrays_t   ha;
+
+    bh = &ngx_bench_hash;
+    b->data = bh;
+
+    if (bh->names) {
+        return NGX_OK;
+    }
+
+    temp_pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, ngx_bench_log);
+    if (temp_pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_memzero(&ha, sizeof(ngx_hash_keys_arrays_t));
+
+    ha.pool = ngx_bench_pool;
+    ha.temp_pool = temp_pool;
+
+    if (ngx_hash_keys_array_init(&ha, NGX_HASH_LARGE) != NGX_OK) {
+        goto failed;
+    }
+
+    /* the server names: exact, "*.domain" and "www.site.*" ones */
+
+    for (i = 0; i < 3 * NGX_BENCH_HASH_NAMES; i++) {
+
+        p = ngx_pnalloc(temp_pool, sizeof("www.domain4294967295.com"));
+        if (p == NULL) {
+            goto failed;
+        }
+
+        name.data = p;
+
+        switch (i % 3) {
+        case 0:
+            name.len = ngx_sprintf(p, "host%ui.example.com", i) - p;
+            break;
+        case 1:
+            name.len = ngx_sprintf(p, "*.domain%ui.com", i) - p;
+            break;
+        default:
+            name.len = ngx_sprintf(p, "www.site%ui.*", i) - p;
+            break;
+        }
+
+        if (ngx_hash_add_key(&ha, &name, ngx_bench_data,
+                             NGX_HASH_WILDCARD_KEY)
+            != NGX_OK)
+        {
+            goto failed;
+        }
+    }
+
+    hinit.hash = &bh->hash.hash;
+    hinit.key = ngx_hash_key_lc;
+    hinit.max_size = 4096;
+    hinit.bucket_size = ngx_align(64, ngx_cacheline_size);
+    hinit.name = "bench_hash";
+    hinit.pool = ngx_bench_pool;
+    hinit.temp_pool = temp_pool;
+
+    if (ngx_hash_init(&hinit, ha.keys.elts, ha.keys.nelts) != NGX_OK) {
+        goto failed;
+    }
+
+    ngx_qsort(ha.dns_wc_head.elts, (size_t) ha.dns_wc_head.nelts,
+              sizeof(ngx_hash_key_t), ngx_bench_hash_cmp);
+
+    hinit.hash = NULL;
+    hinit.temp_pool = temp_pool;
+
+    if (ngx_hash_wildcard_init(&hinit, ha.dns_wc_head.elts,
+                               ha.dns_wc_head.nelts)
+        != NGX_OK)
+    {
+        goto failed;
+    }
+
+    bh->hash.wc_head = (ngx_hash_wildcard_t *) hinit.hash;
+
+    ngx_qsort(ha.dns_wc_tail.elts, (size_t) ha.dns_wc_tail.nelts,
+              sizeof(ngx_hash_key_t), ngx_bench_hash_cmp);
+
+    hinit.hash = NULL;
+    hinit.temp_pool = temp_pool;
+
+    if (ngx_hash_wildcard_init(&hinit, ha.dns_wc_tail.elts,
+                               ha.dns_wc_tail.nelts)
+        != NGX_OK)
+    {
+        goto failed;
+    }
+
+    bh->hash.wc_tail = (ngx_hash_wildcard_t *) hinit.hash;
+
+    /* the names looked up, in the order of the server names above */
+
+    bh->names = ngx_palloc(ngx_bench_pool,
+                           3 * NGX_BENCH_HASH_NAMES * sizeof(ngx_str_t));
+    bh->keys = ngx_palloc(ngx_bench_pool,
+                          3 * NGX_BENCH_HASH_NAMES * sizeof(ngx_uint_t));
+
+    if (bh->names == NULL || bh->keys == NULL) {
+        goto failed;
+    }
+
+    for (i = 0; i < 3 * NGX_BENCH_HASH_NAMES; i++) {
+
+        p = ngx_pnalloc(ngx_bench_pool, sizeof("www.domain4294967295.com"));
+        if (p == NULL) {
+            goto failed;
+        }
+
+        bh->names[i].data = p;
+
+        switch (i % 3) {
+        case 0:
+            bh->names[i].len = ngx_sprintf(p, "host%ui.example.com", i) - p;
+            break;
+        case 1:
+            bh->names[i].len = ngx_sprintf(p, "www.domain%ui.com", i) - p;
+            break;
+        default:
+            bh->names[i].len = ngx_sprintf(p, "www.site%ui.org", i) - p;
+            break;
+        }
+
+        bh->keys[i] = ngx_hash_key(p, bh->names[i].len);
+    }
+
+    ngx_destroy_pool(temp_pool);
+
+    return NGX_OK;
+
+failed:
+
+    ngx_destroy_pool(temp_pool);
+
+    return NGX_ERROR;
+}
+
+
+static int ngx_libc_cdecl
+ngx_bench_hash_cmp(const void *one, const void *two)
+{
+    ngx_hash_key_t  *first, *second;
+
+    first = (ngx_hash_key_t *) one;
+    second = (ngx_hash_key_t *) two;
+
+    return ngx_dns_strcmp(first->key.data, second->key.data);
+}
+
+
+static ngx_int_t
+ngx_bench_hash_find(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_bench_hash_t  *bh = b->data;
+
+    ngx_uint_t  i, k;
+
+    for (i = 0; i < n; i++) {
+        k = 3 * (i % NGX_BENCH_HASH_NAMES);
+
+        if (ngx_hash_find(&bh->hash.hash, bh->keys[k], bh->names[k].data,
+                          bh->names[k].len)
+            == NULL)
+        {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_hash_wc_head(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_bench_hash_t  *bh = b->data;
+
+    ngx_uint_t  i, k;
+
+    for (i = 0; i < n; i++) {
+        k = 3 * (i % NGX_BENCH_HASH_NAMES) + 1;
+
+        if (ngx_hash_find_wc_head(bh->hash.wc_head, bh->names[k].data,
+                                  bh->names[k].len)
+            == NULL)
+        {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_hash_wc_tail(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_bench_hash_t  *bh = b->data;
+
+    ngx_uint_t  i, k;
+
+    for (i = 0; i < n; i++) {
+        k = 3 * (i % NGX_BENCH_HASH_NAMES) + 2;
+
+        if (ngx_hash_find_wc_tail(bh->hash.wc_tail, bh->names[k].data,
+                                  bh->names[k].len)
+            == NULL)
+        {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_hash_combined(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_bench_hash_t  *bh = b->data;
+
+    ngx_uint_t  i, k;
+
+    for (i = 0; i < n; i++) {
+        k = i % (3 * NGX_BENCH_HASH_NAMES);
+
+        if (ngx_hash_find_combined(&bh->hash, bh->keys[k], bh->names[k].data,
+                                   bh->names[k].len)
+            == NULL)
+        {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_escape_uri(ngx_bench_t *b, ngx_uint_t n)
+{
+    u_char      dst[512];
+    ngx_uint_t  i;
+
+    static u_char  uri[] = "/images/2012/summer holidays/IMG_0042 (copy).jpg";
+
+    for (i = 0; i < n; i++) {
+        (void) ngx_escape_uri(dst, uri, sizeof(uri) - 1, NGX_ESCAPE_URI);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_crc32_short(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_uint_t  i;
+
+    for (i = 0; i < n; i++) {
+        ngx_bench_sink += ngx_crc32_short(ngx_bench_data + (i & 63), b->bytes);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_crc32_long(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_uint_t  i;
+
+    for (i = 0; i < n; i++) {
+        ngx_bench_sink += ngx_crc32_long(ngx_bench_data, b->bytes);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_crc32c(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_uint_t  i;
+
+    for (i = 0; i < n; i++) {
+        ngx_bench_sink += ngx_crc32c(ngx_bench_data, b->bytes);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_md5(ngx_bench_t *b, ngx_uint_t n)
+{
+    u_char      digest[16];
+    ngx_md5_t   md5;
+    ngx_uint_t  i;
+
+    for (i = 0; i < n; i++) {
+        ngx_md5_init(&md5);
+        ngx_md5_update(&md5, ngx_bench_data, b->bytes);
+        ngx_md5_final(digest, &md5);
+
+        ngx_bench_sink += digest[0];
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_xxh128(ngx_bench_t *b, ngx_uint_t n)
+{
+    u_char      digest[16];
+    ngx_uint_t  i;
+
+    for (i = 0; i < n; i++) {
+        ngx_xxh128(digest, ngx_bench_data, b->bytes);
+        ngx_bench_sink += digest[0];
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_siphash(ngx_bench_t *b, ngx_uint_t n)
+{
+    u_char      digest[16];
+    ngx_uint_t  i;
+
+    for (i = 0; i < n; i++) {
+        ngx_siphash128(digest, ngx_bench_data, ngx_bench_data, b->bytes);
+        ngx_bench_sink += digest[0];
+    }
+
+    return NGX_OK;
+}
@@ -0,0 +1,160 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+#include <ngx_bench.h>
+
+
+/*
+ * the timer benchmarks keep a population of idle keepalive timers
+ * and either re-arm them or add and expire short timers among them
+ */
+
+#define NGX_BENCH_TIMERS        100000
+#define NGX_BENCH_TIMERS_SHORT  1024
+#define NGX_BENCH_TIMER_IDLE    (24 * 60 * 60 * 1000)
+
+
+static ngx_int_t ngx_bench_timer_init(ngx_bench_t *b);
+static ngx_int_t ngx_bench_timer_rearm(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_timer_expire(ngx_bench_t *b, ngx_uint_t n);
+static void ngx_bench_timer_done(ngx_bench_t *b);
+static void ngx_bench_timer_handler(ngx_event_t *ev);
+
+
+static ngx_event_t       *ngx_bench_events;
+static ngx_connection_t   ngx_bench_connection;
+static ngx_uint_t         ngx_bench_expired;
+
+
+ngx_bench_t  ngx_bench_event[] = {
+
+    { "timer_rearm_rbtree", ngx_bench_timer_init, ngx_bench_timer_rearm,
+      ngx_bench_timer_done, 0, 0, NULL },
+
+    { "timer_rearm_wheel", ngx_bench_timer_init, ngx_bench_timer_rearm,
+      ngx_bench_timer_done, 0, 1, NULL },
+
+    { "timer_expire_rbtree", ngx_bench_timer_init, ngx_bench_timer_expire,
+      ngx_bench_timer_done, 0, 0, NULL },
+
+    { "timer_expire_wheel", ngx_bench_timer_init, ngx_bench_timer_expire,
+      ngx_bench_timer_done, 0, 1, NULL },
+
+    ngx_bench_null
+};
+
+
+static ngx_int_t
+ngx_bench_timer_init(ngx_bench_t *b)
+{
+    ngx_uint_t    i;
+    ngx_event_t  *ev;
+
+    if (ngx_bench_events == NULL) {
+        ngx_bench_events = ngx_pcalloc(ngx_bench_pool,
+                                       (NGX_BENCH_TIMERS
+                                        + NGX_BENCH_TIMERS_SHORT)
+                                       * sizeof(ngx_event_t));
+        if (ngx_bench_events == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_bench_connection.fd = (ngx_socket_t) -1;
+    }
+
+    ngx_event_timer_wheel = b->arg;
+    ngx_current_msec = 1000000;
+
+    if (ngx_event_timer_init(ngx_bench_log) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < NGX_BENCH_TIMERS + NGX_BENCH_TIMERS_SHORT; i++) {
+        ev = &ngx_bench_events[i];
+
+        ev->data = &ngx_bench_connection;
+        ev->log = ngx_bench_log;
+        ev->handler = ngx_bench_timer_handler;
+
+        if (i < NGX_BENCH_TIMERS) {
+            ngx_add_timer(ev, NGX_BENCH_TIMER_IDLE
+                              + ngx_bench_random() % 60000);
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_timer_rearm(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_uint_t    i;
+    ngx_event_t  *ev;
+
+    /* the new timeouts differ by a second at least, so none is lazy */
+
+    for (i = 0; i < n; i++) {
+        ev = &ngx_bench_events[ngx_bench_random() % NGX_BENCH_TIMERS];
+
+        ngx_add_timer(ev, NGX_BENCH_TIMER_IDLE
+                          + (ngx_bench_random() % 60) * 1000);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_timer_expire(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_uint_t    i, k;
+    ngx_event_t  *ev;
+
+    ngx_bench_expired = 0;
+
+    for (i = 0; i < n; i += NGX_BENCH_TIMERS_SHORT) {
+
+        for (k = 0; k < NGX_BENCH_TIMERS_SHORT; k++) {
+            ev = &ngx_bench_events[NGX_BENCH_TIMERS + k];
+            ngx_add_timer(ev, 1 + k % 64);
+        }
+
+        ngx_current_msec += 65;
+
+        ngx_event_expire_timers();
+    }
+
+    return (ngx_bench_expired >= n) ? NGX_OK : NGX_ERROR;
+}
+
+
+static void
+ngx_bench_timer_done(ngx_bench_t *b)
+{
+    ngx_uint_t    i;
+    ngx_event_t  *ev;
+
+    for (i = 0; i < NGX_BENCH_TIMERS + NGX_BENCH_TIMERS_SHORT; i++) {
+        ev = &ngx_bench_events[i];
+
+        if (ev->timer_set) {
+            ngx_del_timer(ev);
+        }
+    }
+
+    ngx_event_timer_wheel = 0;
+}
+
+
+static void
+ngx_bench_timer_handler(ngx_event_t *ev)
+{
+    ngx_bench_expired++;
+}
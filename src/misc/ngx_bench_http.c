@@ -0,0 +1,138 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+#include <ngx_bench.h>
+
+
+static ngx_int_t ngx_bench_http_init(ngx_bench_t *b);
+static ngx_int_t ngx_bench_parse_request_line(ngx_bench_t *b, ngx_uint_t n);
+static ngx_int_t ngx_bench_parse_header_line(ngx_bench_t *b, ngx_uint_t n);
+
+
+static ngx_http_request_t  *ngx_bench_request;
+
+static ngx_str_t  ngx_bench_request_line = ngx_string(
+    "GET /static/js/app.min.js?v=20121211&lang=en-US HTTP/1.1" CRLF
+);
+
+static ngx_str_t  ngx_bench_headers = ngx_string(
+    "Host: www.example.com" CRLF
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:17.0) "
+        "Gecko/20100101 Firefox/17.0" CRLF
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+        "*/*;q=0.8" CRLF
+    "Accept-Language: en-US,en;q=0.5" CRLF
+    "Accept-Encoding: gzip, deflate" CRLF
+    "Referer: http://www.example.com/index.html" CRLF
+    "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark" CRLF
+    "Connection: keep-alive" CRLF
+    "If-Modified-Since: Tue, 11 Dec 2012 13:02:00 GMT" CRLF
+    "Cache-Control: max-age=0" CRLF
+    CRLF
+);
+
+
+ngx_bench_t  ngx_bench_http[] = {
+
+    { "http_parse_request_line", ngx_bench_http_init,
+      ngx_bench_parse_request_line, NULL, 0, 0, &ngx_bench_request_line },
+
+    /* one operation parses all ten lines of the header */
+
+    { "http_parse_header_lines", ngx_bench_http_init,
+      ngx_bench_parse_header_line, NULL, 0, 0, &ngx_bench_headers },
+
+    ngx_bench_null
+};
+
+
+static ngx_int_t
+ngx_bench_http_init(ngx_bench_t *b)
+{
+    ngx_str_t  *s = b->data;
+
+    b->bytes = s->len;
+
+    if (ngx_bench_request) {
+        return NGX_OK;
+    }
+
+    ngx_bench_request = ngx_pcalloc(ngx_bench_pool,
+                                    sizeof(ngx_http_request_t));
+    if (ngx_bench_request == NULL) {
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_parse_request_line(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_str_t  *s = b->data;
+
+    ngx_buf_t            buf;
+    ngx_uint_t           i;
+    ngx_http_request_t  *r;
+
+    r = ngx_bench_request;
+
+    ngx_memzero(&buf, sizeof(ngx_buf_t));
+
+    buf.start = s->data;
+    buf.end = s->data + s->len;
+    buf.last = buf.end;
+
+    for (i = 0; i < n; i++) {
+        buf.pos = buf.start;
+        r->state = 0;
+
+        if (ngx_http_parse_request_line(r, &buf) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_parse_header_line(ngx_bench_t *b, ngx_uint_t n)
+{
+    ngx_str_t  *s = b->data;
+
+    ngx_int_t            rc;
+    ngx_buf_t            buf;
+    ngx_uint_t           i;
+    ngx_http_request_t  *r;
+
+    r = ngx_bench_request;
+
+    ngx_memzero(&buf, sizeof(ngx_buf_t));
+
+    buf.start = s->data;
+    buf.end = s->data + s->len;
+    buf.last = buf.end;
+
+    for (i = 0; i < n; i++) {
+        buf.pos = buf.start;
+        r->state = 0;
+
+        do {
+            rc = ngx_http_parse_header_line(r, &buf, 1);
+        } while (rc == NGX_OK);
+
+        if (rc != NGX_HTTP_PARSE_HEADER_DONE) {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
@@ -0,0 +1,1607 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <nginx.h>
+#include <ngx_load.h>
+
+
+/*
+ * The load harness creates a prefix with static files and a generated
+ * configuration, starts the mock upstreams and nginx on the loopback
+ * interface and runs the scenarios one by one.  The first output line
+ * describes the run, each next one is a JSON object with the results
+ * of a scenario.
+ */
+
+
+#define NGX_LOAD_PORT        18800
+#define NGX_LOAD_MAX_URIS    16
+#define NGX_LOAD_MAX_RUNS    64
+#define NGX_LOAD_MAX_PROCS   64
+#define NGX_LOAD_MAX_WORKERS 256
+#define NGX_LOAD_CONF_SIZE   16384
+#define NGX_LOAD_BODY_MAX    (1024 * 1024)
+
+#define NGX_LOAD_PROXY       0x0001
+#define NGX_LOAD_KEEPALIVE   0x0002
+#define NGX_LOAD_FASTCGI     0x0004
+#define NGX_LOAD_MEMCACHED   0x0008
+#define NGX_LOAD_CACHE       0x0010
+#define NGX_LOAD_GZIP        0x0020
+#define NGX_LOAD_SSL         0x0040
+
+
+typedef struct {
+    char                 *name;
+    ngx_uint_t            require;
+    ngx_uint_t            ssl;
+    ngx_load_uri_t        uris[NGX_LOAD_MAX_URIS];
+} ngx_load_scenario_t;
+
+
+typedef struct {
+    ngx_pid_t             pid;
+    uint64_t              ticks;
+} ngx_load_worker_t;
+
+
+typedef struct {
+    char                 *nginx;
+    char                 *prefix;
+    char                 *http;
+    char                 *events;
+    in_port_t             port;
+    ngx_uint_t            conns;
+    ngx_uint_t            procs;
+    ngx_uint_t            workers;
+    ngx_uint_t            mocks;
+    ngx_uint_t            requests;
+    ngx_msec_t            duration;
+    ngx_msec_t            warmup;
+} ngx_load_conf_t;
+
+
+static ngx_int_t ngx_load_init(char *const *argv);
+static ngx_int_t ngx_load_options(int argc, char *const *argv, int *next);
+static ngx_load_scenario_t *ngx_load_scenario(char *name);
+static ngx_int_t ngx_load_create_prefix(void);
+static ngx_int_t ngx_load_create_conf(void);
+static ngx_int_t ngx_load_create_file(char *name, u_char *data, size_t len);
+static ngx_int_t ngx_load_delete(ngx_tree_ctx_t *ctx, ngx_str_t *path);
+static ngx_int_t ngx_load_delete_dir(ngx_tree_ctx_t *ctx, ngx_str_t *path);
+static ngx_int_t ngx_load_noop(ngx_tree_ctx_t *ctx, ngx_str_t *path);
+#if (NGX_HTTP_SSL)
+static ngx_int_t ngx_load_create_certificate(void);
+#endif
+static ngx_int_t ngx_load_start_mocks(void);
+static ngx_int_t ngx_load_start_nginx(void);
+static void ngx_load_stop(void);
+static ngx_int_t ngx_load_run(ngx_load_scenario_t *s);
+static void ngx_load_report(ngx_load_scenario_t *s, ngx_uint_t n,
+    ngx_msec_t client, ngx_load_worker_t *w0, ngx_uint_t n0,
+    ngx_load_worker_t *w1, ngx_uint_t n1);
+static ngx_uint_t ngx_load_workers(ngx_load_worker_t *w);
+static ngx_int_t ngx_load_sleep(uint64_t until);
+static ngx_msec_t ngx_load_cpu_time(void);
+static u_char *ngx_load_json(u_char *p, u_char *last, char *s);
+static void ngx_load_write(u_char *buf, u_char *last);
+static void ngx_load_signal_handler(int signo);
+
+
+static ngx_load_scenario_t  ngx_load_scenarios[] = {
+
+    { "static_1k", 0, 0,
+      { { "/static/1k", 1, 0 },
+        { NULL, 0, 0 } } },
+
+    { "static_mix", 0, 0,
+      { { "/static/1k", 50, 0 },
+        { "/static/16k", 35, 0 },
+        { "/static/128k", 12, 0 },
+        { "/static/1m", 3, 0 },
+        { NULL, 0, 0 } } },
+
+    { "gzip", NGX_LOAD_GZIP, 0,
+      { { "/gzip/text.txt", 1, 0 },
+        { NULL, 0, 0 } } },
+
+    { "ssl", NGX_LOAD_SSL, 1,
+      { { "/static/1k", 1, 0 },
+        { NULL, 0, 0 } } },
+
+    { "proxy", NGX_LOAD_PROXY, 0,
+      { { "/proxy/%ui?size=1024", 1, 1000 },
+        { NULL, 0, 0 } } },
+
+    { "proxy_keepalive", NGX_LOAD_PROXY|NGX_LOAD_KEEPALIVE, 0,
+      { { "/proxy_keepalive/%ui?size=1024", 1, 1000 },
+        { NULL, 0, 0 } } },
+
+    { "fastcgi", NGX_LOAD_FASTCGI, 0,
+      { { "/fastcgi/%ui?size=1024", 1, 1000 },
+        { NULL, 0, 0 } } },
+
+    { "memcached", NGX_LOAD_MEMCACHED, 0,
+      { { "/memcached/%ui/size=1024", 1, 1000 },
+        { NULL, 0, 0 } } },
+
+    { "cache_hit", NGX_LOAD_PROXY|NGX_LOAD_CACHE, 0,
+      { { "/cache/hot%ui?size=4096", 1, 100 },
+        { NULL, 0, 0 } } },
+
+    { "cache_mix", NGX_LOAD_PROXY|NGX_LOAD_CACHE, 0,
+      { { "/cache/hot%ui?size=4096", 9, 100 },
+        { "/cache/miss%ui?size=4096", 1, NGX_LOAD_UNIQUE },
+        { NULL, 0, 0 } } },
+
+    /* a mix close to a typical front end of an application */
+
+    { "mix", NGX_LOAD_PROXY|NGX_LOAD_CACHE|NGX_LOAD_GZIP, 0,
+      { { "/static/1k", 30, 0 },
+        { "/static/16k", 10, 0 },
+        { "/static/128k", 2, 0 },
+        { "/gzip/text.txt", 10, 0 },
+        { "/proxy/%ui?size=2048", 15, 1000 },
+        { "/cache/hot%ui?size=8192", 28, 1000 },
+        { "/cache/miss%ui?size=8192", 5, NGX_LOAD_UNIQUE },
+        { NULL, 0, 0 } } },
+
+    { NULL, 0, 0, { { NULL, 0, 0 } } }
+};
+
+
+static ngx_uint_t  ngx_load_modules = 0
+#if (NGX_LOAD_HTTP_PROXY)
+    |NGX_LOAD_PROXY
+#endif
+#if (NGX_LOAD_HTTP_UPSTREAM_KEEPALIVE)
+    |NGX_LOAD_KEEPALIVE
+#endif
+#if (NGX_LOAD_HTTP_FASTCGI)
+    |NGX_LOAD_FASTCGI
+#endif
+#if (NGX_LOAD_HTTP_MEMCACHED)
+    |NGX_LOAD_MEMCACHED
+#endif
+#if (NGX_LOAD_HTTP_PROXY && NGX_HTTP_CACHE)
+    |NGX_LOAD_CACHE
+#endif
+#if (NGX_LOAD_HTTP_GZIP)
+    |NGX_LOAD_GZIP
+#endif
+#if (NGX_HTTP_SSL)
+    |NGX_LOAD_SSL
+#endif
+    ;
+
+
+static ngx_load_scenario_t   ngx_load_custom = {
+    "custom", 0, 0, { { NULL, 0, 0 } }
+};
+
+static ngx_load_conf_t       ngx_load_conf;
+static ngx_load_stat_t      *ngx_load_stats;
+static ngx_pid_t             ngx_load_nginx_pid;
+static ngx_pid_t             ngx_load_mock_pids[NGX_LOAD_MAX_PROCS];
+static ngx_uint_t            ngx_load_nmocks;
+static sig_atomic_t          ngx_load_quit;
+
+#if (NGX_OPENSSL)
+static SSL_CTX              *ngx_load_ssl;
+#endif
+
+static ngx_log_t             ngx_load_error_log;
+static ngx_open_file_t       ngx_load_error_file;
+static ngx_cycle_t           ngx_load_cycle;
+
+ngx_log_t                   *ngx_load_log;
+
+
+int ngx_cdecl
+main(int argc, char *const *argv)
+{
+    int                   i;
+    u_char                buf[NGX_MAX_ERROR_STR], *p, *last;
+    ngx_int_t             rc;
+    ngx_uint_t            n, k;
+    ngx_load_scenario_t  *s, *run[NGX_LOAD_MAX_RUNS];
+
+    if (ngx_load_init(argv) != NGX_OK) {
+        return 1;
+    }
+
+    rc = ngx_load_options(argc, argv, &i);
+
+    if (rc == NGX_ERROR) {
+        p = ngx_sprintf(buf,
+                "usage: %s [-l] [-b nginx] [-p prefix] [-P port] [-c conns]"
+                " [-g procs] [-w workers] [-m mocks] [-k requests]"
+                " [-d sec] [-W sec] [-D http-directives]"
+                " [-e events-directives] [-u uri]... [scenario...]"
+                NGX_LINEFEED, argv[0]);
+        (void) ngx_write_fd(ngx_stderr, buf, p - buf);
+        return 1;
+    }
+
+    if (rc == NGX_DONE) {
+        for (s = ngx_load_scenarios; s->name; s++) {
+            p = ngx_sprintf(buf, "%s%s" NGX_LINEFEED, s->name,
+                            (s->require & ~ngx_load_modules)
+                            ? " (not available)" : "");
+            ngx_load_write(buf, p);
+        }
+
+        return 0;
+    }
+
+    n = 0;
+
+    if (ngx_load_custom.uris[0].uri) {
+        run[n++] = &ngx_load_custom;
+    }
+
+    for ( /* void */ ; i < argc && n < NGX_LOAD_MAX_RUNS; i++) {
+        s = ngx_load_scenario(argv[i]);
+
+        if (s == NULL) {
+            ngx_log_error(NGX_LOG_EMERG, ngx_load_log, 0,
+                          "unknown scenario \"%s\"", argv[i]);
+            return 1;
+        }
+
+        if (s->require & ~ngx_load_modules) {
+            ngx_log_error(NGX_LOG_EMERG, ngx_load_log, 0,
+                          "scenario \"%s\" needs modules "
+                          "which are not built", argv[i]);
+            return 1;
+        }
+
+        run[n++] = s;
+    }
+
+    if (n == 0) {
+        for (s = ngx_load_scenarios; s->name; s++) {
+            if ((s->require & ~ngx_load_modules) == 0) {
+                run[n++] = s;
+            }
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, ngx_load_signal_handler);
+    signal(SIGTERM, ngx_load_signal_handler);
+
+    if (ngx_load_create_prefix() != NGX_OK
+        || ngx_load_create_conf() != NGX_OK)
+    {
+        return 1;
+    }
+
+    if (ngx_load_start_mocks() != NGX_OK) {
+        ngx_load_stop();
+        return 1;
+    }
+
+    if (ngx_load_start_nginx() != NGX_OK) {
+        ngx_load_stop();
+        return 1;
+    }
+
+    p = buf;
+    last = buf + NGX_MAX_ERROR_STR;
+
+    p = ngx_slprintf(p, last, "{\"nginx\":\"" NGINX_VERSION "\","
+                              "\"ncpu\":%i,\"workers\":%ui,"
+                              "\"connections\":%ui,\"requests_per_conn\":%ui,"
+                              "\"duration_ms\":%M,\"warmup_ms\":%M,"
+                              "\"directives\":\"",
+                     ngx_ncpu, ngx_load_conf.workers,
+                     ngx_load_conf.conns * ngx_load_conf.procs,
+                     ngx_load_conf.requests, ngx_load_conf.duration,
+                     ngx_load_conf.warmup);
+    p = ngx_load_json(p, last, ngx_load_conf.http);
+    p = ngx_slprintf(p, last, "\",\"events\":\"");
+    p = ngx_load_json(p, last, ngx_load_conf.events);
+    p = ngx_slprintf(p, last, "\"}" NGX_LINEFEED);
+
+    ngx_load_write(buf, p);
+
+    rc = NGX_OK;
+
+    for (k = 0; k < n && rc == NGX_OK; k++) {
+        rc = ngx_load_run(run[k]);
+    }
+
+    ngx_load_stop();
+
+    return (rc == NGX_OK) ? 0 : 1;
+}
+
+
+static ngx_int_t
+ngx_load_init(char *const *argv)
+{
+    ngx_load_error_file.fd = ngx_stderr;
+
+    ngx_load_error_log.file = &ngx_load_error_file;
+    ngx_load_error_log.log_level = NGX_LOG_NOTICE;
+
+    ngx_load_log = &ngx_load_error_log;
+
+    ngx_load_cycle.log = ngx_load_log;
+    ngx_cycle = &ngx_load_cycle;
+
+    if (ngx_strerror_init() != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_time_init();
+
+    ngx_pid = ngx_getpid();
+    ngx_os_argv = (char **) argv;
+
+    if (ngx_os_init(ngx_load_log) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_load_cycle.pool = ngx_create_pool(NGX_CYCLE_POOL_SIZE, ngx_load_log);
+    if (ngx_load_cycle.pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_load_conf.nginx = "objs/nginx";
+    ngx_load_conf.prefix = "objs/load";
+    ngx_load_conf.http = "";
+    ngx_load_conf.events = "";
+    ngx_load_conf.port = NGX_LOAD_PORT;
+    ngx_load_conf.conns = 64;
+    ngx_load_conf.procs = 1;
+    ngx_load_conf.workers = 1;
+    ngx_load_conf.mocks = 1;
+    ngx_load_conf.requests = 0;
+    ngx_load_conf.duration = 10000;
+    ngx_load_conf.warmup = 2000;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_load_options(int argc, char *const *argv, int *next)
+{
+    int          i;
+    char        *value;
+    ngx_int_t    n;
+    ngx_uint_t   k;
+
+    k = 0;
+
+    for (i = 1; i < argc; i++) {
+
+        if (argv[i][0] != '-') {
+            break;
+        }
+
+        if (ngx_strcmp(argv[i], "-l") == 0) {
+            return NGX_DONE;
+        }
+
+        if (argv[i][1] == '\0' || argv[i][2] != '\0' || i + 1 == argc) {
+            return NGX_ERROR;
+        }
+
+        value = argv[++i];
+
+        switch (argv[i - 1][1]) {
+
+        case 'b':
+            ngx_load_conf.nginx = value;
+            continue;
+
+        case 'p':
+            ngx_load_conf.prefix = value;
+            continue;
+
+        case 'D':
+            ngx_load_conf.http = value;
+            continue;
+
+        case 'e':
+            ngx_load_conf.events = value;
+            continue;
+
+        case 'u':
+            if (k == NGX_LOAD_MAX_URIS - 1) {
+                return NGX_ERROR;
+            }
+
+            ngx_load_custom.uris[k].uri = value;
+            ngx_load_custom.uris[k].weight = 1;
+            k++;
+            continue;
+        }
+
+        n = ngx_atoi((u_char *) value, ngx_strlen(value));
+        if (n == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+
+        switch (argv[i - 1][1]) {
+
+        case 'P':
+            if (n == 0 || n > 65535 - 4) {
+                return NGX_ERROR;
+            }
+
+            ngx_load_conf.port = (in_port_t) n;
+            break;
+
+        case 'c':
+            if (n == 0) {
+                return NGX_ERROR;
+            }
+
+            ngx_load_conf.conns = n;
+            break;
+
+        case 'g':
+            if (n == 0 || n > NGX_LOAD_MAX_PROCS) {
+                return NGX_ERROR;
+            }
+
+            ngx_load_conf.procs = n;
+            break;
+
+        case 'w':
+            if (n == 0) {
+                return NGX_ERROR;
+            }
+
+            ngx_load_conf.workers = n;
+            break;
+
+        case 'm':
+            if (n == 0 || n > NGX_LOAD_MAX_PROCS) {
+                return NGX_ERROR;
+            }
+
+            ngx_load_conf.mocks = n;
+            break;
+
+        case 'k':
+            ngx_load_conf.requests = n;
+            break;
+
+        case 'd':
+            if (n == 0) {
+                return NGX_ERROR;
+            }
+
+            ngx_load_conf.duration = n * 1000;
+            break;
+
+        case 'W':
+            ngx_load_conf.warmup = n * 1000;
+            break;
+
+        default:
+            return NGX_ERROR;
+        }
+    }
+
+    *next = i;
+
+    return NGX_OK;
+}
+
+
+static ngx_load_scenario_t *
+ngx_load_scenario(char *name)
+{
+    ngx_load_scenario_t  *s;
+
+    for (s = ngx_load_scenarios; s->name; s++) {
+        if (ngx_strcmp(s->name, name) == 0) {
+            return s;
+        }
+    }
+
+    return NULL;
+}
+
+
+static ngx_int_t
+ngx_load_create_prefix(void)
+{
+    char            *dirs[] = { "", "/conf", "/logs", "/html", "/html/static",
+                                "/html/gzip", "/temp", NULL };
+    char            *files[] = { "1k", "16k", "128k", "1m", NULL };
+    size_t           sizes[] = { 1024, 16384, 131072, 1048576 };
+    char           **d;
+    u_char          *p, *data, name[NGX_MAX_PATH];
+    ngx_str_t        path;
+    ngx_err_t        err;
+    ngx_uint_t       i;
+    ngx_file_info_t  fi;
+    ngx_tree_ctx_t   tree;
+
+    if (ngx_load_conf.prefix[0] != '/') {
+        if (ngx_getcwd(name, NGX_MAX_PATH) == 0) {
+            ngx_log_error(NGX_LOG_EMERG, ngx_load_log, ngx_errno,
+                          ngx_getcwd_n " failed");
+            return NGX_ERROR;
+        }
+
+        p = ngx_pnalloc(ngx_load_cycle.pool, NGX_MAX_PATH);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_snprintf(p, NGX_MAX_PATH, "%s/%s%Z", name, ngx_load_conf.prefix);
+        ngx_load_conf.prefix = (char *) p;
+    }
+
+    for (d = dirs; *d; d++) {
+        ngx_snprintf(name, NGX_MAX_PATH, "%s%s%Z", ngx_load_conf.prefix, *d);
+
+        if (ngx_create_dir(name, 0755) == NGX_FILE_ERROR) {
+            err = ngx_errno;
+
+            if (err != NGX_EEXIST) {
+                ngx_log_error(NGX_LOG_EMERG, ngx_load_log, err,
+                              ngx_create_dir_n " \"%s\" failed", name);
+                return NGX_ERROR;
+            }
+        }
+    }
+
+    /* the cache of a previous run would turn misses into hits */
+
+    p = ngx_snprintf(name, NGX_MAX_PATH, "%s/cache%Z", ngx_load_conf.prefix);
+
+    if (ngx_file_info(name, &fi) != NGX_FILE_ERROR) {
+        path.data = name;
+        path.len = p - name - 1;
+
+        ngx_memzero(&tree, sizeof(ngx_tree_ctx_t));
+
+        tree.init_handler = NULL;
+        tree.file_handler = ngx_load_delete;
+        tree.pre_tree_handler = ngx_load_noop;
+        tree.post_tree_handler = ngx_load_delete_dir;
+        tree.spec_handler = ngx_load_delete;
+        tree.data = NULL;
+        tree.alloc = 0;
+        tree.log = ngx_load_log;
+
+        if (ngx_walk_tree(&tree, &path) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    data = ngx_alloc(NGX_LOAD_BODY_MAX, ngx_load_log);
+    if (data == NULL) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < NGX_LOAD_BODY_MAX; i++) {
+        data[i] = (u_char) ('a' + i % 26);
+    }
+
+    for (i = 0; files[i]; i++) {
+        ngx_snprintf(name, NGX_MAX_PATH, "%s/html/static/%s%Z",
+                     ngx_load_conf.prefix, files[i]);
+
+        if (ngx_load_create_file((char *) name, data, sizes[i]) != NGX_OK) {
+            ngx_free(data);
+            return NGX_ERROR;
+        }
+    }
+
+    /* a text which is compressed about five times */
+
+    p = data;
+
+    for (i = 0; p < data + 65536 - 128; i++) {
+        p = ngx_sprintf(p, "%05ui: the quick brown fox jumps over the lazy "
+                           "dog %ui times" NGX_LINEFEED, i, (i * 7919) % 1000);
+    }
+
+    ngx_snprintf(name, NGX_MAX_PATH, "%s/html/gzip/text.txt%Z",
+                 ngx_load_conf.prefix);
+
+    if (ngx_load_create_file((char *) name, data, p - data) != NGX_OK) {
+        ngx_free(data);
+        return NGX_ERROR;
+    }
+
+    ngx_free(data);
+
+#if (NGX_HTTP_SSL)
+    if (ngx_load_create_certificate() != NGX_OK) {
+        return NGX_ERROR;
+    }
+#endif
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_load_create_conf(void)
+{
+    u_char          *buf, *p, *last, name[NGX_MAX_PATH];
+    in_port_t        port;
+    ngx_uint_t       conns;
+    struct group    *grp;
+    struct passwd   *pwd;
+
+    buf = ngx_pnalloc(ngx_load_cycle.pool, NGX_LOAD_CONF_SIZE);
+    if (buf == NULL) {
+        return NGX_ERROR;
+    }
+
+    p = buf;
+    last = buf + NGX_LOAD_CONF_SIZE;
+
+    port = ngx_load_conf.port;
+    conns = ngx_load_conf.conns * ngx_load_conf.procs;
+
+    if (geteuid() == 0) {
+        pwd = getpwuid(geteuid());
+        grp = getgrgid(getegid());
+
+        if (pwd && grp) {
+            p = ngx_slprintf(p, last, "user  %s %s;\n",
+                             pwd->pw_name, grp->gr_name);
+        }
+    }
+
+    p = ngx_slprintf(p, last,
+        "worker_processes  %ui;\n"
+        "daemon  off;\n"
+        "master_process  on;\n"
+        "error_log  logs/error.log  warn;\n"
+        "pid  logs/nginx.pid;\n"
+        "\n"
+        "events {\n"
+        "    worker_connections  %ui;\n"
+        "    %s\n"
+        "}\n"
+        "\n"
+        "http {\n"
+        "    types {\n"
+        "        text/html   html;\n"
+        "        text/plain  txt;\n"
+        "    }\n"
+        "\n"
+        "    default_type  application/octet-stream;\n"
+        "    access_log  off;\n"
+        "    keepalive_requests  1000000;\n"
+        "    client_body_temp_path  temp/client_body;\n"
+        "\n"
+        "    %s\n"
+        "\n",
+        ngx_load_conf.workers, 1024 + 4 * conns, ngx_load_conf.events,
+        ngx_load_conf.http);
+
+    if (ngx_load_modules & NGX_LOAD_PROXY) {
+        p = ngx_slprintf(p, last,
+            "    proxy_temp_path  temp/proxy;\n"
+            "\n"
+            "    upstream load_http {\n"
+            "        server  127.0.0.1:%d;\n"
+            "    }\n"
+            "\n",
+            port + 2);
+    }
+
+    if (ngx_load_modules & NGX_LOAD_KEEPALIVE) {
+        p = ngx_slprintf(p, last,
+            "    upstream load_http_keepalive {\n"
+            "        server  127.0.0.1:%d;\n"
+            "        keepalive  %ui;\n"
+            "    }\n"
+            "\n",
+            port + 2, ngx_min(conns, 1024));
+    }
+
+    if (ngx_load_modules & NGX_LOAD_CACHE) {
+        p = ngx_slprintf(p, last,
+            "    proxy_cache_path  cache  levels=1:2  keys_zone=load:16m"
+            "  max_size=1g  inactive=1h;\n"
+            "\n");
+    }
+
+    if (ngx_load_modules & NGX_LOAD_FASTCGI) {
+        p = ngx_slprintf(p, last, "    fastcgi_temp_path  temp/fastcgi;\n\n");
+    }
+
+    if (ngx_load_modules & NGX_LOAD_MEMCACHED) {
+        p = ngx_slprintf(p, last,
+            "    map  $uri  $memcached_key {\n"
+            "        default  $uri;\n"
+            "    }\n"
+            "\n");
+    }
+
+    p = ngx_slprintf(p, last,
+        "    server {\n"
+        "        listen  127.0.0.1:%d;\n",
+        port);
+
+#if (NGX_HTTP_SSL)
+    p = ngx_slprintf(p, last,
+        "        listen  127.0.0.1:%d  ssl;\n"
+        "\n"
+        "        ssl_certificate      %s/conf/load.crt;\n"
+        "        ssl_certificate_key  %s/conf/load.key;\n"
+        "        ssl_session_cache    shared:SSL:16m;\n",
+        port + 1, ngx_load_conf.prefix, ngx_load_conf.prefix);
+#endif
+
+    p = ngx_slprintf(p, last,
+        "\n"
+        "        location /static/ {\n"
+        "            root  html;\n"
+        "        }\n");
+
+    if (ngx_load_modules & NGX_LOAD_GZIP) {
+        p = ngx_slprintf(p, last,
+            "\n"
+            "        location /gzip/ {\n"
+            "            root  html;\n"
+            "            gzip  on;\n"
+            "            gzip_types  text/plain;\n"
+            "        }\n");
+    }
+
+    if (ngx_load_modules & NGX_LOAD_PROXY) {
+        p = ngx_slprintf(p, last,
+            "\n"
+            "        location /proxy/ {\n"
+            "            proxy_pass  http://load_http/;\n"
+            "        }\n");
+    }
+
+    if (ngx_load_modules & NGX_LOAD_KEEPALIVE) {
+        p = ngx_slprintf(p, last,
+            "\n"
+            "        location /proxy_keepalive/ {\n"
+            "            proxy_pass  http://load_http_keepalive/;\n"
+            "            proxy_http_version  1.1;\n"
+            "            proxy_set_header  Connection  \"\";\n"
+            "        }\n");
+    }
+
+    if (ngx_load_modules & NGX_LOAD_CACHE) {
+        p = ngx_slprintf(p, last,
+            "\n"
+            "        location /cache/ {\n"
+            "            proxy_pass  http://load_http/;\n"
+            "            proxy_cache  load;\n"
+            "            proxy_cache_valid  200  1h;\n"
+            "        }\n");
+    }
+
+    if (ngx_load_modules & NGX_LOAD_FASTCGI) {
+        p = ngx_slprintf(p, last,
+            "\n"
+            "        location /fastcgi/ {\n"
+            "            fastcgi_pass  127.0.0.1:%d;\n"
+            "            fastcgi_param  QUERY_STRING  $query_string;\n"
+            "            fastcgi_param  REQUEST_URI   $request_uri;\n"
+            "        }\n",
+            port + 3);
+    }
+
+    if (ngx_load_modules & NGX_LOAD_MEMCACHED) {
+        p = ngx_slprintf(p, last,
+            "\n"
+            "        location /memcached/ {\n"
+            "            memcached_pass  127.0.0.1:%d;\n"
+            "        }\n",
+            port + 4);
+    }
+
+    p = ngx_slprintf(p, last, "    }\n" "}\n");
+
+    if (p == last) {
+        ngx_log_error(NGX_LOG_EMERG, ngx_load_log, 0,
+                      "configuration is too large");
+        return NGX_ERROR;
+    }
+
+    ngx_snprintf(name, NGX_MAX_PATH, "%s/conf/nginx.conf%Z",
+                 ngx_load_conf.prefix);
+
+    return ngx_load_create_file((char *) name, buf, p - buf);
+}
+
+
+static ngx_int_t
+ngx_load_create_file(char *name, u_char *data, size_t len)
+{
+    ssize_t   n;
+    ngx_fd_t  fd;
+
+    fd = ngx_open_file(name, NGX_FILE_WRONLY, NGX_FILE_TRUNCATE,
+                       NGX_FILE_DEFAULT_ACCESS);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_error(NGX_LOG_EMERG, ngx_load_log, ngx_errno,
+                      ngx_open_file_n " \"%s\" failed", name);
+        return NGX_ERROR;
+    }
+
+    n = ngx_write_fd(fd, data, len);
+
+    if (n != (ssize_t) len) {
+        ngx_log_error(NGX_LOG_EMERG, ngx_load_log, ngx_errno,
+                      ngx_write_fd_n " \"%s\" failed", name);
+        (void) ngx_close_file(fd);
+        return NGX_ERROR;
+    }
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_load_log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", name);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_load_delete(ngx_tree_ctx_t *ctx, ngx_str_t *path)
+{
+    if (ngx_delete_file(path->data) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, ctx->log, ngx_errno,
+                      ngx_delete_file_n " \"%s\" failed", path->data);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_load_delete_dir(ngx_tree_ctx_t *ctx, ngx_str_t *path)
+{
+    if (ngx_delete_dir(path->data) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, ctx->log, ngx_errno,
+                      ngx_delete_dir_n " \"%s\" failed", path->data);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_load_noop(ngx_tree_ctx_t *ctx, ngx_str_t *path)
+{
+    return NGX_OK;
+}
+
+
+#if (NGX_HTTP_SSL)
+
+static ngx_int_t
+ngx_load_create_certificate(void)
+{
+    u_char           crt[NGX_MAX_PATH], key[NGX_MAX_PATH];
+    FILE            *f;
+    X509            *x509;
+    EVP_PKEY        *pkey;
+    ngx_int_t        rc;
+    X509_NAME       *name;
+    EVP_PKEY_CTX    *ctx;
+    ngx_file_info_t  fi;
+
+    ngx_snprintf(crt, NGX_MAX_PATH, "%s/conf/load.crt%Z",
+                 ngx_load_conf.prefix);
+    ngx_snprintf(key, NGX_MAX_PATH, "%s/conf/load.key%Z",
+                 ngx_load_conf.prefix);
+
+    if (ngx_file_info(crt, &fi) != NGX_FILE_ERROR
+        && ngx_file_info(key, &fi) != NGX_FILE_ERROR)
+    {
+        return NGX_OK;
+    }
+
+    ngx_ssl_init(ngx_load_log);
+
+    rc = NGX_ERROR;
+
+    pkey = NULL;
+    x509 = NULL;
+
+    ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+
+    if (ctx == NULL
+        || EVP_PKEY_keygen_init(ctx) <= 0
+        || EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048) <= 0
+        || EVP_PKEY_keygen(ctx, &pkey) <= 0)
+    {
+        goto failed;
+    }
+
+    x509 = X509_new();
+    if (x509 == NULL) {
+        goto failed;
+    }
+
+    X509_set_version(x509, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x509), 10 * 365 * 86400L);
+#else
+    X509_gmtime_adj(X509_get_notBefore(x509), 0);
+    X509_gmtime_adj(X509_get_notAfter(x509), 10 * 365 * 86400L);
+#endif
+
+    name = X509_get_subject_name(x509);
+
+    if (X509_set_pubkey(x509, pkey) == 0
+        || X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                      (u_char *) "localhost", -1, -1, 0)
+           == 0
+        || X509_set_issuer_name(x509, name) == 0
+        || X509_sign(x509, pkey, EVP_sha256()) == 0)
+    {
+        goto failed;
+    }
+
+    f = fopen((char *) key, "w");
+    if (f == NULL) {
+        goto failed;
+    }
+
+    if (PEM_write_PrivateKey(f, pkey, NULL, NULL, 0, NULL, NULL) == 0) {
+        fclose(f);
+        goto failed;
+    }
+
+    fclose(f);
+
+    f = fopen((char *) crt, "w");
+    if (f == NULL) {
+        goto failed;
+    }
+
+    if (PEM_write_X509(f, x509) == 0) {
+        fclose(f);
+        goto failed;
+    }
+
+    fclose(f);
+
+    rc = NGX_OK;
+
+failed:
+
+    if (rc != NGX_OK) {
+        ngx_ssl_error(NGX_LOG_EMERG, ngx_load_log, 0,
+                      "cannot create a certificate");
+    }
+
+    if (x509) {
+        X509_free(x509);
+    }
+
+    if (pkey) {
+        EVP_PKEY_free(pkey);
+    }
+
+    if (ctx) {
+        EVP_PKEY_CTX_free(ctx);
+    }
+
+    return rc;
+}
+
+#endif
+
+
+static ngx_int_t
+ngx_load_start_mocks(void)
+{
+    int                 on;
+    ngx_uint_t          i;
+    ngx_pid_t           pid;
+    ngx_socket_t        s;
+    struct sockaddr_in  sin;
+    ngx_load_listen_t   ls[NGX_LOAD_MOCK_LAST];
+
+    ngx_memzero(&sin, sizeof(struct sockaddr_in));
+
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (i = 0; i < NGX_LOAD_MOCK_LAST; i++) {
+        ls[i].fd = (ngx_socket_t) -1;
+        ls[i].type = i;
+    }
+
+    for (i = 0; i < NGX_LOAD_MOCK_LAST; i++) {
+        s = ngx_socket(AF_INET, SOCK_STREAM, 0);
+        if (s == (ngx_socket_t) -1) {
+            ngx_log_error(NGX_LOG_EMERG, ngx_load_log, ngx_socket_errno,
+                          ngx_socket_n " failed");
+            goto failed;
+        }
+
+        ls[i].fd = s;
+
+        on = 1;
+        sin.sin_port = htons((in_port_t) (ngx_load_conf.port + 2 + i));
+
+        if (setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const void *) &on,
+                       sizeof(int))
+            == -1
+            || bind(s, (struct sockaddr *) &sin, sizeof(sin)) == -1
+            || listen(s, NGX_LISTEN_BACKLOG) == -1
+            || ngx_nonblocking(s) == -1)
+        {
+            ngx_log_error(NGX_LOG_EMERG, ngx_load_log, ngx_socket_errno,
+                          "cannot listen on 127.0.0.1:%d",
+                          ngx_load_conf.port + 2 + i);
+            goto failed;
+        }
+    }
+
+    for (i = 0; i < ngx_load_conf.mocks; i++) {
+
+        pid = fork();
+
+        if (pid == -1) {
+            ngx_log_error(NGX_LOG_EMERG, ngx_load_log, ngx_errno,
+                          "fork() failed");
+            goto failed;
+        }
+
+        if (pid == 0) {
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTERM, SIG_DFL);
+
+            ngx_pid = ngx_getpid();
+
+            ngx_load_mock(ls, NGX_LOAD_MOCK_LAST, NGX_LOAD_BODY_MAX);
+            exit(0);
+        }
+
+        ngx_load_mock_pids[ngx_load_nmocks++] = pid;
+    }
+
+    for (i = 0; i < NGX_LOAD_MOCK_LAST; i++) {
+        ngx_close_socket(ls[i].fd);
+    }
+
+    return NGX_OK;
+
+failed:
+
+    for (i = 0; i < NGX_LOAD_MOCK_LAST; i++) {
+        if (ls[i].fd != (ngx_socket_t) -1) {
+            ngx_close_socket(ls[i].fd);
+        }
+    }
+
+    return NGX_ERROR;
+}
+
+
+static ngx_int_t
+ngx_load_start_nginx(void)
+{
+    int                 status;
+    char               *argv[6];
+    uint64_t            until;
+    ngx_socket_t        s;
+    struct sockaddr_in  sin;
+
+    argv[0] = ngx_load_conf.nginx;
+    argv[1] = "-p";
+    argv[2] = ngx_load_conf.prefix;
+    argv[3] = "-c";
+    argv[4] = "conf/nginx.conf";
+    argv[5] = NULL;
+
+    ngx_load_nginx_pid = fork();
+
+    if (ngx_load_nginx_pid == -1) {
+        ngx_log_error(NGX_LOG_EMERG, ngx_load_log, ngx_errno,
+                      "fork() failed");
+        return NGX_ERROR;
+    }
+
+    if (ngx_load_nginx_pid == 0) {
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+
+        execv(argv[0], argv);
+
+        ngx_log_error(NGX_LOG_EMERG, ngx_load_log, ngx_errno,
+                      "execv(\"%s\") failed", argv[0]);
+        exit(1);
+    }
+
+    /* wait until nginx accepts connections */
+
+    ngx_memzero(&sin, sizeof(struct sockaddr_in));
+
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(ngx_load_conf.port);
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    until = ngx_load_usec() + 10000000;
+
+    while (ngx_load_usec() < until && !ngx_load_quit) {
+
+        if (waitpid(ngx_load_nginx_pid, &status, WNOHANG) != 0) {
+            ngx_log_error(NGX_LOG_EMERG, ngx_load_log, 0,
+                          "nginx exited, see %s/logs/error.log",
+                          ngx_load_conf.prefix);
+            ngx_load_nginx_pid = 0;
+            return NGX_ERROR;
+        }
+
+        s = ngx_socket(AF_INET, SOCK_STREAM, 0);
+        if (s == (ngx_socket_t) -1) {
+            return NGX_ERROR;
+        }
+
+        if (connect(s, (struct sockaddr *) &sin, sizeof(sin)) == 0) {
+            ngx_close_socket(s);
+            return NGX_OK;
+        }
+
+        ngx_close_socket(s);
+
+        ngx_msleep(50);
+    }
+
+    ngx_log_error(NGX_LOG_EMERG, ngx_load_log, 0,
+                  "nginx does not accept connections on 127.0.0.1:%d",
+                  ngx_load_conf.port);
+
+    return NGX_ERROR;
+}
+
+
+static void
+ngx_load_stop(void)
+{
+    int         status;
+    ngx_uint_t  i;
+
+    if (ngx_load_nginx_pid > 0) {
+        kill(ngx_load_nginx_pid, SIGTERM);
+        waitpid(ngx_load_nginx_pid, &status, 0);
+        ngx_load_nginx_pid = 0;
+    }
+
+    for (i = 0; i < ngx_load_nmocks; i++) {
+        kill(ngx_load_mock_pids[i], SIGTERM);
+    }
+
+    for (i = 0; i < ngx_load_nmocks; i++) {
+        waitpid(ngx_load_mock_pids[i], &status, 0);
+    }
+
+    ngx_load_nmocks = 0;
+}
+
+
+static ngx_int_t
+ngx_load_run(ngx_load_scenario_t *s)
+{
+    int                      status;
+    size_t                   size;
+    ngx_int_t                rc;
+    ngx_msec_t               cpu;
+    ngx_uint_t               i, n, n0, n1;
+    ngx_pid_t                pids[NGX_LOAD_MAX_PROCS];
+    ngx_shm_t                shm;
+    ngx_load_worker_t        w0[NGX_LOAD_MAX_WORKERS];
+    ngx_load_worker_t        w1[NGX_LOAD_MAX_WORKERS];
+    ngx_load_client_conf_t   cf;
+
+    size = ngx_load_conf.procs * sizeof(ngx_load_stat_t);
+
+    ngx_memzero(&shm, sizeof(ngx_shm_t));
+
+    shm.size = size;
+    shm.name.len = sizeof("load") - 1;
+    shm.name.data = (u_char *) "load";
+    shm.log = ngx_load_log;
+
+    if (ngx_shm_alloc(&shm) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_load_stats = (ngx_load_stat_t *) shm.addr;
+    ngx_memzero(ngx_load_stats, size);
+
+    ngx_memzero(&cf, sizeof(ngx_load_client_conf_t));
+
+    cf.port = (in_port_t) (ngx_load_conf.port + (s->ssl ? 1 : 0));
+    cf.conns = ngx_load_conf.conns;
+    cf.requests = ngx_load_conf.requests;
+    cf.uris = s->uris;
+
+    for (cf.nuris = 0; s->uris[cf.nuris].uri; cf.nuris++) {
+        /* void */
+    }
+
+#if (NGX_OPENSSL)
+    if (s->ssl) {
+        if (ngx_load_ssl == NULL) {
+            ngx_ssl_init(ngx_load_log);
+
+            ngx_load_ssl = SSL_CTX_new(SSLv23_client_method());
+            if (ngx_load_ssl == NULL) {
+                ngx_ssl_error(NGX_LOG_EMERG, ngx_load_log, 0,
+                              "SSL_CTX_new() failed");
+                ngx_shm_free(&shm);
+                return NGX_ERROR;
+            }
+
+            SSL_CTX_set_verify(ngx_load_ssl, SSL_VERIFY_NONE, NULL);
+        }
+
+        cf.ssl = ngx_load_ssl;
+    }
+#endif
+
+    cf.start = ngx_load_usec() + (uint64_t) ngx_load_conf.warmup * 1000;
+    cf.end = cf.start + (uint64_t) ngx_load_conf.duration * 1000;
+
+    cpu = ngx_load_cpu_time();
+
+    for (n = 0; n < ngx_load_conf.procs; n++) {
+        cf.id = n;
+
+        pids[n] = fork();
+
+        if (pids[n] == -1) {
+            ngx_log_error(NGX_LOG_EMERG, ngx_load_log, ngx_errno,
+                          "fork() failed");
+            break;
+        }
+
+        if (pids[n] == 0) {
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTERM, SIG_DFL);
+
+            ngx_pid = ngx_getpid();
+
+            rc = ngx_load_client(&cf, &ngx_load_stats[n]);
+            exit(rc == NGX_OK ? 0 : 2);
+        }
+    }
+
+    rc = ngx_load_sleep(cf.start);
+
+    n0 = ngx_load_workers(w0);
+
+    if (rc == NGX_OK) {
+        rc = ngx_load_sleep(cf.end);
+    }
+
+    n1 = ngx_load_workers(w1);
+
+    for (i = 0; i < n; i++) {
+        if (rc != NGX_OK) {
+            kill(pids[i], SIGTERM);
+        }
+
+        if (waitpid(pids[i], &status, 0) == -1
+            || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            rc = NGX_ERROR;
+        }
+    }
+
+    cpu = ngx_load_cpu_time() - cpu;
+
+    if (rc == NGX_OK && n == ngx_load_conf.procs) {
+        ngx_load_report(s, n, cpu, w0, n0, w1, n1);
+
+    } else {
+        rc = NGX_ERROR;
+    }
+
+    ngx_shm_free(&shm);
+
+    return rc;
+}
+
+
+static void
+ngx_load_report(ngx_load_scenario_t *s, ngx_uint_t n, ngx_msec_t client,
+    ngx_load_worker_t *w0, ngx_uint_t n0, ngx_load_worker_t *w1,
+    ngx_uint_t n1)
+{
+    u_char            buf[NGX_MAX_ERROR_STR * 2], *p, *last;
+    double            sec;
+    uint64_t          total, sum, q[4], max;
+    ngx_uint_t        i, k, j, ticks;
+    ngx_load_stat_t   st;
+    static double     quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+    ngx_memzero(&st, sizeof(ngx_load_stat_t));
+
+    max = 0;
+
+    for (i = 0; i < n; i++) {
+        st.requests += ngx_load_stats[i].requests;
+        st.bytes += ngx_load_stats[i].bytes;
+        st.errors += ngx_load_stats[i].errors;
+        st.latency += ngx_load_stats[i].latency;
+
+        for (k = 0; k < 6; k++) {
+            st.status[k] += ngx_load_stats[i].status[k];
+        }
+
+        for (k = 0; k < NGX_LOAD_HIST_SIZE; k++) {
+            st.hist[k] += ngx_load_stats[i].hist[k];
+        }
+
+        max = ngx_max(max, ngx_load_stats[i].latency_max);
+    }
+
+    total = st.requests;
+
+    for (j = 0; j < 4; j++) {
+        q[j] = 0;
+        sum = 0;
+
+        for (k = 0; k < NGX_LOAD_HIST_SIZE && total; k++) {
+            sum += st.hist[k];
+
+            if (sum >= (uint64_t) (quantiles[j] * total + 0.5)) {
+                q[j] = ngx_min(ngx_load_hist_value(k), max);
+                break;
+            }
+        }
+    }
+
+    sec = (double) ngx_load_conf.duration / 1000;
+
+    p = buf;
+    last = buf + sizeof(buf);
+
+    p = ngx_slprintf(p, last,
+            "{\"scenario\":\"%s\",\"requests\":%uL,\"rps\":%.1f,"
+            "\"mb_per_sec\":%.2f,\"errors\":%uL,\"non_2xx\":%uL,"
+            "\"latency_us\":{\"mean\":%uL,\"p50\":%uL,\"p90\":%uL,"
+            "\"p99\":%uL,\"p999\":%uL,\"max\":%uL},"
+            "\"client_cpu_pct\":%.1f,\"workers\":[",
+            s->name, total, total / sec,
+            st.bytes / sec / 1000000, st.errors, total - st.status[2],
+            total ? st.latency / total : 0, q[0], q[1], q[2], q[3], max,
+            client * 100.0 / (ngx_load_conf.warmup + ngx_load_conf.duration));
+
+    /* the CPU usage of workers which run through the whole measurement */
+
+    for (i = 0, j = 0; i < n1; i++) {
+        for (k = 0; k < n0; k++) {
+            if (w0[k].pid == w1[i].pid) {
+                break;
+            }
+        }
+
+        if (k == n0) {
+            continue;
+        }
+
+        ticks = (ngx_uint_t) (w1[i].ticks - w0[k].ticks);
+
+        p = ngx_slprintf(p, last, "%s{\"pid\":%P,\"cpu_pct\":%.1f}",
+                         j++ ? "," : "", w1[i].pid,
+                         ticks * 100.0 / sysconf(_SC_CLK_TCK) / sec);
+    }
+
+    p = ngx_slprintf(p, last, "]}" NGX_LINEFEED);
+
+    ngx_load_write(buf, p);
+}
+
+
+#if (NGX_LINUX)
+
+static ngx_uint_t
+ngx_load_workers(ngx_load_worker_t *w)
+{
+    u_char     *p, *last, buf[512], name[64];
+    ssize_t     len;
+    ngx_fd_t    fd;
+    ngx_int_t   pid;
+    ngx_str_t   proc;
+    ngx_dir_t   dir;
+    ngx_uint_t  n, i;
+    uint64_t    ticks;
+
+    ngx_str_set(&proc, "/proc");
+
+    if (ngx_open_dir(&proc, &dir) == NGX_ERROR) {
+        return 0;
+    }
+
+    n = 0;
+
+    while (n < NGX_LOAD_MAX_WORKERS && ngx_read_dir(&dir) == NGX_OK) {
+
+        pid = ngx_atoi(ngx_de_name(&dir), ngx_de_namelen(&dir));
+        if (pid == NGX_ERROR) {
+            continue;
+        }
+
+        ngx_snprintf(name, sizeof(name), "/proc/%i/stat%Z", pid);
+
+        fd = ngx_open_file(name, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+        if (fd == NGX_INVALID_FILE) {
+            continue;
+        }
+
+        len = ngx_read_fd(fd, buf, sizeof(buf) - 1);
+        (void) ngx_close_file(fd);
+
+        if (len <= 0) {
+            continue;
+        }
+
+        /* "pid (comm) state ppid ... utime stime", the comm may have spaces */
+
+        last = buf + len;
+
+        for (p = last; p > buf && *p != ')'; p--) {
+            /* void */
+        }
+
+        ticks = 0;
+
+        for (i = 3; p < last && i <= 15; i++) {
+
+            for (p++; p < last && *p != ' '; p++) {
+                /* void */
+            }
+
+            if (i == 4
+                && ngx_atoi(p + 1, ngx_strlchr(p + 1, last, ' ') - p - 1)
+                   != ngx_load_nginx_pid)
+            {
+                break;
+            }
+
+            if (i == 14 || i == 15) {
+                ticks += ngx_atoof(p + 1, ngx_strlchr(p + 1, last, ' ')
+                                          - p - 1);
+            }
+        }
+
+        if (i <= 15) {
+            continue;
+        }
+
+        /* the cache manager and loader are children of the master too */
+
+        ngx_snprintf(name, sizeof(name), "/proc/%i/cmdline%Z", pid);
+
+        fd = ngx_open_file(name, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+        if (fd == NGX_INVALID_FILE) {
+            continue;
+        }
+
+        len = ngx_read_fd(fd, buf, sizeof(buf) - 1);
+        (void) ngx_close_file(fd);
+
+        if (len <= 0 || ngx_strnstr(buf, "worker process", len) == NULL) {
+            continue;
+        }
+
+        w[n].pid = pid;
+        w[n].ticks = ticks;
+        n++;
+    }
+
+    (void) ngx_close_dir(&dir);
+
+    return n;
+}
+
+#else
+
+static ngx_uint_t
+ngx_load_workers(ngx_load_worker_t *w)
+{
+    return 0;
+}
+
+#endif
+
+
+static ngx_int_t
+ngx_load_sleep(uint64_t until)
+{
+    uint64_t  now;
+
+    for ( ;; ) {
+        if (ngx_load_quit) {
+            return NGX_ERROR;
+        }
+
+        now = ngx_load_usec();
+
+        if (now >= until) {
+            return NGX_OK;
+        }
+
+        ngx_msleep(ngx_min((until - now) / 1000 + 1, 100));
+    }
+}
+
+
+static ngx_msec_t
+ngx_load_cpu_time(void)
+{
+    struct rusage  ru;
+
+    if (getrusage(RUSAGE_CHILDREN, &ru) == -1) {
+        return 0;
+    }
+
+    return ru.ru_utime.tv_sec * 1000 + ru.ru_utime.tv_usec / 1000
+           + ru.ru_stime.tv_sec * 1000 + ru.ru_stime.tv_usec / 1000;
+}
+
+
+static u_char *
+ngx_load_json(u_char *p, u_char *last, char *s)
+{
+    for ( /* void */ ; *s && p < last - 1; s++) {
+
+        if (*s == '"' || *s == '\\') {
+            *p++ = '\\';
+
+        } else if ((u_char) *s < 0x20) {
+            continue;
+        }
+
+        *p++ = *s;
+    }
+
+    return p;
+}
+
+
+uint64_t
+ngx_load_usec(void)
+{
+    struct timeval  tv;
+
+    ngx_gettimeofday(&tv);
+
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+
+static void
+ngx_load_write(u_char *buf, u_char *last)
+{
+    (void) ngx_write_fd(ngx_stdout, buf, last - buf);
+}
+
+
+static void
+ngx_load_signal_handler(int signo)
+{
+    ngx_load_quit = 1;
+}
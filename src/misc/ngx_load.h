@@ -0,0 +1,84 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_LOAD_H_INCLUDED_
+#define _NGX_LOAD_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+#define NGX_LOAD_HIST_SIZE     1024
+#define NGX_LOAD_UNIQUE        ((ngx_uint_t) -1)
+
+#define NGX_LOAD_MOCK_HTTP       0
+#define NGX_LOAD_MOCK_FASTCGI    1
+#define NGX_LOAD_MOCK_MEMCACHED  2
+#define NGX_LOAD_MOCK_LAST       3
+
+
+/*
+ * "uri" is an ngx_sprintf() format, it gets a key when "keys" is set:
+ * a random one below "keys" or a new one for each request if NGX_LOAD_UNIQUE
+ */
+
+typedef struct {
+    char                *uri;
+    ngx_uint_t           weight;
+    ngx_uint_t           keys;
+} ngx_load_uri_t;
+
+
+typedef struct {
+    uint64_t             requests;
+    uint64_t             bytes;
+    uint64_t             errors;
+    uint64_t             status[6];
+    uint64_t             latency;
+    uint64_t             latency_max;
+    uint64_t             hist[NGX_LOAD_HIST_SIZE];
+} ngx_load_stat_t;
+
+
+typedef struct {
+    in_port_t            port;
+    ngx_uint_t           id;
+    ngx_uint_t           conns;
+    ngx_uint_t           requests;
+
+    ngx_load_uri_t      *uris;
+    ngx_uint_t           nuris;
+
+    uint64_t             start;
+    uint64_t             end;
+
+#if (NGX_OPENSSL)
+    SSL_CTX             *ssl;
+#endif
+} ngx_load_client_conf_t;
+
+
+typedef struct {
+    ngx_socket_t         fd;
+    ngx_uint_t           type;
+} ngx_load_listen_t;
+
+
+ngx_int_t ngx_load_client(ngx_load_client_conf_t *cf, ngx_load_stat_t *st);
+ngx_uint_t ngx_load_hist_index(uint64_t usec);
+uint64_t ngx_load_hist_value(ngx_uint_t index);
+
+void ngx_load_mock(ngx_load_listen_t *ls, ngx_uint_t n, size_t size);
+
+uint64_t ngx_load_usec(void);
+
+
+extern ngx_log_t  *ngx_load_log;
+
+
+#endif /* _NGX_LOAD_H_INCLUDED_ */
@@ -0,0 +1,807 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_load.h>
+
+
+/*
+ * A closed loop load generator: every connection sends the next request
+ * as soon as the previous response is read.  The latency of a request on
+ * a new connection includes connect() and the SSL handshake.
+ */
+
+
+#define NGX_LOAD_BUFFER       16384
+#define NGX_LOAD_REQUEST      1024
+
+#define NGX_LOAD_CONNECT      0
+#define NGX_LOAD_HANDSHAKE    1
+#define NGX_LOAD_SEND         2
+#define NGX_LOAD_RECV         3
+
+#define NGX_LOAD_HEADER       0
+#define NGX_LOAD_BODY         1
+#define NGX_LOAD_CHUNK_SIZE   2
+#define NGX_LOAD_CHUNK_DATA   3
+#define NGX_LOAD_TRAILER      4
+#define NGX_LOAD_EOF          5
+
+
+typedef struct {
+    ngx_socket_t              fd;
+    ngx_uint_t                state;
+    ngx_uint_t                parse;
+    short                     events;
+
+    ngx_uint_t                status;
+    ngx_uint_t                close;
+    ngx_uint_t                requests;
+    off_t                     rest;
+
+    uint64_t                  start;
+    size_t                    bytes;
+
+    size_t                    out_len;
+    size_t                    sent;
+    size_t                    in_len;
+
+#if (NGX_OPENSSL)
+    SSL                      *ssl;
+    SSL_SESSION              *session;
+#endif
+
+    u_char                    out[NGX_LOAD_REQUEST];
+    u_char                    in[NGX_LOAD_BUFFER];
+} ngx_load_conn_t;
+
+
+static ngx_int_t ngx_load_connect(ngx_load_conn_t *c);
+static ngx_int_t ngx_load_handler(ngx_load_conn_t *c);
+static ngx_int_t ngx_load_send_request(ngx_load_conn_t *c);
+static ngx_int_t ngx_load_read_response(ngx_load_conn_t *c);
+static ngx_int_t ngx_load_parse(ngx_load_conn_t *c);
+static ngx_int_t ngx_load_parse_header(ngx_load_conn_t *c, u_char *p,
+    u_char *last);
+static ngx_int_t ngx_load_done(ngx_load_conn_t *c);
+static void ngx_load_request(ngx_load_conn_t *c);
+static void ngx_load_close(ngx_load_conn_t *c);
+static ssize_t ngx_load_recv(ngx_load_conn_t *c, u_char *buf, size_t size);
+static ssize_t ngx_load_send(ngx_load_conn_t *c, u_char *buf, size_t size);
+static uint32_t ngx_load_random(void);
+
+
+static ngx_load_client_conf_t  *ngx_load_conf;
+static ngx_load_stat_t         *ngx_load_stat;
+static ngx_uint_t               ngx_load_weight;
+static uint64_t                 ngx_load_seq;
+static uint32_t                 ngx_load_seed;
+static struct sockaddr_in       ngx_load_sin;
+
+
+ngx_int_t
+ngx_load_client(ngx_load_client_conf_t *cf, ngx_load_stat_t *st)
+{
+    int               rc;
+    uint64_t          now;
+    ngx_err_t         err;
+    ngx_uint_t        i;
+    struct pollfd    *pfd;
+    ngx_load_conn_t  *conns, *c;
+
+    ngx_load_conf = cf;
+    ngx_load_stat = st;
+
+    ngx_load_weight = 0;
+
+    for (i = 0; i < cf->nuris; i++) {
+        ngx_load_weight += cf->uris[i].weight;
+    }
+
+    /* the same sequence of requests in every run */
+
+    ngx_load_seed = (uint32_t) (2463534242U + cf->id * 0x9e3779b9U);
+    ngx_load_seq = cf->start;
+
+    ngx_load_sin.sin_family = AF_INET;
+    ngx_load_sin.sin_port = htons(cf->port);
+    ngx_load_sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    conns = ngx_calloc(cf->conns * sizeof(ngx_load_conn_t), ngx_load_log);
+    pfd = ngx_alloc(cf->conns * sizeof(struct pollfd), ngx_load_log);
+
+    if (conns == NULL || pfd == NULL) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < cf->conns; i++) {
+        conns[i].fd = (ngx_socket_t) -1;
+    }
+
+    for ( ;; ) {
+
+        now = ngx_load_usec();
+
+        if (now >= cf->end) {
+            break;
+        }
+
+        for (i = 0; i < cf->conns; i++) {
+            c = &conns[i];
+
+            if (c->fd == (ngx_socket_t) -1 && ngx_load_connect(c) != NGX_OK) {
+                if (now >= cf->start) {
+                    st->errors++;
+                }
+            }
+
+            pfd[i].fd = c->fd;
+            pfd[i].events = c->events;
+            pfd[i].revents = 0;
+        }
+
+        rc = poll(pfd, cf->conns, 100);
+
+        if (rc == -1) {
+            err = ngx_errno;
+
+            if (err == NGX_EINTR) {
+                continue;
+            }
+
+            ngx_log_error(NGX_LOG_ALERT, ngx_load_log, err, "poll() failed");
+            return NGX_ERROR;
+        }
+
+        for (i = 0; rc && i < cf->conns; i++) {
+
+            if (pfd[i].revents == 0) {
+                continue;
+            }
+
+            rc--;
+
+            c = &conns[i];
+
+            if (ngx_load_handler(c) == NGX_ERROR) {
+                if (ngx_load_usec() >= cf->start) {
+                    st->errors++;
+                }
+
+                ngx_load_close(c);
+            }
+        }
+    }
+
+    for (i = 0; i < cf->conns; i++) {
+        ngx_load_close(&conns[i]);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_load_connect(ngx_load_conn_t *c)
+{
+    int           on;
+    ngx_err_t     err;
+    ngx_socket_t  s;
+
+    c->start = ngx_load_usec();
+
+    s = ngx_socket(AF_INET, SOCK_STREAM, 0);
+    if (s == (ngx_socket_t) -1) {
+        return NGX_ERROR;
+    }
+
+    on = 1;
+
+    if (ngx_nonblocking(s) == -1
+        || setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const void *) &on,
+                      sizeof(int))
+           == -1)
+    {
+        ngx_close_socket(s);
+        return NGX_ERROR;
+    }
+
+    c->fd = s;
+    c->state = NGX_LOAD_CONNECT;
+    c->events = POLLOUT;
+    c->requests = 0;
+
+    if (connect(s, (struct sockaddr *) &ngx_load_sin, sizeof(ngx_load_sin))
+        == -1)
+    {
+        err = ngx_socket_errno;
+
+        if (err != NGX_EINPROGRESS) {
+            ngx_load_close(c);
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_load_handler(ngx_load_conn_t *c)
+{
+    int        err;
+    socklen_t  len;
+
+    switch (c->state) {
+
+    case NGX_LOAD_CONNECT:
+
+        err = 0;
+        len = sizeof(int);
+
+        if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, (void *) &err, &len) == -1
+            || err)
+        {
+            return NGX_ERROR;
+        }
+
+#if (NGX_OPENSSL)
+        if (ngx_load_conf->ssl) {
+            c->ssl = SSL_new(ngx_load_conf->ssl);
+            if (c->ssl == NULL || SSL_set_fd(c->ssl, c->fd) == 0) {
+                return NGX_ERROR;
+            }
+
+            if (c->session) {
+                SSL_set_session(c->ssl, c->session);
+            }
+
+            SSL_set_quiet_shutdown(c->ssl, 1);
+
+            c->state = NGX_LOAD_HANDSHAKE;
+            return ngx_load_handler(c);
+        }
+#endif
+
+        ngx_load_request(c);
+        return ngx_load_send_request(c);
+
+#if (NGX_OPENSSL)
+    case NGX_LOAD_HANDSHAKE:
+
+        err = SSL_connect(c->ssl);
+
+        if (err != 1) {
+            switch (SSL_get_error(c->ssl, err)) {
+
+            case SSL_ERROR_WANT_READ:
+                c->events = POLLIN;
+                return NGX_AGAIN;
+
+            case SSL_ERROR_WANT_WRITE:
+                c->events = POLLOUT;
+                return NGX_AGAIN;
+
+            default:
+                return NGX_ERROR;
+            }
+        }
+
+        ngx_load_request(c);
+        return ngx_load_send_request(c);
+#endif
+
+    case NGX_LOAD_SEND:
+        return ngx_load_send_request(c);
+
+    default: /* NGX_LOAD_RECV */
+        return ngx_load_read_response(c);
+    }
+}
+
+
+static ngx_int_t
+ngx_load_send_request(ngx_load_conn_t *c)
+{
+    ssize_t  n;
+
+    c->state = NGX_LOAD_SEND;
+
+    while (c->sent < c->out_len) {
+        n = ngx_load_send(c, c->out + c->sent, c->out_len - c->sent);
+
+        if (n < 0) {
+            return n;
+        }
+
+        c->sent += n;
+    }
+
+    c->state = NGX_LOAD_RECV;
+    c->events = POLLIN;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_load_read_response(ngx_load_conn_t *c)
+{
+    ssize_t    n;
+    ngx_int_t  rc;
+
+    for ( ;; ) {
+
+        if (c->in_len == NGX_LOAD_BUFFER) {
+            return NGX_ERROR;
+        }
+
+        n = ngx_load_recv(c, c->in + c->in_len, NGX_LOAD_BUFFER - c->in_len);
+
+        if (n == NGX_AGAIN) {
+            return NGX_AGAIN;
+        }
+
+        if (n == 0 && c->parse == NGX_LOAD_EOF) {
+            return ngx_load_done(c);
+        }
+
+        if (n <= 0) {
+            return NGX_ERROR;
+        }
+
+        c->bytes += n;
+        c->in_len += n;
+
+        rc = ngx_load_parse(c);
+
+        if (rc == NGX_OK) {
+            return ngx_load_done(c);
+        }
+
+        if (rc == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+    }
+}
+
+
+static ngx_int_t
+ngx_load_parse(ngx_load_conn_t *c)
+{
+    u_char     *p, *last, *line;
+    off_t       size;
+    ngx_int_t   rc;
+
+    p = c->in;
+    last = c->in + c->in_len;
+
+    rc = NGX_AGAIN;
+
+    for ( ;; ) {
+
+        switch (c->parse) {
+
+        case NGX_LOAD_HEADER:
+
+            line = ngx_strnstr(p, CRLF CRLF, last - p);
+            if (line == NULL) {
+                goto done;
+            }
+
+            if (ngx_load_parse_header(c, p, line + 2) != NGX_OK) {
+                return NGX_ERROR;
+            }
+
+            p = line + 4;
+            break;
+
+        case NGX_LOAD_BODY:
+        case NGX_LOAD_CHUNK_DATA:
+
+            size = ngx_min(c->rest, last - p);
+
+            p += size;
+            c->rest -= size;
+
+            if (c->rest) {
+                goto done;
+            }
+
+            if (c->parse == NGX_LOAD_BODY) {
+                rc = NGX_OK;
+                goto done;
+            }
+
+            c->parse = NGX_LOAD_CHUNK_SIZE;
+            break;
+
+        case NGX_LOAD_CHUNK_SIZE:
+
+            line = ngx_strnstr(p, CRLF, last - p);
+            if (line == NULL) {
+                goto done;
+            }
+
+            for (size = 0; p < line; p++) {
+                if (*p >= '0' && *p <= '9') {
+                    size = size * 16 + *p - '0';
+
+                } else if ((*p | 0x20) >= 'a' && (*p | 0x20) <= 'f') {
+                    size = size * 16 + (*p | 0x20) - 'a' + 10;
+
+                } else {
+                    break;
+                }
+            }
+
+            p = line + 2;
+
+            if (size == 0) {
+                c->parse = NGX_LOAD_TRAILER;
+                break;
+            }
+
+            /* the chunk is followed by CRLF */
+
+            c->rest = size + 2;
+            c->parse = NGX_LOAD_CHUNK_DATA;
+            break;
+
+        case NGX_LOAD_TRAILER:
+
+            line = ngx_strnstr(p, CRLF, last - p);
+            if (line == NULL) {
+                goto done;
+            }
+
+            if (line == p) {
+                p += 2;
+                rc = NGX_OK;
+                goto done;
+            }
+
+            p = line + 2;
+            break;
+
+        default: /* NGX_LOAD_EOF */
+            p = last;
+            goto done;
+        }
+    }
+
+done:
+
+    c->in_len = last - p;
+
+    if (c->in_len) {
+        ngx_memmove(c->in, p, c->in_len);
+    }
+
+    return rc;
+}
+
+
+static ngx_int_t
+ngx_load_parse_header(ngx_load_conn_t *c, u_char *p, u_char *last)
+{
+    u_char  *line, *value;
+    off_t    length;
+
+    if (last - p < 12 || ngx_strncmp(p, "HTTP/1.", 7) != 0) {
+        return NGX_ERROR;
+    }
+
+    c->status = ngx_atoi(p + 9, 3);
+    if (c->status == (ngx_uint_t) NGX_ERROR) {
+        return NGX_ERROR;
+    }
+
+    c->close = (p[7] == '0');
+    c->parse = NGX_LOAD_EOF;
+
+    length = -1;
+
+    for (p = ngx_strnstr(p, CRLF, last - p) + 2; p < last; p = line + 2) {
+
+        line = ngx_strnstr(p, CRLF, last - p);
+        if (line == NULL) {
+            return NGX_ERROR;
+        }
+
+        value = ngx_strlchr(p, line, ':');
+        if (value == NULL) {
+            continue;
+        }
+
+        for (value++; value < line && *value == ' '; value++) {
+            /* void */
+        }
+
+        if (ngx_strncasecmp(p, (u_char *) "Content-Length:", 15) == 0) {
+            length = ngx_atoof(value, line - value);
+
+        } else if (ngx_strncasecmp(p, (u_char *) "Transfer-Encoding:", 18)
+                   == 0)
+        {
+            if (ngx_strlcasestrn(value, line, (u_char *) "chunked", 7 - 1)) {
+                c->parse = NGX_LOAD_CHUNK_SIZE;
+            }
+
+        } else if (ngx_strncasecmp(p, (u_char *) "Connection:", 11) == 0) {
+            c->close = (ngx_strlcasestrn(value, line, (u_char *) "close",
+                                         5 - 1)
+                        != NULL);
+        }
+    }
+
+    if (c->parse != NGX_LOAD_CHUNK_SIZE && length >= 0) {
+        c->parse = NGX_LOAD_BODY;
+        c->rest = length;
+    }
+
+    if (c->parse == NGX_LOAD_EOF) {
+        c->close = 1;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_load_done(ngx_load_conn_t *c)
+{
+    uint64_t          now, usec;
+    ngx_load_stat_t  *st;
+
+    now = ngx_load_usec();
+
+    if (now >= ngx_load_conf->start && now < ngx_load_conf->end) {
+        st = ngx_load_stat;
+
+        usec = now - c->start;
+
+        st->requests++;
+        st->bytes += c->bytes;
+        st->status[ngx_min(c->status / 100, 5)]++;
+        st->latency += usec;
+        st->hist[ngx_load_hist_index(usec)]++;
+
+        if (usec > st->latency_max) {
+            st->latency_max = usec;
+        }
+    }
+
+    c->requests++;
+
+    if (c->close
+        || (ngx_load_conf->requests && c->requests >= ngx_load_conf->requests))
+    {
+        ngx_load_close(c);
+        return NGX_OK;
+    }
+
+    c->start = now;
+
+    ngx_load_request(c);
+
+    return ngx_load_send_request(c);
+}
+
+
+static void
+ngx_load_request(ngx_load_conn_t *c)
+{
+    u_char          *p;
+    ngx_uint_t       i, n, key;
+    ngx_load_uri_t  *u;
+
+    n = ngx_load_random() % ngx_load_weight;
+
+    for (i = 0, u = ngx_load_conf->uris; n >= u->weight; i++, u++) {
+        n -= u->weight;
+    }
+
+    if (u->keys == NGX_LOAD_UNIQUE) {
+        key = (ngx_uint_t) (ngx_load_seq++ * 256 + ngx_load_conf->id);
+
+    } else if (u->keys) {
+        key = ngx_load_random() % u->keys;
+
+    } else {
+        key = 0;
+    }
+
+    p = ngx_cpymem(c->out, "GET ", 4);
+    p = ngx_sprintf(p, u->uri, key);
+    p = ngx_sprintf(p, " HTTP/1.1" CRLF
+                       "Host: localhost" CRLF
+                       "User-Agent: ngx_load" CRLF
+                       "Accept-Encoding: gzip" CRLF CRLF);
+
+    c->out_len = p - c->out;
+    c->sent = 0;
+
+    c->in_len = 0;
+    c->bytes = 0;
+    c->parse = NGX_LOAD_HEADER;
+}
+
+
+static void
+ngx_load_close(ngx_load_conn_t *c)
+{
+    if (c->fd == (ngx_socket_t) -1) {
+        return;
+    }
+
+#if (NGX_OPENSSL)
+    if (c->ssl) {
+        if (SSL_is_init_finished(c->ssl)) {
+            if (c->session) {
+                SSL_SESSION_free(c->session);
+            }
+
+            c->session = SSL_get1_session(c->ssl);
+        }
+
+        SSL_free(c->ssl);
+        c->ssl = NULL;
+    }
+#endif
+
+    ngx_close_socket(c->fd);
+
+    c->fd = (ngx_socket_t) -1;
+    c->events = 0;
+}
+
+
+static ssize_t
+ngx_load_recv(ngx_load_conn_t *c, u_char *buf, size_t size)
+{
+    ssize_t    n;
+    ngx_err_t  err;
+
+#if (NGX_OPENSSL)
+    if (c->ssl) {
+        n = SSL_read(c->ssl, buf, size);
+
+        if (n > 0) {
+            return n;
+        }
+
+        switch (SSL_get_error(c->ssl, n)) {
+
+        case SSL_ERROR_WANT_READ:
+            c->events = POLLIN;
+            return NGX_AGAIN;
+
+        case SSL_ERROR_WANT_WRITE:
+            c->events = POLLOUT;
+            return NGX_AGAIN;
+
+        case SSL_ERROR_ZERO_RETURN:
+            return 0;
+
+        default:
+            return NGX_ERROR;
+        }
+    }
+#endif
+
+    n = recv(c->fd, buf, size, 0);
+
+    if (n == -1) {
+        err = ngx_socket_errno;
+
+        if (err == NGX_EAGAIN) {
+            c->events = POLLIN;
+            return NGX_AGAIN;
+        }
+
+        return NGX_ERROR;
+    }
+
+    return n;
+}
+
+
+static ssize_t
+ngx_load_send(ngx_load_conn_t *c, u_char *buf, size_t size)
+{
+    ssize_t    n;
+    ngx_err_t  err;
+
+#if (NGX_OPENSSL)
+    if (c->ssl) {
+        n = SSL_write(c->ssl, buf, size);
+
+        if (n > 0) {
+            return n;
+        }
+
+        switch (SSL_get_error(c->ssl, n)) {
+
+        case SSL_ERROR_WANT_READ:
+            c->events = POLLIN;
+            return NGX_AGAIN;
+
+        case SSL_ERROR_WANT_WRITE:
+            c->events = POLLOUT;
+            return NGX_AGAIN;
+
+        default:
+            return NGX_ERROR;
+        }
+    }
+#endif
+
+    n = send(c->fd, buf, size, 0);
+
+    if (n == -1) {
+        err = ngx_socket_errno;
+
+        if (err == NGX_EAGAIN) {
+            c->events = POLLOUT;
+            return NGX_AGAIN;
+        }
+
+        return NGX_ERROR;
+    }
+
+    return n;
+}
+
+
+/*
+ * the histogram has 64 linear buckets of 1 usec
+ * and 32 buckets per each next power of two
+ */
+
+ngx_uint_t
+ngx_load_hist_index(uint64_t usec)
+{
+    ngx_uint_t  shift;
+
+    if (usec < 64) {
+        return (ngx_uint_t) usec;
+    }
+
+    for (shift = 1; (usec >> shift) >= 64; shift++) {
+        /* void */
+    }
+
+    return ngx_min(shift * 32 + (ngx_uint_t) (usec >> shift),
+                   NGX_LOAD_HIST_SIZE - 1);
+}
+
+
+uint64_t
+ngx_load_hist_value(ngx_uint_t index)
+{
+    ngx_uint_t  shift;
+
+    if (index < 64) {
+        return index;
+    }
+
+    shift = index / 32 - 1;
+
+    return ((uint64_t) (index - shift * 32 + 1) << shift) - 1;
+}
+
+
+static uint32_t
+ngx_load_random(void)
+{
+    ngx_load_seed ^= ngx_load_seed << 13;
+    ngx_load_seed ^= ngx_load_seed >> 17;
+    ngx_load_seed ^= ngx_load_seed << 5;
+
+    return ngx_load_seed;
+}
@@ -0,0 +1,548 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_load.h>
+
+
+/*
+ * The mock upstreams answer HTTP, FastCGI and memcached requests with
+ * a body of the size given by a "size=" argument found anywhere in the
+ * request: in the URI, in the FastCGI params or in the memcached key.
+ */
+
+
+#define NGX_LOAD_MOCK_CONNS        4096
+#define NGX_LOAD_MOCK_BUFFER       16384
+#define NGX_LOAD_MOCK_SIZE         1024
+#define NGX_LOAD_MOCK_HEADER       256
+
+#define NGX_LOAD_FCGI_BEGIN        1
+#define NGX_LOAD_FCGI_END          3
+#define NGX_LOAD_FCGI_PARAMS       4
+#define NGX_LOAD_FCGI_STDIN        5
+#define NGX_LOAD_FCGI_STDOUT       6
+#define NGX_LOAD_FCGI_KEEP_CONN    1
+#define NGX_LOAD_FCGI_RECORD       32768
+
+
+typedef struct {
+    ngx_socket_t          fd;
+    ngx_uint_t            type;
+    ngx_uint_t            close;
+
+    u_char               *out;
+    size_t                out_size;
+    size_t                out_len;
+    size_t                sent;
+
+    size_t                size;
+    size_t                skip;
+    ngx_uint_t            request_id;
+
+    size_t                in_len;
+    u_char                in[NGX_LOAD_MOCK_BUFFER];
+} ngx_load_mock_conn_t;
+
+
+static ngx_int_t ngx_load_mock_read(ngx_load_mock_conn_t *c);
+static ngx_int_t ngx_load_mock_write(ngx_load_mock_conn_t *c);
+static ngx_int_t ngx_load_mock_process(ngx_load_mock_conn_t *c);
+static ngx_int_t ngx_load_mock_http(ngx_load_mock_conn_t *c);
+static ngx_int_t ngx_load_mock_fastcgi(ngx_load_mock_conn_t *c);
+static ngx_int_t ngx_load_mock_memcached(ngx_load_mock_conn_t *c);
+static u_char *ngx_load_mock_fastcgi_record(u_char *p, ngx_uint_t type,
+    ngx_uint_t id, size_t len);
+static size_t ngx_load_mock_size(u_char *p, size_t len);
+static u_char *ngx_load_mock_alloc(ngx_load_mock_conn_t *c, size_t size);
+static void ngx_load_mock_consume(ngx_load_mock_conn_t *c, size_t len);
+
+
+static u_char  *ngx_load_mock_body;
+static size_t   ngx_load_mock_max;
+
+
+void
+ngx_load_mock(ngx_load_listen_t *ls, ngx_uint_t n, size_t size)
+{
+    int                     events;
+    size_t                  i;
+    ngx_int_t               rc;
+    ngx_err_t               err;
+    ngx_uint_t              k, nconns;
+    ngx_socket_t            s;
+    struct pollfd          *pfd;
+    ngx_load_mock_conn_t  **conns, *c;
+
+    ngx_load_mock_max = size;
+
+    ngx_load_mock_body = ngx_alloc(size, ngx_load_log);
+    pfd = ngx_alloc((n + NGX_LOAD_MOCK_CONNS) * sizeof(struct pollfd),
+                    ngx_load_log);
+    conns = ngx_alloc(NGX_LOAD_MOCK_CONNS * sizeof(ngx_load_mock_conn_t *),
+                      ngx_load_log);
+
+    if (ngx_load_mock_body == NULL || pfd == NULL || conns == NULL) {
+        exit(1);
+    }
+
+    for (i = 0; i < size; i++) {
+        ngx_load_mock_body[i] = (u_char) ('a' + i % 26);
+    }
+
+    for (k = 0; k < n; k++) {
+        pfd[k].fd = ls[k].fd;
+        pfd[k].events = POLLIN;
+    }
+
+    nconns = 0;
+
+    for ( ;; ) {
+
+        for (k = 0; k < nconns; k++) {
+            c = conns[k];
+
+            pfd[n + k].fd = c->fd;
+            pfd[n + k].events = (c->sent < c->out_len) ? POLLOUT : POLLIN;
+            pfd[n + k].revents = 0;
+        }
+
+        if (poll(pfd, n + nconns, -1) == -1) {
+            err = ngx_errno;
+
+            if (err == NGX_EINTR) {
+                continue;
+            }
+
+            ngx_log_error(NGX_LOG_ALERT, ngx_load_log, err, "poll() failed");
+            exit(1);
+        }
+
+        /* the connections are processed first as accept() moves them */
+
+        for (k = nconns; k-- > 0; /* void */) {
+            events = pfd[n + k].revents;
+
+            if (events == 0) {
+                continue;
+            }
+
+            c = conns[k];
+
+            if (c->sent < c->out_len) {
+                rc = ngx_load_mock_write(c);
+
+            } else {
+                rc = ngx_load_mock_read(c);
+            }
+
+            if (rc == NGX_ERROR || rc == NGX_DONE) {
+                ngx_close_socket(c->fd);
+
+                if (c->out) {
+                    ngx_free(c->out);
+                }
+
+                ngx_free(c);
+
+                conns[k] = conns[--nconns];
+            }
+        }
+
+        for (k = 0; k < n; k++) {
+
+            if (!(pfd[k].revents & POLLIN)) {
+                continue;
+            }
+
+            for ( ;; ) {
+                s = accept(ls[k].fd, NULL, NULL);
+
+                if (s == (ngx_socket_t) -1) {
+                    break;
+                }
+
+                if (nconns == NGX_LOAD_MOCK_CONNS
+                    || ngx_nonblocking(s) == -1)
+                {
+                    ngx_close_socket(s);
+                    continue;
+                }
+
+                c = ngx_calloc(sizeof(ngx_load_mock_conn_t), ngx_load_log);
+                if (c == NULL) {
+                    ngx_close_socket(s);
+                    continue;
+                }
+
+                c->fd = s;
+                c->type = ls[k].type;
+
+                conns[nconns++] = c;
+            }
+        }
+    }
+}
+
+
+static ngx_int_t
+ngx_load_mock_read(ngx_load_mock_conn_t *c)
+{
+    ssize_t    n;
+    ngx_err_t  err;
+
+    n = recv(c->fd, c->in + c->in_len, NGX_LOAD_MOCK_BUFFER - c->in_len, 0);
+
+    if (n == 0) {
+        return NGX_DONE;
+    }
+
+    if (n == -1) {
+        err = ngx_socket_errno;
+        return (err == NGX_EAGAIN) ? NGX_AGAIN : NGX_ERROR;
+    }
+
+    c->in_len += n;
+
+    return ngx_load_mock_process(c);
+}
+
+
+static ngx_int_t
+ngx_load_mock_write(ngx_load_mock_conn_t *c)
+{
+    ssize_t    n;
+    ngx_err_t  err;
+
+    while (c->sent < c->out_len) {
+
+        n = send(c->fd, c->out + c->sent, c->out_len - c->sent, 0);
+
+        if (n == -1) {
+            err = ngx_socket_errno;
+            return (err == NGX_EAGAIN) ? NGX_AGAIN : NGX_ERROR;
+        }
+
+        c->sent += n;
+    }
+
+    c->out_len = 0;
+    c->sent = 0;
+
+    if (c->close) {
+        return NGX_DONE;
+    }
+
+    /* pipelined requests */
+
+    return ngx_load_mock_process(c);
+}
+
+
+static ngx_int_t
+ngx_load_mock_process(ngx_load_mock_conn_t *c)
+{
+    ngx_int_t  rc;
+
+    switch (c->type) {
+
+    case NGX_LOAD_MOCK_HTTP:
+        rc = ngx_load_mock_http(c);
+        break;
+
+    case NGX_LOAD_MOCK_FASTCGI:
+        rc = ngx_load_mock_fastcgi(c);
+        break;
+
+    default: /* NGX_LOAD_MOCK_MEMCACHED */
+        rc = ngx_load_mock_memcached(c);
+        break;
+    }
+
+    if (rc == NGX_OK) {
+        return ngx_load_mock_write(c);
+    }
+
+    if (rc == NGX_AGAIN && c->in_len == NGX_LOAD_MOCK_BUFFER) {
+        return NGX_ERROR;
+    }
+
+    return rc;
+}
+
+
+static ngx_int_t
+ngx_load_mock_http(ngx_load_mock_conn_t *c)
+{
+    u_char  *p, *last;
+    size_t   len, size;
+
+    p = ngx_strnstr(c->in, CRLF CRLF, c->in_len);
+    if (p == NULL) {
+        return NGX_AGAIN;
+    }
+
+    len = p + 4 - c->in;
+
+    size = ngx_load_mock_size(c->in, len);
+
+    last = c->in + len;
+    p = ngx_strnstr(c->in, CRLF, len);
+
+    c->close = (ngx_strnstr(c->in, "HTTP/1.0", p - c->in) != NULL
+                || ngx_strlcasestrn(c->in, last, (u_char *) "connection: close",
+                                    sizeof("connection: close") - 2)
+                   != NULL);
+
+    ngx_load_mock_consume(c, len);
+
+    p = ngx_load_mock_alloc(c, NGX_LOAD_MOCK_HEADER + size);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    p = ngx_sprintf(p, "HTTP/1.1 200 OK" CRLF
+                       "Content-Type: text/plain" CRLF
+                       "Content-Length: %uz" CRLF
+                       "Cache-Control: max-age=3600" CRLF
+                       "%s" CRLF,
+                    size, c->close ? "Connection: close" CRLF : "");
+
+    p = ngx_cpymem(p, ngx_load_mock_body, size);
+
+    c->out_len = p - c->out;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_load_mock_fastcgi(ngx_load_mock_conn_t *c)
+{
+    u_char      *p, *body;
+    size_t       len, clen, size, n;
+    ngx_uint_t   type;
+
+    for ( ;; ) {
+
+        if (c->skip) {
+            len = ngx_min(c->skip, c->in_len);
+
+            ngx_load_mock_consume(c, len);
+            c->skip -= len;
+
+            if (c->skip) {
+                return NGX_AGAIN;
+            }
+        }
+
+        if (c->in_len < 8) {
+            return NGX_AGAIN;
+        }
+
+        type = c->in[1];
+        clen = (c->in[4] << 8) + c->in[5];
+        len = 8 + clen + c->in[6];
+
+        if (len > NGX_LOAD_MOCK_BUFFER) {
+
+            /* a large request body is not buffered */
+
+            ngx_load_mock_consume(c, 8);
+            c->skip = len - 8;
+            continue;
+        }
+
+        if (c->in_len < len) {
+            return NGX_AGAIN;
+        }
+
+        switch (type) {
+
+        case NGX_LOAD_FCGI_BEGIN:
+            c->request_id = (c->in[2] << 8) + c->in[3];
+            c->close = !(c->in[8 + 2] & NGX_LOAD_FCGI_KEEP_CONN);
+            c->size = NGX_LOAD_MOCK_SIZE;
+            break;
+
+        case NGX_LOAD_FCGI_PARAMS:
+            if (ngx_strnstr(c->in + 8, "size=", clen)) {
+                c->size = ngx_load_mock_size(c->in + 8, clen);
+            }
+            break;
+
+        case NGX_LOAD_FCGI_STDIN:
+            if (clen == 0) {
+                ngx_load_mock_consume(c, len);
+                goto response;
+            }
+            break;
+        }
+
+        ngx_load_mock_consume(c, len);
+    }
+
+response:
+
+    size = c->size;
+
+    p = ngx_load_mock_alloc(c, NGX_LOAD_MOCK_HEADER + size
+                               + (size / NGX_LOAD_FCGI_RECORD + 4) * 8);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    /* the header text is sent in the first record, then the body */
+
+    body = p + 8;
+
+    body = ngx_sprintf(body, "Status: 200 OK" CRLF
+                             "Content-Type: text/plain" CRLF
+                             "Content-Length: %uz" CRLF
+                             "Cache-Control: max-age=3600" CRLF CRLF,
+                       size);
+
+    p = ngx_load_mock_fastcgi_record(p, NGX_LOAD_FCGI_STDOUT, c->request_id,
+                                     body - p - 8);
+    p = body;
+
+    for (len = 0; len < size; len += n) {
+        n = ngx_min(size - len, NGX_LOAD_FCGI_RECORD);
+
+        p = ngx_load_mock_fastcgi_record(p, NGX_LOAD_FCGI_STDOUT,
+                                         c->request_id, n);
+        p = ngx_cpymem(p, ngx_load_mock_body + len, n);
+    }
+
+    p = ngx_load_mock_fastcgi_record(p, NGX_LOAD_FCGI_STDOUT, c->request_id, 0);
+
+    p = ngx_load_mock_fastcgi_record(p, NGX_LOAD_FCGI_END, c->request_id, 8);
+    ngx_memzero(p, 8);
+    p += 8;
+
+    c->out_len = p - c->out;
+
+    return NGX_OK;
+}
+
+
+static u_char *
+ngx_load_mock_fastcgi_record(u_char *p, ngx_uint_t type, ngx_uint_t id,
+    size_t len)
+{
+    *p++ = 1;
+    *p++ = (u_char) type;
+    *p++ = (u_char) (id >> 8);
+    *p++ = (u_char) id;
+    *p++ = (u_char) (len >> 8);
+    *p++ = (u_char) len;
+    *p++ = 0;
+    *p++ = 0;
+
+    return p;
+}
+
+
+static ngx_int_t
+ngx_load_mock_memcached(ngx_load_mock_conn_t *c)
+{
+    u_char  *p, *key;
+    size_t   len, size;
+
+    p = ngx_strnstr(c->in, CRLF, c->in_len);
+    if (p == NULL) {
+        return NGX_AGAIN;
+    }
+
+    len = p - c->in;
+
+    if (len < sizeof("get ") || ngx_strncmp(c->in, "get ", 4) != 0) {
+        return NGX_ERROR;
+    }
+
+    key = c->in + 4;
+    len -= 4;
+
+    size = ngx_load_mock_size(key, len);
+
+    p = ngx_load_mock_alloc(c, NGX_LOAD_MOCK_HEADER + len + size);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    p = ngx_sprintf(p, "VALUE %*s 0 %uz" CRLF, len, key, size);
+    p = ngx_cpymem(p, ngx_load_mock_body, size);
+    p = ngx_cpymem(p, CRLF "END" CRLF, sizeof(CRLF "END" CRLF) - 1);
+
+    c->out_len = p - c->out;
+
+    ngx_load_mock_consume(c, key + len + 2 - c->in);
+
+    return NGX_OK;
+}
+
+
+static size_t
+ngx_load_mock_size(u_char *p, size_t len)
+{
+    u_char     *s, *last;
+    ngx_int_t   size;
+
+    s = ngx_strnstr(p, "size=", len);
+    if (s == NULL) {
+        return NGX_LOAD_MOCK_SIZE;
+    }
+
+    last = p + len;
+
+    for (s += 5, p = s; p < last && *p >= '0' && *p <= '9'; p++) {
+        /* void */
+    }
+
+    size = ngx_atoi(s, p - s);
+
+    if (size == NGX_ERROR) {
+        return NGX_LOAD_MOCK_SIZE;
+    }
+
+    return ngx_min((size_t) size, ngx_load_mock_max);
+}
+
+
+static u_char *
+ngx_load_mock_alloc(ngx_load_mock_conn_t *c, size_t size)
+{
+    if (c->out_size < size) {
+        if (c->out) {
+            ngx_free(c->out);
+        }
+
+        c->out = ngx_alloc(size, ngx_load_log);
+        if (c->out == NULL) {
+            c->out_size = 0;
+            return NULL;
+        }
+
+        c->out_size = size;
+    }
+
+    c->out_len = 0;
+    c->sent = 0;
+
+    return c->out;
+}
+
+
+static void
+ngx_load_mock_consume(ngx_load_mock_conn_t *c, size_t len)
+{
+    c->in_len -= len;
+
+    if (c->in_len) {
+        ngx_memmove(c->in, c->in + len, c->in_len);
+    }
+}
@@ -0,0 +1,589 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+/*
+ * The test driver is linked with the nginx objects and compares the vector
+ * versions of the string functions with the scalar ones: each function
+ * is called on a randomized input with ngx_cpu_features cleared, and then
+ * at every feature level supported by the CPU.  The inputs have random
+ * lengths and alignments, and half of them end right before an inaccessible
+ * page to catch the reads past the end of the data.
+ */
+
+
+#define NGX_TEST_CASES  20000
+#define NGX_TEST_MAX    (3 * 4096)
+
+
+typedef ngx_int_t (*ngx_test_pt)(ngx_uint_t n);
+
+typedef struct {
+    char         *name;
+    ngx_test_pt   test;
+} ngx_test_t;
+
+
+typedef struct {
+    char         *name;
+    ngx_uint_t    features;
+} ngx_test_level_t;
+
+
+static ngx_int_t ngx_test_init(char *const *argv);
+static ngx_int_t ngx_test_strlow(ngx_uint_t n);
+static ngx_int_t ngx_test_strncasecmp(ngx_uint_t n);
+static ngx_int_t ngx_test_strcasestrn(ngx_uint_t n);
+static ngx_int_t ngx_test_escape_uri(ngx_uint_t n);
+static ngx_int_t ngx_test_unescape_uri(ngx_uint_t n);
+static ngx_int_t ngx_test_escape_html(ngx_uint_t n);
+static ngx_uint_t ngx_test_next_level(void);
+static u_char *ngx_test_input(u_char *buf, size_t len, char *chars);
+static size_t ngx_test_length(void);
+static uint32_t ngx_test_random(void);
+static ngx_int_t ngx_test_failed(ngx_uint_t n, size_t len, char *what);
+
+
+static ngx_test_t  ngx_tests[] = {
+    { "strlow", ngx_test_strlow },
+    { "strncasecmp", ngx_test_strncasecmp },
+    { "strcasestrn", ngx_test_strcasestrn },
+    { "escape_uri", ngx_test_escape_uri },
+    { "unescape_uri", ngx_test_unescape_uri },
+    { "escape_html", ngx_test_escape_html },
+    { NULL, NULL }
+};
+
+
+static ngx_test_level_t  ngx_test_levels[] = {
+    { "sse2", NGX_CPU_SSE2 },
+    { "ssse3", NGX_CPU_SSE2|NGX_CPU_SSSE3 },
+    { "avx2", NGX_CPU_SSE2|NGX_CPU_SSSE3|NGX_CPU_AVX2 },
+    { NULL, 0 }
+};
+
+
+static ngx_log_t         ngx_test_error_log;
+static ngx_open_file_t   ngx_test_error_file;
+static ngx_cycle_t       ngx_test_cycle;
+
+static ngx_uint_t        ngx_test_features;
+static ngx_uint_t        ngx_test_level;
+static uint32_t          ngx_test_seed = 2463534242U;
+
+/* two input buffers, each is followed by an inaccessible page */
+
+static u_char           *ngx_test_buf[2];
+
+static u_char            ngx_test_ref[6 * NGX_TEST_MAX + 64];
+static u_char            ngx_test_out[6 * NGX_TEST_MAX + 64];
+
+
+int ngx_cdecl
+main(int argc, char *const *argv)
+{
+    int          i;
+    u_char       buf[NGX_MAX_ERROR_STR], *p;
+    ngx_int_t    n;
+    ngx_uint_t   k, failed;
+    ngx_test_t  *t;
+
+    for (i = 1; i < argc; i++) {
+
+        if (ngx_strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            i++;
+
+            n = ngx_atoi((u_char *) argv[i], ngx_strlen(argv[i]));
+            if (n <= 0) {
+                goto usage;
+            }
+
+            ngx_test_seed = (uint32_t) n;
+            continue;
+        }
+
+        goto usage;
+    }
+
+    if (ngx_test_init(argv) != NGX_OK) {
+        return 1;
+    }
+
+    p = ngx_sprintf(buf, "seed %uD, levels:", ngx_test_seed);
+
+#if (NGX_HAVE_SIMD)
+
+    for (ngx_test_level = 0; ngx_test_next_level(); ngx_test_level++) {
+        p = ngx_sprintf(p, " %s", ngx_test_levels[ngx_test_level].name);
+    }
+
+#else
+
+    p = ngx_sprintf(p, " none, the vector code is not built");
+
+#endif
+
+    *p++ = LF;
+    (void) ngx_write_fd(ngx_stdout, buf, p - buf);
+
+    failed = 0;
+
+    for (t = ngx_tests; t->name; t++) {
+
+        for (k = 0; k < NGX_TEST_CASES; k++) {
+            if (t->test(k) != NGX_OK) {
+                break;
+            }
+        }
+
+        ngx_cpu_features = ngx_test_features;
+
+        p = ngx_sprintf(buf, "%s: %s" NGX_LINEFEED, t->name,
+                        (k == NGX_TEST_CASES) ? "ok" : "FAILED");
+        (void) ngx_write_fd(ngx_stdout, buf, p - buf);
+
+        if (k != NGX_TEST_CASES) {
+            failed = 1;
+        }
+    }
+
+    return failed;
+
+usage:
+
+    p = ngx_sprintf(buf, "usage: %s [-s seed]" NGX_LINEFEED, argv[0]);
+    (void) ngx_write_fd(ngx_stderr, buf, p - buf);
+
+    return 1;
+}
+
+
+static ngx_int_t
+ngx_test_init(char *const *argv)
+{
+    size_t      size;
+    u_char     *p;
+    ngx_uint_t  i;
+
+    ngx_test_error_file.fd = ngx_stderr;
+
+    ngx_test_error_log.file = &ngx_test_error_file;
+    ngx_test_error_log.log_level = NGX_LOG_NOTICE;
+
+    ngx_test_cycle.log = &ngx_test_error_log;
+    ngx_cycle = &ngx_test_cycle;
+
+    if (ngx_strerror_init() != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_time_init();
+
+    ngx_pid = ngx_getpid();
+    ngx_os_argv = (char **) argv;
+
+    if (ngx_os_init(&ngx_test_error_log) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_test_features = ngx_cpu_features;
+
+    size = ngx_align(NGX_TEST_MAX, ngx_pagesize);
+
+    for (i = 0; i < 2; i++) {
+        p = mmap(NULL, size + ngx_pagesize, PROT_READ|PROT_WRITE,
+                 MAP_ANON|MAP_PRIVATE, -1, 0);
+
+        if (p == MAP_FAILED) {
+            ngx_log_error(NGX_LOG_EMERG, &ngx_test_error_log, ngx_errno,
+                          "mmap(%uz) failed", size + ngx_pagesize);
+            return NGX_ERROR;
+        }
+
+        if (mprotect(p + size, ngx_pagesize, PROT_NONE) == -1) {
+            ngx_log_error(NGX_LOG_EMERG, &ngx_test_error_log, ngx_errno,
+                          "mprotect() failed");
+            return NGX_ERROR;
+        }
+
+        ngx_test_buf[i] = p;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_test_strlow(ngx_uint_t n)
+{
+    u_char  *src;
+    size_t   len;
+
+    len = ngx_test_length();
+    src = ngx_test_input(ngx_test_buf[0], len, NULL);
+
+    ngx_cpu_features = 0;
+    ngx_memset(ngx_test_ref, 0, len + 64);
+    ngx_strlow(ngx_test_ref, src, len);
+
+    for (ngx_test_level = 0; ngx_test_next_level(); ngx_test_level++) {
+        ngx_memset(ngx_test_out, 0, len + 64);
+
+        ngx_strlow(ngx_test_out, src, len);
+
+        if (ngx_memcmp(ngx_test_ref, ngx_test_out, len + 64) != 0) {
+            return ngx_test_failed(n, len, "result");
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_test_strncasecmp(ngx_uint_t n)
+{
+    u_char     *s1, *s2, *p;
+    size_t      len, cmp;
+    ngx_int_t   ref, rc;
+    ngx_uint_t  i;
+
+    /* the strings are equal but for the case, with a random difference */
+
+    len = ngx_test_length();
+    s2 = ngx_test_input(ngx_test_buf[1], len + 1, "aBcZ@[`{09");
+    s1 = ngx_test_buf[0] + (s2 - ngx_test_buf[1]);
+
+    for (i = 0; i < len; i++) {
+        s1[i] = s2[i];
+
+        if (s1[i] == '\0') {
+            s1[i] = s2[i] = 'x';
+        }
+
+        if (ngx_test_random() & 1) {
+            s1[i] = ngx_tolower(s1[i]);
+
+        } else {
+            s1[i] = ngx_toupper(s1[i]);
+        }
+    }
+
+    s1[len] = '\0';
+    s2[len] = '\0';
+
+    if (len && ngx_test_random() % 4 == 0) {
+        p = (ngx_test_random() & 1) ? s1 : s2;
+        p[ngx_test_random() % len] = (u_char) ngx_test_random();
+    }
+
+    /* the length may exceed the strings */
+
+    cmp = len ? ngx_test_random() % (len + 17) : 0;
+
+    ngx_cpu_features = 0;
+    ref = ngx_strncasecmp(s1, s2, cmp);
+
+    for (ngx_test_level = 0; ngx_test_next_level(); ngx_test_level++) {
+        rc = ngx_strncasecmp(s1, s2, cmp);
+
+        if ((rc < 0) != (ref < 0) || (rc > 0) != (ref > 0)) {
+            return ngx_test_failed(n, len, "result");
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_test_strcasestrn(ngx_uint_t n)
+{
+    u_char      *s1, *ref, *rc;
+    size_t       len, nlen, start;
+    ngx_uint_t   i;
+    u_char       s2[32];
+
+    len = ngx_test_length();
+    s1 = ngx_test_input(ngx_test_buf[0], len + 1, "abAB\x80");
+    s1[len] = '\0';
+
+    for (i = 0; i < len; i++) {
+        if (s1[i] == '\0') {
+            s1[i] = 'z';
+        }
+    }
+
+    /* the needle is a part of the string with the case changed, or random */
+
+    nlen = 1 + ngx_test_random() % (sizeof(s2) - 1);
+
+    if (len >= nlen && (ngx_test_random() & 1)) {
+        start = ngx_test_random() % (len - nlen + 1);
+
+        for (i = 0; i < nlen; i++) {
+            s2[i] = (ngx_test_random() & 1) ? ngx_toupper(s1[start + i])
+                                            : ngx_tolower(s1[start + i]);
+        }
+
+    } else {
+        for (i = 0; i < nlen; i++) {
+            s2[i] = "abAB"[ngx_test_random() % 4];
+        }
+    }
+
+    s2[nlen] = '\0';
+
+    ngx_cpu_features = 0;
+    ref = ngx_strcasestrn(s1, (char *) s2, nlen - 1);
+
+    for (ngx_test_level = 0; ngx_test_next_level(); ngx_test_level++) {
+        rc = ngx_strcasestrn(s1, (char *) s2, nlen - 1);
+
+        if (rc != ref) {
+            return ngx_test_failed(n, len, "result");
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_test_escape_uri(ngx_uint_t n)
+{
+    u_char      *src;
+    size_t       len, rlen;
+    uintptr_t    ref, rc;
+    ngx_uint_t   type;
+
+    len = ngx_test_length();
+    src = ngx_test_input(ngx_test_buf[0], len, " \"#%&+?;=\x7f\x80");
+    type = ngx_test_random() % (NGX_ESCAPE_MAIL_AUTH + 1);
+
+    ngx_cpu_features = 0;
+    ngx_memset(ngx_test_ref, 0, 3 * len + 64);
+    ref = ngx_escape_uri(NULL, src, len, type);
+    rlen = (u_char *) ngx_escape_uri(ngx_test_ref, src, len, type)
+           - ngx_test_ref;
+
+    for (ngx_test_level = 0; ngx_test_next_level(); ngx_test_level++) {
+        rc = ngx_escape_uri(NULL, src, len, type);
+
+        if (rc != ref) {
+            return ngx_test_failed(n, len, "count");
+        }
+
+        ngx_memset(ngx_test_out, 0, rlen + 64);
+
+        rc = ngx_escape_uri(ngx_test_out, src, len, type);
+
+        if ((u_char *) rc - ngx_test_out != (ptrdiff_t) rlen
+            || ngx_memcmp(ngx_test_ref, ngx_test_out, rlen + 64) != 0)
+        {
+            return ngx_test_failed(n, len, "result");
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_test_unescape_uri(ngx_uint_t n)
+{
+    u_char      *src, *s, *d, *ref_s, *ref_d;
+    size_t       len;
+    ngx_uint_t   type;
+
+    static ngx_uint_t  types[] = {
+        0, NGX_UNESCAPE_URI, NGX_UNESCAPE_REDIRECT
+    };
+
+    len = ngx_test_length();
+    src = ngx_test_input(ngx_test_buf[0], len, "%%%2A5f?+/\x80");
+    type = types[ngx_test_random() % 3];
+
+    ngx_cpu_features = 0;
+    ngx_memset(ngx_test_ref, 0, len + 64);
+
+    ref_d = ngx_test_ref;
+    ref_s = src;
+    ngx_unescape_uri(&ref_d, &ref_s, len, type);
+
+    for (ngx_test_level = 0; ngx_test_next_level(); ngx_test_level++) {
+        ngx_memset(ngx_test_out, 0, len + 64);
+
+        d = ngx_test_out;
+        s = src;
+        ngx_unescape_uri(&d, &s, len, type);
+
+        if (s != ref_s
+            || d - ngx_test_out != ref_d - ngx_test_ref
+            || ngx_memcmp(ngx_test_ref, ngx_test_out, len + 64) != 0)
+        {
+            return ngx_test_failed(n, len, "result");
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_test_escape_html(ngx_uint_t n)
+{
+    u_char     *src;
+    size_t      len, rlen;
+    uintptr_t   ref, rc;
+
+    len = ngx_test_length();
+    src = ngx_test_input(ngx_test_buf[0], len, "<>&\"'");
+
+    ngx_cpu_features = 0;
+    ngx_memset(ngx_test_ref, 0, 6 * len + 64);
+    ref = ngx_escape_html(NULL, src, len);
+    rlen = (u_char *) ngx_escape_html(ngx_test_ref, src, len) - ngx_test_ref;
+
+    for (ngx_test_level = 0; ngx_test_next_level(); ngx_test_level++) {
+        rc = ngx_escape_html(NULL, src, len);
+
+        if (rc != ref) {
+            return ngx_test_failed(n, len, "count");
+        }
+
+        ngx_memset(ngx_test_out, 0, rlen + 64);
+
+        rc = ngx_escape_html(ngx_test_out, src, len);
+
+        if ((u_char *) rc - ngx_test_out != (ptrdiff_t) rlen
+            || ngx_memcmp(ngx_test_ref, ngx_test_out, rlen + 64) != 0)
+        {
+            return ngx_test_failed(n, len, "result");
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+/*
+ * the scalar results are computed with ngx_cpu_features cleared, the vector
+ * ones with the features set to each of the levels supported by the CPU
+ */
+
+static ngx_uint_t
+ngx_test_next_level(void)
+{
+    ngx_test_level_t  *level;
+
+    for ( ;; ) {
+        level = &ngx_test_levels[ngx_test_level];
+
+        if (level->name == NULL) {
+            ngx_cpu_features = ngx_test_features;
+            return 0;
+        }
+
+        if ((ngx_test_features & level->features) == level->features) {
+            ngx_cpu_features = level->features;
+            return 1;
+        }
+
+        ngx_test_level++;
+    }
+}
+
+
+/*
+ * the input either ends at the inaccessible page, or starts at a random
+ * offset; the bytes are random, a quarter of them are the characters given
+ */
+
+static u_char *
+ngx_test_input(u_char *buf, size_t len, char *chars)
+{
+    u_char    *p;
+    size_t     i, size, n;
+    uint32_t   r;
+
+    size = ngx_align(NGX_TEST_MAX, ngx_pagesize);
+
+    if (ngx_test_random() & 1) {
+        p = buf + size - len;
+
+    } else {
+        p = buf + ngx_test_random() % (size - len + 1);
+    }
+
+    n = chars ? ngx_strlen(chars) : 0;
+
+    for (i = 0; i < len; i++) {
+        r = ngx_test_random();
+
+        if (n && (r & 3) == 0) {
+            p[i] = chars[(r >> 8) % n];
+
+        } else if ((r & 3) == 1) {
+            p[i] = 'A' + (r >> 8) % 26;
+
+        } else {
+            p[i] = (u_char) (r >> 8);
+        }
+    }
+
+    return p;
+}
+
+
+/* mostly short lengths, as in headers, and some long ones */
+
+static size_t
+ngx_test_length(void)
+{
+    uint32_t  r;
+
+    r = ngx_test_random();
+
+    switch (r % 8) {
+
+    case 0:
+        return (r >> 8) % (NGX_TEST_MAX - 1);
+
+    case 1:
+    case 2:
+    case 3:
+        return (r >> 8) % 300;
+
+    default:
+        return (r >> 8) % 80;
+    }
+}
+
+
+static uint32_t
+ngx_test_random(void)
+{
+    ngx_test_seed ^= ngx_test_seed << 13;
+    ngx_test_seed ^= ngx_test_seed >> 17;
+    ngx_test_seed ^= ngx_test_seed << 5;
+
+    return ngx_test_seed;
+}
+
+
+static ngx_int_t
+ngx_test_failed(ngx_uint_t n, size_t len, char *what)
+{
+    ngx_log_error(NGX_LOG_ERR, &ngx_test_error_log, 0,
+                  "case %ui: %s mismatch at level %s, length %uz",
+                  n, what, ngx_test_levels[ngx_test_level].name, len);
+
+    return NGX_ERROR;
+}
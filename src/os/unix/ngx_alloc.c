@@ -125,3 +125,150 @@ ngx_memalign(size_t alignment, size_t size, ngx_log_t *log)
 }
 
 #endif
+
+
+#if (NGX_HAVE_NUMA)
+
+#define NGX_NUMA_MAX_NODES  1024
+
+
+static ngx_int_t
+ngx_numa_local_mask(unsigned long *mask, ngx_log_t *log)
+{
+    unsigned  cpu, node;
+
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno, "getcpu() failed");
+        return NGX_ERROR;
+    }
+
+    if (node >= NGX_NUMA_MAX_NODES) {
+        return NGX_DECLINED;
+    }
+
+    ngx_memzero(mask, NGX_NUMA_MAX_NODES / 8);
+
+    mask[node / (8 * sizeof(unsigned long))] |=
+                                    1UL << (node % (8 * sizeof(unsigned long)));
+
+    ngx_log_debug2(NGX_LOG_DEBUG_ALLOC, log, 0,
+                   "numa local node: %ud, cpu: %ud", node, cpu);
+
+    return NGX_OK;
+}
+
+
+/*
+ * the preferred policy falls back to other nodes
+ * instead of failing when the local node runs out of memory
+ */
+
+ngx_int_t
+ngx_numa_set_local_policy(ngx_log_t *log)
+{
+    unsigned long  mask[NGX_NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+
+    if (ngx_numa_local_mask(mask, log) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask,
+                NGX_NUMA_MAX_NODES + 1)
+        == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "set_mempolicy(MPOL_PREFERRED) failed");
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+#endif
+
+
+void *
+ngx_alloc_pages(size_t size, ngx_uint_t flags, ngx_log_t *log)
+{
+#if (NGX_HAVE_MAP_HUGETLB || NGX_HAVE_NUMA)
+
+    u_char  *p;
+    size_t   len;
+#if (NGX_HAVE_NUMA)
+    unsigned long  mask[NGX_NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+#endif
+
+    if (flags == 0) {
+        return ngx_alloc(size, log);
+    }
+
+#if (NGX_HAVE_MAP_HUGETLB)
+
+    if (flags & NGX_ALLOC_HUGEPAGES) {
+        len = ngx_align(size, 2 * 1024 * 1024);
+
+        p = mmap(NULL, len, PROT_READ|PROT_WRITE,
+                 MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+
+        if (p != MAP_FAILED) {
+            goto done;
+        }
+
+        ngx_log_error(NGX_LOG_NOTICE, log, ngx_errno,
+                      "mmap(MAP_HUGETLB, %uz) failed, "
+                      "using transparent huge pages", len);
+    }
+
+#endif
+
+    len = ngx_align(size, ngx_pagesize);
+
+    p = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS,
+             -1, 0);
+
+    if (p == MAP_FAILED) {
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
+                      "mmap(MAP_ANONYMOUS, %uz) failed", len);
+        return NULL;
+    }
+
+#if (NGX_HAVE_MAP_HUGETLB)
+
+    if ((flags & NGX_ALLOC_HUGEPAGES)
+        && madvise(p, len, MADV_HUGEPAGE) == -1)
+    {
+        ngx_log_error(NGX_LOG_NOTICE, log, ngx_errno,
+                      "madvise(MADV_HUGEPAGE, %uz) failed", len);
+    }
+
+done:
+
+#endif
+
+#if (NGX_HAVE_NUMA)
+
+    /* the pages are not touched yet, so they all follow the policy */
+
+    if ((flags & NGX_ALLOC_NUMA_LOCAL)
+        && ngx_numa_local_mask(mask, log) == NGX_OK
+        && syscall(SYS_mbind, p, len, MPOL_PREFERRED, mask,
+                   NGX_NUMA_MAX_NODES + 1, 0)
+           == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      "mbind(%p, %uz) failed", p, len);
+    }
+
+#endif
+
+    ngx_log_debug3(NGX_LOG_DEBUG_ALLOC, log, 0, "alloc pages: %p:%uz f:%ui",
+                   p, len, flags);
+
+    return p;
+
+#else
+
+    return ngx_alloc(size, log);
+
+#endif
+}
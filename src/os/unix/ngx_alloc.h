@@ -19,6 +19,15 @@ void *ngx_calloc(size_t size, ngx_log_t *log);
 #define ngx_free          free
 
 
+#define NGX_ALLOC_HUGEPAGES   0x0001
+#define NGX_ALLOC_NUMA_LOCAL  0x0002
+
+void *ngx_alloc_pages(size_t size, ngx_uint_t flags, ngx_log_t *log);
+#if (NGX_HAVE_NUMA)
+ngx_int_t ngx_numa_set_local_policy(ngx_log_t *log);
+#endif
+
+
 /*
  * Linux has memalign() or posix_memalign()
  * Solaris has memalign()
@@ -8,6 +8,35 @@
 #include <ngx_config.h>
 #include <ngx_core.h>
 
+#if (NGX_THREAD_POOL)
+#include <ngx_thread_pool.h>
+#endif
+
+
+#if (NGX_THREAD_POOL)
+
+#define NGX_THREAD_PRELOAD_BUFFER  65536
+
+
+typedef struct {
+    ngx_fd_t       fd;
+    u_char        *buf;
+    size_t         size;
+    off_t          offset;
+
+    size_t         read;
+    ngx_err_t      err;
+} ngx_thread_read_ctx_t;
+
+
+static void ngx_thread_read_handler(void *data, ngx_log_t *log);
+#if (NGX_HAVE_PREADV2_NOWAIT)
+static ngx_uint_t ngx_thread_read_cached(ngx_fd_t fd, size_t size,
+    off_t offset);
+#endif
+
+#endif
+
 
 #if (NGX_HAVE_FILE_AIO)
 
@@ -64,6 +93,161 @@ ngx_read_file(ngx_file_t *file, u_char *buf, size_t size, off_t offset)
 }
 
 
+#if (NGX_THREAD_POOL)
+
+ssize_t
+ngx_thread_read(ngx_file_t *file, u_char *buf, size_t size, off_t offset,
+    ngx_pool_t *pool)
+{
+    ngx_thread_task_t      *task;
+    ngx_thread_read_ctx_t  *ctx;
+
+    ngx_log_debug4(NGX_LOG_DEBUG_CORE, file->log, 0,
+                   "thread read: %d, %p, %uz, %O",
+                   file->fd, buf, size, offset);
+
+    task = file->thread_task;
+
+    if (task == NULL) {
+        task = ngx_thread_task_alloc(pool, sizeof(ngx_thread_read_ctx_t));
+        if (task == NULL) {
+            return NGX_ERROR;
+        }
+
+        file->thread_task = task;
+    }
+
+    ctx = task->ctx;
+
+    if (task->event.complete) {
+        task->event.complete = 0;
+
+        if (ctx->fd == file->fd
+            && ctx->buf == buf
+            && ctx->size == size
+            && ctx->offset == offset)
+        {
+            if (ctx->err) {
+                ngx_log_error(NGX_LOG_CRIT, file->log, ctx->err,
+                              "pread() \"%s\" failed", file->name.data);
+                return NGX_ERROR;
+            }
+
+            if (buf) {
+                file->offset += ctx->read;
+            }
+
+            return ctx->read;
+        }
+    }
+
+#if (NGX_HAVE_PREADV2_NOWAIT)
+
+    if (buf == NULL && ngx_thread_read_cached(file->fd, size, offset)) {
+        return size;
+    }
+
+#endif
+
+    task->handler = ngx_thread_read_handler;
+
+    ctx->fd = file->fd;
+    ctx->buf = buf;
+    ctx->size = size;
+    ctx->offset = offset;
+
+    if (file->thread_handler(task, file) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    return NGX_AGAIN;
+}
+
+
+static void
+ngx_thread_read_handler(void *data, ngx_log_t *log)
+{
+    ngx_thread_read_ctx_t *ctx = data;
+
+    size_t   size;
+    ssize_t  n;
+    u_char   buf[NGX_THREAD_PRELOAD_BUFFER];
+
+    ngx_log_debug0(NGX_LOG_DEBUG_CORE, log, 0, "thread read handler");
+
+    ctx->read = 0;
+    ctx->err = 0;
+
+    if (ctx->buf) {
+        n = pread(ctx->fd, ctx->buf, ctx->size, ctx->offset);
+
+        if (n == -1) {
+            ctx->err = ngx_errno;
+
+        } else {
+            ctx->read = (size_t) n;
+        }
+
+        return;
+    }
+
+    /* the data are read only to be sent later from the page cache */
+
+    while (ctx->read < ctx->size) {
+        size = ngx_min(ctx->size - ctx->read, NGX_THREAD_PRELOAD_BUFFER);
+
+        n = pread(ctx->fd, buf, size, ctx->offset + ctx->read);
+
+        if (n == -1) {
+            ctx->err = ngx_errno;
+            return;
+        }
+
+        if (n == 0) {
+            return;
+        }
+
+        ctx->read += n;
+    }
+}
+
+
+#if (NGX_HAVE_PREADV2_NOWAIT)
+
+static ngx_uint_t
+ngx_thread_read_cached(ngx_fd_t fd, size_t size, off_t offset)
+{
+    u_char        c;
+    struct iovec  iov;
+
+    /*
+     * the first and the last pages of the range are probed with one byte
+     * reads, which RWF_NOWAIT fails if a page is not in the page cache;
+     * mincore() reports all pages as cached for the files that the worker
+     * can not write
+     */
+
+    iov.iov_base = &c;
+    iov.iov_len = 1;
+
+    if (preadv2(fd, &iov, 1, offset, RWF_NOWAIT) != 1) {
+        return 0;
+    }
+
+    if (size > 1
+        && preadv2(fd, &iov, 1, offset + size - 1, RWF_NOWAIT) != 1)
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+#endif
+
+#endif
+
+
 ssize_t
 ngx_write_file(ngx_file_t *file, u_char *buf, size_t size, off_t offset)
 {
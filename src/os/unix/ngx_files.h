@@ -374,6 +374,7 @@ size_t ngx_fs_bsize(u_char *name);
 #endif
 
 
+#define ngx_stdout               STDOUT_FILENO
 #define ngx_stderr               STDERR_FILENO
 #define ngx_set_stderr(fd)       dup2(fd, STDERR_FILENO)
 #define ngx_set_stderr_n         "dup2(STDERR_FILENO)"
@@ -388,5 +389,14 @@ extern ngx_uint_t  ngx_file_aio;
 
 #endif
 
+#if (NGX_THREAD_POOL)
+
+/* the NULL buf means the preload of the range into the page cache */
+
+ssize_t ngx_thread_read(ngx_file_t *file, u_char *buf, size_t size,
+    off_t offset, ngx_pool_t *pool);
+
+#endif
+
 
 #endif /* _NGX_FILES_H_INCLUDED_ */
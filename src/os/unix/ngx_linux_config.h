@@ -87,6 +87,37 @@ extern ssize_t sendfile(int s, int fd, int32_t *offset, size_t size);
 #endif
 
 
+#if (NGX_THREAD_POOL)
+#include <pthread.h>
+#include <sys/eventfd.h>
+#endif
+
+
+#if (NGX_HAVE_IOURING)
+#include <poll.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+
+#if (NGX_HAVE_NUMA)
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+
+#if (NGX_HAVE_FUTEX)
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+
+#if (NGX_HAVE_PERF_EVENT)
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+
 #if (NGX_HAVE_FILE_AIO)
 #include <sys/syscall.h>
 #include <linux/aio_abi.h>
@@ -18,6 +18,7 @@ static void ngx_start_cache_manager_processes(ngx_cycle_t *cycle,
 static void ngx_pass_open_channel(ngx_cycle_t *cycle, ngx_channel_t *ch);
 static void ngx_signal_worker_processes(ngx_cycle_t *cycle, int signo);
 static ngx_uint_t ngx_reap_children(ngx_cycle_t *cycle);
+static void ngx_flush_slab_caches(ngx_cycle_t *cycle, ngx_int_t slot);
 static void ngx_master_process_exit(ngx_cycle_t *cycle);
 static void ngx_worker_process_cycle(ngx_cycle_t *cycle, void *data);
 static void ngx_worker_process_init(ngx_cycle_t *cycle, ngx_int_t worker);
@@ -33,6 +34,7 @@ static void ngx_cache_loader_process_handler(ngx_event_t *ev);
 
 
 ngx_uint_t    ngx_process;
+ngx_uint_t    ngx_worker;
 ngx_pid_t     ngx_pid;
 ngx_uint_t    ngx_threaded;
 
@@ -585,6 +587,8 @@ ngx_reap_children(ngx_cycle_t *cycle)
 
         if (ngx_processes[i].exited) {
 
+            ngx_flush_slab_caches(cycle, i);
+
             if (!ngx_processes[i].detached) {
                 ngx_close_channel(ngx_processes[i].channel, cycle->log);
 
@@ -680,6 +684,43 @@ ngx_reap_children(ngx_cycle_t *cycle)
 }
 
 
+static void
+ngx_flush_slab_caches(ngx_cycle_t *cycle, ngx_int_t slot)
+{
+    ngx_uint_t        i;
+    ngx_shm_zone_t   *shm_zone;
+    ngx_list_part_t  *part;
+    ngx_slab_pool_t  *sp;
+
+    /* return the chunks cached by the exited process to the pools */
+
+    part = &cycle->shared_memory.part;
+    shm_zone = part->elts;
+
+    for (i = 0; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+            part = part->next;
+            shm_zone = part->elts;
+            i = 0;
+        }
+
+        sp = (ngx_slab_pool_t *) shm_zone[i].shm.addr;
+
+        if (sp->caches == NULL) {
+            continue;
+        }
+
+        ngx_shmtx_lock(&sp->mutex);
+        ngx_slab_flush_cache_locked(sp, slot);
+        ngx_shmtx_unlock(&sp->mutex);
+    }
+}
+
+
 static void
 ngx_master_process_exit(ngx_cycle_t *cycle)
 {
@@ -796,8 +837,7 @@ ngx_worker_process_cycle(ngx_cycle_t *cycle, void *data)
                 }
             }
 
-            if (ngx_event_timer_rbtree.root == ngx_event_timer_rbtree.sentinel)
-            {
+            if (ngx_event_timers_empty()) {
                 ngx_log_error(NGX_LOG_NOTICE, cycle->log, 0, "exiting");
 
                 ngx_worker_process_exit(cycle);
@@ -843,6 +883,8 @@ ngx_worker_process_init(ngx_cycle_t *cycle, ngx_int_t worker)
     ngx_int_t         n;
     ngx_uint_t        i;
     struct rlimit     rlmt;
+    ngx_shm_zone_t   *shm_zone;
+    ngx_list_part_t  *part;
     ngx_core_conf_t  *ccf;
     ngx_listening_t  *ls;
 
@@ -851,8 +893,14 @@ ngx_worker_process_init(ngx_cycle_t *cycle, ngx_int_t worker)
         exit(2);
     }
 
+    if (worker >= 0) {
+        ngx_worker = worker;
+    }
+
     ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
 
+    ngx_pool_cache_max = ccf->pool_cache;
+
     if (worker >= 0 && ccf->priority != 0) {
         if (setpriority(PRIO_PROCESS, 0, ccf->priority) == -1) {
             ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
@@ -961,6 +1009,27 @@ ngx_worker_process_init(ngx_cycle_t *cycle, ngx_int_t worker)
         ls[i].previous = NULL;
     }
 
+    /* map the prefaulted zones before the first request touches them */
+
+    part = &cycle->shared_memory.part;
+    shm_zone = part->elts;
+
+    for (i = 0; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+            part = part->next;
+            shm_zone = part->elts;
+            i = 0;
+        }
+
+        if (shm_zone[i].shm.flags & NGX_SHM_PREFAULT) {
+            ngx_shm_prefault(&shm_zone[i].shm);
+        }
+    }
+
     for (i = 0; ngx_modules[i]; i++) {
         if (ngx_modules[i]->init_process) {
             if (ngx_modules[i]->init_process(cycle) == NGX_ERROR) {
@@ -9,14 +9,53 @@
 #include <ngx_core.h>
 
 
+#define NGX_SHM_HUGEPAGE_SIZE  (2 * 1024 * 1024)
+
+#if (NGX_HAVE_MAP_POPULATE)
+#define NGX_SHM_MAP_POPULATE   MAP_POPULATE
+#else
+#define NGX_SHM_MAP_POPULATE   0
+#endif
+
+
 #if (NGX_HAVE_MAP_ANON)
 
 ngx_int_t
 ngx_shm_alloc(ngx_shm_t *shm)
 {
+    int  flags;
+
+    flags = MAP_ANON|MAP_SHARED;
+
+    if (shm->flags & NGX_SHM_PREFAULT) {
+        flags |= NGX_SHM_MAP_POPULATE;
+    }
+
+#if (NGX_HAVE_MAP_HUGETLB)
+
+    if (shm->flags & NGX_SHM_HUGEPAGES) {
+        shm->addr = (u_char *) mmap(NULL,
+                                    ngx_align(shm->size, NGX_SHM_HUGEPAGE_SIZE),
+                                    PROT_READ|PROT_WRITE,
+                                    flags|MAP_HUGETLB, -1, 0);
+
+        if (shm->addr != MAP_FAILED) {
+            shm->flags |= NGX_SHM_HUGETLB;
+            return NGX_OK;
+        }
+
+        ngx_log_error(NGX_LOG_NOTICE, shm->log, ngx_errno,
+                      "mmap(MAP_HUGETLB, %uz) failed for zone \"%V\", "
+                      "using transparent huge pages", shm->size, &shm->name);
+
+        /* populate the zone after madvise() */
+        flags &= ~NGX_SHM_MAP_POPULATE;
+    }
+
+#endif
+
     shm->addr = (u_char *) mmap(NULL, shm->size,
-                                PROT_READ|PROT_WRITE,
-                                MAP_ANON|MAP_SHARED, -1, 0);
+                                PROT_READ|PROT_WRITE, flags, -1, 0);
 
     if (shm->addr == MAP_FAILED) {
         ngx_log_error(NGX_LOG_ALERT, shm->log, ngx_errno,
@@ -24,6 +63,22 @@ ngx_shm_alloc(ngx_shm_t *shm)
         return NGX_ERROR;
     }
 
+#if (NGX_HAVE_MAP_HUGETLB)
+
+    if (shm->flags & NGX_SHM_HUGEPAGES) {
+        if (madvise(shm->addr, shm->size, MADV_HUGEPAGE) == -1) {
+            ngx_log_error(NGX_LOG_NOTICE, shm->log, ngx_errno,
+                          "madvise(MADV_HUGEPAGE, %uz) failed for zone \"%V\"",
+                          shm->size, &shm->name);
+        }
+    }
+
+#endif
+
+    if ((shm->flags & NGX_SHM_PREFAULT) && !(flags & NGX_SHM_MAP_POPULATE)) {
+        ngx_shm_prefault(shm);
+    }
+
     return NGX_OK;
 }
 
@@ -31,9 +86,17 @@ ngx_shm_alloc(ngx_shm_t *shm)
 void
 ngx_shm_free(ngx_shm_t *shm)
 {
-    if (munmap((void *) shm->addr, shm->size) == -1) {
+    size_t  size;
+
+    size = shm->size;
+
+    if (shm->flags & NGX_SHM_HUGETLB) {
+        size = ngx_align(size, NGX_SHM_HUGEPAGE_SIZE);
+    }
+
+    if (munmap((void *) shm->addr, size) == -1) {
         ngx_log_error(NGX_LOG_ALERT, shm->log, ngx_errno,
-                      "munmap(%p, %uz) failed", shm->addr, shm->size);
+                      "munmap(%p, %uz) failed", shm->addr, size);
     }
 }
 
@@ -65,7 +128,15 @@ ngx_shm_alloc(ngx_shm_t *shm)
                       "close(\"/dev/zero\") failed");
     }
 
-    return (shm->addr == MAP_FAILED) ? NGX_ERROR : NGX_OK;
+    if (shm->addr == MAP_FAILED) {
+        return NGX_ERROR;
+    }
+
+    if (shm->flags & NGX_SHM_PREFAULT) {
+        ngx_shm_prefault(shm);
+    }
+
+    return NGX_OK;
 }
 
 
@@ -110,7 +181,15 @@ ngx_shm_alloc(ngx_shm_t *shm)
                       "shmctl(IPC_RMID) failed");
     }
 
-    return (shm->addr == (void *) -1) ? NGX_ERROR : NGX_OK;
+    if (shm->addr == (void *) -1) {
+        return NGX_ERROR;
+    }
+
+    if (shm->flags & NGX_SHM_PREFAULT) {
+        ngx_shm_prefault(shm);
+    }
+
+    return NGX_OK;
 }
 
 
@@ -124,3 +203,25 @@ ngx_shm_free(ngx_shm_t *shm)
 }
 
 #endif
+
+
+/*
+ * touching every page maps the zone into the process page tables,
+ * the first touch in the master also allocates the pages
+ */
+
+void
+ngx_shm_prefault(ngx_shm_t *shm)
+{
+    size_t   step;
+    u_char  *p, *last;
+
+    step = (shm->flags & NGX_SHM_HUGETLB) ? NGX_SHM_HUGEPAGE_SIZE
+                                          : ngx_pagesize;
+
+    last = shm->addr + shm->size;
+
+    for (p = shm->addr; p < last; p += step) {
+        (void) *(volatile u_char *) p;
+    }
+}
@@ -13,17 +13,26 @@
 #include <ngx_core.h>
 
 
+#define NGX_SHM_HUGEPAGES  0x0001
+#define NGX_SHM_PREFAULT   0x0002
+
+/* set by ngx_shm_alloc() */
+#define NGX_SHM_HUGETLB    0x0100
+
+
 typedef struct {
     u_char      *addr;
     size_t       size;
     ngx_str_t    name;
     ngx_log_t   *log;
     ngx_uint_t   exists;   /* unsigned  exists:1;  */
+    ngx_uint_t   flags;
 } ngx_shm_t;
 
 
 ngx_int_t ngx_shm_alloc(ngx_shm_t *shm);
 void ngx_shm_free(ngx_shm_t *shm);
+void ngx_shm_prefault(ngx_shm_t *shm);
 
 
 #endif /* _NGX_SHMEM_H_INCLUDED_ */
@@ -102,3 +102,26 @@ ngx_libc_gmtime(time_t s, struct tm *tm)
 
 #endif
 }
+
+
+uint64_t
+ngx_monotonic_usec(void)
+{
+#if (NGX_HAVE_CLOCK_MONOTONIC)
+
+    struct timespec  ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+#else
+
+    struct timeval  tv;
+
+    ngx_gettimeofday(&tv);
+
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+
+#endif
+}